@@ -12,16 +12,74 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "../application/espnow_sender.h"
 #include "../drivers/espnow/espnow.h"
 #include "../drivers/nvs/nvs.h"
 #include "../config/esp32-config.h"
+#include "../utils/holt_predictor.h"
+
+#if HUB_INFLUX_FORWARD
+#include "../application/hub_influx_aggregator.h"
+#include "../drivers/influxdb/influxdb_client.h"
+#include "../drivers/wifi/wifi_manager.h"
+#include "../utils/ntp_time.h"
+#endif // HUB_INFLUX_FORWARD
 
 static const char *TAG = "HUB";
 
+#define HUB_MAX_MODELS  16     ///< Sensors whose moisture predictor the hub tracks
+
+/**
+ * @brief Moisture predictor adopted from a sensor's last report
+ */
+typedef struct {
+    char device_id[32];
+    holt_model_t model;
+} hub_sensor_model_t;
+
+static hub_sensor_model_t s_models[HUB_MAX_MODELS];
+static size_t s_model_count = 0;
+
+/**
+ * @brief Recover the samples a sensor withheld, then adopt its new model
+ *
+ * The sensor stepped the same model without observations for each withheld
+ * sample, so the predictions are within its deadband of the real values.
+ */
+static void hub_track_model(const espnow_sensor_data_t *sensor_data)
+{
+    hub_sensor_model_t *entry = NULL;
+    for (size_t i = 0; i < s_model_count; i++) {
+        if (strncmp(s_models[i].device_id, sensor_data->device_id, sizeof(s_models[i].device_id)) == 0) {
+            entry = &s_models[i];
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        for (uint32_t step = 1; step <= sensor_data->suppressed; step++) {
+            int32_t predicted = holt_predict(&entry->model, step);
+            ESP_LOGI(TAG, "Withheld sample %lu/%lu: moisture ~%ld.%02ld%%",
+                     (unsigned long)step, (unsigned long)sensor_data->suppressed,
+                     (long)(predicted / 100), (long)abs(predicted % 100));
+        }
+    } else if (s_model_count < HUB_MAX_MODELS) {
+        entry = &s_models[s_model_count++];
+        strncpy(entry->device_id, sensor_data->device_id, sizeof(entry->device_id) - 1);
+    } else {
+        ESP_LOGW(TAG, "Model table full, not tracking %s", sensor_data->device_id);
+        return;
+    }
+
+    entry->model.level = sensor_data->model_level;
+    entry->model.trend = sensor_data->model_trend;
+}
+
 /**
  * @brief ESP-NOW receive callback
  * 
@@ -29,6 +87,7 @@ static const char *TAG = "HUB";
  */
 static void espnow_recv_callback(const uint8_t *mac_addr, const uint8_t *data, int len)
 {
+    int64_t rx_us = esp_timer_get_time();
     if (len < 1) {
         return;
     }
@@ -49,8 +108,30 @@ static void espnow_recv_callback(const uint8_t *mac_addr, const uint8_t *data, i
         ESP_LOGI(TAG, "Soil Raw ADC: %d", sensor_data->soil_raw_adc);
         ESP_LOGI(TAG, "Battery Voltage: %.3f V", sensor_data->battery_voltage);
         ESP_LOGI(TAG, "Battery Percentage: %.1f%%", sensor_data->battery_percentage);
+        ESP_LOGI(TAG, "Withheld Before: %lu", (unsigned long)sensor_data->suppressed);
         ESP_LOGI(TAG, "===========================");
 
+        if (sensor_data->has_model) {
+            hub_track_model(sensor_data);
+        }
+
+#if HUB_INFLUX_FORWARD
+        telemetry_sample_t sample = {
+            .timestamp_ms = sensor_data->timestamp_ms,
+            .soil_voltage = sensor_data->soil_voltage,
+            .moisture_percent = sensor_data->soil_moisture_percent,
+            .soil_raw_adc = sensor_data->soil_raw_adc,
+            .battery_voltage = sensor_data->battery_voltage,
+            .battery_percent = sensor_data->battery_percentage,
+        };
+        strncpy(sample.device_id, sensor_data->device_id, sizeof(sample.device_id) - 1);
+        if (sample.timestamp_ms == 0 && ntp_time_is_synced()) {
+            // Sensor without time: stamp on arrival
+            sample.timestamp_ms = ntp_time_get_timestamp_ms();
+        }
+        hub_influx_aggregator_add(&sample);
+#endif // HUB_INFLUX_FORWARD
+
         // Add sensor as peer temporarily to send ACK
         uint8_t current_channel = espnow_get_channel();
         esp_err_t peer_err = espnow_add_peer(mac_addr, current_channel, false);
@@ -59,9 +140,9 @@ static void espnow_recv_callback(const uint8_t *mac_addr, const uint8_t *data, i
             return;
         }
 
-        // Send ACK back to sensor
-        uint8_t ack_msg[1] = {ESPNOW_MSG_TYPE_ACK};
-        esp_err_t ret = esp_now_send(mac_addr, ack_msg, sizeof(ack_msg));
+        // Send ACK back to sensor, with our time so it can set its clock
+        esp_err_t ret = espnow_send_ack_time(mac_addr, ntp_time_get_timestamp_ms(),
+                                             (uint32_t)(esp_timer_get_time() - rx_us));
         if (ret == ESP_OK) {
             ESP_LOGI(TAG, "ACK sent to " MACSTR, MAC2STR(mac_addr));
         } else {
@@ -96,6 +177,40 @@ static void hub_task(void *pvParameters)
     nvs_driver_save(NVS_NAMESPACE, "hub_channel", &hub_channel, sizeof(hub_channel));
     ESP_LOGI(TAG, "Hub channel rotating: %d (old) -> %d (new)", stored_channel, hub_channel);
 
+#if HUB_INFLUX_FORWARD
+    // Uplink to InfluxDB; while associated the radio stays on the AP channel
+    ESP_LOGI(TAG, "Connecting uplink...");
+    wifi_manager_config_t wifi_config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASSWORD,
+        .max_retry = WIFI_MAX_RETRY,
+    };
+    wifi_manager_init(&wifi_config, NULL);
+    if (wifi_manager_connect() == ESP_OK) {
+        wifi_second_chan_t second;
+        wifi_manager_get_channel(&hub_channel, &second);
+        ESP_LOGI(TAG, "Uplink connected, hub follows AP channel %d", hub_channel);
+
+        ntp_time_init(NULL);
+        ntp_time_wait_for_sync(NTP_SYNC_TIMEOUT_MS);
+
+        influxdb_client_config_t influxdb_config = {
+            .server = INFLUXDB_SERVER,
+            .port = INFLUXDB_PORT,
+            .bucket = INFLUXDB_BUCKET,
+            .org = INFLUXDB_ORG,
+            .token = INFLUXDB_TOKEN,
+            .endpoint = INFLUXDB_ENDPOINT,
+            .timeout_ms = 10000,
+            .max_retries = 3
+        };
+        influxdb_client_init(&influxdb_config);
+        hub_influx_aggregator_init(NULL);
+    } else {
+        ESP_LOGW(TAG, "Uplink not available, forwarding disabled");
+    }
+#endif // HUB_INFLUX_FORWARD
+
     // Initialize ESP-NOW
     ESP_LOGI(TAG, "Initializing ESP-NOW...");
     esp_err_t ret = espnow_init();
@@ -125,6 +240,9 @@ static void hub_task(void *pvParameters)
     // Keep task running
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(10000));
+#if HUB_INFLUX_FORWARD
+        hub_influx_aggregator_log_stats();
+#endif // HUB_INFLUX_FORWARD
     }
 
     espnow_deinit();
@@ -0,0 +1,103 @@
+/**
+ * @file adaptive_sleep.c
+ * @brief Adaptive deep sleep interval driven by the moisture rate of change - Implementation
+ */
+
+#include "adaptive_sleep.h"
+#include "../config/esp32-config.h"
+#include "../utils/esp_utils.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define RATE_SMOOTHING      0.5f        ///< Weight of the newest rate in the moving average
+#define MAX_GROWTH          2           ///< Interval grows at most by this factor per wake
+
+static const char* TAG = "ADAPTIVE_SLEEP";
+
+/**
+ * @brief Scheduler state, survives deep sleep
+ */
+typedef struct {
+    bool initialized;
+    float last_moisture;            ///< Moisture of the previous wake
+    uint64_t last_time_ms;          ///< System time of the previous wake
+    float rate_per_hour;            ///< Smoothed |dM/dt| in percent per hour
+    uint32_t interval_s;            ///< Current sleep interval
+} adaptive_sleep_state_t;
+
+static RTC_DATA_ATTR adaptive_sleep_state_t s_state;
+
+static uint32_t clamp_u32(uint32_t value, uint32_t lo, uint32_t hi) {
+    return (value < lo) ? lo : (value > hi) ? hi : value;
+}
+
+/**
+ * @brief Lower bound, raised linearly towards the maximum below the battery threshold
+ */
+static uint32_t min_interval(float battery_percent) {
+    uint32_t min_s = ADAPTIVE_SLEEP_MIN_SECONDS;
+    if (battery_percent < ADAPTIVE_SLEEP_BATTERY_LOW_PERCENT) {
+        float deficit = 1.0f - fmaxf(battery_percent, 0.0f) / ADAPTIVE_SLEEP_BATTERY_LOW_PERCENT;
+        min_s += (uint32_t)(deficit * (ADAPTIVE_SLEEP_MAX_SECONDS - ADAPTIVE_SLEEP_MIN_SECONDS));
+    }
+    return min_s;
+}
+
+uint32_t adaptive_sleep_next_seconds(float moisture_percent, float battery_percent) {
+    uint64_t now_ms = esp_utils_get_timestamp_ms();
+
+    if (!s_state.initialized) {
+        // Start at the fixed interval until a rate is known
+        s_state.initialized = true;
+        s_state.rate_per_hour = 0.0f;
+        s_state.interval_s = clamp_u32(DEEP_SLEEP_DURATION_SECONDS, ADAPTIVE_SLEEP_MIN_SECONDS,
+                                       ADAPTIVE_SLEEP_MAX_SECONDS);
+    } else if (now_ms > s_state.last_time_ms) {
+        // A backwards time step (first NTP sync) keeps the old rate
+        float hours = (float)(now_ms - s_state.last_time_ms) / 3600000.0f;
+        float rate = fabsf(moisture_percent - s_state.last_moisture) / hours;
+        // A faster rate (watering) is taken at once, a slower one decays in
+        if (rate > s_state.rate_per_hour) {
+            s_state.rate_per_hour = rate;
+        } else {
+            s_state.rate_per_hour = RATE_SMOOTHING * rate + (1.0f - RATE_SMOOTHING) * s_state.rate_per_hour;
+        }
+    }
+    s_state.last_moisture = moisture_percent;
+    s_state.last_time_ms = now_ms;
+
+    // Time until the soil moves by the target delta at the current rate
+    uint32_t target_s = ADAPTIVE_SLEEP_MAX_SECONDS;
+    if (s_state.rate_per_hour > 0.0f) {
+        float seconds = ADAPTIVE_SLEEP_TARGET_DELTA_PERCENT / s_state.rate_per_hour * 3600.0f;
+        if (seconds < (float)ADAPTIVE_SLEEP_MAX_SECONDS) {
+            target_s = (uint32_t)seconds;
+        }
+    }
+    target_s = clamp_u32(target_s, min_interval(battery_percent), ADAPTIVE_SLEEP_MAX_SECONDS);
+
+    // Hysteresis: ignore small changes; shorten at once, lengthen gradually
+    uint32_t current = s_state.interval_s;
+    uint32_t band = current * ADAPTIVE_SLEEP_HYSTERESIS_PERCENT / 100;
+    if (target_s + band < current) {
+        s_state.interval_s = target_s;
+    } else if (target_s > current + band) {
+        s_state.interval_s = (target_s < current * MAX_GROWTH) ? target_s : current * MAX_GROWTH;
+    }
+    s_state.interval_s = clamp_u32(s_state.interval_s, min_interval(battery_percent), ADAPTIVE_SLEEP_MAX_SECONDS);
+
+    ESP_LOGI(TAG, "Rate %.2f %%/h -> target %lu s, sleeping %lu s",
+             s_state.rate_per_hour, (unsigned long)target_s, (unsigned long)s_state.interval_s);
+    return s_state.interval_s;
+}
+
+float adaptive_sleep_get_rate(void) {
+    return s_state.rate_per_hour;
+}
+
+void adaptive_sleep_reset(void) {
+    memset(&s_state, 0, sizeof(s_state));
+}
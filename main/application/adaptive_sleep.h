@@ -0,0 +1,40 @@
+/**
+ * @file adaptive_sleep.h
+ * @brief Adaptive deep sleep interval driven by the moisture rate of change
+ *
+ * The next sleep is the time the soil needs, at its recent rate of change,
+ * to move by ADAPTIVE_SLEEP_TARGET_DELTA_PERCENT: short during irrigation,
+ * long in dry spells. The result is bounded by ADAPTIVE_SLEEP_MIN_SECONDS and
+ * ADAPTIVE_SLEEP_MAX_SECONDS, the minimum rises on a low battery, and a
+ * hysteresis band keeps the interval from flapping. State lives in RTC memory.
+ */
+
+#ifndef ADAPTIVE_SLEEP_H
+#define ADAPTIVE_SLEEP_H
+
+#include <stdint.h>
+
+/**
+ * @brief Feed this wake's reading and get the next sleep duration
+ *
+ * Call once per wake.
+ *
+ * @param moisture_percent Moisture measured on this wake
+ * @param battery_percent Battery level measured on this wake
+ * @return uint32_t Sleep duration in seconds
+ */
+uint32_t adaptive_sleep_next_seconds(float moisture_percent, float battery_percent);
+
+/**
+ * @brief Smoothed moisture rate of change in percent per hour (absolute)
+ */
+float adaptive_sleep_get_rate(void);
+
+/**
+ * @brief Forget the learned rate and interval, the next wake starts over
+ *
+ * Use when the sensor was moved or replanted.
+ */
+void adaptive_sleep_reset(void);
+
+#endif // ADAPTIVE_SLEEP_H
@@ -7,6 +7,8 @@
 
 #include "espnow_sender.h"
 #include "../drivers/espnow/espnow.h"
+#include "../config/esp32-config.h"
+#include "../utils/time_sync.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_wifi.h"
@@ -49,6 +51,19 @@ static bool is_mac_valid(const uint8_t *mac)
     return !is_zero_mac(mac);
 }
 
+/**
+ * @brief Set the clock from the ACK's hub time (ESP-NOW-only, WiFi has NTP)
+ */
+static void apply_hub_time(void)
+{
+    espnow_ack_time_t ack_time;
+    if (wifi_is_connected || espnow_get_ack_time(&ack_time) != ESP_OK) {
+        return;
+    }
+    time_sync_apply_hub_time(ack_time.hub_time_ms, ack_time.rtt_us,
+                             ack_time.hub_hold_us, ack_time.rx_local_us);
+}
+
 /**
  * @brief Try to send data on current channel with retries
  * 
@@ -66,9 +81,16 @@ static bool try_send_with_retries(const uint8_t *target_mac,
             target_mac, data, data_len, s_config.ack_timeout_ms);
 
         if (status == ESPNOW_SEND_SUCCESS) {
+            apply_hub_time();
             return true;
         }
 
+        // Link-layer failure is already known after a few ms, no need to
+        // give the hub extra time before the next attempt
+        if (status == ESPNOW_SEND_LINK_FAIL) {
+            continue;
+        }
+
         if (retry < s_config.max_retries - 1) {
             vTaskDelay(pdMS_TO_TICKS(s_config.retry_delay_ms));
         }
@@ -121,7 +143,11 @@ esp_err_t espnow_sender_init(const espnow_sender_config_t *config,
     wifi_is_connected = false;
 
     // Initialize WiFi for ESP-NOW
+#if ESPNOW_LEAN_WIFI_INIT
+    esp_err_t err = espnow_init_wifi_lean(initial_channel, tx_power_dbm);
+#else
     esp_err_t err = espnow_init_wifi(initial_channel, tx_power_dbm);
+#endif // ESPNOW_LEAN_WIFI_INIT
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "WiFi init failed: %s", esp_err_to_name(err));
         return err;
@@ -317,6 +343,13 @@ espnow_sender_status_t espnow_sender_send_data(const espnow_sensor_data_t *data,
         }
     }
 
+    espnow_stats_t stats;
+    espnow_get_stats(&stats);
+    ESP_LOGI(TAG, "TX stats: %lu frames, link ok %.0f%%, app ACK %.0f%%",
+             stats.tx_frames,
+             espnow_stats_link_success_rate(&stats),
+             espnow_stats_app_success_rate(&stats));
+
     // Handle result
     if (success) {
         // Get ACK responder MAC (for discovery)
@@ -33,6 +33,12 @@ typedef struct __attribute__((packed)) {
     // Battery data
     float battery_voltage;          ///< Battery voltage
     float battery_percentage;       ///< Battery percentage (0-100)
+
+    // Report policy
+    uint32_t suppressed;            ///< Samples withheld since the previous packet
+    uint8_t has_model;              ///< model_level/model_trend are valid
+    int32_t model_level;            ///< Shared moisture predictor after this sample (holt_model_t)
+    int32_t model_trend;            ///< See utils/holt_predictor.h
 } espnow_sensor_data_t;
 
 /**
@@ -0,0 +1,475 @@
+/**
+ * @file hub_influx_aggregator.c
+ * @brief Hub-side InfluxDB write aggregation - Implementation
+ */
+
+#include "hub_influx_aggregator.h"
+#include "influxdb_sender.h"
+#include "../drivers/influxdb/influxdb_client.h"
+#include "../config/esp32-config.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HUB_AGG_STACK       8192        ///< TLS handshake
+#define HUB_AGG_PRIO        4
+#define HUB_AGG_LINE_MAX    192
+
+#if HUB_AGG_MAX_DEVICES > 32
+#error "HUB_AGG_MAX_DEVICES must fit the device mask of a snapshot (32)"
+#endif
+
+static const char* TAG = "HUB_AGG";
+
+/**
+ * @brief Pending points, one array per field (oldest first)
+ */
+typedef struct {
+    uint32_t seq[HUB_AGG_MAX_POINTS];               ///< Insertion sequence
+    uint8_t device[HUB_AGG_MAX_POINTS];             ///< Index into the device table
+    TickType_t added_at[HUB_AGG_MAX_POINTS];        ///< For the latency trigger
+    uint64_t timestamp_ms[HUB_AGG_MAX_POINTS];
+    float soil_voltage[HUB_AGG_MAX_POINTS];
+    float moisture_percent[HUB_AGG_MAX_POINTS];
+    int32_t soil_raw_adc[HUB_AGG_MAX_POINTS];
+    float battery_voltage[HUB_AGG_MAX_POINTS];
+    float battery_percent[HUB_AGG_MAX_POINTS];
+    uint16_t line_bytes[HUB_AGG_MAX_POINTS];        ///< Encoded size of both lines
+    size_t count;
+} point_columns_t;
+
+static point_columns_t s_cols;
+static char s_devices[HUB_AGG_MAX_DEVICES][32];
+static uint8_t s_device_pending[HUB_AGG_MAX_DEVICES];    ///< Buffered points per device
+static size_t s_device_count = 0;
+static size_t s_pending_bytes = 0;
+static uint32_t s_next_seq = 1;
+static hub_influx_aggregator_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Owned by the aggregator task
+static hub_influx_aggregator_config_t s_config;
+static TaskHandle_t s_task = NULL;
+static point_columns_t s_snapshot;
+static char s_snapshot_devices[HUB_AGG_MAX_DEVICES][32];
+static char* s_body = NULL;
+
+
+
+
+// #####################################
+// MARK: Columns
+// #####################################
+
+/**
+ * @brief Remove n points starting at index start (lock held)
+ */
+static void columns_remove(size_t start, size_t n) {
+    for (size_t i = start; i < start + n; i++) {
+        s_pending_bytes -= s_cols.line_bytes[i];
+        s_device_pending[s_cols.device[i]]--;
+    }
+    size_t tail = s_cols.count - start - n;
+
+#define SHIFT(col) memmove(&s_cols.col[start], &s_cols.col[start + n], tail * sizeof(s_cols.col[0]))
+    SHIFT(seq);
+    SHIFT(device);
+    SHIFT(added_at);
+    SHIFT(timestamp_ms);
+    SHIFT(soil_voltage);
+    SHIFT(moisture_percent);
+    SHIFT(soil_raw_adc);
+    SHIFT(battery_voltage);
+    SHIFT(battery_percent);
+    SHIFT(line_bytes);
+#undef SHIFT
+
+    s_cols.count -= n;
+}
+
+/**
+ * @brief Drop one point to make room (lock held)
+ *
+ * Backlog goes first: the oldest point of a device that has a newer one
+ * buffered. Only when every point is some device's latest, the oldest overall.
+ */
+static void columns_shed_one(void) {
+    size_t victim = 0;
+    for (size_t i = 0; i < s_cols.count; i++) {
+        if (s_device_pending[s_cols.device[i]] > 1) {
+            victim = i;
+            break;
+        }
+    }
+    columns_remove(victim, 1);
+    s_stats.points_shed++;
+}
+
+/**
+ * @brief Find or add a device (lock held)
+ *
+ * @return Device index, -1 if the table is full of devices with pending points
+ */
+static int device_index(const char* device_id) {
+    for (size_t i = 0; i < s_device_count; i++) {
+        if (strncmp(s_devices[i], device_id, sizeof(s_devices[i])) == 0) {
+            return (int)i;
+        }
+    }
+    if (s_device_count < HUB_AGG_MAX_DEVICES) {
+        strncpy(s_devices[s_device_count], device_id, sizeof(s_devices[0]) - 1);
+        return (int)s_device_count++;
+    }
+
+    // Reuse the slot of a device without pending points
+    for (size_t d = 0; d < HUB_AGG_MAX_DEVICES; d++) {
+        if (s_device_pending[d] == 0) {
+            memset(s_devices[d], 0, sizeof(s_devices[d]));
+            strncpy(s_devices[d], device_id, sizeof(s_devices[d]) - 1);
+            return (int)d;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Copy the first n points and the names of their devices (lock held)
+ *
+ * Only the columns the encoder reads; the device names are copied because a
+ * slot can be reused once its points were shed during the write.
+ */
+static void snapshot_take(size_t n) {
+#define COPY(col) memcpy(s_snapshot.col, s_cols.col, n * sizeof(s_cols.col[0]))
+    COPY(seq);
+    COPY(device);
+    COPY(timestamp_ms);
+    COPY(soil_voltage);
+    COPY(moisture_percent);
+    COPY(soil_raw_adc);
+    COPY(battery_voltage);
+    COPY(battery_percent);
+#undef COPY
+    s_snapshot.count = n;
+
+    uint32_t copied = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t d = s_cols.device[i];
+        if ((copied & (1UL << d)) == 0) {
+            memcpy(s_snapshot_devices[d], s_devices[d], sizeof(s_devices[d]));
+            copied |= 1UL << d;
+        }
+    }
+}
+
+static void to_influx(const point_columns_t* cols, const char (*devices)[32], size_t i,
+                      influxdb_soil_data_t* soil, influxdb_battery_data_t* battery) {
+    uint64_t timestamp_ns = cols->timestamp_ms[i] * 1000000ULL;
+
+    memset(soil, 0, sizeof(*soil));
+    soil->timestamp_ns = timestamp_ns;
+    soil->voltage = cols->soil_voltage[i];
+    soil->moisture_percent = cols->moisture_percent[i];
+    soil->raw_adc = cols->soil_raw_adc[i];
+    strncpy(soil->device_id, devices[cols->device[i]], sizeof(soil->device_id) - 1);
+
+    memset(battery, 0, sizeof(*battery));
+    battery->timestamp_ns = timestamp_ns;
+    battery->voltage = cols->battery_voltage[i];
+    battery->percentage = cols->battery_percent[i];
+    strncpy(battery->device_id, devices[cols->device[i]], sizeof(battery->device_id) - 1);
+}
+
+
+
+
+// #####################################
+// MARK: Flush
+// #####################################
+
+/**
+ * @brief Default transport: one POST through the InfluxDB client
+ */
+static esp_err_t influxdb_transport(const char* body, size_t len, void* ctx) {
+    (void)len;
+    (void)ctx;
+    return influxdb_send_line_protocol(body);
+}
+
+/**
+ * @brief Encode a snapshot grouped by measurement and write it
+ *
+ * @return ESP_OK if nothing was pending or the write succeeded
+ */
+static esp_err_t aggregator_flush(void) {
+    // Take as many points as fit into the body, the rest waits for the next flush.
+    // Only those are copied, the receive callback waits for no more than that.
+    portENTER_CRITICAL(&s_lock);
+    size_t take = 0;
+    size_t bytes = 0;
+    while (take < s_cols.count && bytes + s_cols.line_bytes[take] < HUB_AGG_BODY_BYTES) {
+        bytes += s_cols.line_bytes[take];
+        take++;
+    }
+    snapshot_take(take);
+    portEXIT_CRITICAL(&s_lock);
+    if (take == 0) {
+        return ESP_OK;
+    }
+
+    // Soil lines first, then battery: same measurement and tag keys repeat back to back
+    size_t len = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < take; i++) {
+            influxdb_soil_data_t soil;
+            influxdb_battery_data_t battery;
+            to_influx(&s_snapshot, (const char (*)[32])s_snapshot_devices, i, &soil, &battery);
+            int n = (pass == 0)
+                ? influxdb_format_soil_line(&soil, &s_body[len], HUB_AGG_BODY_BYTES - len)
+                : influxdb_format_battery_line(&battery, &s_body[len], HUB_AGG_BODY_BYTES - len);
+            if (n <= 0 || (size_t)n + 1 >= HUB_AGG_BODY_BYTES - len) {
+                break;
+            }
+            len += (size_t)n;
+            s_body[len++] = '\n';
+        }
+    }
+    if (len > 0) {
+        s_body[--len] = '\0';
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    esp_err_t err = s_config.transport(s_body, len, s_config.transport_ctx);
+    uint32_t elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK) {
+        // Points shed meanwhile are counted as shed; the rest are still at the front
+        uint32_t last_seq = s_snapshot.seq[take - 1];
+        size_t written = 0;
+        while (written < s_cols.count && s_cols.seq[written] <= last_seq) {
+            written++;
+        }
+        columns_remove(0, written);
+        s_stats.points_written += written;
+        s_stats.flushes++;
+        s_stats.last_flush_ms = elapsed_ms;
+        s_stats.last_flush_bytes = len;
+    } else {
+        s_stats.flush_failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Wrote %u point(s) in %u bytes (%lu ms)", (unsigned)take, (unsigned)len,
+                 (unsigned long)elapsed_ms);
+    } else {
+        ESP_LOGW(TAG, "Write of %u point(s) failed: %s", (unsigned)take, esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * @brief Whether a count, size or latency trigger holds
+ */
+static bool flush_due(TickType_t max_latency) {
+    TickType_t now = xTaskGetTickCount();
+    portENTER_CRITICAL(&s_lock);
+    bool due = s_cols.count >= HUB_AGG_FLUSH_POINTS || s_pending_bytes >= HUB_AGG_FLUSH_BYTES ||
+               (s_cols.count > 0 && now - s_cols.added_at[0] >= max_latency);
+    portEXIT_CRITICAL(&s_lock);
+    return due;
+}
+
+static void aggregator_task(void* pvParameters) {
+    (void)pvParameters;
+    const TickType_t max_latency = pdMS_TO_TICKS(s_config.max_latency_ms);
+    TickType_t retry_at = 0;
+    bool backoff = false;
+
+    while (1) {
+        // Latency trigger: wake when the oldest point is due
+        TickType_t wait = portMAX_DELAY;
+        TickType_t now = xTaskGetTickCount();
+        portENTER_CRITICAL(&s_lock);
+        if (s_cols.count > 0) {
+            TickType_t age = now - s_cols.added_at[0];
+            wait = (age >= max_latency) ? 0 : max_latency - age;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        // After a failed write, do not hammer a slow uplink
+        if (backoff && (int32_t)(retry_at - now) > 0 && wait < retry_at - now) {
+            wait = retry_at - now;
+        }
+
+        ulTaskNotifyTake(pdTRUE, wait);
+        if (backoff && (int32_t)(retry_at - xTaskGetTickCount()) > 0) {
+            continue;
+        }
+        // The first point only wakes the task to arm the latency trigger
+        if (!backoff && !flush_due(max_latency)) {
+            continue;
+        }
+
+        backoff = (aggregator_flush() != ESP_OK);
+        if (backoff) {
+            retry_at = xTaskGetTickCount() + max_latency;
+        }
+    }
+}
+
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+esp_err_t hub_influx_aggregator_init(const hub_influx_aggregator_config_t* config) {
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    memset(&s_config, 0, sizeof(s_config));
+    if (config != NULL) {
+        s_config = *config;
+    }
+    if (s_config.max_latency_ms == 0) {
+        s_config.max_latency_ms = HUB_AGG_MAX_LATENCY_MS;
+    }
+    if (s_config.transport == NULL) {
+        if (!influxdb_client_is_initialized()) {
+            ESP_LOGE(TAG, "InfluxDB client not initialized");
+            return ESP_ERR_INVALID_STATE;
+        }
+        s_config.transport = influxdb_transport;
+    }
+
+    s_body = malloc(HUB_AGG_BODY_BYTES);
+    if (s_body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&s_cols, 0, sizeof(s_cols));
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_devices, 0, sizeof(s_devices));
+    memset(s_device_pending, 0, sizeof(s_device_pending));
+    s_device_count = 0;
+    s_pending_bytes = 0;
+
+    if (xTaskCreate(aggregator_task, "hub_agg", HUB_AGG_STACK, NULL, HUB_AGG_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create aggregator task");
+        free(s_body);
+        s_body = NULL;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Aggregator started (%d points, flush at %d points / %d bytes / %lu ms)",
+             HUB_AGG_MAX_POINTS, HUB_AGG_FLUSH_POINTS, HUB_AGG_FLUSH_BYTES,
+             (unsigned long)s_config.max_latency_ms);
+    return ESP_OK;
+}
+
+esp_err_t hub_influx_aggregator_add(const telemetry_sample_t* sample) {
+    if (sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Size the lines outside the lock
+    point_columns_t one = { .timestamp_ms = { sample->timestamp_ms }, .soil_voltage = { sample->soil_voltage },
+                            .moisture_percent = { sample->moisture_percent }, .soil_raw_adc = { sample->soil_raw_adc },
+                            .battery_voltage = { sample->battery_voltage }, .battery_percent = { sample->battery_percent } };
+    char one_device[1][32] = { { 0 } };
+    strncpy(one_device[0], sample->device_id, sizeof(one_device[0]) - 1);
+    influxdb_soil_data_t soil;
+    influxdb_battery_data_t battery;
+    to_influx(&one, (const char (*)[32])one_device, 0, &soil, &battery);
+    char line[HUB_AGG_LINE_MAX];
+    int soil_len = influxdb_format_soil_line(&soil, line, sizeof(line));
+    int battery_len = influxdb_format_battery_line(&battery, line, sizeof(line));
+    if (soil_len <= 0 || battery_len <= 0 || soil_len >= (int)sizeof(line) || battery_len >= (int)sizeof(line)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bool notify = false;
+    esp_err_t ret = ESP_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    int device = device_index(sample->device_id);
+    if (device < 0) {
+        s_stats.points_shed++;
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        if (s_cols.count >= HUB_AGG_MAX_POINTS) {
+            columns_shed_one();
+        }
+        size_t i = s_cols.count++;
+        s_cols.seq[i] = s_next_seq++;
+        s_cols.device[i] = (uint8_t)device;
+        s_device_pending[device]++;
+        s_cols.added_at[i] = xTaskGetTickCount();
+        s_cols.timestamp_ms[i] = sample->timestamp_ms;
+        s_cols.soil_voltage[i] = sample->soil_voltage;
+        s_cols.moisture_percent[i] = sample->moisture_percent;
+        s_cols.soil_raw_adc[i] = sample->soil_raw_adc;
+        s_cols.battery_voltage[i] = sample->battery_voltage;
+        s_cols.battery_percent[i] = sample->battery_percent;
+        s_cols.line_bytes[i] = (uint16_t)(soil_len + battery_len + 2);
+        s_pending_bytes += s_cols.line_bytes[i];
+        s_stats.points_added++;
+
+        // Count and size triggers; the first point arms the latency trigger
+        notify = (s_cols.count == 1 || s_cols.count >= HUB_AGG_FLUSH_POINTS ||
+                  s_pending_bytes >= HUB_AGG_FLUSH_BYTES);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (notify) {
+        xTaskNotifyGive(s_task);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Device table full, sample from %s dropped", sample->device_id);
+    }
+    return ret;
+}
+
+esp_err_t hub_influx_aggregator_deinit(void) {
+    if (s_task != NULL) {
+        vTaskDelete(s_task);
+        s_task = NULL;
+    }
+    free(s_body);
+    s_body = NULL;
+    portENTER_CRITICAL(&s_lock);
+    s_cols.count = 0;
+    s_pending_bytes = 0;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void hub_influx_aggregator_get_stats(hub_influx_aggregator_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    stats->pending = s_cols.count;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void hub_influx_aggregator_log_stats(void) {
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+
+    uint32_t bytes_per_s = (stats.last_flush_ms > 0) ? stats.last_flush_bytes * 1000 / stats.last_flush_ms : 0;
+    ESP_LOGI(TAG, "added=%lu written=%lu shed=%lu pending=%lu flushes=%lu failed=%lu last=%lu B in %lu ms (%lu B/s)",
+             (unsigned long)stats.points_added, (unsigned long)stats.points_written,
+             (unsigned long)stats.points_shed, (unsigned long)stats.pending,
+             (unsigned long)stats.flushes, (unsigned long)stats.flush_failures,
+             (unsigned long)stats.last_flush_bytes, (unsigned long)stats.last_flush_ms,
+             (unsigned long)bytes_per_s);
+}
@@ -0,0 +1,95 @@
+/**
+ * @file hub_influx_aggregator.h
+ * @brief Hub-side InfluxDB write aggregation
+ *
+ * Collects the samples the hub receives from many ESP-NOW sensors in an
+ * in-memory columnar buffer and writes them in few InfluxDB requests, grouped
+ * by measurement. A flush is triggered by point count, encoded size or the
+ * age of the oldest point. When the uplink cannot keep up, backlog is shed
+ * first: the latest sample of every device is kept as long as possible.
+ *
+ * The transport is injectable so the aggregator can run against a fake HTTP
+ * backend on the host.
+ */
+
+#ifndef HUB_INFLUX_AGGREGATOR_H
+#define HUB_INFLUX_AGGREGATOR_H
+
+#include "esp_err.h"
+#include "telemetry_pipeline.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Transport: write one request body of newline-separated lines
+ *
+ * Called from the aggregator task. The body is NUL-terminated.
+ *
+ * @param body Line protocol body
+ * @param len Length of body in bytes
+ * @param ctx Transport context
+ * @return ESP_OK when the server accepted the body, error code otherwise
+ */
+typedef esp_err_t (*hub_influx_transport_t)(const char* body, size_t len, void* ctx);
+
+/**
+ * @brief Aggregator configuration (zero fields take the config defaults)
+ */
+typedef struct {
+    uint32_t max_latency_ms;                ///< Max age of a pending point, also the retry delay (0 = HUB_AGG_MAX_LATENCY_MS)
+    hub_influx_transport_t transport;       ///< NULL = influxdb_send_line_protocol()
+    void* transport_ctx;                    ///< Passed to transport
+} hub_influx_aggregator_config_t;
+
+/**
+ * @brief Aggregator statistics
+ */
+typedef struct {
+    uint32_t points_added;          ///< Samples accepted
+    uint32_t points_shed;           ///< Samples dropped to make room
+    uint32_t points_written;        ///< Samples removed by successful writes (not those shed meanwhile)
+    uint32_t flushes;               ///< Successful writes
+    uint32_t flush_failures;        ///< Failed writes (points kept for the next flush)
+    uint32_t pending;               ///< Samples currently buffered
+    uint32_t last_flush_ms;         ///< Duration of the last successful write
+    uint32_t last_flush_bytes;      ///< Body size of the last successful write
+} hub_influx_aggregator_stats_t;
+
+/**
+ * @brief Start the aggregator task
+ *
+ * influxdb_client_init() must have been called unless a transport is given.
+ *
+ * @param config Configuration, NULL for defaults
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t hub_influx_aggregator_init(const hub_influx_aggregator_config_t* config);
+
+/**
+ * @brief Add a sample (non-blocking, safe from the ESP-NOW receive callback)
+ *
+ * @param sample Sample to write; timestamp_ms 0 lets the server stamp it
+ * @return esp_err_t ESP_OK if buffered (possibly after shedding backlog)
+ */
+esp_err_t hub_influx_aggregator_add(const telemetry_sample_t* sample);
+
+/**
+ * @brief Get aggregator statistics
+ *
+ * @param stats Output statistics
+ */
+void hub_influx_aggregator_get_stats(hub_influx_aggregator_stats_t* stats);
+
+/**
+ * @brief Log aggregator statistics including the write throughput
+ */
+void hub_influx_aggregator_log_stats(void);
+
+/**
+ * @brief Stop the aggregator task, discarding anything not yet written
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t hub_influx_aggregator_deinit(void);
+
+#endif // HUB_INFLUX_AGGREGATOR_H
@@ -1,30 +1,26 @@
+/**
+ * @file influx_sender_task.c
+ * @brief Asynchronous batching InfluxDB writer - Implementation
+ */
 
-
-
-
-
-// ! This file is most likely broken
-// ! Check the implementation before using it
-// ! Make sure the queue is working properly, last time it did not
-
-
-
-
-
-
-#include "influxdb_sender.h"
+#include "influx_sender_task.h"
 #include "esp_log.h"
-#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdlib.h>
+#include <string.h>
 
 #define INFLUX_SENDER_STACK   8192
 #define INFLUX_SENDER_PRIO    5
-#define INFLUX_QUEUE_LEN      10
+#define INFLUX_LINE_MAX       256     ///< Longest formatted line, also the size-trigger headroom
 
 static const char* TAG = "INFLUXDB_SENDER_TASK";
 
 typedef enum {
     INFLUX_MSG_SOIL,
-    INFLUX_MSG_BATTERY
+    INFLUX_MSG_BATTERY,
+    INFLUX_MSG_DRAIN,
 } influx_msg_type_t;
 
 typedef struct {
@@ -32,125 +28,324 @@ typedef struct {
     union {
         influxdb_soil_data_t soil;
         influxdb_battery_data_t battery;
+        TaskHandle_t requester;     ///< INFLUX_MSG_DRAIN: task to notify with the result
     } payload;
 } influx_msg_t;
 
 static TaskHandle_t s_task = NULL;
-static QueueHandle_t sender_queue = NULL;
-static bool sender_task_started = false;
-static bool is_initialized = false;
+static QueueHandle_t s_queue = NULL;
+static influx_sender_config_t s_config;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static influx_sender_stats_t s_stats;
 
-static void influx_sender_task(void* pv) {
-    if (sender_queue == NULL) {
-        ESP_LOGE(TAG, "Sender queue not initialized. Exiting task.");
-        vTaskDelete(NULL);
+// Batch state, owned by the writer task
+static char* s_batch = NULL;
+static size_t s_batch_len = 0;
+static uint32_t s_batch_points = 0;
+static TickType_t s_batch_started = 0;
+
+
+
+
+// #####################################
+// MARK: Batch
+// #####################################
+
+/**
+ * @brief Default transport: one POST through the InfluxDB client
+ */
+static esp_err_t influxdb_transport(const char* body, size_t len, void* ctx) {
+    (void)len;
+    (void)ctx;
+    return influxdb_send_line_protocol(body);
+}
+
+static void batch_reset(void) {
+    s_batch_len = 0;
+    s_batch_points = 0;
+    s_batch[0] = '\0';
+}
+
+/**
+ * @brief Write the current batch; on failure it is kept for the next trigger
+ */
+static esp_err_t batch_flush(void) {
+    if (s_batch_len == 0) {
+        return ESP_OK;
+    }
+
+    // Drop the trailing newline, the server does not need it
+    s_batch[s_batch_len - 1] = '\0';
+    esp_err_t err = s_config.transport(s_batch, s_batch_len - 1, s_config.transport_ctx);
+    s_batch[s_batch_len - 1] = '\n';
+
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK) {
+        s_stats.batches_written++;
+        s_stats.points_written += s_batch_points;
+        s_stats.bytes_written += s_batch_len - 1;
+    } else {
+        s_stats.batches_failed++;
+        s_stats.last_error = err;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGD(TAG, "Wrote batch of %lu point(s), %u bytes",
+                 (unsigned long)s_batch_points, (unsigned)(s_batch_len - 1));
+        batch_reset();
+    } else {
+        ESP_LOGW(TAG, "Batch write failed (%s), keeping %lu point(s)",
+                 esp_err_to_name(err), (unsigned long)s_batch_points);
+        // Restart the age so the retry waits a full interval
+        s_batch_started = xTaskGetTickCount();
+    }
+    return err;
+}
+
+static void batch_drop(uint32_t points) {
+    portENTER_CRITICAL(&s_lock);
+    s_stats.points_dropped += points;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Format a point into the batch, flushing on the size trigger
+ */
+static void batch_append(const influx_msg_t* msg) {
+    char line[INFLUX_LINE_MAX];
+    int len = (msg->type == INFLUX_MSG_SOIL)
+        ? influxdb_format_soil_line(&msg->payload.soil, line, sizeof(line))
+        : influxdb_format_battery_line(&msg->payload.battery, line, sizeof(line));
+    if (len <= 0 || len >= (int)sizeof(line)) {
+        ESP_LOGE(TAG, "Point does not fit into a line, dropped");
+        batch_drop(1);
         return;
     }
 
-    ESP_LOGI(TAG, "Influx sender task started");
-    sender_task_started = true;
+    // Line plus newline must fit; a batch that keeps failing is given up
+    if (s_batch_len + (size_t)len + 1 > s_config.batch_bytes && batch_flush() != ESP_OK) {
+        ESP_LOGW(TAG, "Batch full and not writable, dropping %lu point(s)", (unsigned long)s_batch_points);
+        batch_drop(s_batch_points);
+        batch_reset();
+    }
+
+    if (s_batch_len == 0) {
+        s_batch_started = xTaskGetTickCount();
+    }
+    memcpy(&s_batch[s_batch_len], line, (size_t)len);
+    s_batch_len += (size_t)len;
+    s_batch[s_batch_len++] = '\n';
+    s_batch[s_batch_len] = '\0';
+    s_batch_points++;
 
+    // Size trigger: the next line might not fit anymore
+    if (s_config.batch_bytes - s_batch_len < INFLUX_LINE_MAX) {
+        batch_flush();
+    }
+}
+
+
+
+
+// #####################################
+// MARK: Task
+// #####################################
+
+static void influx_sender_task(void* pv) {
+    (void)pv;
     influx_msg_t msg;
+    TickType_t interval = pdMS_TO_TICKS(s_config.flush_interval_ms);
+
     while (1) {
-        ESP_LOGI(TAG, "Waiting for messages in Influx sender queue...");
-        if (xQueueReceive(sender_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            influxdb_response_status_t ret;
-            if (msg.type == INFLUX_MSG_SOIL) {
-                ret = influxdb_write_soil_data(&msg.payload.soil);
-                if (ret == INFLUXDB_RESPONSE_OK) {
-                    ESP_LOGI(TAG, "Sent soil data to InfluxDB");
-                } else {
-                    ESP_LOGE(TAG, "Failed to send soil data to InfluxDB (status: %d)", ret);
-                }
-            } else if (msg.type == INFLUX_MSG_BATTERY) {
-                ret = influxdb_write_battery_data(&msg.payload.battery);
-                if (ret == INFLUXDB_RESPONSE_OK) {
-                    ESP_LOGI(TAG, "Sent battery data to InfluxDB");
-                } else {
-                    ESP_LOGE(TAG, "Failed to send battery data to InfluxDB (status: %d)", ret);
-                }
-            } else {
-                ESP_LOGW(TAG, "Received unknown message type in Influx sender task");
+        // Time trigger: sleep until the oldest point of the batch is due
+        TickType_t wait = portMAX_DELAY;
+        if (s_batch_len > 0) {
+            TickType_t age = xTaskGetTickCount() - s_batch_started;
+            wait = (age >= interval) ? 0 : interval - age;
+        }
+
+        if (xQueueReceive(s_queue, &msg, wait) != pdTRUE) {
+            batch_flush();
+            continue;
+        }
+
+        switch (msg.type) {
+            case INFLUX_MSG_SOIL:
+            case INFLUX_MSG_BATTERY:
+                batch_append(&msg);
+                break;
+            case INFLUX_MSG_DRAIN: {
+                // The queue is FIFO, so every point enqueued before the drain is in the batch
+                esp_err_t err = batch_flush();
+                xTaskNotify(msg.payload.requester, (uint32_t)err, eSetValueWithOverwrite);
+                break;
             }
+            default:
+                ESP_LOGW(TAG, "Unknown message type %d", msg.type);
+                break;
         }
-        ESP_LOGI(TAG, "Influx sender task idle...");
     }
 }
 
-esp_err_t influx_sender_init(void) {
-    sender_queue = xQueueCreate(INFLUX_QUEUE_LEN, sizeof(influx_msg_t));
-    if (sender_queue == NULL) {
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+esp_err_t influx_sender_init(const influx_sender_config_t* config) {
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    memset(&s_config, 0, sizeof(s_config));
+    if (config != NULL) {
+        s_config = *config;
+    }
+    if (s_config.batch_bytes == 0) {
+        s_config.batch_bytes = INFLUX_BATCH_MAX_BYTES;
+    }
+    if (s_config.flush_interval_ms == 0) {
+        s_config.flush_interval_ms = INFLUX_BATCH_FLUSH_MS;
+    }
+    if (s_config.queue_len == 0) {
+        s_config.queue_len = INFLUX_SENDER_QUEUE_LEN;
+    }
+    if (s_config.transport == NULL) {
+        s_config.transport = influxdb_transport;
+    }
+    if (s_config.batch_bytes < 2 * INFLUX_LINE_MAX) {
+        ESP_LOGE(TAG, "Batch buffer too small (%u < %u)", (unsigned)s_config.batch_bytes, 2 * INFLUX_LINE_MAX);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_batch = malloc(s_config.batch_bytes + 1);
+    if (s_batch == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate batch buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    batch_reset();
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    s_queue = xQueueCreate(s_config.queue_len, sizeof(influx_msg_t));
+    if (s_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create queue");
-        return ESP_FAIL;
+        free(s_batch);
+        s_batch = NULL;
+        return ESP_ERR_NO_MEM;
     }
 
-    BaseType_t ok = xTaskCreate(
-        influx_sender_task,
-        "influx_sender",
-        INFLUX_SENDER_STACK,
-        NULL,
-        INFLUX_SENDER_PRIO,
-        &s_task
-    );
-    if (ok != pdPASS) {
+    // The queue exists before the task, so enqueuing is safe right away
+    if (xTaskCreate(influx_sender_task, "influx_sender", INFLUX_SENDER_STACK, NULL,
+                    INFLUX_SENDER_PRIO, &s_task) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create sender task");
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        free(s_batch);
+        s_batch = NULL;
         return ESP_FAIL;
     }
 
-    // Wait for task to start
-    while (!sender_task_started) {
-        vTaskDelay(pdMS_TO_TICKS(100));
+    ESP_LOGI(TAG, "Influx writer started (batch %u bytes, flush %lu ms)",
+             (unsigned)s_config.batch_bytes, (unsigned long)s_config.flush_interval_ms);
+    return ESP_OK;
+}
+
+static esp_err_t enqueue(const influx_msg_t* msg) {
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bool queued = (xQueueSend(s_queue, msg, 0) == pdTRUE);
+
+    portENTER_CRITICAL(&s_lock);
+    if (queued) {
+        s_stats.points_enqueued++;
+    } else {
+        s_stats.points_dropped++;
     }
+    portEXIT_CRITICAL(&s_lock);
 
-    is_initialized = true;
+    if (!queued) {
+        ESP_LOGW(TAG, "Queue full, point dropped");
+        return ESP_ERR_NO_MEM;
+    }
     return ESP_OK;
 }
 
 esp_err_t influx_sender_enqueue_soil(const influxdb_soil_data_t* data) {
-    if (!is_initialized || !sender_queue || !data) return ESP_ERR_INVALID_STATE;
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
     influx_msg_t msg = { .type = INFLUX_MSG_SOIL };
     memcpy(&msg.payload.soil, data, sizeof(*data));
-    esp_err_t ret = xQueueSend(sender_queue, &msg, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
-    ESP_LOGI(TAG, "Enqueued soil data to Influx sender queue: %s", esp_err_to_name(ret));
-    ESP_LOGI(TAG, "Current queue length: %d", uxQueueMessagesWaiting(sender_queue));
-    return ret;
+    return enqueue(&msg);
 }
 
 esp_err_t influx_sender_enqueue_battery(const influxdb_battery_data_t* data) {
-    if (!is_initialized || !sender_queue || !data) return ESP_ERR_INVALID_STATE;
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
     influx_msg_t msg = { .type = INFLUX_MSG_BATTERY };
     memcpy(&msg.payload.battery, data, sizeof(*data));
-    esp_err_t ret = xQueueSend(sender_queue, &msg, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
-    ESP_LOGI(TAG, "Enqueued battery data to Influx sender queue: %s", esp_err_to_name(ret));
-    ESP_LOGI(TAG, "Current queue length: %d", uxQueueMessagesWaiting(sender_queue));
-    return ret;
+    return enqueue(&msg);
 }
 
 esp_err_t influx_sender_wait_until_empty(uint32_t timeout_ms) {
-    if (!sender_queue) {
-        ESP_LOGW(TAG, "Sender queue not initialized");
+    if (s_queue == NULL) {
         return ESP_ERR_INVALID_STATE;
     }
-    
-    uint32_t elapsed_ms = 0;
-    const uint32_t check_interval_ms = 100;
-    
-    ESP_LOGI(TAG, "Waiting for InfluxDB sender queue to empty...");
-    
-    while (uxQueueMessagesWaiting(sender_queue) > 0) {
-        vTaskDelay(pdMS_TO_TICKS(check_interval_ms));
-        elapsed_ms += check_interval_ms;
-        
-        if (timeout_ms > 0 && elapsed_ms >= timeout_ms) {
-            ESP_LOGW(TAG, "Timeout waiting for sender queue to empty (%lu messages remaining)", 
-                     uxQueueMessagesWaiting(sender_queue));
-            return ESP_ERR_TIMEOUT;
-        }
+
+    // Discard a result left over from an earlier drain that timed out
+    xTaskNotifyWait(0, UINT32_MAX, NULL, 0);
+
+    influx_msg_t msg = {
+        .type = INFLUX_MSG_DRAIN,
+        .payload.requester = xTaskGetCurrentTaskHandle(),
+    };
+    TickType_t start = xTaskGetTickCount();
+    if (xQueueSend(s_queue, &msg, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        ESP_LOGW(TAG, "Timeout queuing drain request");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    uint32_t result;
+    if (elapsed >= timeout ||
+        xTaskNotifyWait(0, UINT32_MAX, &result, timeout - elapsed) != pdTRUE) {
+        ESP_LOGW(TAG, "Timeout waiting for the batch to be written");
+        return ESP_ERR_TIMEOUT;
+    }
+    return (esp_err_t)result;
+}
+
+esp_err_t influx_sender_get_stats(influx_sender_stats_t* stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t influx_sender_deinit(void) {
+    if (s_task != NULL) {
+        vTaskDelete(s_task);
+        s_task = NULL;
+    }
+    if (s_queue != NULL) {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
     }
-    
-    // Give sender task a bit more time to complete the last transmission
-    vTaskDelay(pdMS_TO_TICKS(500));
-    
-    ESP_LOGI(TAG, "InfluxDB sender queue is empty, all data sent");
+    free(s_batch);
+    s_batch = NULL;
+    s_batch_len = 0;
+    s_batch_points = 0;
     return ESP_OK;
 }
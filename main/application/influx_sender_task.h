@@ -0,0 +1,108 @@
+/**
+ * @file influx_sender_task.h
+ * @brief Asynchronous batching InfluxDB writer
+ *
+ * Points are enqueued without blocking and formatted into a line protocol
+ * batch buffer by a dedicated task. The batch is written in one POST when it
+ * is full, when its oldest point reaches the flush interval, or when a caller
+ * drains the writer; the draining caller is woken by a task notification.
+ *
+ * The transport is injectable so the writer can run against a fake HTTP
+ * backend on the host.
+ */
+
+#ifndef INFLUX_SENDER_TASK_H
+#define INFLUX_SENDER_TASK_H
+
+#include "esp_err.h"
+#include "influxdb_sender.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Transport: write one batch of newline-separated lines
+ *
+ * Called from the writer task. The body is NUL-terminated.
+ *
+ * @param body Line protocol batch
+ * @param len Length of body in bytes
+ * @param ctx Transport context
+ * @return ESP_OK when the server accepted the batch, error code otherwise
+ */
+typedef esp_err_t (*influx_sender_transport_t)(const char* body, size_t len, void* ctx);
+
+/**
+ * @brief Writer configuration (zero fields take the config defaults)
+ */
+typedef struct {
+    size_t batch_bytes;                     ///< Batch buffer size (0 = INFLUX_BATCH_MAX_BYTES)
+    uint32_t flush_interval_ms;             ///< Max age of a partial batch (0 = INFLUX_BATCH_FLUSH_MS)
+    size_t queue_len;                       ///< Queued points (0 = INFLUX_SENDER_QUEUE_LEN)
+    influx_sender_transport_t transport;    ///< NULL = influxdb_send_line_protocol()
+    void* transport_ctx;                    ///< Passed to transport
+} influx_sender_config_t;
+
+/**
+ * @brief Writer statistics
+ */
+typedef struct {
+    uint32_t points_enqueued;       ///< Points accepted into the queue
+    uint32_t points_dropped;        ///< Points rejected (queue full, oversized or batch lost)
+    uint32_t points_written;        ///< Points in successfully written batches
+    uint32_t batches_written;       ///< Successful POSTs
+    uint32_t batches_failed;        ///< Failed POSTs
+    uint32_t bytes_written;         ///< Payload bytes of successful POSTs
+    esp_err_t last_error;           ///< Last transport error (ESP_OK if none)
+} influx_sender_stats_t;
+
+/**
+ * @brief Start the writer task
+ *
+ * @param config Configuration, NULL for defaults
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t influx_sender_init(const influx_sender_config_t* config);
+
+/**
+ * @brief Enqueue a soil point (non-blocking)
+ *
+ * @param data Soil data
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t influx_sender_enqueue_soil(const influxdb_soil_data_t* data);
+
+/**
+ * @brief Enqueue a battery point (non-blocking)
+ *
+ * @param data Battery data
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t influx_sender_enqueue_battery(const influxdb_battery_data_t* data);
+
+/**
+ * @brief Flush everything enqueued so far and wait for the write
+ *
+ * Uses the calling task's notification value; must not be called from the
+ * writer's transport.
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return esp_err_t ESP_OK when written, the transport error, or ESP_ERR_TIMEOUT
+ */
+esp_err_t influx_sender_wait_until_empty(uint32_t timeout_ms);
+
+/**
+ * @brief Get writer statistics
+ *
+ * @param stats Output statistics
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not started
+ */
+esp_err_t influx_sender_get_stats(influx_sender_stats_t* stats);
+
+/**
+ * @brief Stop the writer task, discarding anything not yet written
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t influx_sender_deinit(void);
+
+#endif // INFLUX_SENDER_TASK_H
@@ -2,12 +2,33 @@
 #define INFLUXDB_SENDER_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "../drivers/influxdb/influxdb_client.h"
 
+/**
+ * @brief Format soil moisture data as one InfluxDB line protocol line
+ *
+ * @param data Soil data
+ * @param buf Output buffer (NUL-terminated, no trailing newline)
+ * @param size Size of buf
+ * @return int Line length, negative or >= size if it did not fit
+ */
+int influxdb_format_soil_line(const influxdb_soil_data_t* data, char* buf, size_t size);
+
+/**
+ * @brief Format battery data as one InfluxDB line protocol line
+ *
+ * @param data Battery data
+ * @param buf Output buffer (NUL-terminated, no trailing newline)
+ * @param size Size of buf
+ * @return int Line length, negative or >= size if it did not fit
+ */
+int influxdb_format_battery_line(const influxdb_battery_data_t* data, char* buf, size_t size);
+
 /**
  * @brief Write soil moisture data to InfluxDB (immediate, synchronous)
  */
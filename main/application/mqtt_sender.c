@@ -2,190 +2,559 @@
 #include "../drivers/mqtt/my_mqtt_driver.h"
 #include "esp_log.h"
 #include "esp_event.h"
-#include "cJSON.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "../drivers/nvs/nvs.h"
+#include "../config/esp32-config.h"
+#include "../utils/ts_codec.h"
+#include "mbedtls/base64.h"
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static const char* SENDER_TAG = "MQTT_SENDER";
+
+// Per-device topic cache, rebuilt only when the device id changes
+static char s_topic_device_id[32] = {0};
+static char s_soil_topic[MQTT_OUTBOX_TOPIC_MAX_LEN] = {0};
+static char s_battery_topic[MQTT_OUTBOX_TOPIC_MAX_LEN] = {0};
+static char s_batch_topic[MQTT_OUTBOX_TOPIC_MAX_LEN] = {0};
 
 /**
- * @brief Create JSON payload for soil data
+ * @brief Make sure the cached topics belong to device_id
  */
-static char* create_soil_json_payload(const mqtt_soil_data_t* data) {
-    cJSON* root = cJSON_CreateObject();
-    if (root == NULL) {
-        return NULL;
+static void update_topic_cache(const char* device_id) {
+    if (s_soil_topic[0] != '\0' &&
+        strncmp(s_topic_device_id, device_id, sizeof(s_topic_device_id)) == 0) {
+        return;
     }
-    cJSON_AddNumberToObject(root, "timestamp", (double)data->timestamp_ms);
-    cJSON_AddStringToObject(root, "device_id", data->device_id);
-    cJSON_AddNumberToObject(root, "voltage", data->voltage);
-    cJSON_AddNumberToObject(root, "moisture_percent", data->moisture_percent);
-    cJSON_AddNumberToObject(root, "raw_adc", data->raw_adc);
-    char* payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    return payload;
+    strncpy(s_topic_device_id, device_id, sizeof(s_topic_device_id) - 1);
+    snprintf(s_soil_topic, sizeof(s_soil_topic), "soil_sensor/%s/soil", device_id);
+    snprintf(s_battery_topic, sizeof(s_battery_topic), "soil_sensor/%s/battery", device_id);
+    snprintf(s_batch_topic, sizeof(s_batch_topic), "soil_sensor/%s/batch", device_id);
 }
 
 /**
- * @brief Create JSON payload for battery data
+ * @brief Serialize soil data as JSON directly into an outbox slot
  */
-static char* create_battery_json_payload(const mqtt_battery_data_t* data) {
-    cJSON* root = cJSON_CreateObject();
-    if (root == NULL) {
-        return NULL;
+static bool write_soil_json_payload(mqtt_outbox_slot_t* slot, const mqtt_soil_data_t* data) {
+    int len = snprintf(slot->payload, sizeof(slot->payload),
+        "{\"timestamp\":%llu,\"device_id\":\"%s\",\"voltage\":%.3f,\"moisture_percent\":%.2f,\"raw_adc\":%d}",
+        (unsigned long long)data->timestamp_ms, data->device_id,
+        data->voltage, data->moisture_percent, data->raw_adc);
+    if (len < 0 || len >= (int)sizeof(slot->payload)) {
+        return false;
     }
-    cJSON_AddNumberToObject(root, "timestamp", (double)data->timestamp_ms);
-    cJSON_AddStringToObject(root, "device_id", data->device_id);
-    cJSON_AddNumberToObject(root, "voltage", data->voltage);
-    cJSON_AddNumberToObject(root, "percentage", data->percentage);
-    char* payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    return payload;
+    slot->payload_len = len;
+    return true;
 }
 
-static const char* SENDER_TAG = "MQTT_SENDER";
+/**
+ * @brief Serialize battery data as JSON directly into an outbox slot
+ */
+static bool write_battery_json_payload(mqtt_outbox_slot_t* slot, const mqtt_battery_data_t* data) {
+    int len = snprintf(slot->payload, sizeof(slot->payload),
+        "{\"timestamp\":%llu,\"device_id\":\"%s\",\"voltage\":%.3f,\"percentage\":%.1f}",
+        (unsigned long long)data->timestamp_ms, data->device_id,
+        data->voltage, data->percentage);
+    if (len < 0 || len >= (int)sizeof(slot->payload)) {
+        return false;
+    }
+    slot->payload_len = len;
+    return true;
+}
 
-mqtt_client_status_t mqtt_publish_soil_data(const mqtt_soil_data_t* data) {
+/**
+ * @brief Publish soil data to its retained state topic
+ */
+static mqtt_client_status_t publish_soil_state(const mqtt_soil_data_t* data, int qos) {
     if (data == NULL) {
         ESP_LOGE(SENDER_TAG, "Invalid soil data");
         return MQTT_CLIENT_STATUS_INVALID_PARAM;
     }
-    char* payload = create_soil_json_payload(data);
-    if (payload == NULL) {
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    if (slot == NULL) {
+        ESP_LOGE(SENDER_TAG, "No free outbox slot for soil data");
+        return MQTT_CLIENT_STATUS_ERROR;
+    }
+    if (!write_soil_json_payload(slot, data)) {
         ESP_LOGE(SENDER_TAG, "Failed to create JSON payload");
+        mqtt_outbox_release(slot);
         return MQTT_CLIENT_STATUS_ERROR;
     }
-    char topic[128];
-    snprintf(topic, sizeof(topic), "soil_sensor/%s/soil", data->device_id);
-    esp_err_t err = mqtt_client_publish(topic, payload, strlen(payload), 1, 1);
-    free(payload);
+    update_topic_cache(data->device_id);
+    strcpy(slot->topic, s_soil_topic);
+    esp_err_t err = mqtt_client_publish_slot(slot, qos, 1);
     if (err != ESP_OK) {
         ESP_LOGE(SENDER_TAG, "Failed to publish soil data");
         return MQTT_CLIENT_STATUS_ERROR;
     }
-    ESP_LOGI(SENDER_TAG, "Soil data published to topic: %s", topic);
+    ESP_LOGI(SENDER_TAG, "Soil data published to topic: %s", s_soil_topic);
     return MQTT_CLIENT_STATUS_OK;
 }
 
-mqtt_client_status_t mqtt_publish_battery_data(const mqtt_battery_data_t* data) {
+/**
+ * @brief Publish battery data to its retained state topic
+ */
+static mqtt_client_status_t publish_battery_state(const mqtt_battery_data_t* data, int qos) {
     if (data == NULL) {
         ESP_LOGE(SENDER_TAG, "Invalid battery data");
         return MQTT_CLIENT_STATUS_INVALID_PARAM;
     }
-    char* payload = create_battery_json_payload(data);
-    if (payload == NULL) {
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    if (slot == NULL) {
+        ESP_LOGE(SENDER_TAG, "No free outbox slot for battery data");
+        return MQTT_CLIENT_STATUS_ERROR;
+    }
+    if (!write_battery_json_payload(slot, data)) {
         ESP_LOGE(SENDER_TAG, "Failed to create JSON payload");
+        mqtt_outbox_release(slot);
         return MQTT_CLIENT_STATUS_ERROR;
     }
-    char topic[128];
-    snprintf(topic, sizeof(topic), "soil_sensor/%s/battery", data->device_id);
-    esp_err_t err = mqtt_client_publish(topic, payload, strlen(payload), 1, 1);
-    free(payload);
+    update_topic_cache(data->device_id);
+    strcpy(slot->topic, s_battery_topic);
+    esp_err_t err = mqtt_client_publish_slot(slot, qos, 1);
     if (err != ESP_OK) {
         ESP_LOGE(SENDER_TAG, "Failed to publish battery data");
         return MQTT_CLIENT_STATUS_ERROR;
     }
-    ESP_LOGI(SENDER_TAG, "Battery data published to topic: %s", topic);
+    ESP_LOGI(SENDER_TAG, "Battery data published to topic: %s", s_battery_topic);
     return MQTT_CLIENT_STATUS_OK;
 }
 
+mqtt_client_status_t mqtt_publish_soil_data(const mqtt_soil_data_t* data) {
+    return publish_soil_state(data, 1);
+}
+
+mqtt_client_status_t mqtt_publish_battery_data(const mqtt_battery_data_t* data) {
+    return publish_battery_state(data, 1);
+}
+
+mqtt_client_status_t mqtt_publish_latest_state(const mqtt_soil_data_t* soil, const mqtt_battery_data_t* battery) {
+    // Retained "latest value" only, delivery is guaranteed by the batch topic
+    mqtt_client_status_t status = publish_soil_state(soil, 0);
+    if (status != MQTT_CLIENT_STATUS_OK) {
+        return status;
+    }
+    return publish_battery_state(battery, 0);
+}
+
+
+// MARK: Batch Publishing
+
+#if MQTT_BATCH_BACKLOG_MAX > 255
+#error "MQTT_BATCH_BACKLOG_MAX must fit the 8-bit backlog indices"
+#endif
 
 /**
- * @brief Publish a single Home Assistant MQTT discovery message
+ * @brief Backlog entry, tagged so an acknowledged batch removes exactly its samples
  */
-static mqtt_client_status_t publish_ha_discovery(
-    const char* device_id,
-    const char* entity_id,
-    const char* name,
-    const char* state_topic,
-    const char* value_template,
-    const char* unit,
-    const char* precision,
-    const char* device_class,
-    const char* state_class)
-{
-    char topic[160];
-    snprintf(topic, sizeof(topic), "homeassistant/sensor/%s/%s/config", device_id, entity_id);
-
-    cJSON* root = cJSON_CreateObject();
-    if (root == NULL) {
-        ESP_LOGE(SENDER_TAG, "Failed to create JSON object for %s", entity_id);
-        return MQTT_CLIENT_STATUS_ERROR;
+typedef struct {
+    mqtt_batch_sample_t sample;
+    uint16_t seq;                   ///< Running sample number (wraps)
+} batch_entry_t;
+
+// Samples not yet acknowledged on the batch topic, kept across deep sleep
+static RTC_DATA_ATTR batch_entry_t s_batch_backlog[MQTT_BATCH_BACKLOG_MAX];
+static RTC_DATA_ATTR uint8_t s_batch_head = 0;
+static RTC_DATA_ATTR uint8_t s_batch_count = 0;
+static RTC_DATA_ATTR uint16_t s_batch_next_seq = 0;
+static RTC_DATA_ATTR uint32_t s_batch_dropped = 0;
+static portMUX_TYPE s_batch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Completion context of a batch message: sequence range of its samples
+#define BATCH_TAG(first, last)  ((void*)(uintptr_t)(((uint32_t)(first) << 16) | (uint16_t)(last)))
+#define BATCH_TAG_FIRST(ctx)    ((uint16_t)((uintptr_t)(ctx) >> 16))
+#define BATCH_TAG_LAST(ctx)     ((uint16_t)(uintptr_t)(ctx))
+
+void mqtt_batch_add_sample(const mqtt_batch_sample_t* sample) {
+    if (sample == NULL) {
+        return;
     }
+    portENTER_CRITICAL(&s_batch_lock);
+    if (s_batch_count == MQTT_BATCH_BACKLOG_MAX) {
+        // Drop the oldest sample
+        s_batch_head = (s_batch_head + 1) % MQTT_BATCH_BACKLOG_MAX;
+        s_batch_count--;
+        s_batch_dropped++;
+    }
+    batch_entry_t* entry = &s_batch_backlog[(s_batch_head + s_batch_count) % MQTT_BATCH_BACKLOG_MAX];
+    entry->sample = *sample;
+    entry->seq = s_batch_next_seq++;
+    s_batch_count++;
+    portEXIT_CRITICAL(&s_batch_lock);
+}
 
-    // char full_name[64];
-    // snprintf(full_name, sizeof(full_name), "%s %s", device_id, name);
-
-    char unique_id[64];
-    snprintf(unique_id, sizeof(unique_id), "%s_%s", device_id, entity_id);
-
-    cJSON_AddStringToObject(root, "name", name);
-    cJSON_AddStringToObject(root, "unique_id", unique_id);
-    cJSON_AddStringToObject(root, "state_topic", state_topic);
-    cJSON_AddStringToObject(root, "value_template", value_template);
-    cJSON_AddStringToObject(root, "unit_of_measurement", unit);
-    cJSON_AddStringToObject(root, "suggested_display_precision", precision);
-    if (device_class != NULL) {
-        cJSON_AddStringToObject(root, "device_class", device_class);
-    }
-    if (state_class != NULL) {
-        cJSON_AddStringToObject(root, "state_class", state_class);
-    }
-
-    /* Device grouping object */
-    cJSON* device = cJSON_CreateObject();
-    cJSON* identifiers = cJSON_CreateArray();
-    cJSON_AddItemToArray(identifiers, cJSON_CreateString(device_id));
-    cJSON_AddItemToObject(device, "identifiers", identifiers);
-    char device_name[64];
-    snprintf(device_name, sizeof(device_name), "Soil Sensor %s", device_id);
-    cJSON_AddStringToObject(device, "name", device_name);
-    cJSON_AddStringToObject(device, "model", "ESP32 Soil Moisture Sensor");
-    cJSON_AddStringToObject(device, "manufacturer", "DIY");
-    cJSON_AddItemToObject(root, "device", device);
-
-    char* payload = cJSON_PrintUnformatted(root);
-    // printf("Publishing HA discovery for %s: %s\n", entity_id, payload);
-    cJSON_Delete(root);
-    if (payload == NULL) {
-        ESP_LOGE(SENDER_TAG, "Failed to create JSON payload for %s", entity_id);
-        return MQTT_CLIENT_STATUS_ERROR;
+size_t mqtt_batch_pending_count(void) {
+    return s_batch_count;
+}
+
+/**
+ * @brief Drop the samples first..last that were delivered (or handed to the offline store)
+ *
+ * Samples leave the backlog only from the head, so the range is a prefix
+ * unless part of it was already dropped as oldest; newer samples stay.
+ */
+static void batch_drop_samples(uint16_t first, uint16_t last) {
+    size_t removed = 0;
+    portENTER_CRITICAL(&s_batch_lock);
+    while (s_batch_count > 0) {
+        uint16_t seq = s_batch_backlog[s_batch_head].seq;
+        if ((uint16_t)(seq - first) > (uint16_t)(last - first)) {
+            break;
+        }
+        s_batch_head = (s_batch_head + 1) % MQTT_BATCH_BACKLOG_MAX;
+        s_batch_count--;
+        removed++;
     }
-    esp_err_t err = mqtt_client_publish(topic, payload, strlen(payload), 1, 1);
-    free(payload);
-    if (err != ESP_OK) {
-        ESP_LOGE(SENDER_TAG, "Failed to publish HA discovery for %s", entity_id);
+    portEXIT_CRITICAL(&s_batch_lock);
+    ESP_LOGD(SENDER_TAG, "Batch #%u..#%u done, %u sample(s) removed", first, last, (unsigned)removed);
+}
+
+/**
+ * @brief Batch completion: drop the acknowledged samples from the backlog
+ */
+static void batch_done_cb(int msg_id, esp_err_t result, void* ctx) {
+    uint16_t first = BATCH_TAG_FIRST(ctx);
+    uint16_t last = BATCH_TAG_LAST(ctx);
+    if (result != ESP_OK && result != ESP_ERR_NOT_FINISHED) {
+        ESP_LOGW(SENDER_TAG, "Batch msg_id=%d not acknowledged, samples #%u..#%u kept",
+                 msg_id, first, last);
+        return;
+    }
+    // ESP_ERR_NOT_FINISHED: the batch itself is in the offline store now
+    batch_drop_samples(first, last);
+}
+
+#if MQTT_BATCH_COMPRESSED
+#define BATCH_CHANNELS      5
+#define BATCH_BLOCK_MAX     (MQTT_OUTBOX_PAYLOAD_MAX_LEN / 4 * 3)  ///< Largest block whose base64 fits a slot
+#define BATCH_CLOSE         "\""       ///< Closes the "b" string
+
+/**
+ * @brief Encode samples oldest first into a ts_codec block, as base64 into buf
+ *
+ * Channels: soil mV, moisture centi-percent, raw ADC, battery mV, battery
+ * deci-percent.
+ *
+ * @return Number of samples written, 0 on error
+ */
+static size_t write_batch_block(char* buf, size_t cap, size_t pos, size_t count, size_t* out_len) {
+    // Largest block whose base64 fits
+    size_t block_cap = (cap - 1) / 4 * 3;
+    uint8_t block[BATCH_BLOCK_MAX];
+    if (block_cap > sizeof(block)) {
+        block_cap = sizeof(block);
+    }
+
+    ts_encoder_t enc;
+    if (ts_encoder_init(&enc, block, block_cap, BATCH_CHANNELS) != ESP_OK) {
+        return 0;
+    }
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        const mqtt_batch_sample_t* sample = &s_batch_backlog[(pos + i) % MQTT_BATCH_BACKLOG_MAX].sample;
+        int32_t values[BATCH_CHANNELS] = {
+            (int32_t)lroundf(sample->soil_voltage * 1000.0f),
+            (int32_t)lroundf(sample->moisture_percent * 100.0f),
+            sample->raw_adc,
+            (int32_t)lroundf(sample->battery_voltage * 1000.0f),
+            (int32_t)lroundf(sample->battery_percent * 10.0f),
+        };
+        if (ts_encoder_add(&enc, sample->timestamp_ms, values) != ESP_OK) {
+            break;
+        }
+        written++;
+    }
+    size_t block_len = ts_encoder_finish(&enc);
+
+    if (written == 0 ||
+        mbedtls_base64_encode((unsigned char*)buf, cap, out_len, block, block_len) != 0) {
+        return 0;
+    }
+    return written;
+}
+#else
+#define BATCH_CLOSE         "]"         ///< Closes the "s" array
+#endif // MQTT_BATCH_COMPRESSED
+
+/**
+ * @brief Serialize the backlog as a compact batch into an outbox slot
+ *
+ * Layout: {"id":..,"f":[field names],"s":[[row],..],"d":{diagnostics}}, or
+ * with MQTT_BATCH_COMPRESSED {"id":..,"f":[..],"b":"<base64 block>","d":{..}}.
+ * Samples are written oldest first from ring position pos until the slot is full.
+ *
+ * @return Number of samples written, 0 on error
+ */
+static size_t write_batch_payload(mqtt_outbox_slot_t* slot, const char* device_id,
+                                  const mqtt_batch_diag_t* diag, size_t pos, size_t count) {
+    char trailer[128];
+    int trailer_len = snprintf(trailer, sizeof(trailer),
+        "%s,\"d\":{\"wake\":%lu,\"heap\":%lu,\"up\":%lu,\"rst\":%d,\"drop\":%lu,\"sup\":%lu}}",
+        BATCH_CLOSE,
+        (unsigned long)diag->wake_count, (unsigned long)diag->free_heap,
+        (unsigned long)diag->uptime_ms, diag->reset_reason, (unsigned long)s_batch_dropped,
+        (unsigned long)diag->suppressed);
+    if (trailer_len < 0 || trailer_len >= (int)sizeof(trailer)) {
+        return 0;
+    }
+
+    size_t cap = sizeof(slot->payload) - (size_t)trailer_len;
+#if MQTT_BATCH_COMPRESSED
+    int len = snprintf(slot->payload, cap,
+        "{\"id\":\"%s\",\"f\":[\"ts\",\"sv_mv\",\"sm_c\",\"raw\",\"bv_mv\",\"bp_d\"],\"b\":\"", device_id);
+    if (len < 0 || (size_t)len >= cap) {
+        return 0;
+    }
+
+    size_t block_len = 0;
+    size_t written = write_batch_block(slot->payload + len, cap - len, pos, count, &block_len);
+    if (written == 0) {
+        return 0;
+    }
+    len += (int)block_len;
+#else
+    int len = snprintf(slot->payload, cap,
+        "{\"id\":\"%s\",\"f\":[\"ts\",\"sv\",\"sm\",\"raw\",\"bv\",\"bp\"],\"s\":[", device_id);
+    if (len < 0 || (size_t)len >= cap) {
+        return 0;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        const mqtt_batch_sample_t* sample = &s_batch_backlog[(pos + i) % MQTT_BATCH_BACKLOG_MAX].sample;
+        int row = snprintf(slot->payload + len, cap - len,
+            "%s[%llu,%.3f,%.2f,%d,%.3f,%.1f]", (i > 0) ? "," : "",
+            (unsigned long long)sample->timestamp_ms, sample->soil_voltage,
+            sample->moisture_percent, sample->raw_adc,
+            sample->battery_voltage, sample->battery_percent);
+        if (row < 0 || (size_t)(len + row) >= cap) {
+            slot->payload[len] = '\0';
+            break;
+        }
+        len += row;
+        written++;
+    }
+#endif // MQTT_BATCH_COMPRESSED
+
+    memcpy(slot->payload + len, trailer, (size_t)trailer_len + 1);
+    slot->payload_len = (size_t)(len + trailer_len);
+    return written;
+}
+
+mqtt_client_status_t mqtt_publish_batch(const char* device_id, const mqtt_batch_diag_t* diag) {
+    if (device_id == NULL || diag == NULL) {
+        ESP_LOGE(SENDER_TAG, "Invalid batch parameters");
+        return MQTT_CLIENT_STATUS_INVALID_PARAM;
+    }
+    if (s_batch_count == 0) {
+        return MQTT_CLIENT_STATUS_OK;
+    }
+    if (!mqtt_client_is_connected()) {
+        ESP_LOGW(SENDER_TAG, "Not connected, %u sample(s) kept for next wake", (unsigned)s_batch_count);
+        return MQTT_CLIENT_STATUS_NOT_CONNECTED;
+    }
+
+    // Entries of the snapshot stay in place while we read them: only this
+    // task appends, acknowledgements just advance the head
+    portENTER_CRITICAL(&s_batch_lock);
+    size_t pos = s_batch_head;
+    size_t remaining = s_batch_count;
+    portEXIT_CRITICAL(&s_batch_lock);
+
+    update_topic_cache(device_id);
+    size_t total = remaining;
+    size_t messages = 0;
+    while (remaining > 0) {
+        mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+        if (slot == NULL) {
+            ESP_LOGE(SENDER_TAG, "No free outbox slot for batch");
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        size_t samples = write_batch_payload(slot, device_id, diag, pos, remaining);
+        if (samples == 0) {
+            ESP_LOGE(SENDER_TAG, "Failed to create batch payload");
+            mqtt_outbox_release(slot);
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        strcpy(slot->topic, s_batch_topic);
+
+        // A backlog larger than one slot continues in the next message
+        uint16_t first = s_batch_backlog[pos].seq;
+        uint16_t last = s_batch_backlog[(pos + samples - 1) % MQTT_BATCH_BACKLOG_MAX].seq;
+        pos = (pos + samples) % MQTT_BATCH_BACKLOG_MAX;
+        remaining -= samples;
+
+        esp_err_t err = mqtt_client_publish_slot_cb(slot, 1, 0, batch_done_cb, BATCH_TAG(first, last));
+        if (err == ESP_ERR_NOT_FINISHED) {
+            ESP_LOGW(SENDER_TAG, "Batch stored offline for replay");
+            batch_drop_samples(first, last);
+            return MQTT_CLIENT_STATUS_NOT_CONNECTED;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(SENDER_TAG, "Failed to publish batch");
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        messages++;
+    }
+    ESP_LOGI(SENDER_TAG, "Batch published: %u sample(s) in %u message(s)", (unsigned)total,
+             (unsigned)messages);
+    return MQTT_CLIENT_STATUS_OK;
+}
+
+
+// MARK: Home Assistant Discovery
+
+/**
+ * @brief Discovery entities of the soil sensor node
+ *
+ * Adding a metric (or a second probe) only needs a new row here: the
+ * discovery configs are generated from this table and republished
+ * automatically because their content hash changes.
+ */
+static const mqtt_ha_entity_t s_soil_sensor_entities[] = {
+    { "soil_voltage",    "Soil Voltage",    "soil",    "voltage",          "V", "3", "voltage",  "measurement" },
+    { "soil_moisture",   "Soil",            "soil",    "moisture_percent", "%", "2", "moisture", "measurement" },
+    { "battery_voltage", "Battery Voltage", "battery", "voltage",          "V", "3", "voltage",  "measurement" },
+    { "battery_percent", "Battery",         "battery", "percentage",       "%", "2", "battery",  "measurement" },
+};
+
+#define HA_DISCOVERY_ACK_TIMEOUT_MS 5000
+
+/**
+ * @brief FNV-1a hash, continued from a previous value
+ */
+static uint32_t fnv1a_update(uint32_t hash, const void* data, size_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Generate topic and config payload of one entity into an outbox slot
+ */
+static bool build_ha_discovery(mqtt_outbox_slot_t* slot, const char* device_id,
+                               const mqtt_ha_entity_t* entity) {
+    int len = snprintf(slot->topic, sizeof(slot->topic),
+        "homeassistant/sensor/%s/%s/config", device_id, entity->entity_id);
+    if (len < 0 || len >= (int)sizeof(slot->topic)) {
+        return false;
+    }
+
+    char optional[96] = {0};
+    int opt_len = 0;
+    if (entity->device_class != NULL) {
+        opt_len += snprintf(optional + opt_len, sizeof(optional) - opt_len,
+                            ",\"device_class\":\"%s\"", entity->device_class);
+    }
+    if (entity->state_class != NULL && opt_len < (int)sizeof(optional)) {
+        snprintf(optional + opt_len, sizeof(optional) - opt_len,
+                 ",\"state_class\":\"%s\"", entity->state_class);
+    }
+
+    len = snprintf(slot->payload, sizeof(slot->payload),
+        "{\"name\":\"%s\",\"unique_id\":\"%s_%s\",\"state_topic\":\"soil_sensor/%s/%s\","
+        "\"value_template\":\"{{ value_json.%s }}\",\"unit_of_measurement\":\"%s\","
+        "\"suggested_display_precision\":\"%s\"%s,"
+        "\"device\":{\"identifiers\":[\"%s\"],\"name\":\"Soil Sensor %s\","
+        "\"model\":\"ESP32 Soil Moisture Sensor\",\"manufacturer\":\"DIY\"}}",
+        entity->name, device_id, entity->entity_id, device_id, entity->state_suffix,
+        entity->value_key, entity->unit, entity->precision, optional,
+        device_id, device_id);
+    if (len < 0 || len >= (int)sizeof(slot->payload)) {
+        return false;
+    }
+    slot->payload_len = len;
+    return true;
+}
+
+/**
+ * @brief Hash all generated discovery configs (topics and payloads)
+ */
+static mqtt_client_status_t hash_ha_discovery(const char* device_id,
+                                              const mqtt_ha_entity_t* entities,
+                                              size_t entity_count, uint32_t* hash) {
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    if (slot == NULL) {
         return MQTT_CLIENT_STATUS_ERROR;
     }
-    ESP_LOGI(SENDER_TAG, "HA discovery published: %s", topic);
+
+    *hash = 2166136261u;
+    for (size_t i = 0; i < entity_count; i++) {
+        if (!build_ha_discovery(slot, device_id, &entities[i])) {
+            ESP_LOGE(SENDER_TAG, "Discovery config for %s does not fit into an outbox slot",
+                     entities[i].entity_id);
+            mqtt_outbox_release(slot);
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        *hash = fnv1a_update(*hash, slot->topic, strlen(slot->topic) + 1);
+        *hash = fnv1a_update(*hash, slot->payload, slot->payload_len);
+    }
+
+    mqtt_outbox_release(slot);
     return MQTT_CLIENT_STATUS_OK;
 }
 
-mqtt_client_status_t mqtt_publish_soil_sensor_homeassistant_discovery(const char* device_id) {
-    if (device_id == NULL) {
-        ESP_LOGE(SENDER_TAG, "Invalid device ID");
+mqtt_client_status_t mqtt_publish_homeassistant_discovery(const char* device_id,
+                                                          const mqtt_ha_entity_t* entities,
+                                                          size_t entity_count) {
+    if (device_id == NULL || entities == NULL || entity_count == 0) {
+        ESP_LOGE(SENDER_TAG, "Invalid discovery parameters");
         return MQTT_CLIENT_STATUS_INVALID_PARAM;
     }
 
-    char soil_topic[128];
-    snprintf(soil_topic, sizeof(soil_topic), "soil_sensor/%s/soil", device_id);
-
-    char battery_topic[128];
-    snprintf(battery_topic, sizeof(battery_topic), "soil_sensor/%s/battery", device_id);
+    uint32_t hash = 0;
+    mqtt_client_status_t status = hash_ha_discovery(device_id, entities, entity_count, &hash);
+    if (status != MQTT_CLIENT_STATUS_OK) {
+        return status;
+    }
 
-    mqtt_client_status_t status;
+    uint32_t stored_hash = 0;
+    if (nvs_driver_load(NVS_NAMESPACE, NVS_KEY_HA_DISCOVERY_HASH, &stored_hash, sizeof(stored_hash)) == ESP_OK &&
+        stored_hash == hash) {
+        ESP_LOGI(SENDER_TAG, "HA discovery unchanged (hash 0x%08lx), skipping publish", (unsigned long)hash);
+        return MQTT_CLIENT_STATUS_OK;
+    }
 
-    status = publish_ha_discovery(device_id, "soil_voltage", "Soil Voltage",
-        soil_topic, "{{ value_json.voltage }}", "V", "3", "voltage", "measurement");
-    if (status != MQTT_CLIENT_STATUS_OK) return status;
+    for (size_t i = 0; i < entity_count; i++) {
+        mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+        if (slot == NULL) {
+            ESP_LOGE(SENDER_TAG, "No free outbox slot for HA discovery");
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        if (!build_ha_discovery(slot, device_id, &entities[i])) {
+            mqtt_outbox_release(slot);
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        if (mqtt_client_publish_slot(slot, 1, 1) != ESP_OK) {
+            ESP_LOGE(SENDER_TAG, "Failed to publish HA discovery for %s", entities[i].entity_id);
+            return MQTT_CLIENT_STATUS_ERROR;
+        }
+        ESP_LOGI(SENDER_TAG, "HA discovery published: homeassistant/sensor/%s/%s/config",
+                 device_id, entities[i].entity_id);
+    }
 
-    status = publish_ha_discovery(device_id, "soil_moisture", "Soil",
-        soil_topic, "{{ value_json.moisture_percent }}", "%", "2", "moisture", "measurement");
-    if (status != MQTT_CLIENT_STATUS_OK) return status;
+    // Only remember the hash once the broker has the retained configs
+    if (mqtt_client_wait_published(HA_DISCOVERY_ACK_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(SENDER_TAG, "HA discovery not acknowledged, will republish on next wake");
+        return MQTT_CLIENT_STATUS_TIMEOUT;
+    }
+    nvs_driver_save(NVS_NAMESPACE, NVS_KEY_HA_DISCOVERY_HASH, &hash, sizeof(hash));
+    ESP_LOGI(SENDER_TAG, "HA discovery updated (hash 0x%08lx)", (unsigned long)hash);
+    return MQTT_CLIENT_STATUS_OK;
+}
 
-    status = publish_ha_discovery(device_id, "battery_voltage", "Battery Voltage",
-        battery_topic, "{{ value_json.voltage }}", "V", "3", "voltage", "measurement");
-    if (status != MQTT_CLIENT_STATUS_OK) return status;
+mqtt_client_status_t mqtt_publish_soil_sensor_homeassistant_discovery(const char* device_id) {
+    return mqtt_publish_homeassistant_discovery(device_id, s_soil_sensor_entities,
+        sizeof(s_soil_sensor_entities) / sizeof(s_soil_sensor_entities[0]));
+}
 
-    status = publish_ha_discovery(device_id, "battery_percent", "Battery",
-        battery_topic, "{{ value_json.percentage }}", "%", "2", "battery", "measurement");
-    return status;
-}
\ No newline at end of file
+esp_err_t mqtt_invalidate_homeassistant_discovery(void) {
+    return nvs_driver_erase_key(NVS_NAMESPACE, NVS_KEY_HA_DISCOVERY_HASH);
+}
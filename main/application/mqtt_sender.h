@@ -33,12 +33,118 @@ mqtt_client_status_t mqtt_publish_soil_data(const mqtt_soil_data_t* data);
  */
 mqtt_client_status_t mqtt_publish_battery_data(const mqtt_battery_data_t* data);
 
+/**
+ * @brief Update the retained state topics with the latest values only
+ * 
+ * Used together with batch publishing: both messages go out with QoS 0,
+ * the batch topic carries the acknowledged history.
+ * 
+ * @param soil Latest soil measurement
+ * @param battery Latest battery measurement
+ * @return mqtt_client_status_t Status of the operation
+ */
+mqtt_client_status_t mqtt_publish_latest_state(const mqtt_soil_data_t* soil, const mqtt_battery_data_t* battery);
+
+/**
+ * @brief One row of the batch topic (all readings of one wake)
+ */
+typedef struct {
+    uint64_t timestamp_ms;          ///< Timestamp in milliseconds
+    float soil_voltage;             ///< Soil sensor voltage
+    float moisture_percent;         ///< Moisture percentage
+    int raw_adc;                    ///< Raw soil ADC reading
+    float battery_voltage;          ///< Battery voltage
+    float battery_percent;          ///< Battery percentage
+} mqtt_batch_sample_t;
+
+/**
+ * @brief Per-wake diagnostics sent with the batch
+ */
+typedef struct {
+    uint32_t wake_count;            ///< Wakes since power-on
+    uint32_t free_heap;             ///< Free heap in bytes
+    uint32_t uptime_ms;             ///< Time awake when the batch was built
+    int reset_reason;               ///< esp_reset_reason() value
+    uint32_t suppressed;            ///< Samples withheld by the report policy since the last report
+} mqtt_batch_diag_t;
+
+/**
+ * @brief Append a sample to the batch backlog
+ * 
+ * The backlog lives in RTC memory and survives deep sleep. When it is full
+ * the oldest sample is dropped.
+ * 
+ * @param sample Sample to append
+ */
+void mqtt_batch_add_sample(const mqtt_batch_sample_t* sample);
+
+/**
+ * @brief Number of samples waiting for acknowledgement
+ */
+size_t mqtt_batch_pending_count(void);
+
+/**
+ * @brief Publish the backlog as one compact message on soil_sensor/<id>/batch
+ * 
+ * Payload: {"id":"<id>","f":["ts","sv","sm","raw","bv","bp"],"s":[[..],..],
+ * "d":{"wake":..,"heap":..,"up":..,"rst":..,"drop":..}}. With MQTT_BATCH_COMPRESSED
+ * the rows are replaced by "b":"<base64 ts_codec block>" over the fixed-point
+ * fields ["ts","sv_mv","sm_c","raw","bv_mv","bp_d"] (see utils/ts_codec.h). Sent with QoS 1;
+ * a backlog larger than one outbox slot continues in further messages. Each
+ * message carries the sequence range of its samples, and exactly those are
+ * removed from the backlog once the broker acknowledges it.
+ * 
+ * @param device_id Device identifier
+ * @param diag Diagnostics of this wake
+ * @return mqtt_client_status_t Status of the operation
+ */
+mqtt_client_status_t mqtt_publish_batch(const char* device_id, const mqtt_batch_diag_t* diag);
+
+/**
+ * @brief Home Assistant sensor entity description (one discovery config)
+ */
+typedef struct {
+    const char* entity_id;      ///< Entity suffix, e.g. "soil_moisture" (unique per device)
+    const char* name;           ///< Display name
+    const char* state_suffix;   ///< State topic suffix below soil_sensor/<device_id>/
+    const char* value_key;      ///< JSON key in the state payload
+    const char* unit;           ///< Unit of measurement
+    const char* precision;      ///< Suggested display precision
+    const char* device_class;   ///< HA device class (NULL = none)
+    const char* state_class;    ///< HA state class (NULL = none)
+} mqtt_ha_entity_t;
+
+/**
+ * @brief Publish Home Assistant discovery configs generated from an entity table
+ * 
+ * A hash of the generated configs is stored in NVS. The configs are only
+ * published (QoS 1, retained) when the hash differs from the stored one, so
+ * unchanged nodes send nothing.
+ * 
+ * @param device_id Unique device identifier (e.g. derived from MAC address)
+ * @param entities Entity table
+ * @param entity_count Number of entries in the table
+ * @return mqtt_client_status_t Status of the operation
+ */
+mqtt_client_status_t mqtt_publish_homeassistant_discovery(const char* device_id,
+                                                          const mqtt_ha_entity_t* entities,
+                                                          size_t entity_count);
+
 /**
  * @brief Publish Home Assistant MQTT discovery messages for the soil sensor
  * 
+ * Uses the built-in soil sensor entity table, see mqtt_publish_homeassistant_discovery().
+ * 
  * @param device_id Unique device identifier (e.g. derived from MAC address)
  * @return mqtt_client_status_t Status of the operation
  */
 mqtt_client_status_t mqtt_publish_soil_sensor_homeassistant_discovery(const char* device_id);
 
+/**
+ * @brief Forget the stored discovery hash so the next call republishes
+ * 
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_invalidate_homeassistant_discovery(void);
+
 #endif // MQTT_SENDER_H
\ No newline at end of file
@@ -1,49 +1,239 @@
 /**
- * @file mqtt_sender.c
+ * @file mqtt_sender_task.c
  * @brief MQTT Sender Task Implementation
- * 
+ *
  * This module provides a dedicated FreeRTOS task for sending data to MQTT.
- * It uses a queue to buffer messages and sends them asynchronously.
+ * Messages are buffered in priority lanes (alert > discovery > telemetry)
+ * and sent asynchronously, paced by a token bucket.
  */
 
+#include "mqtt_sender_task.h"
 #include "mqtt_sender.h"
 #include "../drivers/mqtt/my_mqtt_driver.h"
 #include "../drivers/wifi/wifi_manager.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include <stdlib.h>
 #include <string.h>
 
-static const char* TAG = "MQTT_SENDER";
+static const char* TAG = "MQTT_SENDER_TASK";
 
-#define MQTT_SENDER_TASK_STACK_SIZE 4048
-#define MQTT_SENDER_TASK_PRIORITY 4
-#define MQTT_SENDER_QUEUE_SIZE 20
+#define MQTT_SENDER_TASK_STACK_SIZE 4096
+#define MQTT_SENDER_TASK_PRIORITY   4
+
+#define MQTT_SENDER_ALERT_LANE_SIZE     8
+#define MQTT_SENDER_DISCOVERY_LANE_SIZE 4
+#define MQTT_SENDER_TELEMETRY_LANE_SIZE 16
+
+#define MQTT_SENDER_RATE_PER_SEC    20      // Sustained publish rate
+#define MQTT_SENDER_BURST           10      // Token bucket depth (back-to-back publishes)
+#define TOKEN_SCALE                 1000    // Tokens are tracked in 1/1000 units
 
 // Message types
 typedef enum {
     MQTT_MSG_TYPE_SOIL,
-    MQTT_MSG_TYPE_BATTERY
+    MQTT_MSG_TYPE_BATTERY,
+    MQTT_MSG_TYPE_DISCOVERY,
+    MQTT_MSG_TYPE_ALERT
 } mqtt_msg_type_t;
 
-// Queue message structure
+// Lane message structure
 typedef struct {
     mqtt_msg_type_t type;
+    TickType_t enqueued_at;
     union {
         mqtt_soil_data_t soil;
         mqtt_battery_data_t battery;
+        char device_id[32];
+        struct {
+            char topic[MQTT_SENDER_ALERT_TOPIC_MAX_LEN];
+            char payload[MQTT_SENDER_ALERT_PAYLOAD_MAX_LEN];
+        } alert;
     } data;
 } mqtt_queue_msg_t;
 
+// Ring buffer lane
+typedef struct {
+    mqtt_queue_msg_t* items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool coalesce;                  // Replace queued messages for the same topic
+    bool evict_oldest;              // When full, drop the oldest instead of rejecting
+    uint64_t latency_sum_ms;
+    mqtt_sender_lane_stats_t stats;
+} mqtt_lane_t;
+
 // Static variables
-static QueueHandle_t mqtt_queue = NULL;
+static mqtt_lane_t lanes[MQTT_SENDER_LANE_COUNT] = {
+    [MQTT_SENDER_LANE_ALERT]     = { .capacity = MQTT_SENDER_ALERT_LANE_SIZE },
+    [MQTT_SENDER_LANE_DISCOVERY] = { .capacity = MQTT_SENDER_DISCOVERY_LANE_SIZE, .coalesce = true },
+    [MQTT_SENDER_LANE_TELEMETRY] = { .capacity = MQTT_SENDER_TELEMETRY_LANE_SIZE, .coalesce = true, .evict_oldest = true },
+};
+static portMUX_TYPE lanes_lock = portMUX_INITIALIZER_UNLOCKED;
 static TaskHandle_t mqtt_task_handle = NULL;
 static bool is_initialized = false;
+static volatile bool is_publishing = false;
+
+// Token bucket
+static uint32_t tokens = MQTT_SENDER_BURST * TOKEN_SCALE;
+static TickType_t tokens_updated_at = 0;
+static uint32_t rate_limited = 0;
 
 
 
 
+// #####################################
+// MARK: Lanes
+// #####################################
+
+/**
+ * @brief Device id of a message (coalescing key together with the type)
+ */
+static const char* msg_device_id(const mqtt_queue_msg_t* msg) {
+    switch (msg->type) {
+        case MQTT_MSG_TYPE_SOIL:      return msg->data.soil.device_id;
+        case MQTT_MSG_TYPE_BATTERY:   return msg->data.battery.device_id;
+        case MQTT_MSG_TYPE_DISCOVERY: return msg->data.device_id;
+        default:                      return NULL;
+    }
+}
+
+/**
+ * @brief Whether two messages target the same topic
+ */
+static bool same_topic(const mqtt_queue_msg_t* a, const mqtt_queue_msg_t* b) {
+    const char* id_a = msg_device_id(a);
+    const char* id_b = msg_device_id(b);
+    return a->type == b->type && id_a != NULL && id_b != NULL &&
+           strncmp(id_a, id_b, sizeof(a->data.device_id)) == 0;
+}
+
+/**
+ * @brief Put a message into a lane
+ */
+static esp_err_t lane_push(mqtt_sender_lane_t lane_id, const mqtt_queue_msg_t* msg) {
+    if (!is_initialized) {
+        ESP_LOGE(TAG, "MQTT sender not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    mqtt_lane_t* lane = &lanes[lane_id];
+    esp_err_t ret = ESP_OK;
+    bool coalesced = false;
+
+    portENTER_CRITICAL(&lanes_lock);
+    if (lane->coalesce) {
+        for (size_t i = 0; i < lane->count; i++) {
+            mqtt_queue_msg_t* queued = &lane->items[(lane->head + i) % lane->capacity];
+            if (same_topic(queued, msg)) {
+                // Keep the queue position and original enqueue time, take the fresh value
+                queued->data = msg->data;
+                lane->stats.coalesced++;
+                coalesced = true;
+                break;
+            }
+        }
+    }
+    if (!coalesced) {
+        if (lane->count == lane->capacity) {
+            if (lane->evict_oldest) {
+                lane->head = (lane->head + 1) % lane->capacity;
+                lane->count--;
+                lane->stats.dropped++;
+            } else {
+                lane->stats.dropped++;
+                ret = ESP_ERR_NO_MEM;
+            }
+        }
+        if (ret == ESP_OK) {
+            lane->items[(lane->head + lane->count) % lane->capacity] = *msg;
+            lane->count++;
+            if (lane->count > lane->stats.high_water) {
+                lane->stats.high_water = lane->count;
+            }
+        }
+    }
+    if (ret == ESP_OK) {
+        lane->stats.enqueued++;
+    }
+    portEXIT_CRITICAL(&lanes_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Lane %d full, message rejected", (int)lane_id);
+        return ret;
+    }
+
+    xTaskNotifyGive(mqtt_task_handle);
+    return ESP_OK;
+}
+
+/**
+ * @brief Take the next message from the highest-priority non-empty lane
+ */
+static bool lanes_pop(mqtt_queue_msg_t* msg, mqtt_sender_lane_t* lane_id) {
+    bool found = false;
+
+    portENTER_CRITICAL(&lanes_lock);
+    for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+        mqtt_lane_t* lane = &lanes[i];
+        if (lane->count > 0) {
+            *msg = lane->items[lane->head];
+            lane->head = (lane->head + 1) % lane->capacity;
+            lane->count--;
+            *lane_id = (mqtt_sender_lane_t)i;
+            found = true;
+            is_publishing = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&lanes_lock);
+
+    return found;
+}
+
+static size_t lanes_depth(void) {
+    size_t depth = 0;
+    portENTER_CRITICAL(&lanes_lock);
+    for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+        depth += lanes[i].count;
+    }
+    portEXIT_CRITICAL(&lanes_lock);
+    return depth;
+}
+
+
+
+
+// #####################################
+// MARK: Rate Limiting
+// #####################################
+
+/**
+ * @brief Block until a publish token is available, then consume it
+ */
+static void token_bucket_take(void) {
+    for (;;) {
+        TickType_t now = xTaskGetTickCount();
+        uint32_t elapsed_ms = pdTICKS_TO_MS(now - tokens_updated_at);
+        tokens_updated_at = now;
+
+        uint64_t refilled = (uint64_t)tokens + (uint64_t)elapsed_ms * MQTT_SENDER_RATE_PER_SEC;
+        tokens = (refilled > MQTT_SENDER_BURST * TOKEN_SCALE) ? MQTT_SENDER_BURST * TOKEN_SCALE
+                                                               : (uint32_t)refilled;
+        if (tokens >= TOKEN_SCALE) {
+            tokens -= TOKEN_SCALE;
+            return;
+        }
+
+        // Sleep exactly until the next token is due
+        uint32_t wait_ms = (TOKEN_SCALE - tokens + MQTT_SENDER_RATE_PER_SEC - 1) / MQTT_SENDER_RATE_PER_SEC;
+        rate_limited++;
+        vTaskDelay(pdMS_TO_TICKS(wait_ms) > 0 ? pdMS_TO_TICKS(wait_ms) : 1);
+    }
+}
+
 
 
 
@@ -51,53 +241,81 @@ static bool is_initialized = false;
 // MARK: Sender Task
 // #####################################
 
+/**
+ * @brief Publish one message, returns true on success
+ */
+static bool publish_msg(const mqtt_queue_msg_t* msg) {
+    mqtt_client_status_t status = MQTT_CLIENT_STATUS_ERROR;
+
+    switch (msg->type) {
+        case MQTT_MSG_TYPE_SOIL:
+            status = mqtt_publish_soil_data(&msg->data.soil);
+            break;
+        case MQTT_MSG_TYPE_BATTERY:
+            status = mqtt_publish_battery_data(&msg->data.battery);
+            break;
+        case MQTT_MSG_TYPE_DISCOVERY:
+            status = mqtt_publish_soil_sensor_homeassistant_discovery(msg->data.device_id);
+            break;
+        case MQTT_MSG_TYPE_ALERT: {
+            esp_err_t err = mqtt_client_publish(msg->data.alert.topic, msg->data.alert.payload,
+                                                strlen(msg->data.alert.payload), 1, 0);
+            status = (err == ESP_OK) ? MQTT_CLIENT_STATUS_OK : MQTT_CLIENT_STATUS_ERROR;
+            break;
+        }
+    }
 
+    if (status != MQTT_CLIENT_STATUS_OK) {
+        ESP_LOGW(TAG, "Failed to send message type %d (status: %d)", (int)msg->type, status);
+        return false;
+    }
+    return true;
+}
 
 /**
  * @brief MQTT sender task
  */
 static void mqtt_sender_task(void* pvParameters) {
     mqtt_queue_msg_t msg;
-    
+    mqtt_sender_lane_t lane_id;
+
     ESP_LOGI(TAG, "MQTT sender task started");
-    
+    tokens_updated_at = xTaskGetTickCount();
+
     while (1) {
-        // Wait for message in queue
-        if (xQueueReceive(mqtt_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            
-            // Check WiFi connection
-            if (!wifi_manager_is_connected()) {
-                ESP_LOGW(TAG, "WiFi not connected, skipping MQTT send");
-                continue;
-            }
-            
-            // Check MQTT connection
-            if (!mqtt_client_is_connected()) {
-                ESP_LOGW(TAG, "MQTT not connected, skipping send");
-                continue;
-            }
-            
-            // Send based on message type
-            mqtt_client_status_t status;
-            if (msg.type == MQTT_MSG_TYPE_SOIL) {
-                status = mqtt_publish_soil_data(&msg.data.soil);
-                if (status == MQTT_CLIENT_STATUS_OK) {
-                    ESP_LOGI(TAG, "Soil data sent to MQTT successfully");
-                } else {
-                    ESP_LOGW(TAG, "Failed to send soil data to MQTT (status: %d)", status);
-                }
-            } else if (msg.type == MQTT_MSG_TYPE_BATTERY) {
-                status = mqtt_publish_battery_data(&msg.data.battery);
-                if (status == MQTT_CLIENT_STATUS_OK) {
-                    ESP_LOGI(TAG, "Battery data sent to MQTT successfully");
-                } else {
-                    ESP_LOGW(TAG, "Failed to send battery data to MQTT (status: %d)", status);
-                }
+        if (lanes_depth() == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        // Take the token first so messages keep coalescing while we wait
+        token_bucket_take();
+        if (!lanes_pop(&msg, &lane_id)) {
+            continue;
+        }
+
+        // While offline the driver moves QoS 1 messages to the flash
+        // store and replays them on the next connection
+        if (!wifi_manager_is_connected() || !mqtt_client_is_connected()) {
+            ESP_LOGW(TAG, "MQTT offline, message goes to the offline store");
+        }
+
+        bool ok = publish_msg(&msg);
+        uint32_t latency_ms = pdTICKS_TO_MS(xTaskGetTickCount() - msg.enqueued_at);
+
+        portENTER_CRITICAL(&lanes_lock);
+        mqtt_lane_t* lane = &lanes[lane_id];
+        if (ok) {
+            lane->stats.sent++;
+            lane->latency_sum_ms += latency_ms;
+            if (latency_ms > lane->stats.latency_max_ms) {
+                lane->stats.latency_max_ms = latency_ms;
             }
-            
-            // Small delay to avoid overwhelming the broker
-            vTaskDelay(pdMS_TO_TICKS(100));
+        } else {
+            lane->stats.failed++;
         }
+        is_publishing = false;
+        portEXIT_CRITICAL(&lanes_lock);
     }
 }
 
@@ -106,14 +324,26 @@ esp_err_t mqtt_sender_task_init(void) {
         ESP_LOGD(TAG, "MQTT sender already initialized");
         return ESP_OK;
     }
-    
-    // Create queue
-    mqtt_queue = xQueueCreate(MQTT_SENDER_QUEUE_SIZE, sizeof(mqtt_queue_msg_t));
-    if (mqtt_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create MQTT queue");
-        return ESP_ERR_NO_MEM;
+
+    // Allocate lanes
+    for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+        lanes[i].items = calloc(lanes[i].capacity, sizeof(mqtt_queue_msg_t));
+        if (lanes[i].items == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate MQTT sender lanes");
+            for (int j = 0; j < i; j++) {
+                free(lanes[j].items);
+                lanes[j].items = NULL;
+            }
+            return ESP_ERR_NO_MEM;
+        }
+        lanes[i].head = 0;
+        lanes[i].count = 0;
+        lanes[i].latency_sum_ms = 0;
+        memset(&lanes[i].stats, 0, sizeof(lanes[i].stats));
     }
-    
+    tokens = MQTT_SENDER_BURST * TOKEN_SCALE;
+    rate_limited = 0;
+
     // Create task
     BaseType_t ret = xTaskCreate(
         mqtt_sender_task,
@@ -123,107 +353,138 @@ esp_err_t mqtt_sender_task_init(void) {
         MQTT_SENDER_TASK_PRIORITY,
         &mqtt_task_handle
     );
-    
+
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create MQTT sender task");
-        vQueueDelete(mqtt_queue);
-        mqtt_queue = NULL;
+        for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+            free(lanes[i].items);
+            lanes[i].items = NULL;
+        }
         return ESP_FAIL;
     }
-    
+
     is_initialized = true;
     ESP_LOGI(TAG, "MQTT sender initialized successfully");
     return ESP_OK;
 }
 
 esp_err_t mqtt_sender_task_enqueue_soil(const mqtt_soil_data_t* data) {
-    if (!is_initialized) {
-        ESP_LOGE(TAG, "MQTT sender not initialized");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
     if (data == NULL) {
         ESP_LOGE(TAG, "Invalid soil data");
         return ESP_ERR_INVALID_ARG;
     }
-    
+
     mqtt_queue_msg_t msg = {
-        .type = MQTT_MSG_TYPE_SOIL
+        .type = MQTT_MSG_TYPE_SOIL,
+        .enqueued_at = xTaskGetTickCount(),
     };
     memcpy(&msg.data.soil, data, sizeof(mqtt_soil_data_t));
-    
-    if (xQueueSend(mqtt_queue, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to enqueue soil data (queue full)");
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    ESP_LOGD(TAG, "Soil data enqueued successfully");
-    return ESP_OK;
+    return lane_push(MQTT_SENDER_LANE_TELEMETRY, &msg);
 }
 
 esp_err_t mqtt_sender_task_enqueue_battery(const mqtt_battery_data_t* data) {
-    if (!is_initialized) {
-        ESP_LOGE(TAG, "MQTT sender not initialized");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
     if (data == NULL) {
         ESP_LOGE(TAG, "Invalid battery data");
         return ESP_ERR_INVALID_ARG;
     }
-    
+
     mqtt_queue_msg_t msg = {
-        .type = MQTT_MSG_TYPE_BATTERY
+        .type = MQTT_MSG_TYPE_BATTERY,
+        .enqueued_at = xTaskGetTickCount(),
     };
     memcpy(&msg.data.battery, data, sizeof(mqtt_battery_data_t));
-    
-    if (xQueueSend(mqtt_queue, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to enqueue battery data (queue full)");
-        return ESP_ERR_TIMEOUT;
+    return lane_push(MQTT_SENDER_LANE_TELEMETRY, &msg);
+}
+
+esp_err_t mqtt_sender_task_enqueue_discovery(const char* device_id) {
+    if (device_id == NULL) {
+        ESP_LOGE(TAG, "Invalid device ID");
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    ESP_LOGD(TAG, "Battery data enqueued successfully");
-    return ESP_OK;
+
+    mqtt_queue_msg_t msg = {
+        .type = MQTT_MSG_TYPE_DISCOVERY,
+        .enqueued_at = xTaskGetTickCount(),
+    };
+    strncpy(msg.data.device_id, device_id, sizeof(msg.data.device_id) - 1);
+    return lane_push(MQTT_SENDER_LANE_DISCOVERY, &msg);
+}
+
+esp_err_t mqtt_sender_task_enqueue_alert(const char* topic, const char* payload) {
+    if (topic == NULL || payload == NULL ||
+        strlen(topic) >= MQTT_SENDER_ALERT_TOPIC_MAX_LEN ||
+        strlen(payload) >= MQTT_SENDER_ALERT_PAYLOAD_MAX_LEN || payload[0] == '\0') {
+        ESP_LOGE(TAG, "Invalid alert");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mqtt_queue_msg_t msg = {
+        .type = MQTT_MSG_TYPE_ALERT,
+        .enqueued_at = xTaskGetTickCount(),
+    };
+    strcpy(msg.data.alert.topic, topic);
+    strcpy(msg.data.alert.payload, payload);
+    return lane_push(MQTT_SENDER_LANE_ALERT, &msg);
 }
 
 esp_err_t mqtt_sender_task_wait_until_empty(uint32_t timeout_ms) {
     if (!is_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     TickType_t start_tick = xTaskGetTickCount();
     TickType_t timeout_ticks = pdMS_TO_TICKS(timeout_ms);
-    
-    while (uxQueueMessagesWaiting(mqtt_queue) > 0) {
+
+    while (lanes_depth() > 0 || is_publishing) {
         if ((xTaskGetTickCount() - start_tick) >= timeout_ticks) {
-            ESP_LOGW(TAG, "Timeout waiting for queue to empty");
+            ESP_LOGW(TAG, "Timeout waiting for lanes to empty");
             return ESP_ERR_TIMEOUT;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
-    
-    ESP_LOGI(TAG, "MQTT queue is empty");
+
+    ESP_LOGI(TAG, "MQTT lanes are empty");
     return ESP_OK;
 }
 
+void mqtt_sender_task_get_stats(mqtt_sender_task_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&lanes_lock);
+    for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+        stats->lanes[i] = lanes[i].stats;
+        stats->lanes[i].depth = lanes[i].count;
+        stats->lanes[i].latency_avg_ms = (lanes[i].stats.sent > 0)
+            ? (uint32_t)(lanes[i].latency_sum_ms / lanes[i].stats.sent) : 0;
+    }
+    stats->rate_limited = rate_limited;
+    portEXIT_CRITICAL(&lanes_lock);
+}
+
 esp_err_t mqtt_sender_task_deinit(void) {
     if (!is_initialized) {
         return ESP_OK;
     }
-    
+
     // Delete task
     if (mqtt_task_handle != NULL) {
         vTaskDelete(mqtt_task_handle);
         mqtt_task_handle = NULL;
     }
-    
-    // Delete queue
-    if (mqtt_queue != NULL) {
-        vQueueDelete(mqtt_queue);
-        mqtt_queue = NULL;
-    }
-    
+
+    // Free lanes
+    portENTER_CRITICAL(&lanes_lock);
     is_initialized = false;
+    is_publishing = false;
+    portEXIT_CRITICAL(&lanes_lock);
+    for (int i = 0; i < MQTT_SENDER_LANE_COUNT; i++) {
+        free(lanes[i].items);
+        lanes[i].items = NULL;
+        lanes[i].count = 0;
+    }
+
     ESP_LOGI(TAG, "MQTT sender deinitialized");
     return ESP_OK;
 }
@@ -1,15 +1,55 @@
 /**
- * @file mqtt_sender.h
+ * @file mqtt_sender_task.h
  * @brief MQTT Sender Task - Handles asynchronous MQTT publishing
+ *
+ * Messages are queued in three lanes served in priority order:
+ * alerts, discovery/config, telemetry. Telemetry is coalesced per topic, so
+ * when the task falls behind only the latest value per topic is kept.
+ * Publishing is paced by a token bucket instead of a fixed delay.
  */
 
-#ifndef MQTT_SENDER_H
-#define MQTT_SENDER_H
+#ifndef MQTT_SENDER_TASK_H
+#define MQTT_SENDER_TASK_H
 
 #include "esp_err.h"
 #include "../drivers/mqtt/my_mqtt_driver.h"
+#include <stdint.h>
 
+#define MQTT_SENDER_ALERT_TOPIC_MAX_LEN     96      ///< Max alert topic length incl. terminator
+#define MQTT_SENDER_ALERT_PAYLOAD_MAX_LEN   128     ///< Max alert payload length incl. terminator
 
+/**
+ * @brief Sender lanes, in service order
+ */
+typedef enum {
+    MQTT_SENDER_LANE_ALERT = 0,     ///< Alerts, never coalesced
+    MQTT_SENDER_LANE_DISCOVERY,     ///< Discovery/config, coalesced per device
+    MQTT_SENDER_LANE_TELEMETRY,     ///< Telemetry, coalesced per topic
+    MQTT_SENDER_LANE_COUNT
+} mqtt_sender_lane_t;
+
+/**
+ * @brief Per-lane statistics
+ */
+typedef struct {
+    uint32_t depth;                 ///< Messages currently queued
+    uint32_t high_water;            ///< Maximum depth seen
+    uint32_t enqueued;              ///< Messages accepted
+    uint32_t coalesced;             ///< Messages replaced by a newer one for the same topic
+    uint32_t dropped;               ///< Messages rejected or evicted because the lane was full
+    uint32_t sent;                  ///< Messages handed to the MQTT client
+    uint32_t failed;                ///< Publish attempts that failed
+    uint32_t latency_avg_ms;        ///< Average enqueue-to-publish latency
+    uint32_t latency_max_ms;        ///< Maximum enqueue-to-publish latency
+} mqtt_sender_lane_stats_t;
+
+/**
+ * @brief Sender task statistics
+ */
+typedef struct {
+    mqtt_sender_lane_stats_t lanes[MQTT_SENDER_LANE_COUNT];
+    uint32_t rate_limited;          ///< Times the task waited for a token
+} mqtt_sender_task_stats_t;
 
 
 
@@ -20,14 +60,16 @@
 
 /**
  * @brief Initialize and start the MQTT sender task (idempotent)
- * 
+ *
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t mqtt_sender_task_init(void);
 
 /**
  * @brief Enqueue soil data to be sent by the MQTT sender task
- * 
+ *
+ * Telemetry lane: replaces a queued soil message of the same device.
+ *
  * @param data Soil moisture data to send
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
@@ -35,26 +77,52 @@ esp_err_t mqtt_sender_task_enqueue_soil(const mqtt_soil_data_t* data);
 
 /**
  * @brief Enqueue battery data to be sent by the MQTT sender task
- * 
+ *
+ * Telemetry lane: replaces a queued battery message of the same device.
+ *
  * @param data Battery data to send
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t mqtt_sender_task_enqueue_battery(const mqtt_battery_data_t* data);
 
 /**
- * @brief Wait until the queue is empty (all data has been sent)
- * 
+ * @brief Enqueue a Home Assistant discovery update for a device
+ *
+ * @param device_id Device identifier
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_sender_task_enqueue_discovery(const char* device_id);
+
+/**
+ * @brief Enqueue an alert (QoS 1, not retained), served before everything else
+ *
+ * @param topic Alert topic
+ * @param payload Null-terminated payload
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM if the alert lane is full
+ */
+esp_err_t mqtt_sender_task_enqueue_alert(const char* topic, const char* payload);
+
+/**
+ * @brief Wait until all lanes are empty (all data has been sent)
+ *
  * @param timeout_ms Maximum time to wait in milliseconds
  * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT on timeout
  */
 esp_err_t mqtt_sender_task_wait_until_empty(uint32_t timeout_ms);
 
+/**
+ * @brief Get queue-depth and latency statistics
+ *
+ * @param stats Output statistics
+ */
+void mqtt_sender_task_get_stats(mqtt_sender_task_stats_t* stats);
+
 /**
  * @brief Deinitialize and stop the MQTT sender task
- * 
+ *
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t mqtt_sender_task_deinit(void);
 
 
-#endif // MQTT_SENDER_H
+#endif // MQTT_SENDER_TASK_H
@@ -0,0 +1,138 @@
+/**
+ * @file report_policy.c
+ * @brief Deadband and heartbeat reporting policy - Implementation
+ */
+
+#include "report_policy.h"
+#include "../config/esp32-config.h"
+#include "../utils/esp_utils.h"
+#include "../utils/holt_predictor.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdlib.h>
+
+static const char* TAG = "REPORT_POLICY";
+
+/**
+ * @brief Last reported state, survives deep sleep
+ */
+typedef struct {
+    bool has_report;                ///< A report was delivered since power-on
+    bool retry;                     ///< Last report failed, report the next sample
+    float moisture_percent;         ///< Moisture of the last report
+    float battery_voltage;          ///< Battery voltage of the last report
+    uint64_t reported_at_ms;        ///< System time of the last report
+    uint32_t suppressed;            ///< Samples withheld since the last report
+    holt_model_t model;             ///< Moisture predictor shared with the receiver
+} report_policy_state_t;
+
+static RTC_DATA_ATTR report_policy_state_t s_state;
+
+#if REPORT_PREDICTOR_ENABLED
+static int32_t to_centi_percent(float percent) {
+    return (int32_t)lroundf(percent * 100.0f);
+}
+#endif // REPORT_PREDICTOR_ENABLED
+
+report_policy_decision_t report_policy_evaluate(const telemetry_sample_t* sample) {
+    if (sample == NULL || !s_state.has_report) {
+        return REPORT_POLICY_FIRST;
+    }
+    if (s_state.retry) {
+        return REPORT_POLICY_RETRY;
+    }
+#if REPORT_PREDICTOR_ENABLED
+    int32_t predicted = holt_predict(&s_state.model, 1);
+    if (labs((long)(to_centi_percent(sample->moisture_percent) - predicted)) >
+        to_centi_percent(REPORT_MOISTURE_DEADBAND_PERCENT)) {
+        return REPORT_POLICY_MOISTURE;
+    }
+#else
+    if (fabsf(sample->moisture_percent - s_state.moisture_percent) > REPORT_MOISTURE_DEADBAND_PERCENT) {
+        return REPORT_POLICY_MOISTURE;
+    }
+#endif // REPORT_PREDICTOR_ENABLED
+    if (fabsf(sample->battery_voltage - s_state.battery_voltage) > REPORT_BATTERY_DEADBAND_V) {
+        return REPORT_POLICY_BATTERY;
+    }
+
+    // The system time keeps running in deep sleep; a backwards step (first
+    // NTP sync) counts as elapsed
+    uint64_t now_ms = esp_utils_get_timestamp_ms();
+    if (now_ms < s_state.reported_at_ms ||
+        now_ms - s_state.reported_at_ms >= (uint64_t)REPORT_HEARTBEAT_SECONDS * 1000ULL) {
+        return REPORT_POLICY_HEARTBEAT;
+    }
+    return REPORT_POLICY_SKIP;
+}
+
+uint32_t report_policy_suppressed_count(void) {
+    return s_state.suppressed;
+}
+
+void report_policy_prepare(telemetry_sample_t* sample) {
+    if (sample == NULL) {
+        return;
+    }
+    sample->suppressed = s_state.suppressed;
+
+#if REPORT_PREDICTOR_ENABLED
+    // Same steps as the receiver: withheld samples advanced the model in
+    // report_policy_record(), this one is an observation. A reading outside
+    // the band (watering) restarts the model there; an update would carry the
+    // step into the trend and overshoot on the following wakes.
+    sample->model = s_state.model;
+    int32_t observed = to_centi_percent(sample->moisture_percent);
+    if (s_state.has_report &&
+        labs((long)(observed - holt_predict(&s_state.model, 1))) <= to_centi_percent(REPORT_MOISTURE_DEADBAND_PERCENT)) {
+        holt_update(&sample->model, observed, REPORT_PREDICTOR_ALPHA_Q15, REPORT_PREDICTOR_BETA_Q15);
+    } else {
+        holt_reset(&sample->model, observed);
+    }
+    sample->has_model = true;
+#endif // REPORT_PREDICTOR_ENABLED
+}
+
+void report_policy_record(const telemetry_sample_t* sample, report_policy_decision_t decision, bool delivered) {
+    if (sample == NULL) {
+        return;
+    }
+
+    if (decision == REPORT_POLICY_SKIP) {
+        s_state.suppressed++;
+        holt_advance(&s_state.model);
+        ESP_LOGI(TAG, "Sample withheld (%lu since last report)", (unsigned long)s_state.suppressed);
+        return;
+    }
+
+    if (!delivered) {
+        // Keep the old reference and the count, the next wake reports again
+        s_state.retry = true;
+        ESP_LOGW(TAG, "Report not delivered, retrying on the next wake");
+        return;
+    }
+
+    s_state.has_report = true;
+    s_state.retry = false;
+    s_state.moisture_percent = sample->moisture_percent;
+    s_state.battery_voltage = sample->battery_voltage;
+    s_state.reported_at_ms = esp_utils_get_timestamp_ms();
+    s_state.suppressed = 0;
+    if (sample->has_model) {
+        s_state.model = sample->model;
+    }
+}
+
+const char* report_policy_decision_to_string(report_policy_decision_t decision) {
+    switch (decision) {
+        case REPORT_POLICY_SKIP:      return "skip";
+        case REPORT_POLICY_FIRST:     return "first";
+        case REPORT_POLICY_MOISTURE:  return "moisture";
+        case REPORT_POLICY_BATTERY:   return "battery";
+        case REPORT_POLICY_HEARTBEAT: return "heartbeat";
+        case REPORT_POLICY_RETRY:     return "retry";
+        case REPORT_POLICY_BACKLOG:   return "backlog";
+        default:                      return "unknown";
+    }
+}
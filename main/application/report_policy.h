@@ -0,0 +1,79 @@
+/**
+ * @file report_policy.h
+ * @brief Deadband and heartbeat reporting policy
+ *
+ * Sits between measurement and the telemetry pipeline. A sample is reported
+ * only when moisture or battery moved more than a deadband since the last
+ * *reported* sample, or when the heartbeat interval elapsed. Otherwise the
+ * wake skips the network entirely. The last reported state lives in RTC
+ * memory; the number of withheld samples goes out with the next report so
+ * the server can reconstruct the series (withheld values stayed within the
+ * deadband of the previous report).
+ *
+ * With REPORT_PREDICTOR_ENABLED the moisture deadband is centered on a Holt
+ * prediction (utils/holt_predictor.h) instead of the last report. Each report
+ * carries the updated model, so the receiver recovers withheld values as
+ * holt_predict(previous model, 1..suppressed) to within the deadband. A
+ * report outside the band restarts the model at the reported value.
+ */
+
+#ifndef REPORT_POLICY_H
+#define REPORT_POLICY_H
+
+#include "telemetry_pipeline.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Policy decision for one sample
+ */
+typedef enum {
+    REPORT_POLICY_SKIP = 0,         ///< Within deadband, heartbeat not due
+    REPORT_POLICY_FIRST,            ///< Nothing reported since power-on
+    REPORT_POLICY_MOISTURE,         ///< Moisture moved past its deadband
+    REPORT_POLICY_BATTERY,          ///< Battery moved past its deadband
+    REPORT_POLICY_HEARTBEAT,        ///< Heartbeat interval elapsed
+    REPORT_POLICY_RETRY,            ///< Previous report was not delivered
+    REPORT_POLICY_BACKLOG,          ///< Readings taken during sleep are waiting (set by the caller)
+} report_policy_decision_t;
+
+/**
+ * @brief Decide whether a sample must be reported
+ *
+ * @param sample Fresh sample (only the measurement fields are used)
+ * @return report_policy_decision_t REPORT_POLICY_SKIP to withhold it
+ */
+report_policy_decision_t report_policy_evaluate(const telemetry_sample_t* sample);
+
+/**
+ * @brief Samples withheld since the last delivered report
+ *
+ * Put into telemetry_sample_t.suppressed of the reported sample.
+ */
+uint32_t report_policy_suppressed_count(void);
+
+/**
+ * @brief Fill the policy fields of a sample about to be reported
+ *
+ * Sets suppressed and, with the predictor enabled, the model the receiver
+ * adopts with this sample.
+ *
+ * @param sample Sample passed to report_policy_evaluate()
+ */
+void report_policy_prepare(telemetry_sample_t* sample);
+
+/**
+ * @brief Record the outcome for a sample
+ *
+ * @param sample Sample passed to report_policy_evaluate()
+ * @param decision Decision returned for it
+ * @param delivered For reported samples: whether every sink delivered it
+ */
+void report_policy_record(const telemetry_sample_t* sample, report_policy_decision_t decision, bool delivered);
+
+/**
+ * @brief Decision name for logs
+ */
+const char* report_policy_decision_to_string(report_policy_decision_t decision);
+
+#endif // REPORT_POLICY_H
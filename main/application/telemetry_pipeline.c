@@ -0,0 +1,411 @@
+/**
+ * @file telemetry_pipeline.c
+ * @brief Transport-agnostic telemetry pipeline - Implementation
+ */
+
+#include "telemetry_pipeline.h"
+#include "../config/esp32-config.h"
+#include "../utils/retry_policy.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include <string.h>
+
+static const char* TAG = "TELEMETRY";
+
+#define SINK_TASK_PRIORITY  4
+#define SINK_PROGRESS_BIT   BIT0    ///< Set whenever a sink finishes a sample
+#define SINK_EXIT_BIT(i)    (BIT1 << (i))   ///< Set by sink i's task right before it ends
+#define SINK_STOP_WAIT_MS   2000    ///< Wait for sink tasks to end, before and again after closing sessions
+
+/**
+ * @brief Queued sample with its submit time
+ */
+typedef struct {
+    telemetry_sample_t sample;
+    TickType_t submitted_at;
+    bool stop;                      ///< Stop request: the task ends instead of sending
+} sink_item_t;
+
+/**
+ * @brief Registered sink with its runtime state
+ */
+typedef struct {
+    telemetry_sink_t sink;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    uint32_t pending;               ///< Submitted but not yet finished samples
+    telemetry_sink_stats_t stats;
+} sink_slot_t;
+
+static sink_slot_t s_sinks[TELEMETRY_MAX_SINKS];
+static size_t s_sink_count = 0;
+static EventGroupHandle_t s_events = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_submit_seq = 0;
+static TickType_t s_deadline = 0;
+static bool s_has_deadline = false;
+
+
+
+
+// #####################################
+// MARK: Sink Task
+// #####################################
+
+/**
+ * @brief Send one sample with the sink's retry policy
+ *
+ * Backoff delays and retried attempts are charged to the per-wake retry
+ * budget shared with the HTTP and InfluxDB clients.
+ */
+static esp_err_t sink_send_with_retry(sink_slot_t* slot, const telemetry_sample_t* sample) {
+    retry_policy_t policy = {
+        .max_attempts = (slot->sink.max_attempts > 0) ? slot->sink.max_attempts : 1,
+        .base_delay_ms = (slot->sink.retry_delay_ms > 0) ? slot->sink.retry_delay_ms : RETRY_BASE_DELAY_MS,
+        .max_delay_ms = RETRY_MAX_DELAY_MS,
+    };
+
+    for (uint8_t attempt = 1; ; attempt++) {
+        TickType_t start = xTaskGetTickCount();
+        esp_err_t err = slot->sink.send(sample, slot->sink.ctx);
+        if (attempt > 1) {
+            retry_budget_charge(pdTICKS_TO_MS(xTaskGetTickCount() - start));
+        }
+        if (err == ESP_OK) {
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "[%s] attempt %u/%u failed: %s", slot->sink.name,
+                 attempt, policy.max_attempts, esp_err_to_name(err));
+
+        // Same classes and per-wake budget as the clients' own retries
+        uint32_t delay_ms;
+        if (!retry_policy_next(&policy, attempt, retry_policy_classify_http(err, 0), 0, &delay_ms)) {
+            return err;
+        }
+        if (delay_ms >= telemetry_pipeline_remaining_ms()) {
+            ESP_LOGW(TAG, "[%s] no time left for a retry", slot->sink.name);
+            return err;
+        }
+        portENTER_CRITICAL(&s_lock);
+        slot->stats.retries++;
+        portEXIT_CRITICAL(&s_lock);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    }
+}
+
+/**
+ * @brief Sink task: drain the sink's queue until a stop request arrives
+ *
+ * Ends itself, so a send in progress (HTTP/TLS session, MQTT wait) always
+ * completes and releases its sockets and locks.
+ */
+static void sink_task(void* pvParameters) {
+    sink_slot_t* slot = (sink_slot_t*)pvParameters;
+    sink_item_t item;
+
+    while (1) {
+        if (xQueueReceive(slot->queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (item.stop) {
+            break;
+        }
+
+        esp_err_t err = sink_send_with_retry(slot, &item.sample);
+        uint32_t latency_ms = pdTICKS_TO_MS(xTaskGetTickCount() - item.submitted_at);
+
+        portENTER_CRITICAL(&s_lock);
+        if (err == ESP_OK) {
+            slot->stats.delivered++;
+            slot->stats.last_latency_ms = latency_ms;
+        } else {
+            slot->stats.failed++;
+            slot->stats.last_error = err;
+        }
+        slot->pending--;
+        portEXIT_CRITICAL(&s_lock);
+
+        xEventGroupSetBits(s_events, SINK_PROGRESS_BIT);
+    }
+
+    ESP_LOGD(TAG, "[%s] task stopped", slot->sink.name);
+    xEventGroupSetBits(s_events, SINK_EXIT_BIT(slot - s_sinks));
+    vTaskDelete(NULL);
+}
+
+
+
+
+// #####################################
+// MARK: Pipeline
+// #####################################
+
+esp_err_t telemetry_pipeline_init(void) {
+    if (s_events != NULL) {
+        return ESP_OK;
+    }
+    s_events = xEventGroupCreate();
+    if (s_events == NULL) {
+        ESP_LOGE(TAG, "Failed to create event group");
+        return ESP_ERR_NO_MEM;
+    }
+    s_sink_count = 0;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_pipeline_register_sink(const telemetry_sink_t* sink) {
+    if (sink == NULL || sink->send == NULL || sink->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_sink_count >= TELEMETRY_MAX_SINKS) {
+        ESP_LOGE(TAG, "No sink slot left for %s", sink->name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    sink_slot_t* slot = &s_sinks[s_sink_count];
+    memset(slot, 0, sizeof(*slot));
+    slot->sink = *sink;
+
+    size_t queue_len = (sink->queue_len > 0) ? sink->queue_len : TELEMETRY_SINK_DEFAULT_QUEUE;
+    slot->queue = xQueueCreate(queue_len, sizeof(sink_item_t));
+    if (slot->queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create queue for %s", sink->name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t stack_size = (sink->stack_size > 0) ? sink->stack_size : TELEMETRY_SINK_DEFAULT_STACK;
+    if (xTaskCreate(sink_task, sink->name, stack_size, slot, SINK_TASK_PRIORITY, &slot->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task for %s", sink->name);
+        vQueueDelete(slot->queue);
+        slot->queue = NULL;
+        return ESP_FAIL;
+    }
+
+    s_sink_count++;
+    ESP_LOGI(TAG, "Sink registered: %s (queue %u, %u attempt(s))", sink->name,
+             (unsigned)queue_len, (unsigned)((sink->max_attempts > 0) ? sink->max_attempts : 1));
+    return ESP_OK;
+}
+
+esp_err_t telemetry_pipeline_submit(const telemetry_sample_t* sample) {
+    if (sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sink_item_t item = {
+        .sample = *sample,
+        .submitted_at = xTaskGetTickCount(),
+        .stop = false,
+    };
+    if (++s_submit_seq == 0) {
+        s_submit_seq = 1;
+    }
+    item.sample.seq = s_submit_seq;
+    size_t accepted = 0;
+
+    for (size_t i = 0; i < s_sink_count; i++) {
+        sink_slot_t* slot = &s_sinks[i];
+
+        // Count before queuing so wait_idle never sees a queued-but-unpending sample
+        portENTER_CRITICAL(&s_lock);
+        slot->pending++;
+        portEXIT_CRITICAL(&s_lock);
+
+        bool queued = (xQueueSend(slot->queue, &item, 0) == pdTRUE);
+
+        portENTER_CRITICAL(&s_lock);
+        if (queued) {
+            slot->stats.submitted++;
+            accepted++;
+        } else {
+            slot->pending--;
+            slot->stats.dropped++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!queued) {
+            ESP_LOGW(TAG, "[%s] queue full, sample dropped", slot->sink.name);
+        }
+    }
+
+    return (accepted > 0) ? ESP_OK : ESP_FAIL;
+}
+
+void telemetry_pipeline_set_deadline(uint32_t timeout_ms) {
+    s_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    s_has_deadline = true;
+}
+
+uint32_t telemetry_pipeline_remaining_ms(void) {
+    if (!s_has_deadline) {
+        return UINT32_MAX;
+    }
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(s_deadline - now) <= 0) {
+        return 0;
+    }
+    return pdTICKS_TO_MS(s_deadline - now);
+}
+
+/**
+ * @brief Sum of pending samples over all sinks
+ */
+static uint32_t pending_total(void) {
+    uint32_t pending = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_sink_count; i++) {
+        pending += s_sinks[i].pending;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return pending;
+}
+
+esp_err_t telemetry_pipeline_wait_idle(uint32_t timeout_ms) {
+    if (s_events == NULL) {
+        return ESP_OK;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    for (;;) {
+        // Clear before checking so progress in between still wakes us
+        xEventGroupClearBits(s_events, SINK_PROGRESS_BIT);
+        uint32_t pending = pending_total();
+        if (pending == 0) {
+            return ESP_OK;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            ESP_LOGW(TAG, "Timeout waiting for sinks (%lu sample(s) pending)", (unsigned long)pending);
+            return ESP_ERR_TIMEOUT;
+        }
+        xEventGroupWaitBits(s_events, SINK_PROGRESS_BIT, pdFALSE, pdTRUE, timeout - elapsed);
+    }
+}
+
+esp_err_t telemetry_pipeline_get_stats(const char* name, telemetry_sink_stats_t* stats) {
+    if (name == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < s_sink_count; i++) {
+        if (strcmp(s_sinks[i].sink.name, name) == 0) {
+            portENTER_CRITICAL(&s_lock);
+            *stats = s_sinks[i].stats;
+            portEXIT_CRITICAL(&s_lock);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+bool telemetry_pipeline_all_delivered(void) {
+    bool all = true;
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_sink_count; i++) {
+        const telemetry_sink_stats_t* stats = &s_sinks[i].stats;
+        if (stats->delivered != stats->submitted || stats->failed > 0 || stats->dropped > 0) {
+            all = false;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return all;
+}
+
+void telemetry_pipeline_log_stats(void) {
+    for (size_t i = 0; i < s_sink_count; i++) {
+        telemetry_sink_stats_t stats;
+        portENTER_CRITICAL(&s_lock);
+        stats = s_sinks[i].stats;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "[%s] submitted=%lu delivered=%lu failed=%lu retries=%lu dropped=%lu latency=%lums",
+                 s_sinks[i].sink.name, (unsigned long)stats.submitted, (unsigned long)stats.delivered,
+                 (unsigned long)stats.failed, (unsigned long)stats.retries,
+                 (unsigned long)stats.dropped, (unsigned long)stats.last_latency_ms);
+    }
+}
+
+/**
+ * @brief Ask every sink task to end after its current send
+ *
+ * Samples still queued are given up, so the stop request always fits.
+ *
+ * @return Exit bits of the sinks that were asked to stop
+ */
+static EventBits_t request_stop(void) {
+    EventBits_t exit_bits = 0;
+    sink_item_t item;
+
+    for (size_t i = 0; i < s_sink_count; i++) {
+        sink_slot_t* slot = &s_sinks[i];
+        if (slot->task == NULL) {
+            continue;
+        }
+        while (xQueueReceive(slot->queue, &item, 0) == pdTRUE) {
+            portENTER_CRITICAL(&s_lock);
+            slot->pending--;
+            slot->stats.failed++;
+            slot->stats.last_error = ESP_ERR_TIMEOUT;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        memset(&item, 0, sizeof(item));
+        item.stop = true;
+        if (xQueueSend(slot->queue, &item, 0) == pdTRUE) {
+            exit_bits |= SINK_EXIT_BIT(i);
+        } else {
+            ESP_LOGW(TAG, "[%s] could not queue stop request", slot->sink.name);
+        }
+    }
+    return exit_bits;
+}
+
+esp_err_t telemetry_pipeline_deinit(void) {
+    if (s_events == NULL) {
+        return ESP_OK;
+    }
+
+    // Tasks end themselves once their current send returns
+    EventBits_t exit_bits = request_stop();
+    EventBits_t bits = xEventGroupWaitBits(s_events, exit_bits, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(SINK_STOP_WAIT_MS));
+
+    // Closing the sessions also makes a sink still blocked in its transport return
+    for (size_t i = 0; i < s_sink_count; i++) {
+        if (s_sinks[i].sink.close != NULL) {
+            s_sinks[i].sink.close(s_sinks[i].sink.ctx);
+        }
+    }
+    if ((bits & exit_bits) != exit_bits) {
+        bits = xEventGroupWaitBits(s_events, exit_bits, pdFALSE, pdTRUE,
+                                   pdMS_TO_TICKS(SINK_STOP_WAIT_MS));
+    }
+    if ((bits & exit_bits) != exit_bits) {
+        // A task still using its slot, queue and the event group: leave them in place
+        for (size_t i = 0; i < s_sink_count; i++) {
+            if ((exit_bits & SINK_EXIT_BIT(i)) && !(bits & SINK_EXIT_BIT(i))) {
+                ESP_LOGW(TAG, "[%s] still sending, left running", s_sinks[i].sink.name);
+            }
+        }
+        return ESP_ERR_TIMEOUT;
+    }
+
+    for (size_t i = 0; i < s_sink_count; i++) {
+        if (s_sinks[i].queue != NULL) {
+            vQueueDelete(s_sinks[i].queue);
+        }
+        memset(&s_sinks[i], 0, sizeof(s_sinks[i]));
+    }
+    s_sink_count = 0;
+    s_has_deadline = false;
+
+    vEventGroupDelete(s_events);
+    s_events = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file telemetry_pipeline.h
+ * @brief Transport-agnostic telemetry pipeline
+ *
+ * One internal sample record is built per measurement and fanned out to all
+ * registered sinks (ESP-NOW, MQTT, InfluxDB, HTTP, ...). Each sink owns its
+ * encoder, a queue, a retry policy and delivery statistics, and runs in its
+ * own task so transports send concurrently instead of one after another.
+ */
+
+#ifndef TELEMETRY_PIPELINE_H
+#define TELEMETRY_PIPELINE_H
+
+#include "esp_err.h"
+#include "../utils/holt_predictor.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TELEMETRY_MAX_SINKS             4       ///< Maximum number of registered sinks
+#define TELEMETRY_SINK_DEFAULT_QUEUE    4       ///< Queue length when a sink requests 0
+#define TELEMETRY_SINK_DEFAULT_STACK    4096    ///< Task stack when a sink requests 0
+
+/**
+ * @brief Internal sample record, the single source for all transports
+ *
+ * Timestamps are always milliseconds since epoch (0 if time is not synced);
+ * sink encoders convert to their wire units.
+ */
+typedef struct {
+    uint64_t timestamp_ms;          ///< Timestamp in milliseconds
+    char device_id[32];             ///< Device identifier
+
+    // Soil
+    float soil_voltage;             ///< Soil sensor voltage
+    float moisture_percent;         ///< Moisture percentage
+    int soil_raw_adc;               ///< Raw soil ADC reading
+
+    // Battery
+    float battery_voltage;          ///< Battery voltage
+    float battery_percent;          ///< Battery percentage (0-100)
+
+    uint32_t suppressed;            ///< Samples withheld by the report policy before this one
+    bool has_model;                 ///< model is set (moisture predictor enabled)
+    holt_model_t model;             ///< Shared moisture predictor after this sample, centi-percent
+
+    bool backlog;                   ///< Taken during sleep, the live sample of this wake follows
+    uint32_t seq;                   ///< Set by telemetry_pipeline_submit(), the same on every retry
+} telemetry_sample_t;
+
+/**
+ * @brief Sink send function: encode the sample and transmit it
+ *
+ * Called from the sink's task. May block. Returning an error triggers the
+ * sink's retry policy, so it should be safe to call again for the same sample.
+ *
+ * @param sample Sample to send
+ * @param ctx Sink context
+ * @return ESP_OK when delivered, error code otherwise
+ */
+typedef esp_err_t (*telemetry_sink_send_fn_t)(const telemetry_sample_t* sample, void* ctx);
+
+/**
+ * @brief Sink close function: end the transport session (optional)
+ *
+ * Called from telemetry_pipeline_deinit() in the caller's task, after the
+ * sink's task ended or did not end in time.
+ *
+ * @param ctx Sink context
+ */
+typedef void (*telemetry_sink_close_fn_t)(void* ctx);
+
+/**
+ * @brief Sink description
+ */
+typedef struct {
+    const char* name;                   ///< Sink name (task name and logs)
+    telemetry_sink_send_fn_t send;      ///< Encoder + transport
+    telemetry_sink_close_fn_t close;    ///< Session teardown (NULL = none)
+    void* ctx;                          ///< Passed to send
+    uint8_t max_attempts;               ///< Attempts per sample (0 = 1), 1 when the client retries itself
+    uint32_t retry_delay_ms;            ///< Backoff cap of the first retry (0 = RETRY_BASE_DELAY_MS)
+    size_t queue_len;                   ///< Queued samples (0 = TELEMETRY_SINK_DEFAULT_QUEUE)
+    uint32_t stack_size;                ///< Task stack (0 = TELEMETRY_SINK_DEFAULT_STACK)
+} telemetry_sink_t;
+
+/**
+ * @brief Per-sink delivery statistics
+ */
+typedef struct {
+    uint32_t submitted;             ///< Samples accepted into the queue
+    uint32_t delivered;             ///< Samples sent successfully
+    uint32_t failed;                ///< Samples given up after all attempts
+    uint32_t retries;               ///< Extra attempts made
+    uint32_t dropped;               ///< Samples rejected because the queue was full
+    uint32_t last_latency_ms;       ///< Submit-to-delivery latency of the last sample
+    esp_err_t last_error;           ///< Last send error (ESP_OK if none)
+} telemetry_sink_stats_t;
+
+/**
+ * @brief Initialize the pipeline (idempotent)
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t telemetry_pipeline_init(void);
+
+/**
+ * @brief Register a sink and start its task
+ *
+ * @param sink Sink description (copied)
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM if no sink slot is left
+ */
+esp_err_t telemetry_pipeline_register_sink(const telemetry_sink_t* sink);
+
+/**
+ * @brief Fan a sample out to all registered sinks
+ *
+ * Never blocks: a sink whose queue is full drops the sample and counts it.
+ * Each submission gets a new seq (never 0).
+ *
+ * @param sample Sample to send
+ * @return esp_err_t ESP_OK if at least one sink accepted it
+ */
+esp_err_t telemetry_pipeline_submit(const telemetry_sample_t* sample);
+
+/**
+ * @brief Set the shared deadline of the network phase
+ *
+ * Sinks bound their own waits by it and skip retries that cannot finish in time.
+ *
+ * @param timeout_ms Deadline relative to now
+ */
+void telemetry_pipeline_set_deadline(uint32_t timeout_ms);
+
+/**
+ * @brief Time left until the deadline
+ *
+ * @return Remaining milliseconds (0 when passed, UINT32_MAX if no deadline is set)
+ */
+uint32_t telemetry_pipeline_remaining_ms(void);
+
+/**
+ * @brief Wait until every sink has processed all submitted samples
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return esp_err_t ESP_OK when idle, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t telemetry_pipeline_wait_idle(uint32_t timeout_ms);
+
+/**
+ * @brief Get statistics of a sink
+ *
+ * @param name Sink name
+ * @param stats Output statistics
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if no such sink
+ */
+esp_err_t telemetry_pipeline_get_stats(const char* name, telemetry_sink_stats_t* stats);
+
+/**
+ * @brief Check whether every sink delivered everything submitted to it
+ *
+ * @return true if no sample failed, was dropped or is still pending
+ */
+bool telemetry_pipeline_all_delivered(void);
+
+/**
+ * @brief Log statistics of all sinks
+ */
+void telemetry_pipeline_log_stats(void);
+
+/**
+ * @brief Stop the sink tasks, close all sink sessions and unregister the sinks
+ *
+ * Samples still queued are given up. Each task finishes its current send and
+ * ends itself; tasks are never deleted from outside, so transports release
+ * their sockets, TLS contexts and locks.
+ *
+ * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT if a sink is still
+ *         sending after its session was closed (its resources are left in place)
+ */
+esp_err_t telemetry_pipeline_deinit(void);
+
+#endif // TELEMETRY_PIPELINE_H
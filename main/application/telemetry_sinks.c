@@ -0,0 +1,319 @@
+/**
+ * @file telemetry_sinks.c
+ * @brief Telemetry pipeline sinks for the available transports - Implementation
+ */
+
+#include "telemetry_sinks.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if USE_MQTT
+#include "../drivers/mqtt/my_mqtt_driver.h"
+#include "mqtt_sender.h"
+#include "mqtt_sender_task.h"
+#endif // USE_MQTT
+
+#if USE_INFLUXDB
+#include "../drivers/influxdb/influxdb_client.h"
+#include "influx_sender_task.h"
+#endif // USE_INFLUXDB
+
+#if USE_HTTP
+#include "../drivers/http/http_client.h"
+#endif // USE_HTTP
+
+
+// #####################################
+// MARK: ESP-NOW
+// #####################################
+
+#if USE_ESPNOW
+static esp_err_t espnow_sink_send(const telemetry_sample_t* sample, void* ctx) {
+    telemetry_espnow_ctx_t* espnow_ctx = (telemetry_espnow_ctx_t*)ctx;
+
+    espnow_sensor_data_t packet;
+    espnow_sender_build_packet(&packet,
+        sample->device_id,
+        sample->timestamp_ms,
+        sample->soil_voltage,
+        sample->moisture_percent,
+        sample->soil_raw_adc,
+        sample->battery_voltage,
+        sample->battery_percent);
+    packet.suppressed = sample->suppressed;
+    packet.has_model = sample->has_model;
+    packet.model_level = sample->model.level;
+    packet.model_trend = sample->model.trend;
+
+    // The sender already scans channels and retries, one pipeline attempt is enough
+    espnow_ctx->last_status = espnow_sender_send_data(&packet, espnow_ctx->channel,
+                                                      espnow_ctx->responder_mac);
+    return (espnow_ctx->last_status == ESPNOW_SENDER_OK) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t telemetry_sink_register_espnow(telemetry_espnow_ctx_t* ctx) {
+    if (ctx == NULL || ctx->channel == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    telemetry_sink_t sink = {
+        .name = "sink_espnow",
+        .send = espnow_sink_send,
+        .ctx = ctx,
+        .max_attempts = 1,
+    };
+    return telemetry_pipeline_register_sink(&sink);
+}
+#endif // USE_ESPNOW
+
+
+
+
+// #####################################
+// MARK: MQTT
+// #####################################
+
+#if USE_MQTT
+static esp_err_t mqtt_sink_send(const telemetry_sample_t* sample, void* ctx) {
+    telemetry_mqtt_ctx_t* mqtt_ctx = (telemetry_mqtt_ctx_t*)ctx;
+
+#if MQTT_BATCH_MODE
+    // Add to the backlog once, a retry only republishes it
+    if (mqtt_ctx->batched_seq != sample->seq) {
+        mqtt_batch_sample_t batch_sample = {
+            .timestamp_ms = sample->timestamp_ms,
+            .soil_voltage = sample->soil_voltage,
+            .moisture_percent = sample->moisture_percent,
+            .raw_adc = sample->soil_raw_adc,
+            .battery_voltage = sample->battery_voltage,
+            .battery_percent = sample->battery_percent,
+        };
+        mqtt_batch_add_sample(&batch_sample);
+        mqtt_ctx->batched_seq = sample->seq;
+    }
+    if (sample->backlog) {
+        // Goes out with the live sample's batch: one batch per wake
+        return ESP_OK;
+    }
+#endif // MQTT_BATCH_MODE
+
+    // Session setup runs here, in parallel with the other sinks
+    if (!mqtt_client_is_connected()) {
+        esp_err_t err = mqtt_client_connect();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (!mqtt_ctx->discovery_done) {
+        // Cheap when nothing changed: only publishes if the config hash differs.
+        // The sender task serves its lane ahead of telemetry
+        mqtt_sender_task_enqueue_discovery(sample->device_id);
+        mqtt_ctx->discovery_done = true;
+    }
+
+    uint32_t flush_ms = telemetry_pipeline_remaining_ms();
+    if (flush_ms > MQTT_FLUSH_TIMEOUT_MS) {
+        flush_ms = MQTT_FLUSH_TIMEOUT_MS;
+    }
+
+    mqtt_soil_data_t soil = {
+        .timestamp_ms = sample->timestamp_ms,
+        .voltage = sample->soil_voltage,
+        .moisture_percent = sample->moisture_percent,
+        .raw_adc = sample->soil_raw_adc,
+    };
+    strncpy(soil.device_id, sample->device_id, sizeof(soil.device_id) - 1);
+
+    mqtt_battery_data_t battery = {
+        .timestamp_ms = sample->timestamp_ms,
+        .voltage = sample->battery_voltage,
+        .percentage = sample->battery_percent,
+    };
+    strncpy(battery.device_id, sample->device_id, sizeof(battery.device_id) - 1);
+
+    mqtt_client_status_t status;
+#if MQTT_BATCH_MODE
+    mqtt_batch_diag_t diag = {
+        .wake_count = mqtt_ctx->wake_count,
+        .free_heap = esp_get_free_heap_size(),
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .reset_reason = mqtt_ctx->reset_reason,
+        .suppressed = sample->suppressed,
+    };
+    status = mqtt_publish_batch(sample->device_id, &diag);
+    if (status == MQTT_CLIENT_STATUS_OK) {
+        status = mqtt_publish_latest_state(&soil, &battery);
+    }
+#else
+    // Per-metric messages go through the sender task's telemetry lane. Waiting
+    // for it to drain keeps samples of this sink from coalescing
+    mqtt_sender_task_stats_t before;
+    mqtt_sender_task_stats_t after;
+    mqtt_sender_task_get_stats(&before);
+    status = MQTT_CLIENT_STATUS_ERROR;
+    if (mqtt_sender_task_enqueue_battery(&battery) == ESP_OK &&
+        mqtt_sender_task_enqueue_soil(&soil) == ESP_OK &&
+        mqtt_sender_task_wait_until_empty(flush_ms) == ESP_OK) {
+        mqtt_sender_task_get_stats(&after);
+        if (after.lanes[MQTT_SENDER_LANE_TELEMETRY].failed == before.lanes[MQTT_SENDER_LANE_TELEMETRY].failed) {
+            status = MQTT_CLIENT_STATUS_OK;
+        }
+    }
+#endif // MQTT_BATCH_MODE
+    if (status != MQTT_CLIENT_STATUS_OK) {
+        return ESP_FAIL;
+    }
+
+    // Returns as soon as the discovery lane is served and the last PUBACK
+    // arrives; anything unacknowledged at disconnect goes to the offline store
+    mqtt_sender_task_wait_until_empty(flush_ms);
+    mqtt_client_wait_published(flush_ms);
+    return ESP_OK;
+}
+
+static void mqtt_sink_close(void* ctx) {
+    (void)ctx;
+    mqtt_client_disconnect();
+}
+
+esp_err_t telemetry_sink_register_mqtt(telemetry_mqtt_ctx_t* ctx) {
+    if (ctx == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    telemetry_sink_t sink = {
+        .name = "sink_mqtt",
+        .send = mqtt_sink_send,
+        .close = mqtt_sink_close,
+        .ctx = ctx,
+        .max_attempts = 2,      // A retry waits on the already started client
+        .retry_delay_ms = 500,
+    };
+    return telemetry_pipeline_register_sink(&sink);
+}
+#endif // USE_MQTT
+
+
+
+
+// #####################################
+// MARK: InfluxDB
+// #####################################
+
+#if USE_INFLUXDB
+static uint32_t s_influx_enqueued_seq = 0;     ///< Submission last handed to the writer
+
+static esp_err_t influxdb_sink_send(const telemetry_sample_t* sample, void* ctx) {
+    (void)ctx;
+
+    // A retry only drains again: the writer keeps a batch whose POST failed
+    if (s_influx_enqueued_seq != sample->seq) {
+        uint64_t timestamp_ns = sample->timestamp_ms * 1000000ULL;
+
+        influxdb_battery_data_t battery = {
+            .timestamp_ns = timestamp_ns,
+            .voltage = sample->battery_voltage,
+            .percentage = sample->battery_percent,
+        };
+        strncpy(battery.device_id, sample->device_id, sizeof(battery.device_id) - 1);
+
+        influxdb_soil_data_t soil = {
+            .timestamp_ns = timestamp_ns,
+            .voltage = sample->soil_voltage,
+            .moisture_percent = sample->moisture_percent,
+            .raw_adc = sample->soil_raw_adc,
+            .suppressed = sample->suppressed,
+        };
+        strncpy(soil.device_id, sample->device_id, sizeof(soil.device_id) - 1);
+
+        // Queue full while the writer is busy posting: write what is queued first
+        esp_err_t err = influx_sender_enqueue_battery(&battery);
+        if (err == ESP_ERR_NO_MEM) {
+            influx_sender_wait_until_empty(telemetry_pipeline_remaining_ms());
+            err = influx_sender_enqueue_battery(&battery);
+        }
+        if (err == ESP_OK) {
+            err = influx_sender_enqueue_soil(&soil);
+            if (err == ESP_ERR_NO_MEM) {
+                influx_sender_wait_until_empty(telemetry_pipeline_remaining_ms());
+                err = influx_sender_enqueue_soil(&soil);
+            }
+        }
+        // Points are idempotent (same tags and timestamp), re-enqueuing after a partial failure is safe
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_influx_enqueued_seq = sample->seq;
+    }
+
+    if (sample->backlog) {
+        // Written together with the live sample: one POST per wake
+        return ESP_OK;
+    }
+    return influx_sender_wait_until_empty(telemetry_pipeline_remaining_ms());
+}
+
+esp_err_t telemetry_sink_register_influxdb(void) {
+    telemetry_sink_t sink = {
+        .name = "sink_influx",
+        .send = influxdb_sink_send,
+        .max_attempts = 1,      // influxdb_client retries within the wake budget
+        .stack_size = 8192,     // TLS handshake
+    };
+    return telemetry_pipeline_register_sink(&sink);
+}
+#endif // USE_INFLUXDB
+
+
+
+
+// #####################################
+// MARK: HTTP
+// #####################################
+
+#if USE_HTTP
+static esp_err_t http_sink_send(const telemetry_sample_t* sample, void* ctx) {
+    (void)ctx;
+    char json[320];
+    int len = snprintf(json, sizeof(json),
+        "{\"timestamp\":%llu,\"device_id\":\"%s\",\"soil_voltage\":%.3f,\"moisture_percent\":%.2f,"
+        "\"raw_adc\":%d,\"battery_voltage\":%.3f,\"battery_percent\":%.1f,\"suppressed\":%lu",
+        (unsigned long long)sample->timestamp_ms, sample->device_id,
+        sample->soil_voltage, sample->moisture_percent, sample->soil_raw_adc,
+        sample->battery_voltage, sample->battery_percent, (unsigned long)sample->suppressed);
+    if (sample->has_model && len > 0 && len < (int)sizeof(json)) {
+        len += snprintf(json + len, sizeof(json) - len, ",\"model_level\":%ld,\"model_trend\":%ld",
+                        (long)sample->model.level, (long)sample->model.trend);
+    }
+    if (len > 0 && len < (int)sizeof(json)) {
+        len += snprintf(json + len, sizeof(json) - len, "}");
+    }
+    if (len < 0 || len >= (int)sizeof(json)) {
+        ESP_LOGE("TELEMETRY_SINK", "HTTP payload too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Buffered as a fixed-point sample, so the flash buffer can compress it
+    http_buffer_sample_t buffered = {
+        .timestamp_ms = sample->timestamp_ms,
+        .soil_mv = (int32_t)lroundf(sample->soil_voltage * 1000.0f),
+        .moisture_centi = (int32_t)lroundf(sample->moisture_percent * 100.0f),
+        .raw_adc = sample->soil_raw_adc,
+        .battery_mv = (int32_t)lroundf(sample->battery_voltage * 1000.0f),
+        .battery_deci = (int32_t)lroundf(sample->battery_percent * 10.0f),
+    };
+    return (http_client_send_sample_buffered(json, &buffered) == HTTP_RESPONSE_OK) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t telemetry_sink_register_http(void) {
+    telemetry_sink_t sink = {
+        .name = "sink_http",
+        .send = http_sink_send,
+        .max_attempts = 1,      // http_client retries within the wake budget
+        .stack_size = 6144,
+    };
+    return telemetry_pipeline_register_sink(&sink);
+}
+#endif // USE_HTTP
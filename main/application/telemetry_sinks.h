@@ -0,0 +1,87 @@
+/**
+ * @file telemetry_sinks.h
+ * @brief Telemetry pipeline sinks for the available transports
+ *
+ * Each sink encodes a telemetry_sample_t into its transport's wire format
+ * (ESP-NOW packet, MQTT JSON, InfluxDB line protocol, HTTP JSON) and sends it
+ * from its own pipeline task.
+ */
+
+#ifndef TELEMETRY_SINKS_H
+#define TELEMETRY_SINKS_H
+
+#include "esp_err.h"
+#include "telemetry_pipeline.h"
+#include "../config/esp32-config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#if USE_ESPNOW
+#include "espnow_sender.h"
+
+/**
+ * @brief ESP-NOW sink context
+ */
+typedef struct {
+    uint8_t* channel;                   ///< In/out: WiFi channel, updated when the hub was found elsewhere
+    uint8_t responder_mac[6];           ///< Out: MAC of the hub that acknowledged the last packet
+    espnow_sender_status_t last_status; ///< Out: status of the last send
+} telemetry_espnow_ctx_t;
+
+/**
+ * @brief Register the ESP-NOW sink
+ *
+ * @param ctx Sink context (must outlive the pipeline)
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t telemetry_sink_register_espnow(telemetry_espnow_ctx_t* ctx);
+#endif // USE_ESPNOW
+
+#if USE_MQTT
+/**
+ * @brief MQTT sink context
+ */
+typedef struct {
+    uint32_t wake_count;                ///< Diagnostics for the batch topic
+    int reset_reason;                   ///< Diagnostics for the batch topic
+    bool discovery_done;                ///< Internal: discovery checked in this session
+    uint32_t batched_seq;               ///< Internal: submission last added to the batch backlog (retries add it once)
+} telemetry_mqtt_ctx_t;
+
+/**
+ * @brief Register the MQTT sink
+ *
+ * The sink owns the whole MQTT session: it connects from its task, hands
+ * discovery (and per-metric telemetry without MQTT_BATCH_MODE) to the MQTT
+ * sender task, waits for the PUBACKs within the pipeline deadline and
+ * disconnects when the pipeline is closed. Requires mqtt_sender_task_init().
+ *
+ * @param ctx Sink context (must outlive the pipeline)
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t telemetry_sink_register_mqtt(telemetry_mqtt_ctx_t* ctx);
+#endif // USE_MQTT
+
+#if USE_INFLUXDB
+/**
+ * @brief Register the InfluxDB sink
+ *
+ * Both points of a sample go through the batching writer (influx_sender_init()
+ * must have been called). Readings taken during sleep are only enqueued, the
+ * live sample drains the writer, so a wake costs one POST.
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t telemetry_sink_register_influxdb(void);
+#endif // USE_INFLUXDB
+
+#if USE_HTTP
+/**
+ * @brief Register the HTTP JSON sink
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t telemetry_sink_register_http(void);
+#endif // USE_HTTP
+
+#endif // TELEMETRY_SINKS_H
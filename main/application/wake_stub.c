@@ -0,0 +1,205 @@
+/**
+ * @file wake_stub.c
+ * @brief Deep-sleep wake stub that samples soil moisture without a full boot - Implementation
+ *
+ * Everything the stub touches must live in RTC memory: code in RTC_IRAM_ATTR,
+ * data in RTC_DATA_ATTR. Flash is not mapped yet, so only ROM functions and
+ * inlined HAL register accessors may be called, and there is no logging.
+ */
+
+#include "wake_stub.h"
+#include "../config/esp32-config.h"
+#include "sdkconfig.h"
+
+#if WAKE_STUB_ENABLED
+
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "esp_rom_sys.h"
+#include "hal/adc_ll.h"
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+#include "soc/io_mux_reg.h"
+#include <string.h>
+
+#if !CONFIG_IDF_TARGET_ESP32
+#error "The wake stub reads the ADC through the ESP32 RTC controller, disable WAKE_STUB_ENABLED on this target"
+#endif
+
+#define WAKE_STUB_MAGIC     0x57534231      ///< "WSB1", stub armed by the application
+#define STUB_ADC_POLL_MAX   10000           ///< Busy-wait polls per conversion before giving up (~1 ms)
+
+/**
+ * @brief Stub state, kept in RTC slow memory across deep sleep
+ */
+typedef struct {
+    uint32_t magic;                                 ///< WAKE_STUB_MAGIC while armed
+    uint32_t wake_seq;                              ///< Incremented on every stub wake
+    uint64_t sleep_us;                              ///< Sleep time between stub wakes
+    uint16_t reference_raw;                         ///< Last uploaded reading
+    uint16_t upload_every;                          ///< Wakes between uploads
+    uint16_t wakes_since_upload;
+    uint8_t head;                                   ///< Oldest sample
+    uint8_t count;
+    uint8_t boot_reason;                            ///< wake_stub_boot_reason_t
+    wake_stub_sample_t samples[WAKE_STUB_RING_LEN];
+} wake_stub_state_t;
+
+static RTC_DATA_ATTR wake_stub_state_t s_state;
+
+
+
+
+// #####################################
+// MARK: Stub
+// #####################################
+
+/**
+ * @brief Power the probe and average SOIL_ADC_MEASUREMENTS raw conversions
+ *
+ * @return Averaged reading, -1 if no conversion completed
+ */
+static int RTC_IRAM_ATTR stub_read_soil_raw(void) {
+    gpio_ll_func_sel(&GPIO, SOIL_SENSOR_POWER_PIN, PIN_FUNC_GPIO);
+    gpio_ll_output_enable(&GPIO, SOIL_SENSOR_POWER_PIN);
+    gpio_ll_set_level(&GPIO, SOIL_SENSOR_POWER_PIN, 1);
+    esp_rom_delay_us(WAKE_STUB_SETTLE_US);
+
+    // The pad kept its analog configuration from the last full boot
+    adc_ll_set_power_manage(SOIL_ADC_UNIT, ADC_LL_POWER_SW_ON);
+    adc_ll_set_controller(SOIL_ADC_UNIT, ADC_LL_CTRL_RTC);
+    adc_oneshot_ll_set_output_bits(SOIL_ADC_UNIT, SOIL_ADC_BITWIDTH);
+    adc_oneshot_ll_set_atten(SOIL_ADC_UNIT, SOIL_ADC_CHANNEL, SOIL_ADC_ATTENUATION);
+
+    uint32_t sum = 0;
+    int done = 0;
+    for (int i = 0; i < SOIL_ADC_MEASUREMENTS; i++) {
+        adc_oneshot_ll_set_channel(SOIL_ADC_UNIT, SOIL_ADC_CHANNEL);
+        adc_oneshot_ll_start(SOIL_ADC_UNIT);
+        // A stuck conversion must not keep the chip awake with the probe powered
+        uint32_t polls = 0;
+        while (!adc_oneshot_ll_get_event(ADC_LL_EVENT_ADC1_ONESHOT_DONE) && polls < STUB_ADC_POLL_MAX) {
+            polls++;
+        }
+        if (polls >= STUB_ADC_POLL_MAX) {
+            break;
+        }
+        sum += adc_oneshot_ll_get_raw_result(SOIL_ADC_UNIT, SOIL_ADC_CHANNEL);
+        done++;
+    }
+
+    adc_ll_set_power_manage(SOIL_ADC_UNIT, ADC_LL_POWER_BY_FSM);
+    gpio_ll_set_level(&GPIO, SOIL_SENSOR_POWER_PIN, 0);
+    return (done > 0) ? (int)(sum / done) : -1;
+}
+
+static void RTC_IRAM_ATTR wake_stub_entry(void) {
+    if (s_state.magic != WAKE_STUB_MAGIC) {
+        esp_default_wake_deep_sleep();
+        return;
+    }
+
+    s_state.wake_seq++;
+    int raw = stub_read_soil_raw();
+    int32_t delta = 0;
+
+    if (raw >= 0) {
+        // Ring buffer, overwrites the oldest reading if the last upload failed to drain it
+        uint8_t slot = (uint8_t)((s_state.head + s_state.count) % WAKE_STUB_RING_LEN);
+        s_state.samples[slot].wake_seq = s_state.wake_seq;
+        s_state.samples[slot].raw_adc = (uint16_t)raw;
+        if (s_state.count < WAKE_STUB_RING_LEN) {
+            s_state.count++;
+        } else {
+            s_state.head = (uint8_t)((s_state.head + 1) % WAKE_STUB_RING_LEN);
+        }
+
+        delta = (int32_t)raw - (int32_t)s_state.reference_raw;
+        if (delta < 0) {
+            delta = -delta;
+        }
+    }
+    s_state.wakes_since_upload++;
+
+    uint8_t reason = WAKE_STUB_BOOT_NONE;
+    if (s_state.count >= WAKE_STUB_RING_LEN) {
+        reason = WAKE_STUB_BOOT_FULL;
+    } else if (delta >= WAKE_STUB_DELTA_RAW) {
+        reason = WAKE_STUB_BOOT_THRESHOLD;
+    } else if (s_state.wakes_since_upload >= s_state.upload_every) {
+        reason = WAKE_STUB_BOOT_INTERVAL;
+    }
+
+    if (reason != WAKE_STUB_BOOT_NONE) {
+        // Continue into the bootloader and the full application
+        s_state.boot_reason = reason;
+        esp_default_wake_deep_sleep();
+        return;
+    }
+
+    esp_wake_stub_set_wakeup_time(s_state.sleep_us);
+    esp_wake_stub_sleep(&wake_stub_entry);
+}
+
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+void wake_stub_arm(uint64_t sleep_us, int reference_raw) {
+    uint32_t upload_every = (uint32_t)(((uint64_t)DEEP_SLEEP_DURATION_SECONDS * 1000000ULL) / sleep_us);
+
+    s_state.sleep_us = sleep_us;
+    s_state.reference_raw = (uint16_t)((reference_raw > 0) ? reference_raw : 0);
+    s_state.upload_every = (uint16_t)((upload_every > 0) ? upload_every : 1);
+    s_state.wakes_since_upload = 0;
+    s_state.boot_reason = WAKE_STUB_BOOT_NONE;
+    s_state.magic = WAKE_STUB_MAGIC;
+
+    esp_set_deep_sleep_wake_stub(&wake_stub_entry);
+}
+
+wake_stub_boot_reason_t wake_stub_get_boot_reason(void) {
+    if (s_state.magic != WAKE_STUB_MAGIC || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+        return WAKE_STUB_BOOT_NONE;
+    }
+    return (wake_stub_boot_reason_t)s_state.boot_reason;
+}
+
+uint32_t wake_stub_get_wake_seq(void) {
+    return s_state.wake_seq;
+}
+
+size_t wake_stub_peek(wake_stub_sample_t* out, size_t max) {
+    if (out == NULL || s_state.magic != WAKE_STUB_MAGIC) {
+        return 0;
+    }
+
+    size_t n = (s_state.count < max) ? s_state.count : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s_state.samples[(s_state.head + i) % WAKE_STUB_RING_LEN];
+    }
+    return n;
+}
+
+void wake_stub_consume(size_t count) {
+    if (s_state.magic != WAKE_STUB_MAGIC) {
+        return;
+    }
+    if (count > s_state.count) {
+        count = s_state.count;
+    }
+    s_state.head = (uint8_t)((s_state.head + count) % WAKE_STUB_RING_LEN);
+    s_state.count = (uint8_t)(s_state.count - count);
+}
+
+size_t wake_stub_take(wake_stub_sample_t* out, size_t max) {
+    size_t n = wake_stub_peek(out, max);
+    wake_stub_consume(n);
+    return n;
+}
+
+#endif // WAKE_STUB_ENABLED
@@ -0,0 +1,89 @@
+/**
+ * @file wake_stub.h
+ * @brief Deep-sleep wake stub that samples soil moisture without a full boot
+ *
+ * On a timer wake the ROM runs the stub from RTC memory before the
+ * bootloader. It powers the probe, takes a raw ADC reading, appends it to a
+ * ring buffer in RTC memory and goes straight back to sleep. The full
+ * application only boots when the buffer is full, the reading moved more
+ * than WAKE_STUB_DELTA_RAW from the last uploaded one, or the upload interval
+ * elapsed. The application then drains the buffer and uploads the backlog.
+ *
+ * The stub reads the ADC at register level through the RTC controller and is
+ * implemented for the ESP32 only.
+ */
+
+#ifndef WAKE_STUB_H
+#define WAKE_STUB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Why the stub continued into the full application
+ */
+typedef enum {
+    WAKE_STUB_BOOT_NONE = 0,        ///< Not booted by the stub (first boot, reset, stub not armed)
+    WAKE_STUB_BOOT_FULL,            ///< Ring buffer full
+    WAKE_STUB_BOOT_THRESHOLD,       ///< Reading moved past WAKE_STUB_DELTA_RAW
+    WAKE_STUB_BOOT_INTERVAL,        ///< Upload interval elapsed
+} wake_stub_boot_reason_t;
+
+/**
+ * @brief Reading taken by the stub
+ */
+typedef struct {
+    uint32_t wake_seq;              ///< Stub wake number, see wake_stub_get_wake_seq()
+    uint16_t raw_adc;               ///< Averaged raw soil ADC reading
+} wake_stub_sample_t;
+
+/**
+ * @brief Install the stub for the next deep sleep
+ *
+ * Call right before esp_deep_sleep_start(); the timer wakeup must be enabled
+ * with the same sleep time.
+ *
+ * @param sleep_us Sleep time between stub wakes
+ * @param reference_raw Raw soil reading just uploaded, base of the threshold
+ */
+void wake_stub_arm(uint64_t sleep_us, int reference_raw);
+
+/**
+ * @brief Reason this boot was let through by the stub
+ */
+wake_stub_boot_reason_t wake_stub_get_boot_reason(void);
+
+/**
+ * @brief Number of the current wake, the age of a sample is the difference in wakes
+ */
+uint32_t wake_stub_get_wake_seq(void);
+
+/**
+ * @brief Copy the buffered readings out of RTC memory (oldest first)
+ *
+ * The buffer is left as is; wake_stub_consume() drops the readings once
+ * they were uploaded.
+ *
+ * @param out Output samples
+ * @param max Capacity of out
+ * @return size_t Number of samples copied
+ */
+size_t wake_stub_peek(wake_stub_sample_t* out, size_t max);
+
+/**
+ * @brief Drop the oldest buffered readings
+ *
+ * @param count Number of readings to drop, e.g. the return of wake_stub_peek()
+ */
+void wake_stub_consume(size_t count);
+
+/**
+ * @brief Move the buffered readings out of RTC memory (oldest first)
+ *
+ * @param out Output samples
+ * @param max Capacity of out
+ * @return size_t Number of samples copied and removed; readings beyond max stay buffered
+ */
+size_t wake_stub_take(wake_stub_sample_t* out, size_t max);
+
+#endif // WAKE_STUB_H
@@ -17,6 +17,7 @@
 #define WIFI_DEFAULT_CHANNEL    11
 #define NVS_NAMESPACE                "soil_sensor"
 #define NVS_KEY_APP_CONFIG           "app_config"
+#define NVS_KEY_HA_DISCOVERY_HASH    "ha_disc_hash"
 
 // GPIO Pin Assignments
 #define LED_GPIO_NUM           GPIO_NUM_22
@@ -78,6 +79,26 @@
 #define DEEP_SLEEP_WAKEUP_DELAY_MS      100                 // Delay before entering deep sleep
 #define NO_DEEP_SLEEP_RESTART_DELAY_MS  60 * 1000           // Delay before restart if deep sleep is disabled
 
+#define WAKE_STUB_ENABLED               0                   // Sample soil from a deep-sleep wake stub, boot fully only to upload (ESP32 only)
+#define WAKE_STUB_INTERVAL_SECONDS      (10*60)             // Stub sampling interval, uploads still every DEEP_SLEEP_DURATION_SECONDS
+#define WAKE_STUB_RING_LEN              16                  // Readings buffered in RTC memory, a full buffer forces an upload
+#define WAKE_STUB_DELTA_RAW             200                 // Upload early when the raw reading moves this far from the last upload
+#define WAKE_STUB_SETTLE_US             (200*1000)          // Probe power-up settle time inside the stub
+
+#define ULP_SAMPLER_ENABLED             0                   // ULP samples soil and battery during deep sleep (ESP32, SOIL_SENSOR_POWER_PIN must be an RTC GPIO, see drivers/adc/ulp_sampler.h)
+#define ULP_SAMPLER_PERIOD_MS           (10*60*1000)        // ULP sampling period
+#define ULP_SAMPLER_SETTLE_MS           200                 // Probe power-up settle time before the ULP samples
+#define ULP_SAMPLER_RING_LEN            64                  // Readings buffered in RTC slow memory, a full buffer wakes the CPU
+#define ULP_SAMPLER_SOIL_THRESHOLD_RAW  2500                // Wake when the raw soil reading crosses this value
+#define ULP_SAMPLER_SOIL_DELTA_RAW      300                 // Wake when the raw soil reading moves this far from the last upload
+
+#define ADAPTIVE_SLEEP_ENABLED          1                   // Sleep interval follows the moisture rate of change (timer wakeup only)
+#define ADAPTIVE_SLEEP_MIN_SECONDS      (10*60)             // Shortest sleep, used while the soil changes fast
+#define ADAPTIVE_SLEEP_MAX_SECONDS      (3*60*60)           // Longest sleep, used while the soil is stable
+#define ADAPTIVE_SLEEP_TARGET_DELTA_PERCENT 2.0f            // Aim to wake once per this much moisture change
+#define ADAPTIVE_SLEEP_HYSTERESIS_PERCENT 25                // Keep the interval unless the target differs by more than this
+#define ADAPTIVE_SLEEP_BATTERY_LOW_PERCENT 20.0f            // Below this the minimum interval rises linearly towards the maximum
+
 // ============================================================================
 // NTP Time Synchronization Configuration
 // ============================================================================
@@ -100,6 +121,18 @@
 #define WIFI_CONNECTED_BIT      BIT0
 #define WIFI_FAIL_BIT           BIT1
 
+// ============================================================================
+// ESP-NOW / Radio Configuration
+// ============================================================================
+
+#define ESPNOW_LEAN_WIFI_INIT           1                   // ESP-NOW-only nodes start WiFi without netif/event loop and with fewer buffers
+#define PHY_CAL_FULL_EVERY_WAKES        48                  // Full RF calibration after this many deep-sleep wakes
+#define PHY_CAL_FULL_INTERVAL_SECONDS   (24*60*60)          // ... or after this long since the last one
+#define PHY_CAL_TEMP_DELTA_C            10.0f               // ... or when the chip temperature moved this far (no sensor on ESP32)
+#define TIME_SYNC_MAX_RTT_MS            50                  // Ignore the hub time in ESP-NOW ACKs with a longer round trip
+#define TIME_SYNC_DRIFT_MIN_INTERVAL_SECONDS 600            // Shortest time between syncs that updates the drift estimate
+#define TIME_SYNC_MAX_DRIFT_PPM         50000.0f            // Clamp of the drift estimate (RTC slow clock)
+
 // ============================================================================
 // InfluxDB Configuration
 // ============================================================================
@@ -111,11 +144,28 @@
 #define INFLUXDB_BUCKET         "soil-test"
 #define INFLUXDB_ORG            "Michipi"           // Note: org is case-sensitive and must match InfluxDB exactly
 #define INFLUXDB_ENDPOINT       "/api/v2/write"
-
+#define INFLUX_BATCH_MAX_BYTES  1024                // Batch buffer of the async writer, flushed when full
+#define INFLUX_BATCH_FLUSH_MS   2000                // Flush a partial batch after this age
+#define INFLUX_SENDER_QUEUE_LEN 10                  // Points queued for the async writer
+#define INFLUXDB_GZIP_ENABLED   1                   // gzip request bodies (Content-Encoding: gzip)
+#define INFLUXDB_GZIP_MIN_BYTES 512                 // Smaller bodies are sent uncompressed
+#define INFLUXDB_GZIP_WINDOW    1024                // LZ77 window, power of two (8 bytes of heap per entry)
+
+#define USE_HTTP                0                   // Enable HTTP JSON sink (main/CMakeLists.txt adds the drivers/http sources)
+#define HTTP_SERVER_IP          "192.168.1.253"     // Server of server/soil_server.py
+#define HTTP_SERVER_PORT        8080
+#define HTTP_ENDPOINT           "/soil-data"
 #define HTTP_TIMEOUT_MS         15000               // Increased timeout to 15s
 #define HTTP_MAX_RETRIES        3                   // More retries
 #define HTTP_ENABLE_BUFFERING   1
-#define HTTP_MAX_BUFFERED_PACKETS  100
+#define HTTP_MAX_BUFFERED_PACKETS  100              // Packets, samples with HTTP_BUFFER_FLASH_LOG
+#define HTTP_BUFFER_FLASH_LOG   1                   // Buffer ts_codec blocks in the "tslog" flash partition (drivers/flash_log) instead of JSON in NVS
+#define HTTP_BUFFER_BLOCK_BYTES 256                 // Open block kept in RTC memory, one flash log record once full
+#define HTTP_STREAM_FLUSH       1                   // Flush the backlog as one chunked NDJSON request
+
+#define RETRY_BASE_DELAY_MS     500                 // Backoff cap of the first retry, doubled per retry (full jitter)
+#define RETRY_MAX_DELAY_MS      4000                // Upper bound of one backoff delay, also caps Retry-After
+#define RETRY_BUDGET_MS         8000                // Retry time per wake shared by the clients and the pipeline sinks
 
 
 // ============================================================================
@@ -129,6 +179,41 @@
 #define MQTT_KEEPALIVE          120                 // Keep-alive interval in seconds
 #define MQTT_TIMEOUT_MS         10000               // Connection timeout in milliseconds
 #define MQTT_USE_SSL            0                   // Use SSL/TLS (0 = no, 1 = yes)
+#define MQTT_OUTBOX_SLOTS       8                   // Pre-allocated publish slots (topic + payload + in-flight state)
+#define MQTT_FLUSH_TIMEOUT_MS   5000                // Upper bound for waiting on PUBACKs before sleep
+#define MQTT_BATCH_MODE         1                   // 1 = one batch message per wake + QoS 0 state topics, 0 = QoS 1 per metric
+#define MQTT_BATCH_BACKLOG_MAX  (8 + WAKE_STUB_ENABLED * WAKE_STUB_RING_LEN + ULP_SAMPLER_ENABLED * ULP_SAMPLER_RING_LEN) // Unacknowledged samples in RTC memory: 8 wakes plus a full sleep backlog
+#define MQTT_BATCH_COMPRESSED   1                   // Batch rows as a base64 delta-of-delta block (utils/ts_codec.h) instead of JSON arrays
+#define MQTT_PERSIST_OFFLINE    1                   // Store undeliverable QoS 1 messages in flash and replay on connect
+#define MQTT_PERSIST_MAX_ENTRIES 32                 // Offline store bound, oldest message is dropped when full
+
+#define TELEMETRY_SEND_TIMEOUT_MS   30000           // Max wait for all telemetry sinks before sleeping
+
+// ============================================================================
+// Reporting Policy
+// ============================================================================
+
+#define REPORT_POLICY_ENABLED           1                   // Withhold samples that did not change, 0 = report every wake
+#define REPORT_MOISTURE_DEADBAND_PERCENT 2.0f               // Report when moisture moved more than this since the last report
+#define REPORT_BATTERY_DEADBAND_V       0.05f               // Report when the battery moved more than this since the last report
+#define REPORT_HEARTBEAT_SECONDS        (6*60*60)           // Report at least this often
+#ifndef REPORT_PREDICTOR_ENABLED                            // The host replay also builds the plain deadband
+#define REPORT_PREDICTOR_ENABLED        1                   // Center the moisture deadband on a Holt prediction shared with the receiver
+#endif
+#define REPORT_PREDICTOR_ALPHA_Q15      16384               // Level smoothing, Q15 (0.5)
+#define REPORT_PREDICTOR_BETA_Q15       8192                // Trend smoothing, Q15 (0.25)
+
+// ============================================================================
+// Hub Configuration
+// ============================================================================
+
+#define HUB_INFLUX_FORWARD      0                   // Hub writes received sensor data to InfluxDB
+#define HUB_AGG_MAX_POINTS      64                  // Buffered points, backlog is shed beyond this
+#define HUB_AGG_MAX_DEVICES     16                  // Distinct sensors with pending points
+#define HUB_AGG_FLUSH_POINTS    32                  // Flush when this many points are pending
+#define HUB_AGG_FLUSH_BYTES     3072                // Flush when the encoded points reach this size
+#define HUB_AGG_BODY_BYTES      4096                // Largest request body, larger backlogs take several writes
+#define HUB_AGG_MAX_LATENCY_MS  5000                // Flush when the oldest point is this old, also the retry delay
 
 #endif // ESP32_CONFIG_H
 
@@ -0,0 +1,298 @@
+/**
+ * @file ulp_sampler.c
+ * @brief ULP coprocessor soil and battery sampling during deep sleep - Implementation
+ *
+ * RTC slow memory layout (32-bit words, the ULP uses the low 16 bits):
+ *   [0, ULP_SAMPLER_PROGRAM_WORDS)  program
+ *   DATA + 0                        number of buffered readings
+ *   DATA + 1                        reference soil reading
+ *   DATA + 2                        side of the threshold the reference is on
+ *   DATA + 3                        wake reason
+ *   DATA + 4 + 2 * i                soil, battery of reading i
+ */
+
+#include "ulp_sampler.h"
+#include "../../config/esp32-config.h"
+#include "sdkconfig.h"
+
+#if ULP_SAMPLER_ENABLED
+
+#include "adc_manager.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "ulp.h"
+#include "ulp_adc.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "hal/adc_ll.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/rtc_io_reg.h"
+#include <string.h>
+
+#if !CONFIG_IDF_TARGET_ESP32 || !CONFIG_ULP_COPROC_TYPE_FSM
+#error "The ULP sampler needs the ESP32 ULP FSM, disable ULP_SAMPLER_ENABLED on this target"
+#endif
+
+#if CONFIG_ULP_COPROC_RESERVE_MEM < ULP_SAMPLER_RESERVE_BYTES
+#error "CONFIG_ULP_COPROC_RESERVE_MEM is too small for the ULP sampler"
+#endif
+
+#define DATA                (ULP_SAMPLER_PROGRAM_WORDS)
+#define VAR_COUNT           (DATA + 0)
+#define VAR_REF             (DATA + 1)
+#define VAR_REF_SIDE        (DATA + 2)
+#define VAR_REASON          (DATA + 3)
+#define VAR_RING            (DATA + 4)
+
+#define ULP_DELAY_CYCLES    0xFFFF      ///< Longest I_DELAY, ~8 ms at RTC_FAST_CLK
+#define ULP_CYCLES_PER_MS   8000
+
+// Program labels
+enum {
+    L_SIDE = 1,
+    L_NO_CROSS,
+    L_NEG,
+    L_ABS,
+    L_FULL,
+    L_WAKE,
+    L_DONE,
+};
+
+/**
+ * @brief Append instructions to the program being built
+ */
+#define EMIT(...) do {                                                      \
+        const ulp_insn_t part_[] = { __VA_ARGS__ };                         \
+        size_t n_ = sizeof(part_) / sizeof(part_[0]);                       \
+        if (len + n_ > ULP_SAMPLER_PROGRAM_WORDS) {                         \
+            return ESP_ERR_NO_MEM;                                          \
+        }                                                                   \
+        memcpy(&program[len], part_, sizeof(part_));                        \
+        len += n_;                                                          \
+    } while (0)
+
+static const char* TAG = "ULP_SAMPLER";
+
+
+
+
+// #####################################
+// MARK: Program
+// #####################################
+
+/**
+ * @brief Generate and load the sampling program
+ *
+ * @param rtcio RTC IO number of the probe power pin
+ */
+static esp_err_t load_program(const ulp_sampler_config_t* config, int rtcio) {
+    ulp_insn_t program[ULP_SAMPLER_PROGRAM_WORDS];
+    size_t len = 0;
+
+    uint32_t settle_loops = (config->settle_ms * ULP_CYCLES_PER_MS + ULP_DELAY_CYCLES - 1) / ULP_DELAY_CYCLES;
+    if (settle_loops > 255) {
+        settle_loops = 255;     // Stage counter is 8 bit
+    }
+
+    // No room left: only ask for a wake
+    EMIT(I_MOVI(R3, 0),
+         I_LD(R0, R3, VAR_COUNT),
+         M_BGE(L_FULL, ULP_SAMPLER_RING_LEN));
+
+    // Probe powered only around the conversions
+    EMIT(I_WR_REG(RTC_GPIO_OUT_W1TS_REG, RTC_GPIO_OUT_DATA_W1TS_S + rtcio, RTC_GPIO_OUT_DATA_W1TS_S + rtcio, 1),
+         I_STAGE_RST(),
+         I_DELAY(ULP_DELAY_CYCLES),
+         I_STAGE_INC(1),
+         I_JUMPS(-2, settle_loops, JUMPS_LT));
+
+    // R1 = soil, R2 = battery
+    EMIT(I_ADC(R1, 0, SOIL_ADC_CHANNEL),
+         I_ADC(R2, 0, BATTERY_ADC_CHANNEL));
+
+    EMIT(I_WR_REG(RTC_GPIO_OUT_W1TC_REG, RTC_GPIO_OUT_DATA_W1TC_S + rtcio, RTC_GPIO_OUT_DATA_W1TC_S + rtcio, 1));
+
+    // Append at VAR_RING + 2 * count
+    EMIT(I_LD(R0, R3, VAR_COUNT),
+         I_LSHI(R0, R0, 1),
+         I_ST(R1, R0, VAR_RING),
+         I_ST(R2, R0, VAR_RING + 1),
+         I_LD(R0, R3, VAR_COUNT),
+         I_ADDI(R0, R0, 1),
+         I_ST(R0, R3, VAR_COUNT),
+         M_BGE(L_FULL, ULP_SAMPLER_RING_LEN));
+
+    // Threshold crossing: side of this reading (R2) differs from the reference side
+    EMIT(I_MOVR(R0, R1),
+         I_MOVI(R2, 0),
+         M_BL(L_SIDE, config->soil_threshold_raw),
+         I_MOVI(R2, 1),
+         M_LABEL(L_SIDE),
+         I_LD(R0, R3, VAR_REF_SIDE),
+         I_SUBR(R0, R0, R2),
+         M_BXZ(L_NO_CROSS),
+         I_MOVI(R2, ULP_SAMPLER_WAKE_THRESHOLD),
+         M_BX(L_WAKE),
+         M_LABEL(L_NO_CROSS));
+
+    // Delta: |soil - reference|, the ALU flags overflow on a negative difference
+    EMIT(I_LD(R2, R3, VAR_REF),
+         I_SUBR(R0, R1, R2),
+         M_BXF(L_NEG),
+         M_BX(L_ABS),
+         M_LABEL(L_NEG),
+         I_SUBR(R0, R2, R1),
+         M_LABEL(L_ABS),
+         M_BL(L_DONE, config->soil_delta_raw),
+         I_MOVI(R2, ULP_SAMPLER_WAKE_DELTA),
+         M_BX(L_WAKE));
+
+    // Wake with the reason in R2; if the CPU is not ready yet, the next period retries
+    EMIT(M_LABEL(L_FULL),
+         I_MOVI(R2, ULP_SAMPLER_WAKE_FULL),
+         M_LABEL(L_WAKE),
+         I_MOVI(R3, 0),
+         I_ST(R2, R3, VAR_REASON),
+         I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+         M_BL(L_DONE, 1),
+         I_WAKE(),
+         M_LABEL(L_DONE),
+         I_HALT());
+
+    size_t size = len;
+    esp_err_t ret = ulp_process_macros_and_load(0, program, &size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load ULP program: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGD(TAG, "ULP program: %u words", (unsigned)size);
+    return ESP_OK;
+}
+
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+esp_err_t ulp_sampler_start(const ulp_sampler_config_t* config, int reference_soil_raw) {
+    if (config == NULL || config->period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (adc_shared_is_initialized(SOIL_ADC_UNIT)) {
+        ESP_LOGE(TAG, "ADC unit %d is still in use", SOIL_ADC_UNIT);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int rtcio = rtc_io_number_get(SOIL_SENSOR_POWER_PIN);
+    if (rtcio < 0) {
+        // The ULP cannot switch the probe; a probe powered all sleep would drain the battery
+        ESP_LOGE(TAG, "GPIO %d is not an RTC GPIO, the ULP cannot power the probe", SOIL_SENSOR_POWER_PIN);
+        gpio_set_direction(SOIL_SENSOR_POWER_PIN, GPIO_MODE_OUTPUT);
+        gpio_set_level(SOIL_SENSOR_POWER_PIN, 0);
+        gpio_hold_en(SOIL_SENSOR_POWER_PIN);
+        gpio_deep_sleep_hold_en();
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Hand ADC1 to the ULP: the soil channel through the driver, the
+    // battery pad and attenuation directly (the driver takes one channel)
+    ulp_adc_cfg_t adc_cfg = {
+        .adc_n = SOIL_ADC_UNIT,
+        .channel = SOIL_ADC_CHANNEL,
+        .atten = SOIL_ADC_ATTENUATION,
+        .width = SOIL_ADC_BITWIDTH,
+        .ulp_mode = ADC_ULP_MODE_FSM,
+    };
+    esp_err_t ret = ulp_adc_init(&adc_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init ULP ADC: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    int battery_io = -1;
+    adc_oneshot_channel_to_io(BATTERY_ADC_UNIT, BATTERY_ADC_CHANNEL, &battery_io);
+    rtc_gpio_init(battery_io);
+    rtc_gpio_set_direction(battery_io, RTC_GPIO_MODE_DISABLED);
+    rtc_gpio_pullup_dis(battery_io);
+    rtc_gpio_pulldown_dis(battery_io);
+    adc_oneshot_ll_set_atten(BATTERY_ADC_UNIT, BATTERY_ADC_CHANNEL, BATTERY_ADC_ATTENUATION);
+
+    // Low between conversions, the ULP raises it only around each one
+    rtc_gpio_init(SOIL_SENSOR_POWER_PIN);
+    rtc_gpio_set_direction(SOIL_SENSOR_POWER_PIN, RTC_GPIO_MODE_OUTPUT_ONLY);
+    rtc_gpio_set_level(SOIL_SENSOR_POWER_PIN, 0);
+
+    ret = load_program(config, rtcio);
+    if (ret != ESP_OK) {
+        rtc_gpio_isolate(SOIL_SENSOR_POWER_PIN);
+        return ret;
+    }
+
+    if (reference_soil_raw < 0) {
+        reference_soil_raw = 0;
+    }
+    RTC_SLOW_MEM[VAR_COUNT] = 0;
+    RTC_SLOW_MEM[VAR_REF] = (uint32_t)reference_soil_raw;
+    RTC_SLOW_MEM[VAR_REF_SIDE] = (reference_soil_raw >= config->soil_threshold_raw) ? 1 : 0;
+    RTC_SLOW_MEM[VAR_REASON] = ULP_SAMPLER_WAKE_NONE;
+
+    ret = ulp_set_wakeup_period(0, config->period_ms * 1000);
+    if (ret == ESP_OK) {
+        ret = esp_sleep_enable_ulp_wakeup();
+    }
+    if (ret == ESP_OK) {
+        ret = ulp_run(0);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start ULP: %s", esp_err_to_name(ret));
+        rtc_gpio_isolate(SOIL_SENSOR_POWER_PIN);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "ULP sampling every %lu ms (threshold %u, delta %u, %d readings)",
+             (unsigned long)config->period_ms, config->soil_threshold_raw, config->soil_delta_raw,
+             ULP_SAMPLER_RING_LEN);
+    return ESP_OK;
+}
+
+ulp_sampler_wake_reason_t ulp_sampler_get_wake_reason(void) {
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_ULP) {
+        return ULP_SAMPLER_WAKE_NONE;
+    }
+    return (ulp_sampler_wake_reason_t)(RTC_SLOW_MEM[VAR_REASON] & 0xFFFF);
+}
+
+size_t ulp_sampler_take(ulp_sampler_reading_t* out, size_t max) {
+    ulp_timer_stop();
+
+    // Give the probe pin back to the digital GPIO matrix (isolated or held low during sleep)
+    if (rtc_io_number_get(SOIL_SENSOR_POWER_PIN) >= 0) {
+        rtc_gpio_hold_dis(SOIL_SENSOR_POWER_PIN);
+        rtc_gpio_deinit(SOIL_SENSOR_POWER_PIN);
+    } else {
+        gpio_hold_dis(SOIL_SENSOR_POWER_PIN);
+        gpio_deep_sleep_hold_dis();
+    }
+
+    if (out == NULL || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_ULP) {
+        return 0;
+    }
+
+    size_t count = RTC_SLOW_MEM[VAR_COUNT] & 0xFFFF;
+    if (count > ULP_SAMPLER_RING_LEN) {
+        count = ULP_SAMPLER_RING_LEN;
+    }
+    if (count > max) {
+        count = max;
+    }
+    for (size_t i = 0; i < count; i++) {
+        out[i].soil_raw = (uint16_t)(RTC_SLOW_MEM[VAR_RING + 2 * i] & 0xFFFF);
+        out[i].battery_raw = (uint16_t)(RTC_SLOW_MEM[VAR_RING + 2 * i + 1] & 0xFFFF);
+    }
+    RTC_SLOW_MEM[VAR_COUNT] = 0;
+    RTC_SLOW_MEM[VAR_REASON] = ULP_SAMPLER_WAKE_NONE;
+    return count;
+}
+
+#endif // ULP_SAMPLER_ENABLED
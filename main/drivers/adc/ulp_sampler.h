@@ -0,0 +1,85 @@
+/**
+ * @file ulp_sampler.h
+ * @brief ULP coprocessor soil and battery sampling during deep sleep
+ *
+ * A small ULP FSM program, generated at runtime from the legacy ULP macros,
+ * periodically powers the soil probe, samples the soil and battery channels
+ * of ADC1 and appends both raw values to a buffer in RTC slow memory. The
+ * main CPU is woken only when the soil reading crosses a threshold, moves
+ * more than a delta from the last reported value, or the buffer is full.
+ *
+ * Requirements (ESP32 only):
+ * - CONFIG_ULP_COPROC_ENABLED=y, CONFIG_ULP_COPROC_TYPE_FSM=y
+ * - CONFIG_ULP_COPROC_RESERVE_MEM >= ULP_SAMPLER_RESERVE_BYTES
+ * - SOIL_SENSOR_POWER_PIN must be an RTC GPIO: the ULP powers the probe only
+ *   around each conversion. Otherwise ulp_sampler_start() fails and holds
+ *   the pin low through the sleep.
+ */
+
+#ifndef ULP_SAMPLER_H
+#define ULP_SAMPLER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define ULP_SAMPLER_PROGRAM_WORDS   96      ///< Space reserved for the program
+#define ULP_SAMPLER_RESERVE_BYTES   ((ULP_SAMPLER_PROGRAM_WORDS + 4 + 2 * ULP_SAMPLER_RING_LEN) * 4)
+
+/**
+ * @brief Sampler configuration
+ */
+typedef struct {
+    uint32_t period_ms;             ///< Sampling period (ULP timer, max ~71 minutes)
+    uint32_t settle_ms;             ///< Probe power-up time before sampling
+    uint16_t soil_threshold_raw;    ///< Wake when the soil reading crosses this value
+    uint16_t soil_delta_raw;        ///< Wake when the soil reading moves this far
+} ulp_sampler_config_t;
+
+/**
+ * @brief Why the ULP woke the main CPU
+ */
+typedef enum {
+    ULP_SAMPLER_WAKE_NONE = 0,      ///< Not a ULP wake
+    ULP_SAMPLER_WAKE_FULL,          ///< Buffer full
+    ULP_SAMPLER_WAKE_THRESHOLD,     ///< Soil crossed soil_threshold_raw
+    ULP_SAMPLER_WAKE_DELTA,         ///< Soil moved soil_delta_raw
+} ulp_sampler_wake_reason_t;
+
+/**
+ * @brief Raw reading taken by the ULP
+ */
+typedef struct {
+    uint16_t soil_raw;              ///< Soil channel, 12 bit
+    uint16_t battery_raw;           ///< Battery channel, 12 bit
+} ulp_sampler_reading_t;
+
+/**
+ * @brief Load and start the ULP program, call right before deep sleep
+ *
+ * The shared ADC unit must be released first (csm_v2_deinit() and
+ * battery_monitor_deinit()) because ADC1 is handed over to the ULP.
+ * Enables the ULP wakeup source.
+ *
+ * @param config Sampler configuration
+ * @param reference_soil_raw Soil reading just reported, base of threshold and delta
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the probe power
+ *         pin is not an RTC GPIO, error code otherwise
+ */
+esp_err_t ulp_sampler_start(const ulp_sampler_config_t* config, int reference_soil_raw);
+
+/**
+ * @brief Reason for this wake, ULP_SAMPLER_WAKE_NONE if not woken by the ULP
+ */
+ulp_sampler_wake_reason_t ulp_sampler_get_wake_reason(void);
+
+/**
+ * @brief Stop the ULP timer and move the buffered readings out (oldest first)
+ *
+ * @param out Output readings
+ * @param max Capacity of out
+ * @return size_t Number of readings copied; the buffer is empty afterwards
+ */
+size_t ulp_sampler_take(ulp_sampler_reading_t* out, size_t max);
+
+#endif // ULP_SAMPLER_H
@@ -6,6 +6,7 @@
  */
 
 #include "espnow.h"
+#include "../../utils/wake_profiler.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_now.h"
@@ -13,8 +14,12 @@
 #include "esp_mac.h"
 #include "esp_netif.h"
 #include "esp_event.h"
+#include "esp_idf_version.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 #include <string.h>
 
 static const char *TAG = "ESPNOW_DRV";
@@ -25,6 +30,44 @@ static espnow_recv_cb_t s_user_recv_cb = NULL;
 static SemaphoreHandle_t s_ack_semaphore = NULL;
 static bool s_ack_received = false;
 static uint8_t s_ack_responder_mac[6] = {0};  // MAC of device that sent ACK (for discovery)
+static SemaphoreHandle_t s_tx_status_semaphore = NULL;
+static volatile esp_now_send_status_t s_last_tx_status = ESP_NOW_SEND_FAIL;
+// Send callbacks arrive once per esp_now_send() and in order, so numbering
+// both sides tells which frame a callback belongs to
+static volatile uint32_t s_tx_sent_seq = 0;     // Frames accepted by esp_now_send()
+static volatile uint32_t s_tx_done_seq = 0;     // Send callbacks seen
+static volatile uint32_t s_tx_await_seq = 0;    // Data frame of espnow_send_with_ack(), 0 = none
+static espnow_stats_t s_stats = {0};
+static bool s_first_frame_sent = false;
+static int64_t s_ack_tx_us = 0;             // esp_timer when the data awaiting an ACK was sent
+static espnow_ack_time_t s_ack_time;
+static bool s_ack_time_valid = false;
+
+/**
+ * @brief Internal ESP-NOW send callback (MAC-layer delivery status)
+ */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
+static void espnow_send_cb(const esp_now_send_info_t *tx_info, esp_now_send_status_t status)
+#else
+static void espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
+#endif
+{
+    // A late callback of an earlier frame (ACK reply, timed-out data) is ignored
+    uint32_t seq = ++s_tx_done_seq;
+    if (seq != s_tx_await_seq) {
+        return;
+    }
+    s_tx_await_seq = 0;
+    s_last_tx_status = status;
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        s_stats.link_ok++;
+    } else {
+        s_stats.link_fail++;
+    }
+    if (s_tx_status_semaphore) {
+        xSemaphoreGive(s_tx_status_semaphore);
+    }
+}
 
 /**
  * @brief Internal ESP-NOW receive callback
@@ -43,6 +86,15 @@ static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *
         s_ack_received = true;
         // Store the MAC of the device that sent the ACK (for discovery)
         memcpy(s_ack_responder_mac, mac_addr, 6);
+        if (len >= (int)sizeof(espnow_ack_time_msg_t)) {
+            espnow_ack_time_msg_t msg;
+            memcpy(&msg, data, sizeof(msg));
+            s_ack_time.rx_local_us = esp_timer_get_time();
+            s_ack_time.rtt_us = (uint32_t)(s_ack_time.rx_local_us - s_ack_tx_us);
+            s_ack_time.hub_time_ms = msg.hub_time_ms;
+            s_ack_time.hub_hold_us = msg.hub_hold_us;
+            s_ack_time_valid = true;
+        }
         if (s_ack_semaphore) {
             xSemaphoreGive(s_ack_semaphore);
         }
@@ -72,10 +124,27 @@ esp_err_t espnow_init(void)
         return err;
     }
 
-    // Create ACK semaphore
+    // Register send callback (MAC-layer delivery status)
+    err = esp_now_register_send_cb(espnow_send_cb);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Register send callback failed: %s", esp_err_to_name(err));
+        esp_now_deinit();
+        return err;
+    }
+
+    // Create ACK and TX status semaphores
     s_ack_semaphore = xSemaphoreCreateBinary();
-    if (!s_ack_semaphore) {
-        ESP_LOGE(TAG, "Failed to create ACK semaphore");
+    s_tx_status_semaphore = xSemaphoreCreateBinary();
+    if (!s_ack_semaphore || !s_tx_status_semaphore) {
+        ESP_LOGE(TAG, "Failed to create ESP-NOW semaphores");
+        if (s_ack_semaphore) {
+            vSemaphoreDelete(s_ack_semaphore);
+            s_ack_semaphore = NULL;
+        }
+        if (s_tx_status_semaphore) {
+            vSemaphoreDelete(s_tx_status_semaphore);
+            s_tx_status_semaphore = NULL;
+        }
         esp_now_deinit();
         return ESP_ERR_NO_MEM;
     }
@@ -90,7 +159,12 @@ esp_err_t espnow_deinit(void)
         vSemaphoreDelete(s_ack_semaphore);
         s_ack_semaphore = NULL;
     }
+    if (s_tx_status_semaphore) {
+        vSemaphoreDelete(s_tx_status_semaphore);
+        s_tx_status_semaphore = NULL;
+    }
 
+    esp_now_unregister_send_cb();
     esp_err_t err = esp_now_deinit();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ESP-NOW deinit failed: %s", esp_err_to_name(err));
@@ -101,26 +175,12 @@ esp_err_t espnow_deinit(void)
     return ESP_OK;
 }
 
-esp_err_t espnow_init_wifi(uint8_t channel, int8_t tx_power_dbm)
+/**
+ * @brief Start the WiFi driver in STA mode on a channel
+ */
+static esp_err_t start_wifi(const wifi_init_config_t *cfg, uint8_t channel, int8_t tx_power_dbm)
 {
-    esp_err_t err;
-    
-    err = esp_netif_init();
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_LOGE(TAG, "Netif init failed: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    err = esp_event_loop_create_default();
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_LOGE(TAG, "Event loop create failed: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    err = esp_wifi_init(&cfg);
+    esp_err_t err = esp_wifi_init(cfg);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "WiFi init failed: %s", esp_err_to_name(err));
         return err;
@@ -132,11 +192,13 @@ esp_err_t espnow_init_wifi(uint8_t channel, int8_t tx_power_dbm)
         return err;
     }
 
+    wake_profiler_mark("wifi_start");
     err = esp_wifi_start();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "WiFi start failed: %s",esp_err_to_name(err));
         return err;
     }
+    wake_profiler_mark("wifi_started");
 
     err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
     if (err != ESP_OK) {
@@ -153,8 +215,65 @@ esp_err_t espnow_init_wifi(uint8_t channel, int8_t tx_power_dbm)
             ESP_LOGW(TAG, "Failed to set TX power: %s", esp_err_to_name(err));
         }
     }
+    return ESP_OK;
+}
+
+esp_err_t espnow_init_wifi(uint8_t channel, int8_t tx_power_dbm)
+{
+    esp_err_t err;
+    uint32_t heap_before = esp_get_free_heap_size();
+    wake_profiler_mark("espnow_wifi_init");
+    
+    err = esp_netif_init();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Netif init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Event loop create failed: %s", esp_err_to_name(err));
+        return err;
+    }
 
-    ESP_LOGI(TAG, "WiFi initialized for ESP-NOW on channel %d", channel);
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    err = start_wifi(&cfg, channel, tx_power_dbm);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "WiFi initialized for ESP-NOW on channel %d (%lu bytes heap)",
+             channel, (unsigned long)(heap_before - esp_get_free_heap_size()));
+    return ESP_OK;
+}
+
+esp_err_t espnow_init_wifi_lean(uint8_t channel, int8_t tx_power_dbm)
+{
+    uint32_t heap_before = esp_get_free_heap_size();
+    wake_profiler_mark("espnow_wifi_init");
+
+    // No netif and no event loop: ESP-NOW frames never reach the IP stack
+    // and nothing listens for WiFi events on this path
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    cfg.static_rx_buf_num = ESPNOW_LEAN_STATIC_RX_BUF_NUM;
+    cfg.dynamic_rx_buf_num = ESPNOW_LEAN_DYNAMIC_RX_BUF_NUM;
+    cfg.tx_buf_type = 1;                    // Dynamic TX buffers, allocated per frame
+    cfg.dynamic_tx_buf_num = ESPNOW_LEAN_DYNAMIC_TX_BUF_NUM;
+    cfg.cache_tx_buf_num = 0;
+    cfg.ampdu_rx_enable = 0;                // Aggregation needs an association
+    cfg.ampdu_tx_enable = 0;
+    cfg.amsdu_tx_enable = 0;
+    cfg.nvs_enable = 0;                     // No STA config to persist
+
+    esp_err_t err = start_wifi(&cfg, channel, tx_power_dbm);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "WiFi initialized for ESP-NOW on channel %d, lean (%lu bytes heap)",
+             channel, (unsigned long)(heap_before - esp_get_free_heap_size()));
     return ESP_OK;
 }
 
@@ -220,6 +339,11 @@ esp_err_t espnow_send(const uint8_t *dest_mac, const uint8_t *data, size_t len)
         ESP_LOGE(TAG, "Send failed: %s", esp_err_to_name(err));
         return err;
     }
+    s_tx_sent_seq++;
+    if (!s_first_frame_sent) {
+        s_first_frame_sent = true;
+        wake_profiler_mark("espnow_first_frame");
+    }
 
     ESP_LOGD(TAG, "Sent %d bytes", len);
     return ESP_OK;
@@ -235,22 +359,47 @@ espnow_send_status_t espnow_send_with_ack(const uint8_t *dest_mac,
 
     // Reset ACK flag
     s_ack_received = false;
+    s_ack_time_valid = false;
     xSemaphoreTake(s_ack_semaphore, 0); // Clear any previous semaphore
+    xSemaphoreTake(s_tx_status_semaphore, 0);
 
-    // Send data
+    TickType_t start = xTaskGetTickCount();
+    s_ack_tx_us = esp_timer_get_time();
+
+    // Send data; set before sending, the callback can fire before esp_now_send() returns
+    s_tx_await_seq = s_tx_sent_seq + 1;
     esp_err_t err = espnow_send(dest_mac, data, len);
     if (err != ESP_OK) {
+        s_tx_await_seq = 0;
         return ESPNOW_SEND_FAIL;
     }
+    s_stats.tx_frames++;
+
+    // Wait for MAC-layer status first: a frame the peer never received at the
+    // link layer cannot be answered, so don't sit out the full ACK timeout.
+    if (xSemaphoreTake(s_tx_status_semaphore, pdMS_TO_TICKS(ESPNOW_TX_STATUS_TIMEOUT_MS)) == pdTRUE) {
+        if (s_last_tx_status != ESP_NOW_SEND_SUCCESS) {
+            ESP_LOGD(TAG, "Frame to " MACSTR " not delivered at link layer", MAC2STR(dest_mac));
+            return ESPNOW_SEND_LINK_FAIL;
+        }
+    } else {
+        s_stats.link_status_timeout++;
+        ESP_LOGD(TAG, "No send callback within %d ms, waiting for ACK anyway", ESPNOW_TX_STATUS_TIMEOUT_MS);
+    }
 
-    // Wait for ACK
-    if (xSemaphoreTake(s_ack_semaphore, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) {
+    // Wait for ACK (remaining time of the overall timeout)
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    TickType_t timeout_ticks = pdMS_TO_TICKS(timeout_ms);
+    TickType_t remaining = (elapsed < timeout_ticks) ? (timeout_ticks - elapsed) : 0;
+    if (xSemaphoreTake(s_ack_semaphore, remaining) == pdTRUE) {
         if (s_ack_received) {
+            s_stats.app_ack_ok++;
             ESP_LOGD(TAG, "ACK confirmed");
             return ESPNOW_SEND_SUCCESS;
         }
     }
 
+    s_stats.app_ack_timeout++;
     ESP_LOGW(TAG, "No ACK received within %lu ms", timeout_ms);
     return ESPNOW_SEND_NO_ACK;
 }
@@ -276,6 +425,36 @@ esp_err_t espnow_send_ack(const uint8_t *dest_mac)
     return err;
 }
 
+esp_err_t espnow_send_ack_time(const uint8_t *dest_mac, uint64_t hub_time_ms, uint32_t hub_hold_us)
+{
+    if (!dest_mac) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    espnow_ack_time_msg_t ack_msg = {
+        .msg_type = ESPNOW_MSG_TYPE_ACK,
+        .hub_time_ms = hub_time_ms,
+        .hub_hold_us = hub_hold_us,
+    };
+    esp_err_t err = espnow_send(dest_mac, (const uint8_t *)&ack_msg, sizeof(ack_msg));
+    if (err == ESP_OK) {
+        ESP_LOGD(TAG, "ACK with time sent to " MACSTR, MAC2STR(dest_mac));
+    }
+    return err;
+}
+
+esp_err_t espnow_get_ack_time(espnow_ack_time_t *ack_time)
+{
+    if (!ack_time) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_ack_time_valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ack_time = s_ack_time;
+    return ESP_OK;
+}
+
 esp_err_t espnow_set_channel(uint8_t channel)
 {
     if (channel < 1 || channel > 13) {
@@ -305,4 +484,34 @@ esp_err_t espnow_get_ack_responder_mac(uint8_t *mac_addr)
     }
     memcpy(mac_addr, s_ack_responder_mac, 6);
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t espnow_get_stats(espnow_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(stats, &s_stats, sizeof(espnow_stats_t));
+    return ESP_OK;
+}
+
+void espnow_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(espnow_stats_t));
+}
+
+float espnow_stats_link_success_rate(const espnow_stats_t *stats)
+{
+    if (!stats || stats->tx_frames == 0) {
+        return 100.0f;
+    }
+    return (100.0f * stats->link_ok) / stats->tx_frames;
+}
+
+float espnow_stats_app_success_rate(const espnow_stats_t *stats)
+{
+    if (!stats || stats->tx_frames == 0) {
+        return 100.0f;
+    }
+    return (100.0f * stats->app_ack_ok) / stats->tx_frames;
+}
@@ -17,7 +17,11 @@
 
 #define ESPNOW_MAX_DATA_LEN        250  ///< ESP-NOW maximum data length
 #define ESPNOW_ACK_TIMEOUT_MS      1000 ///< Timeout waiting for ACK
+#define ESPNOW_TX_STATUS_TIMEOUT_MS 50  ///< Timeout waiting for the MAC-layer send callback
 #define ESPNOW_BROADCAST_MAC       {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}
+#define ESPNOW_LEAN_STATIC_RX_BUF_NUM   4   ///< Static RX buffers of espnow_init_wifi_lean() (default 10)
+#define ESPNOW_LEAN_DYNAMIC_RX_BUF_NUM  8   ///< Dynamic RX buffers of espnow_init_wifi_lean() (default 32)
+#define ESPNOW_LEAN_DYNAMIC_TX_BUF_NUM  8   ///< Dynamic TX buffers of espnow_init_wifi_lean() (default 32)
 
 /**
  * @brief ESP-NOW message types
@@ -27,6 +31,28 @@ typedef enum {
     ESPNOW_MSG_TYPE_ACK  = 1     ///< ACK message
 } espnow_msg_type_t;
 
+/**
+ * @brief ACK carrying the hub's time
+ *
+ * Sent instead of the one-byte ACK by hubs that know the time. Receivers
+ * that only look at the first byte still see an ACK.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t msg_type;            ///< ESPNOW_MSG_TYPE_ACK
+    uint64_t hub_time_ms;        ///< Hub time (Unix ms) when sending the ACK, 0 if not synced
+    uint32_t hub_hold_us;        ///< Time between receiving the data and sending the ACK
+} espnow_ack_time_msg_t;
+
+/**
+ * @brief Timing of the ACK that answered the last espnow_send_with_ack()
+ */
+typedef struct {
+    uint64_t hub_time_ms;        ///< From the ACK
+    uint32_t hub_hold_us;        ///< From the ACK
+    uint32_t rtt_us;             ///< Sending the data to receiving the ACK
+    int64_t rx_local_us;         ///< esp_timer_get_time() at ACK reception
+} espnow_ack_time_t;
+
 /**
  * @brief ESP-NOW send status
  */
@@ -34,9 +60,27 @@ typedef enum {
     ESPNOW_SEND_SUCCESS = 0,
     ESPNOW_SEND_FAIL,
     ESPNOW_SEND_NO_ACK,
-    ESPNOW_SEND_TIMEOUT
+    ESPNOW_SEND_TIMEOUT,
+    ESPNOW_SEND_LINK_FAIL        ///< Frame not acknowledged at the 802.11 MAC layer
 } espnow_send_status_t;
 
+/**
+ * @brief ESP-NOW transmission counters
+ * 
+ * Only data frames sent with espnow_send_with_ack() are counted; ACK
+ * replies and plain espnow_send() calls are not. Link-level counters come
+ * from the esp_now send callback (802.11 ACK) of that frame,
+ * application-level counters from the ESPNOW_MSG_TYPE_ACK reply of the peer.
+ */
+typedef struct {
+    uint32_t tx_frames;          ///< Data frames handed to esp_now_send()
+    uint32_t link_ok;            ///< Frames confirmed by the MAC layer
+    uint32_t link_fail;          ///< Frames the MAC layer could not deliver
+    uint32_t link_status_timeout;///< Frames without send callback in time
+    uint32_t app_ack_ok;         ///< Frames answered with an application ACK
+    uint32_t app_ack_timeout;    ///< Frames delivered but never answered
+} espnow_stats_t;
+
 /**
  * @brief ESP-NOW receive callback function type
  * 
@@ -71,6 +115,22 @@ esp_err_t espnow_deinit(void);
  */
 esp_err_t espnow_init_wifi(uint8_t channel, int8_t tx_power_dbm);
 
+/**
+ * @brief Initialize WiFi for ESP-NOW only, without the TCP/IP stack
+ * 
+ * Starts the WiFi driver in STA mode without esp_netif and without the
+ * default event loop, with fewer RX/TX buffers (ESPNOW_LEAN_*), no
+ * aggregation and no NVS storage of the WiFi config. For nodes that never
+ * use IP; WiFi events are not delivered. Time to the first frame is marked
+ * as "espnow_first_frame" in the wake profiler, and both init paths log
+ * the heap they took.
+ * 
+ * @param channel WiFi channel (1-13)
+ * @param tx_power_dbm TX power in dBm (0 = use default, max ~20 dBm)
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t espnow_init_wifi_lean(uint8_t channel, int8_t tx_power_dbm);
+
 /**
  * @brief Add a peer to ESP-NOW
  * 
@@ -110,6 +170,10 @@ esp_err_t espnow_send(const uint8_t *dest_mac, const uint8_t *data, size_t len);
 /**
  * @brief Send data and wait for ACK
  * 
+ * Waits for the MAC-layer send status first and returns ESPNOW_SEND_LINK_FAIL
+ * immediately if the frame was not acknowledged at the link layer. Only
+ * delivered frames wait (for the rest of timeout_ms) for the application ACK.
+ * 
  * @param dest_mac Destination MAC address (6 bytes)
  * @param data Data to send
  * @param len Data length
@@ -136,6 +200,24 @@ esp_err_t espnow_register_recv_callback(espnow_recv_cb_t cb);
  */
 esp_err_t espnow_send_ack(const uint8_t *dest_mac);
 
+/**
+ * @brief Send an ACK message with the hub's time
+ * 
+ * @param dest_mac Destination MAC address (6 bytes)
+ * @param hub_time_ms Current Unix time in milliseconds (0 if not synced)
+ * @param hub_hold_us Time since the answered data frame was received
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t espnow_send_ack_time(const uint8_t *dest_mac, uint64_t hub_time_ms, uint32_t hub_hold_us);
+
+/**
+ * @brief Get the time carried by the last ACK
+ * 
+ * @param ack_time Output: hub time and round trip of the last espnow_send_with_ack()
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if that ACK carried no time
+ */
+esp_err_t espnow_get_ack_time(espnow_ack_time_t *ack_time);
+
 /**
  * @brief Set WiFi channel
  * 
@@ -162,4 +244,33 @@ uint8_t espnow_get_channel(void);
  */
 esp_err_t espnow_get_ack_responder_mac(uint8_t *mac_addr);
 
+/**
+ * @brief Get link-level and application-level transmission counters
+ * 
+ * @param stats Output: copy of the current counters
+ * @return ESP_OK on success
+ */
+esp_err_t espnow_get_stats(espnow_stats_t *stats);
+
+/**
+ * @brief Reset all transmission counters to zero
+ */
+void espnow_reset_stats(void);
+
+/**
+ * @brief Link-level delivery rate in percent (0-100)
+ * 
+ * @param stats Counters from espnow_get_stats()
+ * @return Percentage of frames acknowledged at the MAC layer (100 if none sent)
+ */
+float espnow_stats_link_success_rate(const espnow_stats_t *stats);
+
+/**
+ * @brief Application-level delivery rate in percent (0-100)
+ * 
+ * @param stats Counters from espnow_get_stats()
+ * @return Percentage of frames answered with an application ACK (100 if none sent)
+ */
+float espnow_stats_app_success_rate(const espnow_stats_t *stats);
+
 #endif // ESPNOW_DRIVER_H
\ No newline at end of file
@@ -0,0 +1,494 @@
+/**
+ * @file flash_log.c
+ * @brief Append-only record log in a dedicated flash partition - Implementation
+ */
+
+#include "flash_log.h"
+#include "esp_partition.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char* TAG = "FLASH_LOG";
+
+#define SECTOR_SIZE         4096
+#define SB_SECTORS          2                               ///< Superblock ping-pong sectors
+#define DATA_START          (SB_SECTORS * SECTOR_SIZE)
+#define RECORD_MAGIC        0x4c52                          // "RL"
+#define SB_MAGIC            0x4c475354u                     // "TSGL"
+#define CACHE_MAGIC         0x31434c46u                     // "FLC1"
+#define ALIGN4(x)           (((x) + 3u) & ~3u)
+
+/**
+ * @brief Record header, followed by the payload padded to 4 bytes
+ */
+typedef struct {
+    uint16_t magic;
+    uint16_t len;                   ///< Payload length
+    uint32_t seq;
+    uint32_t crc;                   ///< CRC32 of seq, len and payload
+} record_hdr_t;
+
+/**
+ * @brief Superblock slot; the valid slot with the highest generation wins
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t tail_pos;              ///< Offset of the oldest record
+    uint32_t tail_seq;              ///< Sequence number of the oldest record
+    uint32_t dropped;
+    uint32_t crc;                   ///< CRC32 of the fields above
+} superblock_t;
+
+#define HDR_LEN             sizeof(record_hdr_t)
+#define SB_SLOTS            (SECTOR_SIZE / sizeof(superblock_t))
+#define MAX_PAYLOAD         (SECTOR_SIZE - HDR_LEN)
+
+/**
+ * @brief Log positions, kept in RTC memory so a deep-sleep wake skips the scan
+ */
+typedef struct {
+    uint32_t magic;                 ///< CACHE_MAGIC when valid
+    uint32_t partition_address;     ///< Partition the positions belong to
+    superblock_t sb;                ///< Current superblock
+    uint32_t sb_sector;             ///< Superblock sector in use (0 or 1)
+    uint32_t sb_slot;               ///< Slot of the current superblock
+    uint32_t head;                  ///< Offset of the next append
+    uint32_t next_seq;              ///< Sequence number of the next append
+} log_state_t;
+
+static RTC_DATA_ATTR log_state_t s_state;
+static const esp_partition_t* s_partition = NULL;
+static uint32_t s_data_end = 0;
+static bool s_reader_open = false;
+static SemaphoreHandle_t s_mutex = NULL;
+
+
+
+
+// #####################################
+// MARK: Records
+// #####################################
+
+static uint32_t next_sector(uint32_t pos) {
+    uint32_t next = (pos / SECTOR_SIZE + 1) * SECTOR_SIZE;
+    return (next >= s_data_end) ? DATA_START : next;
+}
+
+static uint32_t advance(uint32_t pos, uint16_t len) {
+    pos += ALIGN4(HDR_LEN + len);
+    return (pos >= s_data_end) ? DATA_START : pos;
+}
+
+static bool is_erased(const record_hdr_t* hdr) {
+    const uint8_t* bytes = (const uint8_t*)hdr;
+    for (size_t i = 0; i < HDR_LEN; i++) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t header_crc(uint32_t seq, uint16_t len) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&seq, sizeof(seq));
+    return esp_rom_crc32_le(crc, (const uint8_t*)&len, sizeof(len));
+}
+
+/**
+ * @brief Check the record at pos; reads through the mapping when base is set
+ */
+static bool load_record(uint32_t pos, record_hdr_t* hdr, const uint8_t* base) {
+    uint32_t room = SECTOR_SIZE - (pos % SECTOR_SIZE);
+    if (room < HDR_LEN) {
+        return false;
+    }
+    if (base != NULL) {
+        memcpy(hdr, base + pos, HDR_LEN);
+    } else if (esp_partition_read(s_partition, pos, hdr, HDR_LEN) != ESP_OK) {
+        return false;
+    }
+    if (hdr->magic != RECORD_MAGIC || hdr->len > room - HDR_LEN) {
+        return false;
+    }
+
+    uint32_t crc = header_crc(hdr->seq, hdr->len);
+    if (base != NULL) {
+        crc = esp_rom_crc32_le(crc, base + pos + HDR_LEN, hdr->len);
+    } else {
+        uint8_t chunk[64];
+        for (uint16_t done = 0; done < hdr->len; ) {
+            uint16_t n = (uint16_t)(hdr->len - done);
+            if (n > sizeof(chunk)) {
+                n = sizeof(chunk);
+            }
+            if (esp_partition_read(s_partition, pos + HDR_LEN + done, chunk, n) != ESP_OK) {
+                return false;
+            }
+            crc = esp_rom_crc32_le(crc, chunk, n);
+            done += n;
+        }
+    }
+    return crc == hdr->crc;
+}
+
+/**
+ * @brief Find record seq at pos or, after padding or a torn write, at the next sector start
+ */
+static bool find_record(uint32_t* pos, uint32_t seq, record_hdr_t* hdr, const uint8_t* base) {
+    if (load_record(*pos, hdr, base) && hdr->seq == seq) {
+        return true;
+    }
+    uint32_t next = next_sector(*pos);
+    if (load_record(next, hdr, base) && hdr->seq == seq) {
+        *pos = next;
+        return true;
+    }
+    return false;
+}
+
+
+
+
+// #####################################
+// MARK: Superblock
+// #####################################
+
+static uint32_t superblock_crc(const superblock_t* sb) {
+    return esp_rom_crc32_le(0, (const uint8_t*)sb, offsetof(superblock_t, crc));
+}
+
+/**
+ * @brief Find the newest valid superblock in both sectors
+ */
+static bool superblock_load(void) {
+    bool found = false;
+    for (uint32_t sector = 0; sector < SB_SECTORS; sector++) {
+        for (uint32_t slot = 0; slot < SB_SLOTS; slot++) {
+            superblock_t sb;
+            if (esp_partition_read(s_partition, sector * SECTOR_SIZE + slot * sizeof(sb), &sb, sizeof(sb)) != ESP_OK ||
+                sb.magic != SB_MAGIC || sb.crc != superblock_crc(&sb)) {
+                break;  // Slots are written in order, the rest is erased or torn
+            }
+            if (!found || sb.generation > s_state.sb.generation) {
+                s_state.sb = sb;
+                s_state.sb_sector = sector;
+                s_state.sb_slot = slot;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Write a new superblock into the next slot, erasing the other sector when one is full
+ */
+static esp_err_t superblock_write(uint32_t tail_pos, uint32_t tail_seq, uint32_t dropped) {
+    superblock_t sb = {
+        .magic = SB_MAGIC,
+        .generation = s_state.sb.generation + 1,
+        .tail_pos = tail_pos,
+        .tail_seq = tail_seq,
+        .dropped = dropped,
+    };
+    sb.crc = superblock_crc(&sb);
+
+    uint32_t sector = s_state.sb_sector;
+    uint32_t slot = s_state.sb_slot + 1;
+    if (slot >= SB_SLOTS) {
+        // The current sector keeps the previous superblock until this write lands
+        sector ^= 1;
+        slot = 0;
+        esp_err_t err = esp_partition_erase_range(s_partition, sector * SECTOR_SIZE, SECTOR_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    esp_err_t err = esp_partition_write(s_partition, sector * SECTOR_SIZE + slot * sizeof(sb), &sb, sizeof(sb));
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_state.sb = sb;
+    s_state.sb_sector = sector;
+    s_state.sb_slot = slot;
+    return ESP_OK;
+}
+
+
+
+
+// #####################################
+// MARK: Recovery
+// #####################################
+
+/**
+ * @brief Follow the records from the tail to find the head
+ */
+static void recover_head(void) {
+    uint32_t pos = s_state.sb.tail_pos;
+    uint32_t seq = s_state.sb.tail_seq;
+    uint32_t max_records = (s_data_end - DATA_START) / HDR_LEN;
+    record_hdr_t hdr;
+
+    for (uint32_t i = 0; i < max_records && find_record(&pos, seq, &hdr, NULL); i++) {
+        pos = advance(pos, hdr.len);
+        seq++;
+    }
+
+    // A torn write leaves programmed bits behind the last record; start over
+    // in the next sector, which is erased before use
+    if (SECTOR_SIZE - (pos % SECTOR_SIZE) >= HDR_LEN &&
+        esp_partition_read(s_partition, pos, &hdr, HDR_LEN) == ESP_OK && !is_erased(&hdr)) {
+        ESP_LOGW(TAG, "Torn record at 0x%lx, skipping to the next sector", (unsigned long)pos);
+        pos = next_sector(pos);
+    }
+
+    s_state.head = pos;
+    s_state.next_seq = seq;
+}
+
+/**
+ * @brief Erase the sector at pos before writing into it, dropping the oldest records if it holds the tail
+ */
+static esp_err_t prepare_sector(uint32_t pos) {
+    uint32_t count = s_state.next_seq - s_state.sb.tail_seq;
+    if (count > 0 && s_state.sb.tail_pos / SECTOR_SIZE == pos / SECTOR_SIZE) {
+        uint32_t tail_pos = next_sector(pos);
+        uint32_t tail_seq = s_state.next_seq;
+        record_hdr_t hdr;
+        if (load_record(tail_pos, &hdr, NULL) &&
+            hdr.seq > s_state.sb.tail_seq && hdr.seq < s_state.next_seq) {
+            tail_seq = hdr.seq;
+        } else {
+            tail_pos = pos;
+        }
+        uint32_t dropped = tail_seq - s_state.sb.tail_seq;
+        ESP_LOGW(TAG, "Log full, dropping %lu oldest record(s)", (unsigned long)dropped);
+        esp_err_t err = superblock_write(tail_pos, tail_seq, s_state.sb.dropped + dropped);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return esp_partition_erase_range(s_partition, pos, SECTOR_SIZE);
+}
+
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+esp_err_t flash_log_init(void) {
+    if (s_partition != NULL) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+        (esp_partition_subtype_t)FLASH_LOG_PARTITION_SUBTYPE, FLASH_LOG_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", FLASH_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (partition->size < DATA_START + 2 * SECTOR_SIZE) {
+        ESP_LOGE(TAG, "Partition '%s' too small", FLASH_LOG_PARTITION_LABEL);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_partition = partition;
+    s_data_end = partition->size / SECTOR_SIZE * SECTOR_SIZE;
+
+    // RTC memory is only trusted after a deep sleep, any other reset may have
+    // interrupted a write
+    if (esp_reset_reason() == ESP_RST_DEEPSLEEP && s_state.magic == CACHE_MAGIC &&
+        s_state.partition_address == partition->address) {
+        ESP_LOGI(TAG, "Resumed: %lu record(s)", (unsigned long)flash_log_count());
+        return ESP_OK;
+    }
+
+    memset(&s_state, 0, sizeof(s_state));
+    if (superblock_load()) {
+        recover_head();
+    } else {
+        ESP_LOGW(TAG, "No superblock, formatting");
+        s_state.sb_sector = SB_SECTORS - 1;    // First write erases and uses sector 0
+        s_state.sb_slot = SB_SLOTS - 1;
+        esp_err_t err = superblock_write(DATA_START, 1, 0);
+        if (err != ESP_OK) {
+            s_partition = NULL;
+            return err;
+        }
+        s_state.head = DATA_START;
+        s_state.next_seq = 1;
+    }
+    s_state.partition_address = partition->address;
+    s_state.magic = CACHE_MAGIC;
+
+    ESP_LOGI(TAG, "Recovered: %lu record(s), %lu dropped, %lu KB",
+             (unsigned long)flash_log_count(), (unsigned long)s_state.sb.dropped,
+             (unsigned long)((s_data_end - DATA_START) / 1024));
+    return ESP_OK;
+}
+
+esp_err_t flash_log_deinit(void) {
+    if (s_partition == NULL) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (!s_reader_open) {
+        s_partition = NULL;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+esp_err_t flash_log_append(const void* data, size_t len) {
+    if (data == NULL || len == 0 || len > MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (!s_reader_open) {
+        uint32_t pos = s_state.head;
+        if (SECTOR_SIZE - (pos % SECTOR_SIZE) < ALIGN4(HDR_LEN + len)) {
+            pos = next_sector(pos);
+        }
+        err = (pos % SECTOR_SIZE == 0) ? prepare_sector(pos) : ESP_OK;
+
+        // Header first: an erased header then means nothing follows it
+        record_hdr_t hdr = {
+            .magic = RECORD_MAGIC,
+            .len = (uint16_t)len,
+            .seq = s_state.next_seq,
+        };
+        hdr.crc = esp_rom_crc32_le(header_crc(hdr.seq, hdr.len), data, len);
+        if (err == ESP_OK) {
+            err = esp_partition_write(s_partition, pos, &hdr, HDR_LEN);
+        }
+        if (err == ESP_OK) {
+            err = esp_partition_write(s_partition, pos + HDR_LEN, data, len);
+        }
+        if (err == ESP_OK) {
+            s_state.head = advance(pos, hdr.len);
+            s_state.next_seq++;
+        } else {
+            // Do not write behind a failed record
+            s_state.head = next_sector(pos);
+            ESP_LOGE(TAG, "Append failed: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+uint32_t flash_log_count(void) {
+    return (s_partition != NULL) ? s_state.next_seq - s_state.sb.tail_seq : 0;
+}
+
+esp_err_t flash_log_reader_begin(flash_log_reader_t* reader) {
+    if (reader == NULL || s_partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (!s_reader_open) {
+        const void* base = NULL;
+        err = esp_partition_mmap(s_partition, 0, s_data_end, ESP_PARTITION_MMAP_DATA,
+                                 &base, &reader->handle);
+        if (err == ESP_OK) {
+            reader->base = (const uint8_t*)base;
+            reader->pos = s_state.sb.tail_pos;
+            reader->seq = s_state.sb.tail_seq;
+            s_reader_open = true;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+bool flash_log_reader_next(flash_log_reader_t* reader, flash_log_record_t* record) {
+    if (reader == NULL || record == NULL || reader->base == NULL || reader->seq >= s_state.next_seq) {
+        return false;
+    }
+    record_hdr_t hdr;
+    if (!find_record(&reader->pos, reader->seq, &hdr, reader->base)) {
+        ESP_LOGW(TAG, "Record %lu unreadable, stopping", (unsigned long)reader->seq);
+        return false;
+    }
+    record->seq = hdr.seq;
+    record->len = hdr.len;
+    record->data = reader->base + reader->pos + HDR_LEN;
+    reader->pos = advance(reader->pos, hdr.len);
+    reader->seq++;
+    return true;
+}
+
+void flash_log_reader_end(flash_log_reader_t* reader) {
+    if (reader == NULL || reader->base == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    spi_flash_munmap(reader->handle);
+    reader->base = NULL;
+    s_reader_open = false;
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t flash_log_consume(uint32_t seq) {
+    if (s_partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (seq >= s_state.sb.tail_seq) {
+        if (seq >= s_state.next_seq) {
+            seq = s_state.next_seq - 1;
+        }
+        uint32_t pos = s_state.sb.tail_pos;
+        uint32_t next = s_state.sb.tail_seq;
+        record_hdr_t hdr;
+        while (next <= seq) {
+            if (!find_record(&pos, next, &hdr, NULL)) {
+                // Unreadable record: nothing behind it can be reached either
+                pos = s_state.head;
+                next = s_state.next_seq;
+                break;
+            }
+            pos = advance(pos, hdr.len);
+            next++;
+        }
+        err = superblock_write(pos, next, s_state.sb.dropped);
+    }
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+void flash_log_get_stats(flash_log_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->count = flash_log_count();
+    stats->capacity_bytes = (s_partition != NULL) ? s_data_end - DATA_START : 0;
+    stats->dropped = s_state.sb.dropped;
+    stats->next_seq = s_state.next_seq;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file flash_log.h
+ * @brief Append-only record log in a dedicated flash partition
+ *
+ * Time-series backlog without NVS overhead: records are appended to a ring
+ * of 4 KB sectors in the FLASH_LOG_PARTITION_LABEL data partition (see
+ * partitions.csv). Each record has a header with a sequence number, its
+ * length and a CRC32; records never cross a sector boundary. The first two
+ * sectors hold the superblock (tail position, written as ping-pong slots),
+ * so consuming records costs one small write instead of an erase.
+ *
+ * Power loss mid-write leaves at most one torn record, which fails its CRC
+ * and is skipped; the head is recovered by following the sequence numbers
+ * from the tail. When the ring is full the oldest sector is dropped.
+ *
+ * Readers map the partition (esp_partition_mmap) and get pointers straight
+ * into flash, so a replay copies each record once, into the writer's buffer.
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include "esp_err.h"
+#include "spi_flash_mmap.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FLASH_LOG_PARTITION_LABEL   "tslog"     ///< Partition label in partitions.csv
+#define FLASH_LOG_PARTITION_SUBTYPE 0x40        ///< Custom data subtype in partitions.csv
+
+/**
+ * @brief One record as seen by a reader
+ */
+typedef struct {
+    uint32_t seq;                   ///< Sequence number (pass to flash_log_consume())
+    uint16_t len;                   ///< Payload length
+    const uint8_t* data;            ///< Payload, mapped flash, valid until flash_log_reader_end()
+} flash_log_record_t;
+
+/**
+ * @brief Reader over the mapped partition
+ */
+typedef struct {
+    const uint8_t* base;            ///< Mapped partition
+    spi_flash_mmap_handle_t handle;
+    uint32_t pos;                   ///< Offset of the next record
+    uint32_t seq;                   ///< Sequence number of the next record
+} flash_log_reader_t;
+
+/**
+ * @brief Log statistics
+ */
+typedef struct {
+    uint32_t count;                 ///< Records stored
+    uint32_t capacity_bytes;        ///< Bytes available for records
+    uint32_t dropped;               ///< Records dropped because the ring was full
+    uint32_t next_seq;              ///< Sequence number of the next append
+} flash_log_stats_t;
+
+/**
+ * @brief Open the log partition and recover head and tail
+ *
+ * After a deep-sleep wake the positions come from RTC memory; after any
+ * other reset the log is scanned from the tail. An unformatted partition is
+ * formatted. Calling it again while open is a no-op.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the partition does not exist
+ */
+esp_err_t flash_log_init(void);
+
+/**
+ * @brief Close the log
+ *
+ * The positions stay in RTC memory, so the next flash_log_init() after a
+ * deep sleep resumes without a scan. Fails while a reader is open.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE (a reader is open)
+ */
+esp_err_t flash_log_deinit(void);
+
+/**
+ * @brief Append a record
+ *
+ * @param data Payload
+ * @param len Payload length (up to one sector minus the record header)
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_STATE (not open or a reader is open)
+ */
+esp_err_t flash_log_append(const void* data, size_t len);
+
+/**
+ * @brief Number of stored records
+ */
+uint32_t flash_log_count(void);
+
+/**
+ * @brief Map the log for reading, oldest record first
+ *
+ * Appends fail while a reader is open.
+ *
+ * @param reader Reader to start
+ * @return ESP_OK or the esp_partition_mmap() error
+ */
+esp_err_t flash_log_reader_begin(flash_log_reader_t* reader);
+
+/**
+ * @brief Get the next record
+ *
+ * @param reader Reader
+ * @param record Output record
+ * @return true when a record was returned, false at the end
+ */
+bool flash_log_reader_next(flash_log_reader_t* reader, flash_log_record_t* record);
+
+/**
+ * @brief Unmap the log
+ */
+void flash_log_reader_end(flash_log_reader_t* reader);
+
+/**
+ * @brief Drop records up to and including seq
+ *
+ * @param seq Last record delivered
+ * @return ESP_OK or a flash write error
+ */
+esp_err_t flash_log_consume(uint32_t seq);
+
+/**
+ * @brief Get log statistics
+ */
+void flash_log_get_stats(flash_log_stats_t* stats);
+
+#endif // FLASH_LOG_H
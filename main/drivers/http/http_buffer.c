@@ -4,12 +4,35 @@
  */
 
 #include "http_buffer.h"
+#include "../../config/esp32-config.h"
 #include "../../utils/esp_utils.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+int http_buffer_format_sample(const http_buffer_sample_t* sample, const char* device_id,
+                              char* buf, size_t cap)
+{
+    if (sample == NULL || buf == NULL) {
+        return -1;
+    }
+    // Same keys as the HTTP sink
+    int len = snprintf(buf, cap,
+        "{\"timestamp\":%llu,\"device_id\":\"%s\",\"soil_voltage\":%.3f,\"moisture_percent\":%.2f,"
+        "\"raw_adc\":%ld,\"battery_voltage\":%.3f,\"battery_percent\":%.1f}",
+        (unsigned long long)sample->timestamp_ms, (device_id != NULL) ? device_id : "",
+        sample->soil_mv / 1000.0, sample->moisture_centi / 100.0, (long)sample->raw_adc,
+        sample->battery_mv / 1000.0, sample->battery_deci / 10.0);
+    return (len < 0 || (size_t)len >= cap) ? -1 : len;
+}
+
+#if !HTTP_BUFFER_FLASH_LOG
+
+#include "nvs_flash.h"
+#include "nvs.h"
+
 static const char *TAG = "HTTPBuffer";
 
 // NVS buffering constants
@@ -23,6 +46,14 @@ static const char *TAG = "HTTPBuffer";
 static nvs_handle_t s_nvs_handle = 0;
 static bool s_buffering_enabled = false;
 static int32_t s_max_buffered_packets = DEFAULT_MAX_BUFFERED_PACKETS;
+static char s_device_id[32] = {0};
+
+// Stream state (one stream at a time)
+static http_buffered_packet_t* s_stream_packet = NULL;
+static int32_t s_stream_count = 0;
+static int32_t s_stream_index = 0;
+static size_t s_stream_offset = 0;
+static size_t s_stream_len = 0;
 
 esp_err_t http_buffer_init(const http_buffer_config_t* config)
 {
@@ -33,6 +64,9 @@ esp_err_t http_buffer_init(const http_buffer_config_t* config)
     s_buffering_enabled = config->enable_buffering;
     s_max_buffered_packets = (config->max_buffered_packets > 0) ? 
                             config->max_buffered_packets : DEFAULT_MAX_BUFFERED_PACKETS;
+    if (config->device_id != NULL) {
+        strncpy(s_device_id, config->device_id, sizeof(s_device_id) - 1);
+    }
     
     // Initialize NVS for buffering if enabled
     if (s_buffering_enabled) {
@@ -141,6 +175,15 @@ esp_err_t http_buffer_add_packet(const char* json_payload)
     return ESP_OK;
 }
 
+esp_err_t http_buffer_add_sample(const http_buffer_sample_t* sample)
+{
+    char json[MAX_PACKET_SIZE / 4];
+    if (http_buffer_format_sample(sample, s_device_id, json, sizeof(json)) < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return http_buffer_add_packet(json);
+}
+
 int32_t http_buffer_get_count(void)
 {
     if (!s_buffering_enabled || s_nvs_handle == 0) {
@@ -300,7 +343,127 @@ esp_err_t http_buffer_flush_packets(http_buffer_send_func_t send_func)
     return (failed_count == 0) ? ESP_OK : ESP_FAIL;
 }
 
+esp_err_t http_buffer_stream_begin(int32_t* count)
+{
+    if (count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = 0;
+    if (!s_buffering_enabled || s_nvs_handle == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_stream_packet != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_stream_packet = malloc(MAX_PACKET_SIZE);
+    if (s_stream_packet == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_stream_count = http_buffer_get_count();
+    s_stream_index = 0;
+    s_stream_offset = 0;
+    s_stream_len = 0;
+
+    *count = s_stream_count;
+    ESP_LOGI(TAG, "Streaming %ld buffered packets", (long)s_stream_count);
+    return ESP_OK;
+}
+
+/**
+ * @brief Load the next stored packet, newline-terminated instead of NUL-terminated
+ */
+static bool stream_load_next(void)
+{
+    while (s_stream_index < s_stream_count) {
+        char packet_key[32];
+        snprintf(packet_key, sizeof(packet_key), HTTP_BUFFER_PACKET_KEY, (int)s_stream_index);
+        s_stream_index++;
+
+        size_t packet_size = MAX_PACKET_SIZE;
+        if (nvs_get_blob(s_nvs_handle, packet_key, s_stream_packet, &packet_size) != ESP_OK ||
+            packet_size <= sizeof(http_buffered_packet_t)) {
+            continue; // Gap, skip like http_buffer_flush_packets()
+        }
+
+        size_t max_payload = packet_size - sizeof(http_buffered_packet_t);
+        size_t len = (s_stream_packet->payload_size < max_payload) ? s_stream_packet->payload_size : max_payload - 1;
+        s_stream_packet->payload[len] = '\n';
+        s_stream_offset = 0;
+        s_stream_len = len + 1;
+        return true;
+    }
+    return false;
+}
+
+int http_buffer_stream_read(char* buf, size_t cap, void* ctx)
+{
+    (void)ctx;
+    if (s_stream_packet == NULL || buf == NULL) {
+        return -1;
+    }
+
+    size_t produced = 0;
+    while (produced < cap) {
+        if (s_stream_offset >= s_stream_len && !stream_load_next()) {
+            break;
+        }
+        size_t n = s_stream_len - s_stream_offset;
+        if (n > cap - produced) {
+            n = cap - produced;
+        }
+        memcpy(&buf[produced], &s_stream_packet->payload[s_stream_offset], n);
+        s_stream_offset += n;
+        produced += n;
+    }
+    return (int)produced;
+}
+
+esp_err_t http_buffer_stream_end(bool sent)
+{
+    if (s_stream_packet == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(s_stream_packet);
+    s_stream_packet = NULL;
+
+    if (!sent || s_stream_count == 0) {
+        return ESP_OK;
+    }
+
+    // Remove the streamed packets and move anything added since to the front
+    int32_t packet_count = http_buffer_get_count();
+    int32_t new_count = 0;
+    for (int32_t i = 0; i < packet_count; i++) {
+        char packet_key[32];
+        snprintf(packet_key, sizeof(packet_key), HTTP_BUFFER_PACKET_KEY, (int)i);
+        if (i < s_stream_count) {
+            nvs_erase_key(s_nvs_handle, packet_key);
+            continue;
+        }
+
+        size_t packet_size = MAX_PACKET_SIZE;
+        char temp_buffer[MAX_PACKET_SIZE];
+        if (nvs_get_blob(s_nvs_handle, packet_key, temp_buffer, &packet_size) == ESP_OK) {
+            char new_key[32];
+            snprintf(new_key, sizeof(new_key), HTTP_BUFFER_PACKET_KEY, (int)new_count);
+            nvs_set_blob(s_nvs_handle, new_key, temp_buffer, packet_size);
+            nvs_erase_key(s_nvs_handle, packet_key);
+            new_count++;
+        }
+    }
+
+    esp_err_t ret = nvs_set_i32(s_nvs_handle, HTTP_BUFFER_COUNT_KEY, new_count);
+    nvs_commit(s_nvs_handle);
+
+    ESP_LOGI(TAG, "Stream complete: %ld sent, %ld remaining", (long)s_stream_count, (long)new_count);
+    s_stream_count = 0;
+    return ret;
+}
+
 bool http_buffer_is_enabled(void)
 {
     return s_buffering_enabled && s_nvs_handle != 0;
-}
\ No newline at end of file
+}
+
+#endif // !HTTP_BUFFER_FLASH_LOG
@@ -2,9 +2,11 @@
  * @file http_buffer.h
  * @brief HTTP Packet Buffering System
  * 
- * This module provides NVS-based packet buffering for HTTP requests when
- * the server is temporarily unavailable. It implements a FIFO buffer with
- * automatic overflow handling.
+ * This module provides packet buffering for HTTP requests when the server
+ * is temporarily unavailable. It implements a FIFO buffer with automatic
+ * overflow handling, either in NVS (JSON packets, http_buffer.c) or in the
+ * flash log partition (ts_codec blocks of samples, http_buffer_flash.c,
+ * selected with HTTP_BUFFER_FLASH_LOG). Both replay JSON.
  */
 
 #ifndef HTTP_BUFFER_H
@@ -12,13 +14,12 @@
 
 #include "esp_err.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 /**
- * @brief Buffered packet structure
+ * @brief Buffered packet structure (NVS buffer)
  */
 typedef struct {
     uint32_t timestamp;     ///< Packet timestamp
@@ -26,12 +27,27 @@ typedef struct {
     char payload[];         ///< JSON payload data
 } http_buffered_packet_t;
 
+/**
+ * @brief Sample to buffer, fixed point so the flash buffer can compress it
+ */
+typedef struct {
+    uint64_t timestamp_ms;         ///< Sample time (Unix ms)
+    int32_t soil_mv;               ///< Soil voltage in mV
+    int32_t moisture_centi;        ///< Soil moisture in 0.01 %
+    int32_t raw_adc;               ///< Raw soil ADC reading
+    int32_t battery_mv;            ///< Battery voltage in mV
+    int32_t battery_deci;          ///< Battery charge in 0.1 %
+} http_buffer_sample_t;
+
+#define HTTP_BUFFER_SAMPLE_CHANNELS 5   ///< Value fields of http_buffer_sample_t
+
 /**
  * @brief HTTP buffer configuration
  */
 typedef struct {
-    int32_t max_buffered_packets;  ///< Maximum packets to buffer
+    int32_t max_buffered_packets;  ///< Maximum packets (flash: samples) to buffer
     bool enable_buffering;         ///< Enable/disable buffering
+    const char* device_id;         ///< device_id of replayed samples
 } http_buffer_config_t;
 
 /**
@@ -52,15 +68,41 @@ esp_err_t http_buffer_deinit(void);
 /**
  * @brief Add a packet to the buffer
  * 
+ * Only the NVS buffer stores JSON; the flash buffer stores samples.
+ * 
  * @param json_payload JSON string to buffer
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_SUPPORTED with the flash buffer
  */
 esp_err_t http_buffer_add_packet(const char* json_payload);
 
+/**
+ * @brief Add a sample to the buffer
+ * 
+ * The flash buffer appends it to a ts_codec block held in RTC memory and
+ * writes the block to the flash log once it is full or a replay starts.
+ * The NVS buffer stores it as a JSON packet.
+ * 
+ * @param sample Sample to buffer
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t http_buffer_add_sample(const http_buffer_sample_t* sample);
+
+/**
+ * @brief Render a buffered sample as the JSON object the HTTP sink sends
+ * 
+ * @param sample Sample
+ * @param device_id Device ID to report
+ * @param buf Output buffer
+ * @param cap Size of buf
+ * @return int Length written, -1 if it does not fit
+ */
+int http_buffer_format_sample(const http_buffer_sample_t* sample, const char* device_id,
+                              char* buf, size_t cap);
+
 /**
  * @brief Get count of buffered packets
  * 
- * @return int32_t Number of packets currently buffered
+ * @return int32_t Number of packets (flash buffer: samples) currently buffered
  */
 int32_t http_buffer_get_count(void);
 
@@ -80,6 +122,37 @@ esp_err_t http_buffer_clear_all(void);
 typedef esp_err_t (*http_buffer_send_func_t)(const char* json_payload);
 esp_err_t http_buffer_flush_packets(http_buffer_send_func_t send_func);
 
+/**
+ * @brief Start streaming the buffered packets as newline-delimited JSON
+ *
+ * Only one stream can be open at a time. Packets stay in the buffer until
+ * http_buffer_stream_end() confirms they were sent.
+ *
+ * @param count Output: number of packets (flash buffer: samples) covered by the stream
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t http_buffer_stream_begin(int32_t* count);
+
+/**
+ * @brief Stream producer: copy the next piece of the stream
+ *
+ * Matches http_stream_producer_t. Holds at most one packet (one JSON line) in RAM.
+ *
+ * @param buf Buffer to fill
+ * @param cap Size of buf
+ * @param ctx Unused
+ * @return int Bytes written, 0 at the end of the stream
+ */
+int http_buffer_stream_read(char* buf, size_t cap, void* ctx);
+
+/**
+ * @brief End the stream
+ *
+ * @param sent true to remove the streamed packets from the buffer
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t http_buffer_stream_end(bool sent);
+
 /**
  * @brief Check if buffering is enabled and available
  * 
@@ -0,0 +1,481 @@
+/**
+ * @file http_buffer_flash.c
+ * @brief HTTP Packet Buffering in the flash log partition
+ *
+ * Same API as the NVS implementation in http_buffer.c, selected with
+ * HTTP_BUFFER_FLASH_LOG. Samples are compressed into ts_codec blocks: the
+ * open block lives in RTC memory across deep sleep and is appended to the
+ * flash log once it is full or a replay starts. Replays decode the blocks
+ * straight from mapped flash, oldest first, and render each sample as JSON.
+ * Counts and the buffer limit are in samples; a block holds at most a
+ * quarter of the limit, so a full buffer drops at most that many at once.
+ */
+
+#include "http_buffer.h"
+#include "../flash_log/flash_log.h"
+#include "../../utils/ts_codec.h"
+#include "../../config/esp32-config.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#if HTTP_BUFFER_FLASH_LOG
+
+static const char *TAG = "HTTPBuffer";
+
+#define DEFAULT_MAX_BUFFERED_PACKETS 50
+#define OPEN_BLOCK_MAGIC    0x48425546      ///< "HBUF", open block valid
+#define LINE_MAX            256             ///< One rendered sample with its newline
+
+/**
+ * @brief Block being filled, kept in RTC memory so it survives deep sleep
+ */
+typedef struct {
+    uint32_t magic;                         ///< OPEN_BLOCK_MAGIC while a block is open
+    ts_encoder_t enc;                       ///< enc.buf re-pointed at buf on every init
+    uint8_t buf[HTTP_BUFFER_BLOCK_BYTES];
+} open_block_t;
+
+static RTC_DATA_ATTR open_block_t s_open;
+
+static bool s_buffering_enabled = false;
+static int32_t s_max_buffered_packets = DEFAULT_MAX_BUFFERED_PACKETS;
+static uint32_t s_block_samples = DEFAULT_MAX_BUFFERED_PACKETS / 4;    ///< Seal the open block at this count
+static char s_device_id[32] = {0};
+
+// Stream state (one stream at a time)
+static flash_log_reader_t s_reader;
+static bool s_streaming = false;
+static bool s_stream_in_block = false;
+static ts_decoder_t s_stream_dec;
+static uint32_t s_stream_seq = 0;
+static char s_stream_line[LINE_MAX];
+static size_t s_stream_line_len = 0;
+static size_t s_stream_offset = 0;
+static bool s_stream_has_sent = false;
+static uint32_t s_stream_last_seq = 0;                          ///< Last block streamed completely
+
+
+
+
+// #####################################
+// MARK: Blocks
+// #####################################
+
+static void sample_to_values(const http_buffer_sample_t* sample, int32_t* values)
+{
+    values[0] = sample->soil_mv;
+    values[1] = sample->moisture_centi;
+    values[2] = sample->raw_adc;
+    values[3] = sample->battery_mv;
+    values[4] = sample->battery_deci;
+}
+
+static void values_to_sample(uint64_t ts_ms, const int32_t* values, http_buffer_sample_t* sample)
+{
+    sample->timestamp_ms = ts_ms;
+    sample->soil_mv = values[0];
+    sample->moisture_centi = values[1];
+    sample->raw_adc = values[2];
+    sample->battery_mv = values[3];
+    sample->battery_deci = values[4];
+}
+
+static uint32_t open_count(void)
+{
+    return (s_open.magic == OPEN_BLOCK_MAGIC) ? s_open.enc.count : 0;
+}
+
+/**
+ * @brief Sequence number of the oldest stored block
+ */
+static uint32_t oldest_seq(void)
+{
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    return stats.next_seq - stats.count;
+}
+
+/**
+ * @brief Samples in the stored blocks, read from the block headers
+ */
+static uint32_t stored_samples(void)
+{
+    flash_log_reader_t reader;
+    if (flash_log_count() == 0 || flash_log_reader_begin(&reader) != ESP_OK) {
+        return 0;
+    }
+    uint32_t samples = 0;
+    flash_log_record_t record;
+    ts_block_header_t header;
+    while (flash_log_reader_next(&reader, &record)) {
+        if (ts_block_read_header(record.data, record.len, &header) == ESP_OK) {
+            samples += header.count;
+        }
+    }
+    flash_log_reader_end(&reader);
+    return samples;
+}
+
+static esp_err_t open_block(void)
+{
+    esp_err_t ret = ts_encoder_init(&s_open.enc, s_open.buf, sizeof(s_open.buf),
+                                    HTTP_BUFFER_SAMPLE_CHANNELS);
+    s_open.magic = (ret == ESP_OK) ? OPEN_BLOCK_MAGIC : 0;
+    return ret;
+}
+
+/**
+ * @brief Append the open block to the flash log
+ *
+ * The block stays open when the append fails, so no sample is lost.
+ */
+static esp_err_t seal_open_block(void)
+{
+    if (open_count() == 0) {
+        return ESP_OK;
+    }
+    size_t size = ts_encoder_finish(&s_open.enc);
+    esp_err_t ret = flash_log_append(s_open.buf, size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store buffered block: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGD(TAG, "Stored block of %u samples in %u bytes", (unsigned)s_open.enc.count, (unsigned)size);
+    s_open.magic = 0;
+    return ESP_OK;
+}
+
+/**
+ * @brief Make room for one sample: drop the oldest block, or the open one if none is stored
+ */
+static void drop_oldest(void)
+{
+    if (flash_log_count() > 0) {
+        flash_log_consume(oldest_seq());
+        return;
+    }
+    ESP_LOGW(TAG, "Dropping the open block (%lu samples)", (unsigned long)open_count());
+    s_open.magic = 0;
+}
+
+
+
+
+// #####################################
+// MARK: Buffer
+// #####################################
+
+esp_err_t http_buffer_init(const http_buffer_config_t* config)
+{
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_buffering_enabled = config->enable_buffering;
+    s_max_buffered_packets = (config->max_buffered_packets > 0) ?
+                            config->max_buffered_packets : DEFAULT_MAX_BUFFERED_PACKETS;
+    s_block_samples = (s_max_buffered_packets >= 4) ? (uint32_t)s_max_buffered_packets / 4 : 1;
+    if (config->device_id != NULL) {
+        strncpy(s_device_id, config->device_id, sizeof(s_device_id) - 1);
+    }
+
+    if (s_buffering_enabled) {
+        esp_err_t ret = flash_log_init();
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Flash log unavailable for buffering: %s", esp_err_to_name(ret));
+            s_buffering_enabled = false;
+            return ret;
+        }
+
+        // RTC memory is random after power-on and the buffer moved with the image
+        s_open.enc.buf = s_open.buf;
+        if (s_open.magic == OPEN_BLOCK_MAGIC &&
+            (s_open.enc.cap != sizeof(s_open.buf) ||
+             s_open.enc.channels != HTTP_BUFFER_SAMPLE_CHANNELS ||
+             s_open.enc.bit_pos > (sizeof(s_open.buf) - sizeof(ts_block_header_t)) * 8u)) {
+            ESP_LOGW(TAG, "Discarding invalid open block");
+            s_open.magic = 0;
+        }
+
+        ESP_LOGI(TAG, "HTTP buffering initialized in flash (max %ld samples, %ld stored)",
+                 (long)s_max_buffered_packets, (long)http_buffer_get_count());
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_buffer_deinit(void)
+{
+    s_buffering_enabled = false;
+    ESP_LOGI(TAG, "HTTP buffer deinitialized");
+    return ESP_OK;
+}
+
+esp_err_t http_buffer_add_packet(const char* json_payload)
+{
+    (void)json_payload;
+    ESP_LOGE(TAG, "The flash buffer stores samples, use http_buffer_add_sample()");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t http_buffer_add_sample(const http_buffer_sample_t* sample)
+{
+    if (!s_buffering_enabled || sample == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_streaming) {
+        return ESP_ERR_INVALID_STATE;   // The flash log is locked by the reader
+    }
+
+    if (http_buffer_get_count() >= s_max_buffered_packets) {
+        ESP_LOGW(TAG, "Buffer full (%ld samples), dropping oldest", (long)http_buffer_get_count());
+        drop_oldest();
+    }
+
+    int32_t values[HTTP_BUFFER_SAMPLE_CHANNELS];
+    sample_to_values(sample, values);
+
+    esp_err_t ret = (open_count() >= s_block_samples) ? seal_open_block() : ESP_OK;
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (s_open.magic != OPEN_BLOCK_MAGIC) {
+        ret = open_block();
+    }
+    if (ret == ESP_OK) {
+        ret = ts_encoder_add(&s_open.enc, sample->timestamp_ms, values);
+    }
+    if (ret == ESP_ERR_NO_MEM || ret == ESP_ERR_INVALID_ARG) {
+        // Block full or the clock went backwards: store it and start a new one
+        ret = seal_open_block();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        ret = open_block();
+        if (ret == ESP_OK) {
+            ret = ts_encoder_add(&s_open.enc, sample->timestamp_ms, values);
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to buffer sample: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Sample buffered (%ld/%ld samples stored)",
+             (long)http_buffer_get_count(), (long)s_max_buffered_packets);
+    return ESP_OK;
+}
+
+int32_t http_buffer_get_count(void)
+{
+    return s_buffering_enabled ? (int32_t)(stored_samples() + open_count()) : 0;
+}
+
+esp_err_t http_buffer_clear_all(void)
+{
+    if (!s_buffering_enabled) {
+        return ESP_OK;
+    }
+    int32_t count = http_buffer_get_count();
+    s_open.magic = 0;
+    esp_err_t ret = ESP_OK;
+    uint32_t blocks = flash_log_count();
+    if (blocks > 0) {
+        ret = flash_log_consume(oldest_seq() + blocks - 1);
+    }
+    ESP_LOGI(TAG, "Cleared %ld buffered samples", (long)count);
+    return ret;
+}
+
+
+
+
+// #####################################
+// MARK: Replay
+// #####################################
+
+esp_err_t http_buffer_flush_packets(http_buffer_send_func_t send_func)
+{
+    if (!s_buffering_enabled || send_func == NULL) {
+        return ESP_OK;
+    }
+    esp_err_t ret = seal_open_block();
+    if (ret != ESP_OK || flash_log_count() == 0) {
+        return ret; // Nothing to flush
+    }
+
+    flash_log_reader_t reader;
+    ret = flash_log_reader_begin(&reader);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Flushing %lu buffered blocks...", (unsigned long)flash_log_count());
+    int32_t sent_count = 0;
+    uint32_t last_sent = 0;
+    bool failed = false;
+    flash_log_record_t record;
+    while (!failed && flash_log_reader_next(&reader, &record)) {
+        ts_decoder_t dec;
+        if (ts_decoder_init(&dec, record.data, record.len) != ESP_OK) {
+            last_sent = record.seq;     // Not a block, drop it with the others
+            continue;
+        }
+
+        // A block goes only once all of its samples were sent
+        uint64_t ts_ms;
+        int32_t values[TS_CODEC_MAX_CHANNELS];
+        while (ts_decoder_next(&dec, &ts_ms, values)) {
+            http_buffer_sample_t sample;
+            char json[LINE_MAX];
+            values_to_sample(ts_ms, values, &sample);
+            if (http_buffer_format_sample(&sample, s_device_id, json, sizeof(json)) < 0) {
+                continue;
+            }
+            if (send_func(json) != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to send buffered block %lu, keeping it and the rest",
+                         (unsigned long)record.seq);
+                failed = true;
+                break;
+            }
+            sent_count++;
+        }
+        if (!failed) {
+            last_sent = record.seq;
+            // Small delay between blocks to avoid overwhelming server
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+    flash_log_reader_end(&reader);
+
+    if (last_sent != 0) {
+        flash_log_consume(last_sent);
+    }
+    ESP_LOGI(TAG, "Flush complete: %ld samples sent, %ld remaining",
+             (long)sent_count, (long)http_buffer_get_count());
+    return failed ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t http_buffer_stream_begin(int32_t* count)
+{
+    if (count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = 0;
+    if (!s_buffering_enabled || s_streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = seal_open_block();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *count = (int32_t)stored_samples();
+    ret = flash_log_reader_begin(&s_reader);
+    if (ret != ESP_OK) {
+        *count = 0;
+        return ret;
+    }
+    s_streaming = true;
+    s_stream_in_block = false;
+    s_stream_line_len = 0;
+    s_stream_offset = 0;
+    s_stream_has_sent = false;
+
+    ESP_LOGI(TAG, "Streaming %ld buffered samples", (long)*count);
+    return ESP_OK;
+}
+
+/**
+ * @brief Render the next sample as one line, remembering each completed block
+ */
+static bool stream_next_line(void)
+{
+    for (;;) {
+        if (s_stream_in_block) {
+            uint64_t ts_ms;
+            int32_t values[TS_CODEC_MAX_CHANNELS];
+            if (ts_decoder_next(&s_stream_dec, &ts_ms, values)) {
+                http_buffer_sample_t sample;
+                values_to_sample(ts_ms, values, &sample);
+                int len = http_buffer_format_sample(&sample, s_device_id, s_stream_line,
+                                                    sizeof(s_stream_line) - 1);
+                if (len < 0) {
+                    continue;
+                }
+                s_stream_line[len] = '\n';
+                s_stream_line_len = (size_t)len + 1;
+                s_stream_offset = 0;
+                return true;
+            }
+            s_stream_last_seq = s_stream_seq;
+            s_stream_has_sent = true;
+            s_stream_in_block = false;
+        }
+
+        flash_log_record_t record;
+        if (!flash_log_reader_next(&s_reader, &record)) {
+            return false;
+        }
+        s_stream_seq = record.seq;
+        s_stream_in_block = true;
+        if (ts_decoder_init(&s_stream_dec, record.data, record.len) != ESP_OK) {
+            s_stream_dec.header.count = 0;  // Not a block, ends at once and is dropped
+            s_stream_dec.index = 0;
+        }
+    }
+}
+
+int http_buffer_stream_read(char* buf, size_t cap, void* ctx)
+{
+    (void)ctx;
+    if (!s_streaming || buf == NULL) {
+        return -1;
+    }
+
+    size_t produced = 0;
+    while (produced < cap) {
+        if (s_stream_offset >= s_stream_line_len && !stream_next_line()) {
+            break;
+        }
+        size_t n = s_stream_line_len - s_stream_offset;
+        if (n > cap - produced) {
+            n = cap - produced;
+        }
+        memcpy(&buf[produced], &s_stream_line[s_stream_offset], n);
+        s_stream_offset += n;
+        produced += n;
+    }
+    return (int)produced;
+}
+
+esp_err_t http_buffer_stream_end(bool sent)
+{
+    if (!s_streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // A block streamed up to the newline of its last sample counts as sent
+    if (s_stream_in_block && s_stream_offset >= s_stream_line_len &&
+        s_stream_dec.index >= s_stream_dec.header.count) {
+        s_stream_last_seq = s_stream_seq;
+        s_stream_has_sent = true;
+    }
+    flash_log_reader_end(&s_reader);
+    s_streaming = false;
+    s_stream_in_block = false;
+
+    if (!sent || !s_stream_has_sent) {
+        return ESP_OK;
+    }
+    esp_err_t ret = flash_log_consume(s_stream_last_seq);
+    ESP_LOGI(TAG, "Stream complete: %ld remaining", (long)http_buffer_get_count());
+    return ret;
+}
+
+bool http_buffer_is_enabled(void)
+{
+    return s_buffering_enabled;
+}
+
+#endif // HTTP_BUFFER_FLASH_LOG
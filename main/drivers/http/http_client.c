@@ -5,10 +5,13 @@
 
 #include "http_client.h"
 #include "http_buffer.h"
+#include "../../utils/retry_policy.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <strings.h>
+#include "esp_timer.h"
 
 static const char *TAG = "HTTPClient";
 
@@ -17,6 +20,7 @@ static http_client_config_t s_config;
 static int s_last_status_code = 0;
 static bool is_initialized = false;
 static esp_http_client_handle_t s_persistent_client = NULL;
+static uint32_t s_retry_after_ms = 0;
 
 // Forward declarations
 static esp_err_t http_event_handler(esp_http_client_event_t *evt);
@@ -56,7 +60,8 @@ esp_err_t http_client_init(const http_client_config_t* config)
     // Initialize HTTP buffer
     http_buffer_config_t buffer_config = {
         .enable_buffering = s_config.enable_buffering,
-        .max_buffered_packets = s_config.max_buffered_packets
+        .max_buffered_packets = s_config.max_buffered_packets,
+        .device_id = s_config.device_id,
     };
     
     esp_err_t buffer_ret = http_buffer_init(&buffer_config);
@@ -107,46 +112,75 @@ http_response_status_t http_client_send_json(const char* json_payload)
     ESP_LOGD(TAG, "Payload: %s", json_payload);
 
     http_response_status_t result = HTTP_RESPONSE_ERROR;
-    int retry_count = 0;
+    retry_policy_t policy = {
+        .max_attempts = (uint8_t)(s_config.max_retries + 1),
+        .base_delay_ms = RETRY_BASE_DELAY_MS,
+        .max_delay_ms = RETRY_MAX_DELAY_MS,
+    };
 
-    while (retry_count <= s_config.max_retries) {
+    for (uint8_t attempt = 1; ; attempt++) {
+        s_retry_after_ms = 0;
+        int64_t start_us = esp_timer_get_time();
         esp_err_t err = esp_http_client_perform(s_persistent_client);
-        
+        if (attempt > 1) {
+            retry_budget_charge((uint32_t)((esp_timer_get_time() - start_us) / 1000));
+        }
+
         if (err == ESP_OK) {
             s_last_status_code = esp_http_client_get_status_code(s_persistent_client);
             ESP_LOGD(TAG, "HTTP POST Status = %d", s_last_status_code);
-            
-            if (s_last_status_code >= 200 && s_last_status_code < 300) {
-                result = HTTP_RESPONSE_OK;
-                break;
-            } else {
-                result = HTTP_RESPONSE_ERROR;
-            }
+            result = (s_last_status_code >= 200 && s_last_status_code < 300) ? HTTP_RESPONSE_OK : HTTP_RESPONSE_ERROR;
         } else if (err == ESP_ERR_TIMEOUT) {
-            ESP_LOGW(TAG, "HTTP request timeout (retry %d/%d)", retry_count, s_config.max_retries);
+            ESP_LOGW(TAG, "HTTP request timeout (attempt %u/%u)", attempt, policy.max_attempts);
             result = HTTP_RESPONSE_TIMEOUT;
         } else if (err == ESP_ERR_HTTP_EAGAIN) {
-            ESP_LOGW(TAG, "HTTP EAGAIN - server busy or connection issue (retry %d/%d)", retry_count, s_config.max_retries);
+            ESP_LOGW(TAG, "HTTP EAGAIN - server busy or connection issue (attempt %u/%u)", attempt, policy.max_attempts);
             result = HTTP_RESPONSE_TIMEOUT;
             // Recreate client connection on EAGAIN error
             esp_http_client_close(s_persistent_client);
         } else {
-            ESP_LOGE(TAG, "HTTP POST request failed: %s (retry %d/%d)", esp_err_to_name(err), retry_count, s_config.max_retries);
+            ESP_LOGE(TAG, "HTTP POST request failed: %s (attempt %u/%u)", esp_err_to_name(err), attempt, policy.max_attempts);
             result = HTTP_RESPONSE_NO_CONNECTION;
             // Close and recreate connection for other errors too
             esp_http_client_close(s_persistent_client);
         }
 
-        retry_count++;
-        if (retry_count <= s_config.max_retries) {
-            ESP_LOGW(TAG, "Retrying HTTP request (%d/%d) in 2 seconds...", retry_count, s_config.max_retries);
-            vTaskDelay(pdMS_TO_TICKS(2000)); // Wait 2 seconds before retry (increased)
+        retry_class_t cls = retry_policy_classify_http(err, s_last_status_code);
+        if (cls == RETRY_CLASS_PERMANENT && err == ESP_OK) {
+            ESP_LOGE(TAG, "HTTP status %d is not retryable", s_last_status_code);
         }
+        uint32_t delay_ms;
+        if (!retry_policy_next(&policy, attempt, cls, s_retry_after_ms, &delay_ms)) {
+            break;
+        }
+        ESP_LOGW(TAG, "Retrying HTTP request (%u/%u) in %lu ms...", attempt + 1, policy.max_attempts, (unsigned long)delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
     }
     
     return result;
 }
 
+http_response_status_t http_client_send_stream(http_stream_producer_t producer, void* ctx,
+                                               const char* content_type)
+{
+    if (!is_initialized || producer == NULL || s_persistent_client == NULL) {
+        return HTTP_RESPONSE_ERROR;
+    }
+
+    char full_url[256];
+    snprintf(full_url, sizeof(full_url), "http://%s:%d%s", 
+             s_config.server_ip, s_config.server_port, s_config.endpoint);
+    esp_http_client_set_url(s_persistent_client, full_url);
+    esp_http_client_set_header(s_persistent_client, "Content-Type",
+                               content_type != NULL ? content_type : "application/json");
+
+    esp_err_t err = http_stream_post(s_persistent_client, producer, ctx, &s_last_status_code);
+    if (err == ESP_OK) {
+        return HTTP_RESPONSE_OK;
+    }
+    return (s_last_status_code == 0) ? HTTP_RESPONSE_NO_CONNECTION : HTTP_RESPONSE_ERROR;
+}
+
 http_response_status_t http_client_test_connection(void)
 {
     if (!is_initialized) {
@@ -188,6 +222,9 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (strcasecmp(evt->header_key, "Retry-After") == 0) {
+                s_retry_after_ms = retry_policy_parse_retry_after(evt->header_value);
+            }
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -205,14 +242,19 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+#if !HTTP_STREAM_FLUSH
 // Helper function to convert HTTP response to esp_err_t for buffer callback
 static esp_err_t http_send_callback(const char* json_payload)
 {
     http_response_status_t result = http_client_send_json(json_payload);
     return (result == HTTP_RESPONSE_OK) ? ESP_OK : ESP_FAIL;
 }
+#endif // !HTTP_STREAM_FLUSH
 
-http_response_status_t http_client_send_json_buffered(const char* json_payload)
+/**
+ * @brief Send JSON, buffer the sample (or the JSON if sample is NULL) on failure
+ */
+static http_response_status_t send_buffered(const char* json_payload, const http_buffer_sample_t* sample)
 {
     if (!is_initialized || json_payload == NULL) {
         return HTTP_RESPONSE_ERROR;
@@ -236,7 +278,8 @@ http_response_status_t http_client_send_json_buffered(const char* json_payload)
     if (http_buffer_is_enabled() && (result == HTTP_RESPONSE_NO_CONNECTION || 
                                      result == HTTP_RESPONSE_TIMEOUT || 
                                      result == HTTP_RESPONSE_ERROR)) {
-        esp_err_t buffer_ret = http_buffer_add_packet(json_payload);
+        esp_err_t buffer_ret = (sample != NULL) ? http_buffer_add_sample(sample)
+                                                : http_buffer_add_packet(json_payload);
         if (buffer_ret == ESP_OK) {
             ESP_LOGW(TAG, "Server unavailable, packet buffered for later transmission");
             return HTTP_RESPONSE_OK; // Return OK since we buffered successfully
@@ -248,9 +291,36 @@ http_response_status_t http_client_send_json_buffered(const char* json_payload)
     return result;
 }
 
+http_response_status_t http_client_send_json_buffered(const char* json_payload)
+{
+    return send_buffered(json_payload, NULL);
+}
+
+http_response_status_t http_client_send_sample_buffered(const char* json_payload,
+                                                        const http_buffer_sample_t* sample)
+{
+    return send_buffered(json_payload, sample);
+}
+
 esp_err_t http_client_flush_buffered_packets(void)
 {
+#if HTTP_STREAM_FLUSH
+    int32_t count = 0;
+    esp_err_t ret = http_buffer_stream_begin(&count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (count == 0) {
+        return http_buffer_stream_end(false);
+    }
+
+    http_response_status_t result = http_client_send_stream(http_buffer_stream_read, NULL,
+                                                            "application/x-ndjson");
+    http_buffer_stream_end(result == HTTP_RESPONSE_OK);
+    return (result == HTTP_RESPONSE_OK) ? ESP_OK : ESP_FAIL;
+#else
     return http_buffer_flush_packets(http_send_callback);
+#endif // HTTP_STREAM_FLUSH
 }
 
 int32_t http_client_get_buffered_packet_count(void)
@@ -11,6 +11,8 @@
 
 #include "../../utils/esp_utils.h"
 #include "../../config/esp32-config.h"
+#include "http_stream.h"
+#include "http_buffer.h"
 
 #include "esp_err.h"
 #include "esp_http_client.h"
@@ -33,6 +35,7 @@ typedef struct {
     int max_retries;        ///< Maximum retry attempts
     bool enable_buffering;  ///< Enable offline packet buffering
     int max_buffered_packets; ///< Maximum packets to buffer offline
+    char device_id[32];     ///< device_id of replayed buffered samples
 } http_client_config_t;
 
 
@@ -70,6 +73,19 @@ esp_err_t http_client_deinit(void);
  */
 http_response_status_t http_client_send_json(const char* json_payload);
 
+/**
+ * @brief Send a body pulled from a producer in one chunked request
+ *
+ * Not retried, a stream cannot be replayed.
+ *
+ * @param producer Body producer
+ * @param ctx Producer context
+ * @param content_type Content-Type of the body
+ * @return http_response_status_t Response status
+ */
+http_response_status_t http_client_send_stream(http_stream_producer_t producer, void* ctx,
+                                               const char* content_type);
+
 /**
  * @brief Test HTTP connection to server
  * 
@@ -99,8 +115,23 @@ int http_client_get_last_status_code(void);
  */
 http_response_status_t http_client_send_json_buffered(const char* json_payload);
 
+/**
+ * @brief Send a sample's JSON, buffering the sample itself when the server is unavailable
+ * 
+ * The flash buffer only stores samples (see http_buffer_add_sample()).
+ * 
+ * @param json_payload JSON rendering of sample to send now
+ * @param sample Sample to buffer on failure
+ * @return http_response_status_t Response status
+ */
+http_response_status_t http_client_send_sample_buffered(const char* json_payload,
+                                                        const http_buffer_sample_t* sample);
+
 /**
  * @brief Flush all buffered packets when server becomes available
+ *
+ * With HTTP_STREAM_FLUSH the whole backlog goes out in one chunked request
+ * as newline-delimited JSON, otherwise one request per packet.
  * 
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
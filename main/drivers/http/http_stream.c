@@ -0,0 +1,115 @@
+/**
+ * @file http_stream.c
+ * @brief Chunked streaming HTTP request bodies - Implementation
+ */
+
+#include "http_stream.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "HTTPStream";
+
+/**
+ * @brief Write all bytes, esp_http_client_write may write less than asked
+ */
+static esp_err_t write_all(esp_http_client_handle_t client, const char* data, int len)
+{
+    while (len > 0) {
+        int written = esp_http_client_write(client, data, len);
+        if (written <= 0) {
+            return ESP_FAIL;
+        }
+        data += written;
+        len -= written;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Frame one chunk: size line, data, CRLF
+ */
+static esp_err_t write_chunk(esp_http_client_handle_t client, const char* data, int len)
+{
+    char size_line[12];
+    int n = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned)len);
+    if (write_all(client, size_line, n) != ESP_OK ||
+        write_all(client, data, len) != ESP_OK ||
+        write_all(client, "\r\n", 2) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Close the connection and drop the chunked header again
+ *
+ * The header stays on the handle otherwise and would break a later
+ * esp_http_client_perform() with a Content-Length body.
+ */
+static void stream_close(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    esp_http_client_delete_header(client, "Transfer-Encoding");
+}
+
+esp_err_t http_stream_post(esp_http_client_handle_t client, http_stream_producer_t producer,
+                           void* ctx, int* status_code)
+{
+    if (client == NULL || producer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (status_code != NULL) {
+        *status_code = 0;
+    }
+
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+
+    // A negative length makes the client send Transfer-Encoding: chunked
+    esp_err_t err = esp_http_client_open(client, -1);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open connection: %s", esp_err_to_name(err));
+        stream_close(client);
+        return err;
+    }
+
+    char chunk[HTTP_STREAM_CHUNK_SIZE];
+    size_t total = 0;
+    for (;;) {
+        int len = producer(chunk, sizeof(chunk), ctx);
+        if (len == 0) {
+            break;
+        }
+        if (len < 0 || len > (int)sizeof(chunk)) {
+            ESP_LOGE(TAG, "Producer aborted the body after %u bytes", (unsigned)total);
+            stream_close(client);
+            return ESP_FAIL;
+        }
+        if (write_chunk(client, chunk, len) != ESP_OK) {
+            ESP_LOGE(TAG, "Write failed after %u bytes", (unsigned)total);
+            stream_close(client);
+            return ESP_FAIL;
+        }
+        total += (size_t)len;
+    }
+
+    // Last chunk, no trailers
+    if (write_all(client, "0\r\n\r\n", 5) != ESP_OK) {
+        stream_close(client);
+        return ESP_FAIL;
+    }
+
+    if (esp_http_client_fetch_headers(client) < 0) {
+        ESP_LOGE(TAG, "No response after %u bytes", (unsigned)total);
+        stream_close(client);
+        return ESP_FAIL;
+    }
+    int status = esp_http_client_get_status_code(client);
+    if (status_code != NULL) {
+        *status_code = status;
+    }
+    esp_http_client_flush_response(client, NULL);
+    stream_close(client);
+
+    ESP_LOGD(TAG, "Streamed %u bytes, status %d", (unsigned)total, status);
+    return (status >= 200 && status < 300) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file http_stream.h
+ * @brief Chunked streaming HTTP request bodies
+ *
+ * Sends a POST body with Transfer-Encoding: chunked, pulling it piece by
+ * piece from a producer callback. The body is never materialized, so an
+ * arbitrarily large backlog uploads in one request with a constant
+ * HTTP_STREAM_CHUNK_SIZE buffer.
+ */
+
+#ifndef HTTP_STREAM_H
+#define HTTP_STREAM_H
+
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include <stddef.h>
+
+#define HTTP_STREAM_CHUNK_SIZE  512     ///< Producer buffer, one chunk on the wire
+
+/**
+ * @brief Body producer
+ *
+ * @param buf Buffer to fill
+ * @param cap Size of buf
+ * @param ctx Producer context
+ * @return int Bytes written (> 0), 0 at the end of the body, < 0 to abort the request
+ */
+typedef int (*http_stream_producer_t)(char* buf, size_t cap, void* ctx);
+
+/**
+ * @brief POST a chunked body on a configured client
+ *
+ * URL and headers must already be set on the client. A stream cannot be
+ * replayed, so there is no retry; the caller keeps its data until ESP_OK.
+ * The connection is closed afterwards.
+ *
+ * @param client HTTP client handle
+ * @param producer Body producer
+ * @param ctx Producer context
+ * @param status_code Output: HTTP status code (0 if no response was received)
+ * @return esp_err_t ESP_OK if the server answered 2xx, error code otherwise
+ */
+esp_err_t http_stream_post(esp_http_client_handle_t client, http_stream_producer_t producer,
+                           void* ctx, int* status_code);
+
+#endif // HTTP_STREAM_H
@@ -8,8 +8,17 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include <strings.h>
+#include "../../utils/retry_policy.h"
+#if INFLUXDB_GZIP_ENABLED
+#include "influxdb_gzip.h"
+#endif
 
 static const char *TAG = "InfluxDBClient";
 
@@ -18,6 +27,12 @@ static influxdb_client_config_t s_config;
 static int s_last_status_code = 0;
 static bool is_initialized = false;
 static esp_http_client_handle_t s_client = NULL;
+static uint32_t s_retry_after_ms = 0;
+
+// Request template, prepared once in influxdb_client_init()
+static char s_write_url[256];
+static bool s_url_redirected = false;       ///< A redirect replaced the handle's URL
+static bool s_gzip_header_set = false;      ///< Content-Encoding: gzip is on the handle
 
 // Forward declarations
 static esp_err_t influxdb_event_handler(esp_http_client_event_t *evt);
@@ -31,18 +46,20 @@ esp_err_t influxdb_client_init(const influxdb_client_config_t* config)
 
     memcpy(&s_config, config, sizeof(influxdb_client_config_t));
     
-    // Create HTTP client for InfluxDB
-    char url[256];
-#if INFLUXDB_USE_HTTPS
-    snprintf(url, sizeof(url), "https://%s:%d%s", 
-             s_config.server, s_config.port, s_config.endpoint);
+    // Write URL with query parameters, built once; a write only swaps the body
+    const char* scheme = INFLUXDB_USE_HTTPS ? "https" : "http";
+#if NTP_ENABLED
+    // With NTP: Include precision parameter for timestamps
+    snprintf(s_write_url, sizeof(s_write_url), "%s://%s:%d%s?org=%s&bucket=%s&precision=ns",
+             scheme, s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
 #else
-    snprintf(url, sizeof(url), "http://%s:%d%s", 
-             s_config.server, s_config.port, s_config.endpoint);
+    // Without NTP: No precision parameter needed (server time)
+    snprintf(s_write_url, sizeof(s_write_url), "%s://%s:%d%s?org=%s&bucket=%s",
+             scheme, s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
 #endif
 
     esp_http_client_config_t client_config = {
-        .url = url,
+        .url = s_write_url,
         .event_handler = influxdb_event_handler,
         .timeout_ms = s_config.timeout_ms,
         .method = HTTP_METHOD_POST,
@@ -63,13 +80,31 @@ esp_err_t influxdb_client_init(const influxdb_client_config_t* config)
         return ESP_FAIL;
     }
 
+    // Headers stay on the handle across requests
+    esp_err_t err = ESP_OK;
+    err |= esp_http_client_set_header(s_client, "Content-Type", "text/plain; charset=utf-8");
+    err |= esp_http_client_set_header(s_client, "Accept", "application/json");
+    if (strlen(s_config.token) > 0) {
+        char auth_header[sizeof(s_config.token) + 8];
+        snprintf(auth_header, sizeof(auth_header), "Token %s", s_config.token);
+        err |= esp_http_client_set_header(s_client, "Authorization", auth_header);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set InfluxDB request headers");
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+        return ESP_FAIL;
+    }
+    s_url_redirected = false;
+    s_gzip_header_set = false;
+
     is_initialized = true;
     
     ESP_LOGI(TAG, "InfluxDB client initialized for server %s:%d", 
              s_config.server, s_config.port);
     ESP_LOGI(TAG, "Protocol: %s", INFLUXDB_USE_HTTPS ? "HTTPS" : "HTTP");
     ESP_LOGI(TAG, "Bucket: %s, Organization: %s", s_config.bucket, s_config.org);
-    ESP_LOGI(TAG, "Full URL: %s", url);
+    ESP_LOGI(TAG, "Full URL: %s", s_write_url);
     
     return ESP_OK;
 }
@@ -87,6 +122,60 @@ esp_err_t influxdb_client_deinit(void)
 }
 
 
+#if INFLUXDB_GZIP_ENABLED
+/**
+ * @brief Compress a body above INFLUXDB_GZIP_MIN_BYTES
+ *
+ * @return Heap buffer with the gzip body (caller frees), NULL to send uncompressed
+ */
+static uint8_t* influxdb_gzip_body(const char* body, size_t body_len, size_t* out_len)
+{
+    if (body_len < INFLUXDB_GZIP_MIN_BYTES) {
+        return NULL;
+    }
+
+    // Bounded by the input: a body that does not shrink is sent as is
+    uint8_t* out = malloc(body_len);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = influxdb_gzip_compress((const uint8_t*)body, body_len, out, body_len, out_len);
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Body not compressed (%s)", esp_err_to_name(err));
+        free(out);
+        return NULL;
+    }
+    ESP_LOGD(TAG, "gzip %u -> %u bytes (%u%%) in %lld us", (unsigned)body_len, (unsigned)*out_len,
+             (unsigned)(*out_len * 100 / body_len), (long long)(esp_timer_get_time() - start_us));
+    return out;
+}
+#endif // INFLUXDB_GZIP_ENABLED
+
+/**
+ * @brief Restore the request template after a redirect and set the body encoding
+ *
+ * URL and static headers are prepared in influxdb_client_init(); this only
+ * touches the handle when something actually changed.
+ */
+static esp_err_t influxdb_prepare_request(bool gzip)
+{
+    esp_err_t err = ESP_OK;
+    if (s_url_redirected) {
+        err |= esp_http_client_set_url(s_client, s_write_url);
+        s_url_redirected = false;
+    }
+    if (gzip && !s_gzip_header_set) {
+        err |= esp_http_client_set_header(s_client, "Content-Encoding", "gzip");
+        s_gzip_header_set = true;
+    } else if (!gzip && s_gzip_header_set) {
+        esp_http_client_delete_header(s_client, "Content-Encoding");
+        s_gzip_header_set = false;
+    }
+    return err;
+}
+
 esp_err_t influxdb_send_line_protocol(const char* line_protocol)
 {
     if (!is_initialized || line_protocol == NULL || s_client == NULL) {
@@ -94,66 +183,52 @@ esp_err_t influxdb_send_line_protocol(const char* line_protocol)
         return ESP_FAIL;
     }
 
-    // Build full URL with query parameters
-    char full_url[256];
-#if INFLUXDB_USE_HTTPS
-    #if NTP_ENABLED
-        // With NTP: Include precision parameter for timestamps
-        snprintf(full_url, sizeof(full_url), "https://%s:%d%s?org=%s&bucket=%s&precision=ns", 
-                 s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
-    #else
-        // Without NTP: No precision parameter needed (server time)
-        snprintf(full_url, sizeof(full_url), "https://%s:%d%s?org=%s&bucket=%s", 
-                 s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
-    #endif
-#else
-    #if NTP_ENABLED
-        snprintf(full_url, sizeof(full_url), "http://%s:%d%s?org=%s&bucket=%s&precision=ns", 
-                 s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
-    #else
-        snprintf(full_url, sizeof(full_url), "http://%s:%d%s?org=%s&bucket=%s", 
-                 s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
-    #endif
+    // Only the body changes per write
+    size_t body_len = strlen(line_protocol);
+    size_t gzip_len = 0;
+    uint8_t* gzip_body = NULL;
+#if INFLUXDB_GZIP_ENABLED
+    gzip_body = influxdb_gzip_body(line_protocol, body_len, &gzip_len);
 #endif
-
-    // Set the URL for this request
-    esp_err_t err = ESP_OK;
-    err |= esp_http_client_set_url(s_client, full_url);
-
-    // Set headers
-    err |= esp_http_client_set_header(s_client, "Content-Type", "text/plain; charset=utf-8");
-    err |= esp_http_client_set_header(s_client, "Accept", "application/json");
-    
-    // Set authorization header if token is provided
-    if (strlen(s_config.token) > 0) {
-        char auth_header[512];
-        snprintf(auth_header, sizeof(auth_header), "Token %s", s_config.token);
-        err |= esp_http_client_set_header(s_client, "Authorization", auth_header);
+    esp_cpu_cycle_count_t setup_start = esp_cpu_get_cycle_count();
+    esp_err_t err = influxdb_prepare_request(gzip_body != NULL);
+    if (gzip_body != NULL) {
+        err |= esp_http_client_set_post_field(s_client, (const char*)gzip_body, (int)gzip_len);
+    } else {
+        err |= esp_http_client_set_post_field(s_client, line_protocol, (int)body_len);
     }
-
-    // Set payload
-    err |= esp_http_client_set_post_field(s_client, line_protocol, strlen(line_protocol));
+    esp_cpu_cycle_count_t setup_cycles = esp_cpu_get_cycle_count() - setup_start;
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set up InfluxDB HTTP request: %s", esp_err_to_name(err));
+        free(gzip_body);
         return err;
     }
 
     esp_err_t result = ESP_FAIL;
-    int retry_count = 0;
+    int64_t write_start_us = esp_timer_get_time();
+    retry_policy_t policy = {
+        .max_attempts = (uint8_t)(s_config.max_retries + 1),
+        .base_delay_ms = RETRY_BASE_DELAY_MS,
+        .max_delay_ms = RETRY_MAX_DELAY_MS,
+    };
 
-    while (retry_count <= s_config.max_retries) {
+    for (uint8_t attempt = 1; ; attempt++) {
+        s_retry_after_ms = 0;
+        int64_t start_us = esp_timer_get_time();
         esp_err_t err = esp_http_client_perform(s_client);
+        if (attempt > 1) {
+            retry_budget_charge((uint32_t)((esp_timer_get_time() - start_us) / 1000));
+        }
+
         if (err == ESP_OK) {
             s_last_status_code = esp_http_client_get_status_code(s_client);
             ESP_LOGD(TAG, "InfluxDB POST Status = %d", s_last_status_code);
             
             if (s_last_status_code >= 200 && s_last_status_code < 300) {
                 result = ESP_OK;
-                break;
             } else if (s_last_status_code == 401) {
                 ESP_LOGE(TAG, "InfluxDB authentication failed - check token");
                 result = ESP_ERR_NOT_ALLOWED;
-                break; // Don't retry auth errors
             } else if (s_last_status_code == 404) {
                 ESP_LOGE(TAG, "InfluxDB endpoint not found (404) - check nginx routing to InfluxDB");
                 result = ESP_FAIL;
@@ -165,28 +240,58 @@ esp_err_t influxdb_send_line_protocol(const char* line_protocol)
                 result = ESP_FAIL;
             }
         } else if (err == ESP_ERR_TIMEOUT) {
-            ESP_LOGW(TAG, "InfluxDB request timeout (retry %d/%d)", retry_count, s_config.max_retries);
+            ESP_LOGW(TAG, "InfluxDB request timeout (attempt %u/%u)", attempt, policy.max_attempts);
             result = ESP_ERR_TIMEOUT;
         } else if (err == ESP_ERR_HTTP_EAGAIN) {
-            ESP_LOGW(TAG, "InfluxDB EAGAIN - server busy (retry %d/%d)", retry_count, s_config.max_retries);
+            ESP_LOGW(TAG, "InfluxDB EAGAIN - server busy (attempt %u/%u)", attempt, policy.max_attempts);
             result = ESP_ERR_TIMEOUT;
             esp_http_client_close(s_client);
         } else {
-            ESP_LOGE(TAG, "InfluxDB POST failed: %s (retry %d/%d)", esp_err_to_name(err), retry_count, s_config.max_retries);
+            ESP_LOGE(TAG, "InfluxDB POST failed: %s (attempt %u/%u)", esp_err_to_name(err), attempt, policy.max_attempts);
             result = ESP_FAIL;
             esp_http_client_close(s_client);
         }
 
-        retry_count++;
-        if (retry_count <= s_config.max_retries) {
-            ESP_LOGW(TAG, "Retrying InfluxDB request (%d/%d) in 2 seconds...", retry_count, s_config.max_retries);
-            vTaskDelay(pdMS_TO_TICKS(2000));
+        // Permanent errors (auth, 404, bad request) are not retried
+        retry_class_t cls = retry_policy_classify_http(err, s_last_status_code);
+        uint32_t delay_ms;
+        if (!retry_policy_next(&policy, attempt, cls, s_retry_after_ms, &delay_ms)) {
+            break;
         }
+        ESP_LOGW(TAG, "Retrying InfluxDB request (%u/%u) in %lu ms...", attempt + 1, policy.max_attempts, (unsigned long)delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
     }
-    
+
+    // Setup is what the prepared template saves; the rest is network time
+    ESP_LOGD(TAG, "Write: setup %lu cycles, %lld us total, stack high water %u bytes",
+             (unsigned long)setup_cycles, (long long)(esp_timer_get_time() - write_start_us),
+             (unsigned)uxTaskGetStackHighWaterMark(NULL));
+
+    free(gzip_body);
     return result;
 }
 
+esp_err_t influxdb_send_stream(http_stream_producer_t producer, void* ctx)
+{
+    if (!is_initialized || producer == NULL || s_client == NULL) {
+        ESP_LOGE(TAG, "InfluxDB client not initialized or invalid producer");
+        return ESP_FAIL;
+    }
+
+    // The gzip encoder needs the whole body, streams go out uncompressed
+    esp_err_t err = influxdb_prepare_request(false);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up InfluxDB HTTP request: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = http_stream_post(s_client, producer, ctx, &s_last_status_code);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "InfluxDB stream write failed (status %d)", s_last_status_code);
+    }
+    return err;
+}
+
 static bool influxdb_test_socket_connection(void)
 {
     ESP_LOGI(TAG, "Testing socket connection to %s:%d", s_config.server, s_config.port);
@@ -347,6 +452,9 @@ static esp_err_t influxdb_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (strcasecmp(evt->header_key, "Retry-After") == 0) {
+                s_retry_after_ms = retry_policy_parse_retry_after(evt->header_value);
+            }
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -366,6 +474,7 @@ static esp_err_t influxdb_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_REDIRECT:
             ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
+            s_url_redirected = true;
             break;
     }
     return ESP_OK;
@@ -11,7 +11,7 @@
 
 #include "../../utils/esp_utils.h"
 #include "../../config/esp32-config.h"
-#include "../../config/credentials.h"
+#include "../http/http_stream.h"
 
 #include "esp_err.h"
 #include "esp_http_client.h"
@@ -53,6 +53,7 @@ typedef struct {
     float voltage;                  ///< Sensor voltage
     float moisture_percent;         ///< Moisture percentage
     int raw_adc;                   ///< Raw ADC reading
+    uint32_t suppressed;           ///< Samples withheld before this one (field omitted if 0)
     char device_id[32];            ///< Device identifier
 } influxdb_soil_data_t;
 
@@ -100,6 +101,18 @@ int influxdb_get_last_status_code(void);
  */
 esp_err_t influxdb_send_line_protocol(const char* line_protocol);
 
+/**
+ * @brief Write line protocol pulled from a producer in one chunked request
+ *
+ * The producer returns newline-separated lines. Not retried and not
+ * compressed; the caller keeps its data until ESP_OK.
+ *
+ * @param producer Body producer
+ * @param ctx Producer context
+ * @return esp_err_t ESP_OK if the server accepted the write, error code otherwise
+ */
+esp_err_t influxdb_send_stream(http_stream_producer_t producer, void* ctx);
+
 /**
  * @brief Query whether the InfluxDB client has been initialized
  *
@@ -0,0 +1,268 @@
+/**
+ * @file influxdb_gzip.c
+ * @brief Small-footprint gzip encoder for InfluxDB request bodies - Implementation
+ */
+
+#include "influxdb_gzip.h"
+#include "../../config/esp32-config.h"
+#include "esp_rom_crc.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define GZIP_HASH_BITS      9
+#define GZIP_HASH_SIZE      (1 << GZIP_HASH_BITS)
+#define GZIP_MAX_CHAIN      8       ///< Candidates tried per position
+#define GZIP_MIN_MATCH      3
+#define GZIP_MAX_MATCH      258
+
+#if (INFLUXDB_GZIP_WINDOW & (INFLUXDB_GZIP_WINDOW - 1)) != 0 || INFLUXDB_GZIP_WINDOW > 32768
+#error "INFLUXDB_GZIP_WINDOW must be a power of two <= 32768"
+#endif
+
+// RFC 1951 3.2.5: length codes 257..285 and distance codes 0..29
+static const uint16_t s_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t s_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t s_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t s_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/**
+ * @brief LSB-first bit writer into a bounded buffer
+ */
+typedef struct {
+    uint8_t* out;
+    size_t cap;
+    size_t len;
+    uint32_t bits;
+    uint8_t nbits;
+    bool overflow;
+} bit_writer_t;
+
+/**
+ * @brief LZ77 match state (heap, freed after each call)
+ */
+typedef struct {
+    int32_t head[GZIP_HASH_SIZE];           ///< Last position per hash
+    int32_t prev[INFLUXDB_GZIP_WINDOW];     ///< Previous position with the same hash
+} match_state_t;
+
+
+
+
+// #####################################
+// MARK: Bit Writer
+// #####################################
+
+static void put_byte(bit_writer_t* bw, uint8_t byte) {
+    if (bw->len >= bw->cap) {
+        bw->overflow = true;
+        return;
+    }
+    bw->out[bw->len++] = byte;
+}
+
+static void put_bits(bit_writer_t* bw, uint32_t value, uint8_t count) {
+    bw->bits |= value << bw->nbits;
+    bw->nbits += count;
+    while (bw->nbits >= 8) {
+        put_byte(bw, (uint8_t)bw->bits);
+        bw->bits >>= 8;
+        bw->nbits -= 8;
+    }
+}
+
+static void flush_bits(bit_writer_t* bw) {
+    if (bw->nbits > 0) {
+        put_byte(bw, (uint8_t)bw->bits);
+    }
+    bw->bits = 0;
+    bw->nbits = 0;
+}
+
+/**
+ * @brief Huffman codes are packed starting with their most significant bit
+ */
+static void put_code(bit_writer_t* bw, uint32_t code, uint8_t count) {
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    put_bits(bw, reversed, count);
+}
+
+/**
+ * @brief Fixed literal/length code (RFC 1951 3.2.6)
+ */
+static void put_litlen(bit_writer_t* bw, uint16_t symbol) {
+    if (symbol <= 143) {
+        put_code(bw, 0x30 + symbol, 8);
+    } else if (symbol <= 255) {
+        put_code(bw, 0x190 + (symbol - 144), 9);
+    } else if (symbol <= 279) {
+        put_code(bw, symbol - 256, 7);
+    } else {
+        put_code(bw, 0xC0 + (symbol - 280), 8);
+    }
+}
+
+static void put_match(bit_writer_t* bw, uint16_t length, uint16_t distance) {
+    uint8_t code = 28;
+    while (s_len_base[code] > length) {
+        code--;
+    }
+    put_litlen(bw, 257 + code);
+    put_bits(bw, length - s_len_base[code], s_len_extra[code]);
+
+    code = 29;
+    while (s_dist_base[code] > distance) {
+        code--;
+    }
+    put_code(bw, code, 5);
+    put_bits(bw, distance - s_dist_base[code], s_dist_extra[code]);
+}
+
+static void put_le32(bit_writer_t* bw, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        put_byte(bw, (uint8_t)(value >> (8 * i)));
+    }
+}
+
+
+
+
+// #####################################
+// MARK: LZ77
+// #####################################
+
+static inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+static inline void insert_pos(match_state_t* ms, const uint8_t* in, int32_t pos) {
+    uint32_t h = hash3(&in[pos]);
+    ms->prev[pos & (INFLUXDB_GZIP_WINDOW - 1)] = ms->head[h];
+    ms->head[h] = pos;
+}
+
+/**
+ * @brief Longest match for pos within the window, 0 if none
+ */
+static uint16_t find_match(const match_state_t* ms, const uint8_t* in, size_t in_len,
+                           int32_t pos, uint16_t* distance) {
+    size_t max_len = in_len - (size_t)pos;
+    if (max_len > GZIP_MAX_MATCH) {
+        max_len = GZIP_MAX_MATCH;
+    }
+
+    uint16_t best = 0;
+    int32_t cand = ms->head[hash3(&in[pos])];
+    for (int chain = 0; chain < GZIP_MAX_CHAIN && cand >= 0; chain++) {
+        if (pos - cand > INFLUXDB_GZIP_WINDOW) {
+            break;
+        }
+        size_t len = 0;
+        while (len < max_len && in[cand + len] == in[pos + len]) {
+            len++;
+        }
+        if (len > best) {
+            best = (uint16_t)len;
+            *distance = (uint16_t)(pos - cand);
+            if (len == max_len) {
+                break;
+            }
+        }
+        // Slots are reused every window, stop when the chain stops going back
+        int32_t next = ms->prev[cand & (INFLUXDB_GZIP_WINDOW - 1)];
+        if (next >= cand) {
+            break;
+        }
+        cand = next;
+    }
+    return best;
+}
+
+
+
+
+// #####################################
+// MARK: Public API
+// #####################################
+
+esp_err_t influxdb_gzip_compress(const uint8_t* in, size_t in_len,
+                                 uint8_t* out, size_t out_cap, size_t* out_len) {
+    if (in == NULL || out == NULL || out_len == NULL || in_len > INT32_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    match_state_t* ms = malloc(sizeof(match_state_t));
+    if (ms == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < GZIP_HASH_SIZE; i++) {
+        ms->head[i] = -1;
+    }
+
+    bit_writer_t bw = { .out = out, .cap = out_cap };
+
+    // Member header: deflate, no flags, no mtime, unknown OS
+    static const uint8_t header[10] = { 0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0xff };
+    for (size_t i = 0; i < sizeof(header); i++) {
+        put_byte(&bw, header[i]);
+    }
+
+    // One final block with fixed codes
+    put_bits(&bw, 1, 1);
+    put_bits(&bw, 1, 2);
+
+    int32_t pos = 0;
+    while ((size_t)pos < in_len && !bw.overflow) {
+        uint16_t length = 0;
+        uint16_t distance = 0;
+        bool hashable = (size_t)pos + GZIP_MIN_MATCH <= in_len;
+
+        if (hashable) {
+            length = find_match(ms, in, in_len, pos, &distance);
+            insert_pos(ms, in, pos);
+        }
+
+        if (length >= GZIP_MIN_MATCH) {
+            put_match(&bw, length, distance);
+            for (int32_t k = 1; k < length; k++) {
+                if ((size_t)(pos + k) + GZIP_MIN_MATCH <= in_len) {
+                    insert_pos(ms, in, pos + k);
+                }
+            }
+            pos += length;
+        } else {
+            put_litlen(&bw, in[pos]);
+            pos++;
+        }
+    }
+
+    put_litlen(&bw, 256);
+    flush_bits(&bw);
+
+    // Trailer: CRC-32 and input size modulo 2^32
+    put_le32(&bw, esp_rom_crc32_le(0, in, (uint32_t)in_len));
+    put_le32(&bw, (uint32_t)in_len);
+
+    free(ms);
+
+    if (bw.overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = bw.len;
+    return ESP_OK;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file influxdb_gzip.h
+ * @brief Small-footprint gzip encoder for InfluxDB request bodies
+ *
+ * Single-block deflate with fixed Huffman codes and LZ77 over a small
+ * window (INFLUXDB_GZIP_WINDOW). Line protocol batches repeat measurement,
+ * tag and field names on every line, so this already removes most of the
+ * redundancy while needing only a few KB of temporary heap. Output is written
+ * into a caller-bounded buffer; when it would not fit, the body is not worth
+ * compressing and the caller sends it uncompressed.
+ */
+
+#ifndef INFLUXDB_GZIP_H
+#define INFLUXDB_GZIP_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Compress a buffer into a gzip member
+ *
+ * @param in Input data
+ * @param in_len Input length in bytes
+ * @param out Output buffer
+ * @param out_cap Output buffer size
+ * @param out_len Output: compressed length
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_SIZE if the output does
+ *         not fit into out_cap, ESP_ERR_NO_MEM if the match state could not be allocated
+ */
+esp_err_t influxdb_gzip_compress(const uint8_t* in, size_t in_len,
+                                 uint8_t* out, size_t out_cap, size_t* out_len);
+
+#endif // INFLUXDB_GZIP_H
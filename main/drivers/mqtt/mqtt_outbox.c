@@ -0,0 +1,251 @@
+/**
+ * @file mqtt_outbox.c
+ * @brief Fixed-capacity MQTT outbox arena - Implementation
+ */
+
+#include "mqtt_outbox.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "MQTT_OUTBOX";
+
+static mqtt_outbox_slot_t* s_slots = NULL;
+static size_t s_capacity = 0;
+static size_t s_in_use = 0;
+static size_t s_in_flight = 0;
+static size_t s_high_water = 0;
+static uint32_t s_reserve_failures = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// PUBACKs that arrived before their slot was marked in flight
+static int s_early_acks[MQTT_OUTBOX_EARLY_ACKS];
+static size_t s_early_ack_next = 0;
+
+/**
+ * @brief Free a slot (caller holds s_lock)
+ */
+static void free_slot_locked(mqtt_outbox_slot_t* slot) {
+    if (slot->state == MQTT_OUTBOX_SLOT_IN_FLIGHT) {
+        s_in_flight--;
+    }
+    slot->state = MQTT_OUTBOX_SLOT_FREE;
+    slot->msg_id = -1;
+    slot->done_cb = NULL;
+    slot->done_ctx = NULL;
+    s_in_use--;
+}
+
+/**
+ * @brief Consume a remembered early PUBACK (caller holds s_lock)
+ */
+static bool take_early_ack_locked(int msg_id) {
+    for (size_t i = 0; i < MQTT_OUTBOX_EARLY_ACKS; i++) {
+        if (s_early_acks[i] == msg_id) {
+            s_early_acks[i] = -1;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t mqtt_outbox_init(size_t slot_count) {
+    if (s_slots != NULL) {
+        return ESP_OK;
+    }
+
+    if (slot_count == 0) {
+        slot_count = MQTT_OUTBOX_DEFAULT_SLOTS;
+    }
+
+    s_slots = calloc(slot_count, sizeof(mqtt_outbox_slot_t));
+    if (s_slots == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate outbox arena (%u slots)", (unsigned)slot_count);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_capacity = slot_count;
+    s_in_use = 0;
+    s_in_flight = 0;
+    s_high_water = 0;
+    s_reserve_failures = 0;
+    mqtt_outbox_reset_session();
+
+    ESP_LOGI(TAG, "Outbox arena ready: %u slots, %u bytes",
+             (unsigned)slot_count, (unsigned)(slot_count * sizeof(mqtt_outbox_slot_t)));
+    return ESP_OK;
+}
+
+void mqtt_outbox_deinit(void) {
+    portENTER_CRITICAL(&s_lock);
+    mqtt_outbox_slot_t* slots = s_slots;
+    s_slots = NULL;
+    s_capacity = 0;
+    s_in_use = 0;
+    s_in_flight = 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    free(slots);
+}
+
+mqtt_outbox_slot_t* mqtt_outbox_reserve(void) {
+    mqtt_outbox_slot_t* slot = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_capacity; i++) {
+        if (s_slots[i].state == MQTT_OUTBOX_SLOT_FREE) {
+            slot = &s_slots[i];
+            slot->state = MQTT_OUTBOX_SLOT_RESERVED;
+            slot->payload_len = 0;
+            slot->msg_id = -1;
+            slot->qos = 0;
+            slot->retain = 0;
+            slot->persist_seq = 0;
+            slot->done_cb = NULL;
+            slot->done_ctx = NULL;
+            s_in_use++;
+            if (s_in_use > s_high_water) {
+                s_high_water = s_in_use;
+            }
+            break;
+        }
+    }
+    if (slot == NULL) {
+        s_reserve_failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (slot == NULL) {
+        ESP_LOGW(TAG, "Outbox full (%u slots in use)", (unsigned)s_capacity);
+    }
+    return slot;
+}
+
+bool mqtt_outbox_mark_in_flight(mqtt_outbox_slot_t* slot, int msg_id) {
+    if (slot == NULL) {
+        return false;
+    }
+
+    bool acked = false;
+    mqtt_outbox_done_cb_t cb = NULL;
+    void* ctx = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    if (take_early_ack_locked(msg_id)) {
+        acked = true;
+        cb = slot->done_cb;
+        ctx = slot->done_ctx;
+        free_slot_locked(slot);
+    } else {
+        slot->msg_id = msg_id;
+        slot->state = MQTT_OUTBOX_SLOT_IN_FLIGHT;
+        s_in_flight++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (acked && cb != NULL) {
+        cb(msg_id, ESP_OK, ctx);
+    }
+    return !acked;
+}
+
+void mqtt_outbox_release(mqtt_outbox_slot_t* slot) {
+    if (slot == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (slot->state != MQTT_OUTBOX_SLOT_FREE) {
+        free_slot_locked(slot);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool mqtt_outbox_complete(int msg_id, esp_err_t result) {
+    bool found = false;
+    mqtt_outbox_done_cb_t cb = NULL;
+    void* ctx = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_capacity; i++) {
+        if (s_slots[i].state == MQTT_OUTBOX_SLOT_IN_FLIGHT && s_slots[i].msg_id == msg_id) {
+            cb = s_slots[i].done_cb;
+            ctx = s_slots[i].done_ctx;
+            free_slot_locked(&s_slots[i]);
+            found = true;
+            break;
+        }
+    }
+    if (!found && result == ESP_OK) {
+        s_early_acks[s_early_ack_next] = msg_id;
+        s_early_ack_next = (s_early_ack_next + 1) % MQTT_OUTBOX_EARLY_ACKS;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (cb != NULL) {
+        cb(msg_id, result, ctx);
+    }
+    return found;
+}
+
+size_t mqtt_outbox_fail_all_in_flight(esp_err_t result, mqtt_outbox_fail_hook_t hook) {
+    size_t failed = 0;
+
+    for (;;) {
+        mqtt_outbox_slot_t* slot = NULL;
+
+        // Take one slot per lock round back into RESERVED, so the hook and
+        // callback run without the lock while nobody else can match it
+        portENTER_CRITICAL(&s_lock);
+        for (size_t i = 0; i < s_capacity; i++) {
+            if (s_slots[i].state == MQTT_OUTBOX_SLOT_IN_FLIGHT) {
+                slot = &s_slots[i];
+                slot->state = MQTT_OUTBOX_SLOT_RESERVED;
+                s_in_flight--;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (slot == NULL) {
+            break;
+        }
+        esp_err_t slot_result = (hook != NULL) ? hook(slot, result) : result;
+        if (slot->done_cb != NULL) {
+            slot->done_cb(slot->msg_id, slot_result, slot->done_ctx);
+        }
+        mqtt_outbox_release(slot);
+        failed++;
+    }
+
+    return failed;
+}
+
+void mqtt_outbox_reset_session(void) {
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < MQTT_OUTBOX_EARLY_ACKS; i++) {
+        s_early_acks[i] = -1;
+    }
+    s_early_ack_next = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+size_t mqtt_outbox_in_flight_count(void) {
+    portENTER_CRITICAL(&s_lock);
+    size_t in_flight = s_in_flight;
+    portEXIT_CRITICAL(&s_lock);
+    return in_flight;
+}
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    stats->capacity = s_capacity;
+    stats->in_use = s_in_use;
+    stats->in_flight = s_in_flight;
+    stats->high_water = s_high_water;
+    stats->reserve_failures = s_reserve_failures;
+    portEXIT_CRITICAL(&s_lock);
+}
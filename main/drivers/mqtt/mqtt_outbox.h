@@ -0,0 +1,168 @@
+/**
+ * @file mqtt_outbox.h
+ * @brief Fixed-capacity MQTT outbox arena
+ *
+ * Pre-sized pool of publish slots (topic + payload + in-flight bookkeeping)
+ * allocated once at init. Publishers reserve a slot, serialize the message
+ * directly into it and hand it to the driver. The slot is released when the
+ * broker acknowledges the message (PUBACK) or immediately for QoS 0, so
+ * building and tracking a message needs no allocation. esp-mqtt itself still
+ * copies each QoS>0 packet into its internal outbox until the PUBACK.
+ *
+ * In-flight slots double as the in-flight table: each one carries its MQTT
+ * message id and an optional completion callback, so PUBACKs are matched
+ * per message id instead of with a shared counter.
+ */
+
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MQTT_OUTBOX_TOPIC_MAX_LEN     96    ///< Max topic length incl. terminator
+#define MQTT_OUTBOX_PAYLOAD_MAX_LEN   640   ///< Max payload length incl. terminator
+#define MQTT_OUTBOX_DEFAULT_SLOTS     8     ///< Slots used when config requests 0
+#define MQTT_OUTBOX_EARLY_ACKS        4     ///< PUBACKs remembered before their slot is marked
+
+/**
+ * @brief Outbox slot state
+ */
+typedef enum {
+    MQTT_OUTBOX_SLOT_FREE = 0,      ///< Available for reservation
+    MQTT_OUTBOX_SLOT_RESERVED,      ///< Owned by a publisher, being serialized
+    MQTT_OUTBOX_SLOT_IN_FLIGHT      ///< Handed to the broker, waiting for PUBACK
+} mqtt_outbox_slot_state_t;
+
+/**
+ * @brief Per-message completion callback
+ *
+ * Called exactly once per published message, outside of any outbox lock.
+ *
+ * @param msg_id MQTT message id (0 for QoS 0)
+ * @param result ESP_OK when delivered, error code when the message was dropped
+ * @param ctx User context given at publish time
+ */
+typedef void (*mqtt_outbox_done_cb_t)(int msg_id, esp_err_t result, void* ctx);
+
+/**
+ * @brief Outbox slot
+ */
+typedef struct {
+    char topic[MQTT_OUTBOX_TOPIC_MAX_LEN];      ///< Topic (null-terminated)
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX_LEN];  ///< Payload buffer
+    size_t payload_len;                         ///< Used payload bytes
+    int msg_id;                                 ///< MQTT message id while in flight
+    uint8_t qos;                                ///< QoS the message was published with
+    uint8_t retain;                             ///< Retain flag the message was published with
+    uint32_t persist_seq;                       ///< Offline store sequence number (0 = not stored)
+    mqtt_outbox_done_cb_t done_cb;              ///< Completion callback (optional)
+    void* done_ctx;                             ///< Completion callback context
+    mqtt_outbox_slot_state_t state;             ///< Slot state
+} mqtt_outbox_slot_t;
+
+/**
+ * @brief Outbox usage statistics
+ */
+typedef struct {
+    size_t capacity;            ///< Total number of slots
+    size_t in_use;              ///< Slots currently reserved or in flight
+    size_t in_flight;           ///< Slots waiting for PUBACK
+    size_t high_water;          ///< Maximum slots in use at the same time
+    uint32_t reserve_failures;  ///< Reservations rejected because the arena was full
+} mqtt_outbox_stats_t;
+
+/**
+ * @brief Allocate the outbox arena
+ *
+ * The only allocation of the outbox. Calling it again while initialized is a no-op.
+ *
+ * @param slot_count Number of slots (0 = MQTT_OUTBOX_DEFAULT_SLOTS)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the arena cannot be allocated
+ */
+esp_err_t mqtt_outbox_init(size_t slot_count);
+
+/**
+ * @brief Free the outbox arena (all slots are dropped)
+ */
+void mqtt_outbox_deinit(void);
+
+/**
+ * @brief Reserve a free slot
+ *
+ * @return Pointer to the reserved slot, NULL if the outbox is full or not initialized
+ */
+mqtt_outbox_slot_t* mqtt_outbox_reserve(void);
+
+/**
+ * @brief Mark a reserved slot as in flight
+ *
+ * If the PUBACK for msg_id already arrived (it can overtake this call once
+ * the client has sent the message), the slot is completed right away.
+ *
+ * @param slot Slot returned by mqtt_outbox_reserve()
+ * @param msg_id MQTT message id returned by the client
+ * @return true if the slot stays in flight, false if it was already completed
+ */
+bool mqtt_outbox_mark_in_flight(mqtt_outbox_slot_t* slot, int msg_id);
+
+/**
+ * @brief Release a slot back to the arena
+ *
+ * @param slot Slot to release (NULL is ignored)
+ */
+void mqtt_outbox_release(mqtt_outbox_slot_t* slot);
+
+/**
+ * @brief Complete the in-flight slot carrying the given message id
+ *
+ * Releases the slot and invokes its completion callback. A successful
+ * completion for an unknown id is remembered for mqtt_outbox_mark_in_flight().
+ *
+ * @param msg_id MQTT message id from MQTT_EVENT_PUBLISHED / MQTT_EVENT_DELETED
+ * @param result Result passed to the completion callback
+ * @return true if a slot was completed, false if the id is unknown
+ */
+bool mqtt_outbox_complete(int msg_id, esp_err_t result);
+
+/**
+ * @brief Hook invoked for each slot failed by mqtt_outbox_fail_all_in_flight()
+ *
+ * Runs before the completion callback, outside of the outbox lock, while the
+ * slot content is still valid (e.g. to persist it for a later session).
+ * Returns the result to hand to the slot's completion callback.
+ */
+typedef esp_err_t (*mqtt_outbox_fail_hook_t)(const mqtt_outbox_slot_t* slot, esp_err_t result);
+
+/**
+ * @brief Complete every in-flight slot with an error
+ *
+ * @param result Error passed to the completion callbacks
+ * @param hook Optional hook called with each slot before it is released
+ * @return Number of slots that were failed
+ */
+size_t mqtt_outbox_fail_all_in_flight(esp_err_t result, mqtt_outbox_fail_hook_t hook);
+
+/**
+ * @brief Start a new broker session
+ *
+ * Forgets early PUBACKs of the previous session, whose message ids the
+ * client reuses. Call on every connect.
+ */
+void mqtt_outbox_reset_session(void);
+
+/**
+ * @brief Number of slots waiting for PUBACK
+ */
+size_t mqtt_outbox_in_flight_count(void);
+
+/**
+ * @brief Get outbox usage statistics
+ *
+ * @param stats Output statistics
+ */
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t* stats);
+
+#endif // MQTT_OUTBOX_H
@@ -0,0 +1,252 @@
+/**
+ * @file mqtt_persist.c
+ * @brief Flash-backed MQTT offline store - Implementation
+ */
+
+#include "mqtt_persist.h"
+#include "../nvs/nvs.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "MQTT_PERSIST";
+
+#define PERSIST_META_KEY    "meta"
+#define PERSIST_META_MAGIC  0x4d514f31u     // "MQO1"
+
+/**
+ * @brief Store metadata, saved under PERSIST_META_KEY
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t head_seq;      ///< Oldest entry that may still exist
+    uint32_t tail_seq;      ///< Next sequence number to assign
+    uint32_t dropped;       ///< Entries dropped on overflow
+} persist_meta_t;
+
+/**
+ * @brief Entry header, followed by the topic (with terminator) and the payload
+ */
+typedef struct {
+    uint8_t qos;
+    uint8_t retain;
+    uint16_t payload_len;
+} persist_entry_hdr_t;
+
+static persist_meta_t s_meta = {0};
+static size_t s_max_entries = 0;
+static SemaphoreHandle_t s_mutex = NULL;
+
+// Entry serialization buffer (static to keep it off the MQTT task stack)
+static uint8_t s_entry_buf[sizeof(persist_entry_hdr_t) + MQTT_OUTBOX_TOPIC_MAX_LEN + MQTT_OUTBOX_PAYLOAD_MAX_LEN];
+
+static void entry_key(uint32_t seq, char* key, size_t key_size) {
+    snprintf(key, key_size, "m%08lx", (unsigned long)seq);
+}
+
+static esp_err_t save_meta(void) {
+    return nvs_driver_save(MQTT_PERSIST_NAMESPACE, PERSIST_META_KEY, &s_meta, sizeof(s_meta));
+}
+
+/**
+ * @brief Move head past entries that no longer exist (caller holds s_mutex)
+ */
+static void advance_head(void) {
+    char key[16];
+    while (s_meta.head_seq < s_meta.tail_seq) {
+        entry_key(s_meta.head_seq, key, sizeof(key));
+        if (nvs_driver_key_exists(MQTT_PERSIST_NAMESPACE, key)) {
+            break;
+        }
+        s_meta.head_seq++;
+    }
+}
+
+esp_err_t mqtt_persist_init(size_t max_entries) {
+    if (s_mutex != NULL) {
+        return ESP_OK;
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_max_entries = (max_entries > 0) ? max_entries : MQTT_PERSIST_DEFAULT_MAX;
+
+    if (nvs_driver_load(MQTT_PERSIST_NAMESPACE, PERSIST_META_KEY, &s_meta, sizeof(s_meta)) != ESP_OK ||
+        s_meta.magic != PERSIST_META_MAGIC || s_meta.head_seq > s_meta.tail_seq) {
+        // Sequence numbers start at 1, 0 marks "not stored" in outbox slots
+        s_meta = (persist_meta_t){ .magic = PERSIST_META_MAGIC, .head_seq = 1, .tail_seq = 1 };
+    }
+
+    ESP_LOGI(TAG, "Offline store: %lu message(s) pending (max %u)",
+             (unsigned long)(s_meta.tail_seq - s_meta.head_seq), (unsigned)s_max_entries);
+    return ESP_OK;
+}
+
+void mqtt_persist_deinit(void) {
+    if (s_mutex != NULL) {
+        vSemaphoreDelete(s_mutex);
+        s_mutex = NULL;
+    }
+}
+
+esp_err_t mqtt_persist_append(const mqtt_outbox_slot_t* slot, uint32_t* seq) {
+    if (slot == NULL || slot->payload_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t topic_len = strnlen(slot->topic, MQTT_OUTBOX_TOPIC_MAX_LEN - 1) + 1;
+    persist_entry_hdr_t hdr = {
+        .qos = slot->qos,
+        .retain = slot->retain,
+        .payload_len = (uint16_t)slot->payload_len,
+    };
+    char key[16];
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    // Drop the oldest entry when the store is full
+    while (s_meta.tail_seq - s_meta.head_seq >= s_max_entries) {
+        entry_key(s_meta.head_seq, key, sizeof(key));
+        nvs_driver_erase_key(MQTT_PERSIST_NAMESPACE, key);
+        s_meta.head_seq++;
+        s_meta.dropped++;
+        ESP_LOGW(TAG, "Offline store full, dropped oldest message");
+    }
+
+    memcpy(s_entry_buf, &hdr, sizeof(hdr));
+    memcpy(s_entry_buf + sizeof(hdr), slot->topic, topic_len);
+    s_entry_buf[sizeof(hdr) + topic_len - 1] = '\0';
+    memcpy(s_entry_buf + sizeof(hdr) + topic_len, slot->payload, slot->payload_len);
+
+    uint32_t new_seq = s_meta.tail_seq;
+    entry_key(new_seq, key, sizeof(key));
+    esp_err_t err = nvs_driver_save(MQTT_PERSIST_NAMESPACE, key, s_entry_buf,
+                                    sizeof(hdr) + topic_len + slot->payload_len);
+    if (err == ESP_OK) {
+        s_meta.tail_seq++;
+    }
+    // Meta is saved even on failure so dropped entries stay accounted for
+    save_meta();
+
+    xSemaphoreGive(s_mutex);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Stored message #%lu for %s", (unsigned long)new_seq, slot->topic);
+        if (seq != NULL) {
+            *seq = new_seq;
+        }
+    }
+    return err;
+}
+
+bool mqtt_persist_next(uint32_t from_seq, uint32_t* seq) {
+    if (s_mutex == NULL || seq == NULL) {
+        return false;
+    }
+
+    bool found = false;
+    char key[16];
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t candidate = (from_seq > s_meta.head_seq) ? from_seq : s_meta.head_seq;
+    for (; candidate < s_meta.tail_seq; candidate++) {
+        entry_key(candidate, key, sizeof(key));
+        if (nvs_driver_key_exists(MQTT_PERSIST_NAMESPACE, key)) {
+            *seq = candidate;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+
+    return found;
+}
+
+esp_err_t mqtt_persist_load(uint32_t seq, mqtt_outbox_slot_t* slot) {
+    if (slot == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char key[16];
+    entry_key(seq, key, sizeof(key));
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    size_t size = sizeof(s_entry_buf);
+    esp_err_t err = nvs_driver_load_sized(MQTT_PERSIST_NAMESPACE, key, s_entry_buf, &size);
+
+    if (err == ESP_OK && size <= sizeof(persist_entry_hdr_t)) {
+        ESP_LOGE(TAG, "Truncated entry #%lu, discarding", (unsigned long)seq);
+        nvs_driver_erase_key(MQTT_PERSIST_NAMESPACE, key);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+
+    if (err == ESP_OK) {
+        persist_entry_hdr_t hdr;
+        memcpy(&hdr, s_entry_buf, sizeof(hdr));
+        const char* topic = (const char*)s_entry_buf + sizeof(hdr);
+        size_t topic_len = strnlen(topic, size - sizeof(hdr)) + 1;
+
+        if (topic_len > MQTT_OUTBOX_TOPIC_MAX_LEN ||
+            hdr.payload_len > MQTT_OUTBOX_PAYLOAD_MAX_LEN ||
+            sizeof(hdr) + topic_len + hdr.payload_len != size) {
+            ESP_LOGE(TAG, "Corrupt entry #%lu, discarding", (unsigned long)seq);
+            nvs_driver_erase_key(MQTT_PERSIST_NAMESPACE, key);
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            memcpy(slot->topic, topic, topic_len);
+            memcpy(slot->payload, s_entry_buf + sizeof(hdr) + topic_len, hdr.payload_len);
+            slot->payload_len = hdr.payload_len;
+            slot->qos = hdr.qos;
+            slot->retain = hdr.retain;
+            slot->persist_seq = seq;
+        }
+    }
+
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+esp_err_t mqtt_persist_remove(uint32_t seq) {
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char key[16];
+    entry_key(seq, key, sizeof(key));
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = nvs_driver_erase_key(MQTT_PERSIST_NAMESPACE, key);
+    if (err == ESP_OK && seq == s_meta.head_seq) {
+        advance_head();
+        save_meta();
+    }
+    xSemaphoreGive(s_mutex);
+
+    return err;
+}
+
+size_t mqtt_persist_count(void) {
+    return (size_t)(s_meta.tail_seq - s_meta.head_seq);
+}
+
+void mqtt_persist_get_stats(mqtt_persist_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->count = mqtt_persist_count();
+    stats->max_entries = s_max_entries;
+    stats->head_seq = s_meta.head_seq;
+    stats->tail_seq = s_meta.tail_seq;
+    stats->dropped = s_meta.dropped;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file mqtt_persist.h
+ * @brief Flash-backed MQTT offline store
+ *
+ * Log-structured store in its own NVS namespace. Every message that could not
+ * be delivered (publish failed, not connected, or still unacknowledged when
+ * the session ended) is appended under a monotonically increasing sequence
+ * number. Entries are replayed in sequence order on the next connection and
+ * removed only after their PUBACK, so QoS 1 delivery survives deep sleep and
+ * power loss. The store is bounded; when full, the oldest entry is dropped.
+ */
+
+#ifndef MQTT_PERSIST_H
+#define MQTT_PERSIST_H
+
+#include "esp_err.h"
+#include "mqtt_outbox.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MQTT_PERSIST_NAMESPACE      "mqtt_outbox"   ///< NVS namespace of the store
+#define MQTT_PERSIST_DEFAULT_MAX    32              ///< Entries kept when init requests 0
+
+/**
+ * @brief Offline store statistics
+ */
+typedef struct {
+    size_t count;               ///< Entries currently stored
+    size_t max_entries;         ///< Store bound
+    uint32_t head_seq;          ///< Oldest stored sequence number
+    uint32_t tail_seq;          ///< Next sequence number to assign
+    uint32_t dropped;           ///< Entries dropped because the store was full
+} mqtt_persist_stats_t;
+
+/**
+ * @brief Load the store metadata from NVS
+ *
+ * Requires nvs_driver_init(). Calling it again while initialized is a no-op.
+ *
+ * @param max_entries Maximum number of stored messages (0 = MQTT_PERSIST_DEFAULT_MAX)
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_persist_init(size_t max_entries);
+
+/**
+ * @brief Release the store lock; stored entries stay in NVS
+ */
+void mqtt_persist_deinit(void);
+
+/**
+ * @brief Append a message (topic, payload, qos, retain of the slot)
+ *
+ * @param slot Slot holding the message
+ * @param seq Optional output: sequence number assigned to the entry
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_persist_append(const mqtt_outbox_slot_t* slot, uint32_t* seq);
+
+/**
+ * @brief Find the first stored entry with a sequence number >= from_seq
+ *
+ * @param from_seq Sequence number to start searching at
+ * @param seq Output: sequence number of the entry found
+ * @return true if an entry was found
+ */
+bool mqtt_persist_next(uint32_t from_seq, uint32_t* seq);
+
+/**
+ * @brief Load a stored entry into an outbox slot
+ *
+ * Fills topic, payload, qos, retain and sets persist_seq.
+ *
+ * @param seq Sequence number
+ * @param slot Reserved slot to fill
+ * @return ESP_OK on success, error code if the entry is gone or corrupt
+ */
+esp_err_t mqtt_persist_load(uint32_t seq, mqtt_outbox_slot_t* slot);
+
+/**
+ * @brief Remove an entry once it has been acknowledged
+ *
+ * @param seq Sequence number
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_persist_remove(uint32_t seq);
+
+/**
+ * @brief Number of stored entries
+ */
+size_t mqtt_persist_count(void);
+
+/**
+ * @brief Get store statistics
+ *
+ * @param stats Output statistics
+ */
+void mqtt_persist_get_stats(mqtt_persist_stats_t* stats);
+
+#endif // MQTT_PERSIST_H
@@ -7,7 +7,8 @@
 #include "mqtt_client.h"
 #include "esp_log.h"
 #include "esp_event.h"
-#include "cJSON.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -17,20 +18,146 @@ static const char* TAG = "MQTT_CLIENT";
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 static mqtt_client_config_t client_config = {0};
 static bool is_connected = false;
+static bool is_started = false;      // esp_mqtt_client_start() called, esp-mqtt reconnects by itself
 static SemaphoreHandle_t connection_semaphore = NULL;
-static SemaphoreHandle_t publish_semaphore = NULL;
-static int pending_publishes = 0;
+static EventGroupHandle_t publish_events = NULL;
+
+#define PUBLISH_IDLE_BIT BIT0   ///< Set whenever the last in-flight message completes
+#define REPLAY_DONE_BIT  BIT1   ///< Set once the offline store replay of this session ended
+#define REPLAY_WINDOW    2      ///< Stored messages in flight at once, leaves slots for live traffic
+
+// Offline store replay state (only touched from the MQTT task)
+static uint32_t replay_cursor = 0;
+static int replay_in_flight = 0;
+
+static void replay_next(void);
+
+/**
+ * @brief Release live publishes once no stored message is in flight anymore
+ */
+static void replay_finish_if_idle(void) {
+    if (publish_events && replay_in_flight == 0) {
+        xEventGroupSetBits(publish_events, REPLAY_DONE_BIT);
+    }
+}
+
+/**
+ * @brief Hold a live publish until the replay ended, so stored messages go out first
+ */
+static void wait_replay_done(void) {
+    if (publish_events == NULL) {
+        return;
+    }
+    EventBits_t bits = xEventGroupWaitBits(publish_events, REPLAY_DONE_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(client_config.timeout_ms));
+    if ((bits & REPLAY_DONE_BIT) == 0) {
+        ESP_LOGW(TAG, "Replay still running, publishing anyway");
+    }
+}
+
+/**
+ * @brief Wake mqtt_client_wait_published() once nothing is in flight anymore
+ */
+static void notify_if_idle(void) {
+    if (publish_events && mqtt_outbox_in_flight_count() == 0) {
+        xEventGroupSetBits(publish_events, PUBLISH_IDLE_BIT);
+    }
+}
+
+/**
+ * @brief Store an undelivered message for the next session
+ * 
+ * @return true if the message is in the offline store
+ */
+static bool persist_slot(const mqtt_outbox_slot_t* slot) {
+    if (!client_config.persist_offline || slot->qos == 0) {
+        return false;
+    }
+    if (slot->persist_seq != 0) {
+        // Replayed message, still stored until its PUBACK
+        return true;
+    }
+    return mqtt_persist_append(slot, NULL) == ESP_OK;
+}
+
+/**
+ * @brief Outbox hook for messages still unacknowledged at disconnect
+ */
+static esp_err_t persist_fail_hook(const mqtt_outbox_slot_t* slot, esp_err_t result) {
+    return persist_slot(slot) ? ESP_ERR_NOT_FINISHED : result;
+}
+
+/**
+ * @brief Completion of a replayed message: drop it from the store on PUBACK
+ */
+static void replay_done_cb(int msg_id, esp_err_t result, void* ctx) {
+    uint32_t seq = (uint32_t)(uintptr_t)ctx;
+    if (replay_in_flight > 0) {
+        replay_in_flight--;
+    }
+    if (result == ESP_OK) {
+        ESP_LOGI(TAG, "Stored message #%lu delivered (msg_id=%d)", (unsigned long)seq, msg_id);
+        mqtt_persist_remove(seq);
+        replay_next();
+    } else {
+        replay_finish_if_idle();
+    }
+}
+
+/**
+ * @brief Publish the next stored messages in sequence order
+ */
+static void replay_next(void) {
+    if (!client_config.persist_offline || !is_connected) {
+        replay_finish_if_idle();
+        return;
+    }
+
+    while (replay_in_flight < REPLAY_WINDOW) {
+        uint32_t seq;
+        if (!mqtt_persist_next(replay_cursor, &seq)) {
+            break;
+        }
+        mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+        if (slot == NULL) {
+            break;
+        }
+        replay_cursor = seq + 1;
+        if (mqtt_persist_load(seq, slot) != ESP_OK) {
+            mqtt_outbox_release(slot);
+            continue;
+        }
+        replay_in_flight++;
+        if (mqtt_client_publish_slot_cb(slot, slot->qos, slot->retain,
+                                        replay_done_cb, (void*)(uintptr_t)seq) != ESP_OK) {
+            replay_in_flight--;
+            break;
+        }
+    }
+    // Store empty, or no progress possible without a completion
+    replay_finish_if_idle();
+}
 
 /**
  * @brief MQTT event handler
  */
 static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
+    (void)handler_args;
+    (void)base;
     esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
     
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT client connected to broker");
             is_connected = true;
+            mqtt_outbox_reset_session();
+            // Stored messages go out before anything published after connect
+            replay_cursor = 0;
+            replay_in_flight = 0;
+            if (publish_events) {
+                xEventGroupClearBits(publish_events, REPLAY_DONE_BIT);
+            }
+            replay_next();
             if (connection_semaphore) {
                 xSemaphoreGive(connection_semaphore);
             }
@@ -39,16 +166,23 @@ static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT client disconnected from broker");
             is_connected = false;
+            // Held publishes go to the offline store instead
+            if (publish_events) {
+                xEventGroupSetBits(publish_events, REPLAY_DONE_BIT);
+            }
             break;
             
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGD(TAG, "Message published successfully, msg_id=%d", event->msg_id);
-            if (pending_publishes > 0) {
-                pending_publishes--;
-            }
-            if (publish_semaphore && pending_publishes == 0) {
-                xSemaphoreGive(publish_semaphore);
-            }
+            mqtt_outbox_complete(event->msg_id, ESP_OK);
+            notify_if_idle();
+            break;
+            
+        case MQTT_EVENT_DELETED:
+            // Expired from the client's internal outbox without a PUBACK
+            ESP_LOGW(TAG, "Message dropped by client, msg_id=%d", event->msg_id);
+            mqtt_outbox_complete(event->msg_id, ESP_ERR_TIMEOUT);
+            notify_if_idle();
             break;
             
         case MQTT_EVENT_ERROR:
@@ -69,11 +203,29 @@ static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_
             break;
             
         default:
-            ESP_LOGD(TAG, "MQTT event: %ld", event_id);
+            ESP_LOGD(TAG, "MQTT event: %ld", (long)event_id);
             break;
     }
 }
 
+/**
+ * @brief Undo a partial mqtt_client_init()
+ */
+static void release_init_resources(void) {
+    if (connection_semaphore) {
+        vSemaphoreDelete(connection_semaphore);
+        connection_semaphore = NULL;
+    }
+    if (publish_events) {
+        vEventGroupDelete(publish_events);
+        publish_events = NULL;
+    }
+    if (client_config.persist_offline) {
+        mqtt_persist_deinit();
+    }
+    mqtt_outbox_deinit();
+}
+
 esp_err_t mqtt_client_init(const mqtt_client_config_t* config) {
     if (config == NULL) {
         ESP_LOGE(TAG, "Invalid configuration");
@@ -88,13 +240,29 @@ esp_err_t mqtt_client_init(const mqtt_client_config_t* config) {
     // Copy configuration
     memcpy(&client_config, config, sizeof(mqtt_client_config_t));
     
-    // Create semaphores
+    // Allocate the publish arena once, up front
+    esp_err_t ret = mqtt_outbox_init(client_config.outbox_slots);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    if (client_config.persist_offline) {
+        esp_err_t persist_ret = mqtt_persist_init(client_config.persist_max_entries);
+        if (persist_ret != ESP_OK) {
+            ESP_LOGW(TAG, "Offline store unavailable: %s", esp_err_to_name(persist_ret));
+            client_config.persist_offline = false;
+        }
+    }
+    
+    // Create semaphore and event group
     connection_semaphore = xSemaphoreCreateBinary();
-    publish_semaphore = xSemaphoreCreateBinary();
-    if (connection_semaphore == NULL || publish_semaphore == NULL) {
+    publish_events = xEventGroupCreate();
+    if (connection_semaphore == NULL || publish_events == NULL) {
         ESP_LOGE(TAG, "Failed to create semaphores");
+        release_init_resources();
         return ESP_ERR_NO_MEM;
     }
+    xEventGroupSetBits(publish_events, REPLAY_DONE_BIT);
     
     // Configure MQTT client
     esp_mqtt_client_config_t mqtt_cfg = {
@@ -116,23 +284,17 @@ esp_err_t mqtt_client_init(const mqtt_client_config_t* config) {
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (mqtt_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
-        vSemaphoreDelete(connection_semaphore);
-        vSemaphoreDelete(publish_semaphore);
-        connection_semaphore = NULL;
-        publish_semaphore = NULL;
+        release_init_resources();
         return ESP_FAIL;
     }
     
     // Register event handler
-    esp_err_t ret = esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    ret = esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register MQTT event handler: %s", esp_err_to_name(ret));
         esp_mqtt_client_destroy(mqtt_client);
         mqtt_client = NULL;
-        vSemaphoreDelete(connection_semaphore);
-        vSemaphoreDelete(publish_semaphore);
-        connection_semaphore = NULL;
-        publish_semaphore = NULL;
+        release_init_resources();
         return ret;
     }
     
@@ -145,21 +307,28 @@ esp_err_t mqtt_client_deinit(void) {
         return ESP_OK;
     }
     
-    if (is_connected) {
+    if (is_started) {
         mqtt_client_disconnect();
     }
     
     esp_err_t ret = esp_mqtt_client_destroy(mqtt_client);
     mqtt_client = NULL;
     is_connected = false;
+    is_started = false;
     
     if (connection_semaphore) {
         vSemaphoreDelete(connection_semaphore);
         connection_semaphore = NULL;
     }
-    if (publish_semaphore) {
-        vSemaphoreDelete(publish_semaphore);
-        publish_semaphore = NULL;
+    if (publish_events) {
+        vEventGroupDelete(publish_events);
+        publish_events = NULL;
+    }
+    
+    mqtt_outbox_fail_all_in_flight(ESP_ERR_INVALID_STATE, persist_fail_hook);
+    mqtt_outbox_deinit();
+    if (client_config.persist_offline) {
+        mqtt_persist_deinit();
     }
     
     ESP_LOGI(TAG, "MQTT client deinitialized");
@@ -177,11 +346,17 @@ esp_err_t mqtt_client_connect(void) {
         return ESP_OK;
     }
     
-    ESP_LOGI(TAG, "Connecting to MQTT broker: %s", client_config.broker_uri);
-    esp_err_t ret = esp_mqtt_client_start(mqtt_client);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(ret));
-        return ret;
+    if (is_started) {
+        // A previous attempt timed out, the client keeps connecting: only wait again
+        ESP_LOGI(TAG, "MQTT client already started, waiting for connection");
+    } else {
+        ESP_LOGI(TAG, "Connecting to MQTT broker: %s", client_config.broker_uri);
+        esp_err_t ret = esp_mqtt_client_start(mqtt_client);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        is_started = true;
     }
     
     // Wait for connection with timeout
@@ -194,24 +369,82 @@ esp_err_t mqtt_client_connect(void) {
     }
 }
 
-    esp_err_t mqtt_client_publish(const char* topic, const char* payload, size_t payload_len, int qos, int retain) {
-        if (mqtt_client == NULL || !is_connected) {
-            ESP_LOGE(TAG, "MQTT client not initialized or not connected");
-            return ESP_ERR_INVALID_STATE;
-        }
-        if (topic == NULL || payload == NULL || payload_len == 0) {
-            ESP_LOGE(TAG, "Invalid publish parameters");
-            return ESP_ERR_INVALID_ARG;
+esp_err_t mqtt_client_publish(const char* topic, const char* payload, size_t payload_len, int qos, int retain) {
+    if (topic == NULL || payload == NULL || payload_len == 0) {
+        ESP_LOGE(TAG, "Invalid publish parameters");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(topic) >= MQTT_OUTBOX_TOPIC_MAX_LEN || payload_len > MQTT_OUTBOX_PAYLOAD_MAX_LEN) {
+        ESP_LOGE(TAG, "Message too large for outbox slot (topic %s, %u bytes)", topic, (unsigned)payload_len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(slot->topic, topic);
+    memcpy(slot->payload, payload, payload_len);
+    slot->payload_len = payload_len;
+
+    return mqtt_client_publish_slot(slot, qos, retain);
+}
+
+esp_err_t mqtt_client_publish_slot(mqtt_outbox_slot_t* slot, int qos, int retain) {
+    return mqtt_client_publish_slot_cb(slot, qos, retain, NULL, NULL);
+}
+
+esp_err_t mqtt_client_publish_slot_cb(mqtt_outbox_slot_t* slot, int qos, int retain,
+                                      mqtt_outbox_done_cb_t done_cb, void* done_ctx) {
+    if (slot == NULL || slot->payload_len == 0) {
+        ESP_LOGE(TAG, "Invalid publish parameters");
+        mqtt_outbox_release(slot);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    slot->qos = (uint8_t)qos;
+    slot->retain = (uint8_t)retain;
+    slot->done_cb = done_cb;
+    slot->done_ctx = done_ctx;
+
+    if (done_cb != replay_done_cb && is_connected) {
+        wait_replay_done();
+    }
+
+    if (mqtt_client == NULL || !is_connected) {
+        if (persist_slot(slot)) {
+            ESP_LOGW(TAG, "Not connected, message for %s stored for replay", slot->topic);
+            mqtt_outbox_release(slot);
+            return ESP_ERR_NOT_FINISHED;
         }
-        int msg_id = esp_mqtt_client_publish(mqtt_client, topic, payload, payload_len, qos, retain);
-        if (msg_id < 0) {
-            ESP_LOGE(TAG, "Failed to publish message to topic %s", topic);
-            return ESP_FAIL;
+        ESP_LOGE(TAG, "MQTT client not initialized or not connected");
+        mqtt_outbox_release(slot);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int msg_id = esp_mqtt_client_publish(mqtt_client, slot->topic, slot->payload,
+                                         slot->payload_len, qos, retain);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish message to topic %s", slot->topic);
+        bool stored = persist_slot(slot);
+        mqtt_outbox_release(slot);
+        notify_if_idle();
+        return stored ? ESP_ERR_NOT_FINISHED : ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Published to topic: %s (msg_id=%d)", slot->topic, msg_id);
+    if (qos == 0) {
+        // No PUBACK for QoS 0, the message is done once it is written
+        mqtt_outbox_release(slot);
+        if (done_cb != NULL) {
+            done_cb(msg_id, ESP_OK, done_ctx);
         }
-        pending_publishes++;
-        ESP_LOGI(TAG, "Published to topic: %s (msg_id=%d)", topic, msg_id);
-        return ESP_OK;
+    } else if (!mqtt_outbox_mark_in_flight(slot, msg_id)) {
+        // PUBACK overtook us, the slot is already completed
+        notify_if_idle();
     }
+    return ESP_OK;
+}
 
 esp_err_t mqtt_client_disconnect(void) {
     if (mqtt_client == NULL) {
@@ -221,6 +454,15 @@ esp_err_t mqtt_client_disconnect(void) {
     ESP_LOGI(TAG, "Disconnecting from MQTT broker");
     esp_err_t ret = esp_mqtt_client_stop(mqtt_client);
     is_connected = false;
+    is_started = false;
+
+    // Anything still unacknowledged will not be delivered in this session,
+    // QoS 1/2 messages move to the offline store when enabled
+    size_t dropped = mqtt_outbox_fail_all_in_flight(ESP_ERR_INVALID_STATE, persist_fail_hook);
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "%u message(s) unacknowledged at disconnect", (unsigned)dropped);
+    }
+    notify_if_idle();
     return ret;
 }
 
@@ -229,14 +471,26 @@ bool mqtt_client_is_connected(void) {
 }
 
 esp_err_t mqtt_client_wait_published(uint32_t timeout_ms) {
-    if (pending_publishes == 0) {
+    if (publish_events == NULL) {
         return ESP_OK;
     }
-    
-    if (xSemaphoreTake(publish_semaphore, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) {
-        return ESP_OK;
-    } else {
-        ESP_LOGW(TAG, "Timeout waiting for publishes to complete (%d pending)", pending_publishes);
-        return ESP_ERR_TIMEOUT;
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    for (;;) {
+        // Clear before checking so a completion in between still wakes us
+        xEventGroupClearBits(publish_events, PUBLISH_IDLE_BIT);
+        size_t in_flight = mqtt_outbox_in_flight_count();
+        if (in_flight == 0) {
+            return ESP_OK;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            ESP_LOGW(TAG, "Timeout waiting for publishes to complete (%u pending)", (unsigned)in_flight);
+            return ESP_ERR_TIMEOUT;
+        }
+        xEventGroupWaitBits(publish_events, PUBLISH_IDLE_BIT, pdFALSE, pdTRUE, timeout - elapsed);
     }
 }
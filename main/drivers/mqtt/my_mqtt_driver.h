@@ -14,6 +14,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "mqtt_client.h"
+#include "mqtt_outbox.h"
+#include "mqtt_persist.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -33,6 +35,9 @@ typedef struct {
     int keepalive;              ///< Keep-alive interval in seconds
     int timeout_ms;             ///< Connection timeout in milliseconds
     bool use_ssl;               ///< Use SSL/TLS for connection
+    int outbox_slots;           ///< Pre-allocated outbox slots (0 = MQTT_OUTBOX_DEFAULT_SLOTS)
+    bool persist_offline;       ///< Store undeliverable QoS 1/2 messages in flash and replay them
+    int persist_max_entries;    ///< Offline store bound (0 = MQTT_PERSIST_DEFAULT_MAX)
 } mqtt_client_config_t;
 
 /**
@@ -85,7 +90,10 @@ esp_err_t mqtt_client_deinit(void);
 /**
  * @brief Connect to MQTT broker
  * 
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * Starts the client on the first call. After a timeout the client keeps
+ * reconnecting on its own, so a later call only waits for the connection.
+ * 
+ * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT if not connected within timeout_ms
  */
 esp_err_t mqtt_client_connect(void);
 
@@ -106,6 +114,9 @@ bool mqtt_client_is_connected(void);
 /**
  * @brief Publish a message to MQTT broker
  * 
+ * Copies topic and payload into an outbox slot. Prefer mqtt_client_publish_slot()
+ * with a slot from mqtt_outbox_reserve() to serialize in place without the copy.
+ * 
  * @param topic MQTT topic to publish to
  * @param payload Message payload
  * @param payload_len Length of the payload
@@ -114,9 +125,50 @@ bool mqtt_client_is_connected(void);
  */
 esp_err_t mqtt_client_publish(const char* topic, const char* payload, size_t payload_len, int qos, int retain);
 
+/**
+ * @brief Publish a message that was serialized directly into an outbox slot
+ * 
+ * Takes ownership of the slot: it is released on PUBACK (QoS 1/2), right after
+ * sending (QoS 0), or immediately on error. Returns ESP_ERR_NOT_FINISHED if
+ * the message was stored offline for replay on the next connection.
+ * 
+ * @param slot Reserved slot with topic, payload and payload_len filled in
+ * @param qos Quality of Service level (0, 1, or 2)
+ * @param retain Retain flag
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_client_publish_slot(mqtt_outbox_slot_t* slot, int qos, int retain);
+
+/**
+ * @brief Publish an outbox slot and get notified when it completes
+ * 
+ * Like mqtt_client_publish_slot(). If ESP_OK is returned, done_cb is called
+ * exactly once: with ESP_OK on PUBACK (QoS 1/2) or right after sending (QoS 0),
+ * with ESP_ERR_NOT_FINISHED if the message was moved to the offline store at
+ * disconnect, or with another error if the message is dropped.
+ * The callback may run in the MQTT task, keep it short.
+ * 
+ * With persist_offline, a QoS 1/2 message that cannot be sent now is stored
+ * for replay and ESP_ERR_NOT_FINISHED is returned (done_cb is not called).
+ * Right after a connect the call blocks (up to the connect timeout) until the
+ * stored messages are replayed, so they reach the broker first.
+ * 
+ * @param slot Reserved slot with topic, payload and payload_len filled in
+ * @param qos Quality of Service level (0, 1, or 2)
+ * @param retain Retain flag
+ * @param done_cb Completion callback (NULL = none)
+ * @param done_ctx Context passed to done_cb
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_client_publish_slot_cb(mqtt_outbox_slot_t* slot, int qos, int retain,
+                                      mqtt_outbox_done_cb_t done_cb, void* done_ctx);
+
 /**
  * @brief Wait for all pending publishes to complete
  * 
+ * Event driven: returns as soon as the last in-flight message is acknowledged
+ * (or immediately if nothing is in flight).
+ * 
  * @param timeout_ms Maximum time to wait in milliseconds
  * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT on timeout
  */
@@ -117,6 +117,32 @@ esp_err_t nvs_driver_load(const char *ns, const char *key,
     return err;
 }
 
+esp_err_t nvs_driver_load_sized(const char *ns, const char *key,
+                                void *data, size_t *size)
+{
+    if (!ns || !key || !data || !size || *size == 0) {
+        ESP_LOGE(TAG, "nvs_driver_load_sized: invalid arguments");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ns, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(TAG, "nvs_open('%s') failed: %s", ns, esp_err_to_name(err));
+        }
+        return err;
+    }
+
+    err = nvs_get_blob(handle, key, data, size);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "nvs_get_blob('%s'/'%s') failed: %s", ns, key, esp_err_to_name(err));
+    }
+
+    nvs_close(handle);
+    return err;
+}
+
 esp_err_t nvs_driver_erase_key(const char *ns, const char *key)
 {
     if (!ns || !key) {
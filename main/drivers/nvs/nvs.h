@@ -65,6 +65,21 @@ esp_err_t nvs_driver_save(const char *ns, const char *key,
 esp_err_t nvs_driver_load(const char *ns, const char *key,
                           void *data, size_t size);
 
+/**
+ * @brief Load a variable-length blob from NVS.
+ *
+ * @param ns   NVS namespace string (max 15 chars).
+ * @param key  Key string (max 15 chars).
+ * @param data Pointer to buffer that receives the data.
+ * @param size In: buffer size, out: number of bytes stored under the key.
+ * @return ESP_OK on success,
+ *         ESP_ERR_NVS_NOT_FOUND if key has never been saved,
+ *         ESP_ERR_NVS_INVALID_LENGTH if the blob is larger than the buffer,
+ *         error code otherwise.
+ */
+esp_err_t nvs_driver_load_sized(const char *ns, const char *key,
+                                void *data, size_t *size);
+
 /**
  * @brief Erase a single key from NVS.
  *
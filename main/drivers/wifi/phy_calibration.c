@@ -0,0 +1,108 @@
+/**
+ * @file phy_calibration.c
+ * @brief RF/PHY calibration scheduling across deep sleep - Implementation
+ */
+
+#include "phy_calibration.h"
+#include "../../config/esp32-config.h"
+#include "../../utils/esp_utils.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_phy_init.h"
+#include "esp_system.h"
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include <math.h>
+
+#if SOC_TEMP_SENSOR_SUPPORTED
+#include "driver/temperature_sensor.h"
+#endif // SOC_TEMP_SENSOR_SUPPORTED
+
+#if !CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE
+#warning "CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE is off, every wake calibrates fully"
+#endif
+
+static const char* TAG = "PHY_CAL";
+
+/**
+ * @brief Calibration state, survives deep sleep
+ */
+typedef struct {
+    bool valid;
+    bool pending;                   ///< The next radio start calibrates
+    uint32_t wakes_since_full;
+    uint64_t full_at_ms;            ///< System time of the last full calibration
+    float full_temp_c;              ///< Chip temperature at the last full calibration (NAN = unknown)
+    uint32_t calibrated_bringup_us; ///< Average bring-up when calibrating
+    uint32_t cached_bringup_us;     ///< Average bring-up from stored data
+} phy_cal_state_t;
+
+static RTC_DATA_ATTR phy_cal_state_t s_state;
+
+/**
+ * @brief Chip temperature, NAN where the SoC has no sensor
+ */
+static float read_temperature(void) {
+#if SOC_TEMP_SENSOR_SUPPORTED
+    temperature_sensor_handle_t sensor = NULL;
+    temperature_sensor_config_t config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+    float celsius = NAN;
+    if (temperature_sensor_install(&config, &sensor) == ESP_OK) {
+        if (temperature_sensor_enable(sensor) == ESP_OK) {
+            temperature_sensor_get_celsius(sensor, &celsius);
+            temperature_sensor_disable(sensor);
+        }
+        temperature_sensor_uninstall(sensor);
+    }
+    return celsius;
+#else
+    return NAN;
+#endif // SOC_TEMP_SENSOR_SUPPORTED
+}
+
+bool phy_calibration_prepare(void) {
+    uint64_t now_ms = esp_utils_get_timestamp_ms();
+    float temp_c = read_temperature();
+
+    const char* reason = NULL;
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP || !s_state.valid) {
+        // The PHY runs its own calibration check outside deep-sleep wakes
+        reason = "boot";
+    } else if (++s_state.wakes_since_full >= PHY_CAL_FULL_EVERY_WAKES) {
+        reason = "wake count";
+    } else if (now_ms < s_state.full_at_ms ||
+               now_ms - s_state.full_at_ms >= (uint64_t)PHY_CAL_FULL_INTERVAL_SECONDS * 1000ULL) {
+        reason = "interval";
+    } else if (!isnan(temp_c) && !isnan(s_state.full_temp_c) &&
+               fabsf(temp_c - s_state.full_temp_c) >= PHY_CAL_TEMP_DELTA_C) {
+        reason = "temperature";
+    }
+
+    if (reason != NULL) {
+        if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+            // Without stored data the next radio init calibrates fully and stores the result
+            esp_err_t err = esp_phy_erase_cal_data_in_nvs();
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to erase calibration data: %s", esp_err_to_name(err));
+            }
+        }
+        s_state.valid = true;
+        s_state.pending = true;
+        s_state.wakes_since_full = 0;
+        s_state.full_at_ms = now_ms;
+        s_state.full_temp_c = temp_c;
+        ESP_LOGI(TAG, "Calibrating (%s), %.1f C", reason, temp_c);
+    }
+    return s_state.pending;
+}
+
+void phy_calibration_record_bringup(uint32_t bringup_us) {
+    // A wake without radio leaves the calibration to the next one that starts it
+    bool calibrated = s_state.pending;
+    s_state.pending = false;
+    uint32_t* average = calibrated ? &s_state.calibrated_bringup_us : &s_state.cached_bringup_us;
+    *average = (*average == 0) ? bringup_us : (*average * 7 + bringup_us) / 8;
+    ESP_LOGI(TAG, "Radio bring-up %lu us (%s); average calibrating %lu us, from stored data %lu us",
+             (unsigned long)bringup_us, calibrated ? "calibrating" : "stored data",
+             (unsigned long)s_state.calibrated_bringup_us, (unsigned long)s_state.cached_bringup_us);
+}
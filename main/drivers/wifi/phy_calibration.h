@@ -0,0 +1,41 @@
+/**
+ * @file phy_calibration.h
+ * @brief RF/PHY calibration scheduling across deep sleep
+ *
+ * With CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE the PHY calibration data
+ * is kept in NVS and a deep-sleep wake starts the radio from it without
+ * calibrating. This module forces a full recalibration on a schedule
+ * (every PHY_CAL_FULL_EVERY_WAKES wakes or PHY_CAL_FULL_INTERVAL_SECONDS)
+ * or when the chip temperature moved by PHY_CAL_TEMP_DELTA_C, by erasing the
+ * stored data before the radio starts. It also keeps the average radio
+ * bring-up time of both cases in RTC memory for comparison.
+ */
+
+#ifndef PHY_CALIBRATION_H
+#define PHY_CALIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Decide the calibration of this wake
+ *
+ * Call after nvs_driver_init() and before the first WiFi/ESP-NOW init.
+ * A calibration decided on a wake that does not start the radio is done by
+ * the next wake that does.
+ *
+ * @return true when the next radio start calibrates (full after deep sleep,
+ *         the PHY's own check after other resets)
+ */
+bool phy_calibration_prepare(void);
+
+/**
+ * @brief Record the radio bring-up time of this wake
+ *
+ * Call once per wake that started the radio.
+ *
+ * @param bringup_us Time from the start of the radio init until it is ready
+ */
+void phy_calibration_record_bringup(uint32_t bringup_us);
+
+#endif // PHY_CALIBRATION_H
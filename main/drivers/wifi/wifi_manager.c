@@ -5,6 +5,7 @@
 
 #include "../../config/esp32-config.h"
 #include "wifi_manager.h"
+#include "../../utils/wake_profiler.h"
 
 #include <string.h>
 #include "nvs_flash.h"
@@ -103,7 +104,9 @@ esp_err_t wifi_manager_connect(void)
     // Set WiFi mode and configuration
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    wake_profiler_mark("wifi_start");
     ESP_ERROR_CHECK(esp_wifi_start());
+    wake_profiler_mark("wifi_started");
     
     update_status(WIFI_STATUS_CONNECTING, NULL);
 
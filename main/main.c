@@ -9,12 +9,16 @@
 #include "esp_log.h"
 #include "esp_system.h" // For esp_reset_reason()
 #include "esp_sleep.h"
+#include "esp_attr.h"
 #include "application/battery_monitor.h"
 #include "drivers/csm_v2_driver/csm_v2_driver.h"
 #include "drivers/wifi/wifi_manager.h"
+#include "drivers/wifi/phy_calibration.h"
 #include "drivers/nvs/nvs.h"
 #include "utils/esp_utils.h"
 #include "utils/ntp_time.h"
+#include "utils/wake_profiler.h"
+#include "utils/time_sync.h"
 #include "esp_mac.h"
 #include "config/esp32-config.h"
 #include "esp_err.h"
@@ -30,13 +34,34 @@
 #if USE_MQTT
 #include "drivers/mqtt/my_mqtt_driver.h"
 #include "application/mqtt_sender.h"
+#include "application/mqtt_sender_task.h"
 #endif // USE_MQTT
 
 #if USE_INFLUXDB
 #include "drivers/influxdb/influxdb_client.h"
-#include "application/influxdb_sender.h"
+#include "application/influx_sender_task.h"
 #endif // USE_INFLUXDB
 
+#if USE_HTTP
+#include "drivers/http/http_client.h"
+#endif // USE_HTTP
+
+#include "application/telemetry_pipeline.h"
+#include "application/telemetry_sinks.h"
+#include "application/report_policy.h"
+
+#if ADAPTIVE_SLEEP_ENABLED
+#include "application/adaptive_sleep.h"
+#endif // ADAPTIVE_SLEEP_ENABLED
+
+#if WAKE_STUB_ENABLED
+#include "application/wake_stub.h"
+#endif // WAKE_STUB_ENABLED
+
+#if ULP_SAMPLER_ENABLED
+#include "drivers/adc/ulp_sampler.h"
+#endif // ULP_SAMPLER_ENABLED
+
 typedef struct {
     char device_id[32];
     uint8_t espnow_hub_mac[6];
@@ -50,10 +75,17 @@ typedef struct {
 static const char *TAG = "MAIN";
 static bool is_first_boot = false;
 static bool battery_is_dead = false;
+static RTC_DATA_ATTR uint32_t wake_count = 0;
 
 #define MEASUREMENT_TASK_STACK_SIZE 8192
 #define MEASUREMENT_TASK_PRIORITY   5
-#define USE_WIFI                    (USE_MQTT || USE_INFLUXDB) // WiFi is needed if either MQTT or InfluxDB is used
+#define USE_WIFI                    (USE_MQTT || USE_INFLUXDB || USE_HTTP) // WiFi is needed if MQTT, InfluxDB or HTTP is used
+#define USE_SLEEP_BACKLOG           (WAKE_STUB_ENABLED || ULP_SAMPLER_ENABLED) // Readings are taken while the main CPU sleeps
+#define SLEEP_BACKLOG_MAX           (WAKE_STUB_ENABLED ? WAKE_STUB_RING_LEN : ULP_SAMPLER_RING_LEN)
+
+#if WAKE_STUB_ENABLED && ULP_SAMPLER_ENABLED
+#error "WAKE_STUB_ENABLED and ULP_SAMPLER_ENABLED are alternatives, enable only one"
+#endif
 
 
 // Static initial application configuration (is loaded/saved from NVS)
@@ -66,6 +98,225 @@ static app_config_t app_config = {
 
 
 
+#if USE_SLEEP_BACKLOG
+// MARK: Sleep Backlog
+/**
+ * @brief Reading taken while the main CPU slept
+ */
+typedef struct {
+    uint32_t age_s;                 ///< Seconds before this wake
+    int soil_raw;                   ///< Raw soil ADC reading
+    int battery_raw;                ///< Raw battery ADC reading, -1 if not sampled
+} sleep_reading_t;
+
+static sleep_reading_t s_backlog[SLEEP_BACKLOG_MAX];
+static size_t s_backlog_count = 0;
+#if WAKE_STUB_ENABLED
+static size_t s_stub_peeked = 0;        ///< Stub readings copied, dropped from RTC memory once submitted
+#endif // WAKE_STUB_ENABLED
+
+/**
+ * @brief Copy the readings buffered during sleep out of RTC memory
+ *
+ * Runs before the drivers are initialized: the ULP owns ADC1 and the probe
+ * pin until its buffer is taken. Readings of this wake are skipped, the full
+ * measurement supersedes them. The stub's ring is only peeked here and
+ * emptied by submit_sleep_backlog().
+ */
+static void collect_sleep_backlog(void) {
+#if WAKE_STUB_ENABLED
+    wake_stub_sample_t raw[WAKE_STUB_RING_LEN];
+    uint32_t wake_seq = wake_stub_get_wake_seq();
+    size_t count = wake_stub_peek(raw, WAKE_STUB_RING_LEN);
+    s_stub_peeked = count;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t age_wakes = wake_seq - raw[i].wake_seq;
+        if (age_wakes > 0) {
+            s_backlog[s_backlog_count].age_s = age_wakes * WAKE_STUB_INTERVAL_SECONDS;
+            s_backlog[s_backlog_count].soil_raw = raw[i].raw_adc;
+            s_backlog[s_backlog_count].battery_raw = -1;
+            s_backlog_count++;
+        }
+    }
+#else
+    ulp_sampler_reading_t raw[ULP_SAMPLER_RING_LEN];
+    size_t count = ulp_sampler_take(raw, ULP_SAMPLER_RING_LEN);
+    for (size_t i = 0; i + 1 < count; i++) {
+        // The last reading triggered this wake
+        s_backlog[s_backlog_count].age_s = (uint32_t)(count - 1 - i) * (ULP_SAMPLER_PERIOD_MS / 1000);
+        s_backlog[s_backlog_count].soil_raw = raw[i].soil_raw;
+        s_backlog[s_backlog_count].battery_raw = raw[i].battery_raw;
+        s_backlog_count++;
+    }
+#endif // WAKE_STUB_ENABLED
+    ESP_LOGI(TAG, "Collected %u reading(s) taken during sleep", (unsigned)s_backlog_count);
+}
+
+/**
+ * @brief Submit the readings taken during sleep
+ *
+ * Only raw values are available: soil voltage is scaled with the ratio of
+ * the fresh calibrated reading, missing battery values are taken from this
+ * wake. Timestamps are reconstructed from the sampling interval. Without a
+ * time sync the stub's readings stay in RTC memory for the next upload.
+ */
+static void submit_sleep_backlog(const telemetry_sample_t* current) {
+    if (current->timestamp_ms == 0) {
+        if (s_backlog_count > 0) {
+#if WAKE_STUB_ENABLED
+            ESP_LOGW(TAG, "No time sync, keeping %u reading(s) taken during sleep", (unsigned)s_backlog_count);
+#else
+            ESP_LOGW(TAG, "No time sync, dropping %u reading(s) taken during sleep", (unsigned)s_backlog_count);
+#endif // WAKE_STUB_ENABLED
+        }
+        return;
+    }
+#if WAKE_STUB_ENABLED
+    // Includes the reading of this wake, superseded by the full measurement
+    wake_stub_consume(s_stub_peeked);
+    s_stub_peeked = 0;
+#endif // WAKE_STUB_ENABLED
+    if (s_backlog_count == 0) {
+        return;
+    }
+
+    float volts_per_raw = (current->soil_raw_adc > 0)
+        ? current->soil_voltage / current->soil_raw_adc
+        : SOIL_ADC_VREF / 4095.0f;
+
+    for (size_t i = 0; i < s_backlog_count; i++) {
+        const sleep_reading_t* reading = &s_backlog[i];
+        telemetry_sample_t sample = *current;
+        sample.timestamp_ms = current->timestamp_ms - (uint64_t)reading->age_s * 1000ULL;
+        sample.soil_raw_adc = reading->soil_raw;
+        sample.soil_voltage = reading->soil_raw * volts_per_raw;
+        sample.moisture_percent = csm_v2_voltage_to_percent(sample.soil_voltage);
+        sample.suppressed = 0;
+        sample.has_model = false;       // The receiver's model steps on live samples only
+        sample.backlog = true;          // Batching sinks send these together with the live sample
+        if (reading->battery_raw >= 0) {
+            sample.battery_voltage = reading->battery_raw * BATTERY_ADC_VREF / 4095.0f * BATTERY_MONITOR_VOLTAGE_SCALE_FACTOR;
+            sample.battery_percent = ((sample.battery_voltage - BATTERY_MONITOR_LOW_VOLTAGE_THRESHOLD) /
+                                      (BATTERY_MONITOR_HIGH_VOLTAGE - BATTERY_MONITOR_LOW_VOLTAGE_THRESHOLD)) * 100.0f;
+        }
+        telemetry_pipeline_submit(&sample);
+
+        // Sink queues are short, let them drain between groups
+        if ((i + 1) % TELEMETRY_SINK_DEFAULT_QUEUE == 0) {
+            telemetry_pipeline_wait_idle(telemetry_pipeline_remaining_ms());
+        }
+    }
+    ESP_LOGI(TAG, "Submitted %u reading(s) taken during sleep", (unsigned)s_backlog_count);
+    s_backlog_count = 0;
+}
+#endif // USE_SLEEP_BACKLOG
+
+
+
+
+// MARK: Network
+/**
+ * @brief Bring up the radio and the network clients
+ *
+ * Only runs on wakes that send: a withheld sample never starts the radio.
+ */
+static void network_init(void) {
+    // Decide on RF calibration before the first radio start
+#if USE_WIFI || USE_ESPNOW
+    phy_calibration_prepare();
+#endif // USE_WIFI || USE_ESPNOW
+
+
+    // Initialize WiFi 
+#if USE_WIFI
+    ESP_LOGI(TAG, "Initializing WiFi...");
+    wifi_manager_config_t wifi_config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASSWORD,
+        .max_retry = WIFI_MAX_RETRY,
+    };
+    wifi_manager_init(&wifi_config, NULL);
+#endif // USE_WIFI
+
+    // Initialize ESP-NOW
+#if USE_ESPNOW
+    espnow_sender_config_t espnow_config = {
+        .hub_mac = {0},
+        .start_channel = app_config.wifi_current_channel,
+        .max_retries = 3,
+        .retry_delay_ms = 200,
+        .ack_timeout_ms = 500
+    };
+    strncpy((char*)espnow_config.hub_mac, (char*)app_config.espnow_hub_mac, 6);
+
+    if (USE_WIFI) {
+        espnow_sender_init_on_existing_wifi(&espnow_config, app_config.wifi_current_channel);
+    } else {
+        // If WiFi is not used, initialize ESP-NOW sender which also initializes WiFi in STA mode
+        espnow_sender_init(&espnow_config, app_config.wifi_current_channel, 0);
+    }
+#endif // USE_ESPNOW
+
+
+    // Initialize MQTT client
+#if USE_MQTT
+    mqtt_client_config_t mqtt_config = {
+        .broker_uri = MQTT_BROKER_URI,
+        .username = MQTT_USERNAME,
+        .password = MQTT_PASSWORD,
+        .client_id = {0},
+        .base_topic = MQTT_BASE_TOPIC,
+        .keepalive = 60,
+        .timeout_ms = 5000,
+        .use_ssl = MQTT_USE_SSL,
+        .outbox_slots = MQTT_OUTBOX_SLOTS,
+        .persist_offline = MQTT_PERSIST_OFFLINE,
+        .persist_max_entries = MQTT_PERSIST_MAX_ENTRIES,
+    };
+    mqtt_client_init(&mqtt_config);
+
+    // Serves discovery and per-metric telemetry for the MQTT sink. Not torn
+    // down before sleep: deep sleep resets it anyway
+    mqtt_sender_task_init();
+#endif // USE_MQTT
+
+#if USE_INFLUXDB
+    // Initialize InfluxDB client
+    influxdb_client_config_t influxdb_config = {
+        .server = INFLUXDB_SERVER,
+        .port = INFLUXDB_PORT,
+        .bucket = INFLUXDB_BUCKET,
+        .org = INFLUXDB_ORG,
+        .token = INFLUXDB_TOKEN,
+        .endpoint = INFLUXDB_ENDPOINT,
+        .timeout_ms = 10000,
+        .max_retries = 3
+    };
+    influxdb_client_init(&influxdb_config);
+
+    // Batches the sink's points into one POST per wake
+    influx_sender_init(NULL);
+#endif // USE_INFLUXDB
+
+#if USE_HTTP
+    // Initialize HTTP client, also opens the offline buffer
+    http_client_config_t http_config = {
+        .server_ip = HTTP_SERVER_IP,
+        .server_port = HTTP_SERVER_PORT,
+        .endpoint = HTTP_ENDPOINT,
+        .timeout_ms = HTTP_TIMEOUT_MS,
+        .max_retries = HTTP_MAX_RETRIES,
+        .enable_buffering = HTTP_ENABLE_BUFFERING,
+        .max_buffered_packets = HTTP_MAX_BUFFERED_PACKETS,
+    };
+    strncpy(http_config.device_id, app_config.device_id, sizeof(http_config.device_id) - 1);
+    http_client_init(&http_config);
+#endif // USE_HTTP
+}
+
+
+
+
 // MARK: Measurement Task
 /**
  * @brief Measurement task - handles battery monitoring, WiFi, data transmission
@@ -86,6 +337,7 @@ static void measurement_task(void* pvParameters) {
     // Check if this is a deep sleep wakeup
     esp_sleep_wakeup_cause_t wake_cause = esp_sleep_get_wakeup_cause();
     esp_reset_reason_t reset_reason = esp_reset_reason();
+    wake_count++;
 
     if (wake_cause == ESP_SLEEP_WAKEUP_TIMER) {
         ESP_LOGI("BOOT", "Woke up from deep sleep timer");
@@ -106,6 +358,17 @@ static void measurement_task(void* pvParameters) {
 
     printf(is_first_boot ? "First boot detected" : "Wakeup from deep sleep detected");
 
+#if WAKE_STUB_ENABLED
+    ESP_LOGI("BOOT", "Wake stub boot reason: %d (stub wake %lu)",
+             wake_stub_get_boot_reason(), (unsigned long)wake_stub_get_wake_seq());
+#endif // WAKE_STUB_ENABLED
+#if ULP_SAMPLER_ENABLED
+    ESP_LOGI("BOOT", "ULP wake reason: %d", ulp_sampler_get_wake_reason());
+#endif // ULP_SAMPLER_ENABLED
+#if USE_SLEEP_BACKLOG
+    collect_sleep_backlog();
+#endif // USE_SLEEP_BACKLOG
+
     if (is_first_boot) {
         ESP_LOGI(TAG, "Performing first boot initialization...");
 
@@ -158,68 +421,6 @@ static void measurement_task(void* pvParameters) {
     battery_monitor_init();
 
 
-    // Initialize WiFi 
-#if USE_WIFI
-    ESP_LOGI(TAG, "Initializing WiFi...");
-    wifi_manager_config_t wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-        .max_retry = WIFI_MAX_RETRY,
-    };
-    wifi_manager_init(&wifi_config, NULL);
-#endif // USE_WIFI
-
-    // Initialize ESP-NOW
-#if USE_ESPNOW
-    espnow_sender_config_t espnow_config = {
-        .hub_mac = {0},
-        .start_channel = app_config.wifi_current_channel,
-        .max_retries = 3,
-        .retry_delay_ms = 200,
-        .ack_timeout_ms = 500
-    };
-    strncpy((char*)espnow_config.hub_mac, (char*)app_config.espnow_hub_mac, 6);
-
-    if (USE_WIFI) {
-        espnow_sender_init_on_existing_wifi(&espnow_config, app_config.wifi_current_channel);
-    } else {
-        // If WiFi is not used, initialize ESP-NOW sender which also initializes WiFi in STA mode
-        espnow_sender_init(&espnow_config, app_config.wifi_current_channel, 0);
-    }
-#endif // USE_ESPNOW
-
-
-    // Initialize MQTT client
-#if USE_MQTT
-    mqtt_client_config_t mqtt_config = {
-        .broker_uri = MQTT_BROKER_URI,
-        .username = MQTT_USERNAME,
-        .password = MQTT_PASSWORD,
-        .client_id = {0},
-        .base_topic = MQTT_BASE_TOPIC,
-        .keepalive = 60,
-        .timeout_ms = 5000,
-        .use_ssl = MQTT_USE_SSL,
-    };
-    mqtt_client_init(&mqtt_config);
-#endif // USE_MQTT
-
-#if USE_INFLUXDB
-    // Initialize InfluxDB client
-    influxdb_client_config_t influxdb_config = {
-        .server = INFLUXDB_SERVER,
-        .port = INFLUXDB_PORT,
-        .bucket = INFLUXDB_BUCKET,
-        .org = INFLUXDB_ORG,
-        .token = INFLUXDB_TOKEN,
-        .endpoint = INFLUXDB_ENDPOINT,
-        .timeout_ms = 10000,
-        .max_retries = 3
-    };
-    influxdb_client_init(&influxdb_config);
-#endif // USE_INFLUXDB
-
-
 
     // ######################################################
     // MARK: Main Measurement Loop
@@ -294,10 +495,37 @@ static void measurement_task(void* pvParameters) {
     // MARK: Wait for Data to be Sent
     // ######################################################
  
+    // One sample for all transports, each sink encodes it for its wire format
+    telemetry_sample_t sample = {
+        .soil_voltage = soil_reading_mean.voltage,
+        .moisture_percent = soil_reading_mean.moisture_percent,
+        .soil_raw_adc = soil_reading_mean.raw_adc,
+        .battery_voltage = battery_voltage_mean.voltage,
+        .battery_percent = battery_voltage_mean.percentage,
+    };
+    strncpy(sample.device_id, app_config.device_id, sizeof(sample.device_id) - 1);
+
+    // Decide before touching the radio: a withheld sample costs no WiFi at all
+#if REPORT_POLICY_ENABLED
+    report_policy_decision_t decision = report_policy_evaluate(&sample);
+#else
+    report_policy_decision_t decision = REPORT_POLICY_HEARTBEAT;   // Report every sample
+#endif // REPORT_POLICY_ENABLED
+#if USE_SLEEP_BACKLOG
+    if (decision == REPORT_POLICY_SKIP && s_backlog_count > 0) {
+        decision = REPORT_POLICY_BACKLOG;
+    }
+#endif // USE_SLEEP_BACKLOG
+    ESP_LOGI(TAG, "Report policy: %s (%lu withheld before)",
+             report_policy_decision_to_string(decision), (unsigned long)report_policy_suppressed_count());
+
     if (battery_is_dead) {
         ESP_LOGW(TAG, "Battery is too low. Skipping data transmission and entering deep sleep to save power.");
+    } else if (decision == REPORT_POLICY_SKIP) {
+        ESP_LOGI(TAG, "No significant change, skipping data transmission.");
+        report_policy_record(&sample, decision, false);
     } else {
-
+        network_init();
 
 #if USE_WIFI
         wifi_manager_connect();
@@ -310,38 +538,63 @@ static void measurement_task(void* pvParameters) {
 #endif // USE_WIFI
 
         // Get current timestamp, if NTP not synced, returns 0
-        uint64_t timestamp_ms = ntp_time_get_timestamp_ms();
-
-        // Send data via ESP-NOW
+        sample.timestamp_ms = ntp_time_get_timestamp_ms();
 #if USE_ESPNOW
-        espnow_sensor_data_t espnow_data;
-        espnow_sender_build_packet(&espnow_data,
-            app_config.device_id,
-            timestamp_ms,
-            soil_reading_mean.voltage,
-            soil_reading_mean.moisture_percent,
-            soil_reading_mean.raw_adc,
-            battery_voltage_mean.voltage,
-            battery_voltage_mean.percentage);
+        if (sample.timestamp_ms == 0) {
+            // No NTP: clock set from the hub's last ACK, 0 until the first one
+            sample.timestamp_ms = time_sync_get_timestamp_ms();
+        }
+#endif // USE_ESPNOW
+        report_policy_prepare(&sample);
 
+        telemetry_pipeline_init();
+
+#if USE_ESPNOW
         // Check if in discovery mode (hub MAC is broadcast address)
         bool is_discovery_mode = espnow_sender_is_broadcast_mac(app_config.espnow_hub_mac);
-
-        uint8_t ack_responder_mac[6] = {0};
         uint8_t previous_channel = app_config.wifi_current_channel;
-        
-        espnow_sender_status_t send_status = espnow_sender_send_data(&espnow_data, 
-                                                                     &app_config.wifi_current_channel,
-                                                                     ack_responder_mac);
-        
-        if (send_status == ESPNOW_SENDER_OK) {
+
+        static telemetry_espnow_ctx_t espnow_ctx;
+        espnow_ctx.channel = &app_config.wifi_current_channel;
+        telemetry_sink_register_espnow(&espnow_ctx);
+#endif // USE_ESPNOW
+
+#if USE_MQTT
+        static telemetry_mqtt_ctx_t mqtt_ctx;
+        mqtt_ctx.wake_count = wake_count;
+        mqtt_ctx.reset_reason = reset_reason;
+        telemetry_sink_register_mqtt(&mqtt_ctx);
+#endif // USE_MQTT
+
+#if USE_INFLUXDB
+        telemetry_sink_register_influxdb();
+#endif // USE_INFLUXDB
+
+#if USE_HTTP
+        telemetry_sink_register_http();
+#endif // USE_HTTP
+
+        // Sinks run their sessions concurrently on the shared WiFi connection:
+        // the network phase takes max(sink) instead of sum(sink), bounded by
+        // a single deadline
+        telemetry_pipeline_set_deadline(TELEMETRY_SEND_TIMEOUT_MS);
+#if USE_SLEEP_BACKLOG
+        submit_sleep_backlog(&sample);
+#endif // USE_SLEEP_BACKLOG
+        telemetry_pipeline_submit(&sample);
+        telemetry_pipeline_wait_idle(telemetry_pipeline_remaining_ms());
+        telemetry_pipeline_log_stats();
+        report_policy_record(&sample, decision, telemetry_pipeline_all_delivered());
+
+#if USE_ESPNOW
+        if (espnow_ctx.last_status == ESPNOW_SENDER_OK) {
             ESP_LOGI(TAG, "Data sent successfully via ESP-NOW on channel %d", 
                     app_config.wifi_current_channel);
             
             // In discovery mode, save the discovered hub MAC (if valid)
-            if (is_discovery_mode && espnow_sender_is_mac_valid(ack_responder_mac)) {
-                memcpy(app_config.espnow_hub_mac, ack_responder_mac, 6);
-                ESP_LOGI(TAG, "Hub discovered: " MACSTR, MAC2STR(ack_responder_mac));
+            if (is_discovery_mode && espnow_sender_is_mac_valid(espnow_ctx.responder_mac)) {
+                memcpy(app_config.espnow_hub_mac, espnow_ctx.responder_mac, 6);
+                ESP_LOGI(TAG, "Hub discovered: " MACSTR, MAC2STR(espnow_ctx.responder_mac));
             }
             
             // Save config if channel changed OR hub was discovered
@@ -351,65 +604,20 @@ static void measurement_task(void* pvParameters) {
                         app_config.wifi_current_channel, MAC2STR(app_config.espnow_hub_mac));
             }
         } else {
-            ESP_LOGE(TAG, "Failed to send data via ESP-NOW: %d", send_status);
+            ESP_LOGE(TAG, "Failed to send data via ESP-NOW: %d", espnow_ctx.last_status);
         }
 #endif // USE_ESPNOW
 
-#if USE_MQTT
-        mqtt_client_connect();
-
-        if (is_first_boot) {
-            mqtt_publish_soil_sensor_homeassistant_discovery(app_config.device_id);
-        }
-
-        mqtt_battery_data_t mqtt_bdata = {
-            .timestamp_ms = timestamp_ms,
-            .voltage = battery_voltage_mean.voltage,
-            .percentage = battery_voltage_mean.percentage,
-        };
-        strncpy(mqtt_bdata.device_id, app_config.device_id, sizeof(mqtt_bdata.device_id) - 1);
-        mqtt_publish_battery_data(&mqtt_bdata);
-
-        mqtt_soil_data_t mqtt_sdata = {
-            .timestamp_ms = timestamp_ms,
-            .voltage = soil_reading_mean.voltage,
-            .moisture_percent = soil_reading_mean.moisture_percent,
-            .raw_adc = soil_reading_mean.raw_adc,
-        };
-        strncpy(mqtt_sdata.device_id, app_config.device_id, sizeof(mqtt_sdata.device_id) - 1);
-        mqtt_publish_soil_data(&mqtt_sdata);
-
-        mqtt_sdata.voltage = soil_reading_mean.voltage;
-        mqtt_sdata.moisture_percent = soil_reading_mean.moisture_percent;
-        mqtt_sdata.raw_adc = soil_reading_mean.raw_adc;
-        strncpy(mqtt_sdata.device_id, app_config.device_id, sizeof(mqtt_sdata.device_id) - 1);
-        mqtt_publish_soil_data(&mqtt_sdata);
-
-        mqtt_client_wait_published(5000);  // Wait up to 5 seconds for messages to be published
-        mqtt_client_disconnect();
-#endif // USE_MQTT
-
-#if USE_INFLUXDB
-        influxdb_battery_data_t influx_bdata = {
-            .timestamp_ns = timestamp_ms * 1000000ULL, // Convert ms to ns
-            .voltage = battery_voltage_mean.voltage,
-            .percentage = battery_voltage_mean.percentage,
-        };
-        strncpy(influx_bdata.device_id, app_config.device_id, sizeof(influx_bdata.device_id) - 1);
-        influxdb_write_battery_data(&influx_bdata);
-
-        influxdb_soil_data_t influx_sdata = {
-            .timestamp_ns = timestamp_ms * 1000000ULL, // Convert ms to ns
-            .voltage = soil_reading_mean.voltage,
-            .moisture_percent = soil_reading_mean.moisture_percent,
-            .raw_adc = soil_reading_mean.raw_adc
-        };
-        strncpy(influx_sdata.device_id, app_config.device_id, sizeof(influx_sdata.device_id) - 1);
-        influxdb_write_soil_data(&influx_sdata);
-#endif // USE_INFLUXDB
+        // Stops the sink tasks and closes their sessions (MQTT disconnect)
+        esp_err_t pipeline_ret = telemetry_pipeline_deinit();
 
 #if USE_WIFI
-        wifi_manager_disconnect();      
+        // A sink still sending keeps its connection; deep sleep ends it
+        if (pipeline_ret == ESP_OK) {
+            wifi_manager_disconnect();
+        }
+#else
+        (void)pipeline_ret;
 #endif // USE_WIFI
 
 
@@ -424,18 +632,55 @@ static void measurement_task(void* pvParameters) {
     
 
 
+#if USE_WIFI || USE_ESPNOW
+    // Wakes that kept the radio off have no bring-up to record
+    uint32_t radio_bringup_us = wake_profiler_span_us("wifi_start", "wifi_started");
+    if (radio_bringup_us > 0) {
+        phy_calibration_record_bringup(radio_bringup_us);
+    }
+#endif // USE_WIFI || USE_ESPNOW
+    wake_profiler_log();
+
     // Check if deep sleep is enabled
     if (DEEP_SLEEP_ENABLED || battery_is_dead) {
         ESP_LOGI(TAG, "Preparing for deep sleep...");
         
         // Configure timer wakeup
-        uint64_t sleep_time_us = (uint64_t)DEEP_SLEEP_DURATION_SECONDS * 1000000ULL;
+#if WAKE_STUB_ENABLED
+        // The stub samples every interval and boots us once per upload
+        uint32_t sleep_seconds = WAKE_STUB_INTERVAL_SECONDS;
+#elif ADAPTIVE_SLEEP_ENABLED && !ULP_SAMPLER_ENABLED
+        // Sleep shorter while the soil is changing, longer when it is stable
+        uint32_t sleep_seconds = adaptive_sleep_next_seconds(sample.moisture_percent, sample.battery_percent);
+#else
+        uint32_t sleep_seconds = DEEP_SLEEP_DURATION_SECONDS;
+#endif // WAKE_STUB_ENABLED
+        uint64_t sleep_time_us = (uint64_t)sleep_seconds * 1000000ULL;
         if (battery_is_dead) {
             ESP_LOGW(TAG, "Battery is dead. Entering deep without a wakeup timer.");
         } else {
+#if ULP_SAMPLER_ENABLED
+            // ADC1 goes to the ULP, which wakes us on a change or a full buffer
+            csm_v2_deinit();
+            battery_monitor_deinit();
+            ulp_sampler_config_t ulp_config = {
+                .period_ms = ULP_SAMPLER_PERIOD_MS,
+                .settle_ms = ULP_SAMPLER_SETTLE_MS,
+                .soil_threshold_raw = ULP_SAMPLER_SOIL_THRESHOLD_RAW,
+                .soil_delta_raw = ULP_SAMPLER_SOIL_DELTA_RAW,
+            };
+            if (ulp_sampler_start(&ulp_config, soil_reading_mean.raw_adc) != ESP_OK) {
+                ESP_LOGW(TAG, "ULP sampler not started, falling back to the wakeup timer");
+                esp_sleep_enable_timer_wakeup(sleep_time_us);
+            }
+#else
          esp_sleep_enable_timer_wakeup(sleep_time_us);
+#endif // ULP_SAMPLER_ENABLED
+#if WAKE_STUB_ENABLED
+            wake_stub_arm(sleep_time_us, soil_reading_mean.raw_adc);
+#endif // WAKE_STUB_ENABLED
         
-            ESP_LOGI(TAG, "Entering deep sleep for %d seconds...", DEEP_SLEEP_DURATION_SECONDS);
+            ESP_LOGI(TAG, "Entering deep sleep for %lu seconds...", (unsigned long)sleep_seconds);
         }
         ESP_LOGI(TAG, "============================================");
         
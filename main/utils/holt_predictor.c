@@ -0,0 +1,38 @@
+/**
+ * @file holt_predictor.c
+ * @brief Fixed-point Holt (level + trend) predictor shared by sensor and hub - Implementation
+ */
+
+#include "holt_predictor.h"
+
+/**
+ * @brief Scale by a Q15 factor, truncating towards zero (C99 division)
+ */
+static int32_t mul_q15(int32_t value, uint16_t factor_q15) {
+    return (int32_t)(((int64_t)value * factor_q15) / HOLT_Q15_ONE);
+}
+
+void holt_reset(holt_model_t* model, int32_t value) {
+    model->level = value * (1 << HOLT_FRAC_BITS);
+    model->trend = 0;
+}
+
+int32_t holt_predict(const holt_model_t* model, uint32_t steps) {
+    int64_t scaled = (int64_t)model->level + (int64_t)model->trend * steps;
+    return (int32_t)(scaled / (1 << HOLT_FRAC_BITS));
+}
+
+void holt_update(holt_model_t* model, int32_t value, uint16_t alpha_q15, uint16_t beta_q15) {
+    int32_t forecast = model->level + model->trend;
+    int32_t observed = value * (1 << HOLT_FRAC_BITS);
+
+    // level' = forecast + alpha * (x - forecast)
+    int32_t level = forecast + mul_q15(observed - forecast, alpha_q15);
+    // trend' = trend + beta * (level' - forecast), i.e. beta * (level' - level) + (1 - beta) * trend
+    model->trend += mul_q15(level - forecast, beta_q15);
+    model->level = level;
+}
+
+void holt_advance(holt_model_t* model) {
+    model->level += model->trend;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file holt_predictor.h
+ * @brief Fixed-point Holt (level + trend) predictor shared by sensor and hub
+ *
+ * Dual prediction: the sensor and the hub hold the same model. The sensor
+ * transmits only when a reading leaves the error bound around the model's
+ * prediction, together with the updated model state; on withheld samples
+ * both sides step the model without an observation. The hub then knows every
+ * withheld value to within the bound.
+ *
+ * All arithmetic is integer with truncating division, so both sides compute
+ * bit-identical results. Values are in caller units (e.g. centi-percent);
+ * level and trend carry HOLT_FRAC_BITS extra fractional bits. One step is one
+ * sample, whatever time lies between samples.
+ */
+
+#ifndef HOLT_PREDICTOR_H
+#define HOLT_PREDICTOR_H
+
+#include <stdint.h>
+
+#define HOLT_FRAC_BITS      8           ///< Fractional bits of level and trend
+#define HOLT_Q15_ONE        32768       ///< 1.0 in Q15 smoothing factors
+
+/**
+ * @brief Model state, also the wire format of a model update
+ */
+typedef struct {
+    int32_t level;                  ///< Smoothed value << HOLT_FRAC_BITS
+    int32_t trend;                  ///< Change per step << HOLT_FRAC_BITS
+} holt_model_t;
+
+/**
+ * @brief Start a model at a value with zero trend
+ *
+ * @param model Model to reset
+ * @param value First observation
+ */
+void holt_reset(holt_model_t* model, int32_t value);
+
+/**
+ * @brief Predict the value a number of steps ahead
+ *
+ * @param model Model state
+ * @param steps Steps ahead (1 = next sample)
+ * @return int32_t Predicted value
+ */
+int32_t holt_predict(const holt_model_t* model, uint32_t steps);
+
+/**
+ * @brief Step the model with an observation
+ *
+ * @param model Model to update
+ * @param value Observed value
+ * @param alpha_q15 Level smoothing factor (Q15, HOLT_Q15_ONE = follow the observation)
+ * @param beta_q15 Trend smoothing factor (Q15, 0 = no trend)
+ */
+void holt_update(holt_model_t* model, int32_t value, uint16_t alpha_q15, uint16_t beta_q15);
+
+/**
+ * @brief Step the model without an observation (sample withheld)
+ *
+ * @param model Model to advance
+ */
+void holt_advance(holt_model_t* model);
+
+#endif // HOLT_PREDICTOR_H
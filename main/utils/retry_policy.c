@@ -0,0 +1,155 @@
+/**
+ * @file retry_policy.c
+ * @brief Shared retry policy for network requests - Implementation
+ */
+
+#include "retry_policy.h"
+#include "../config/esp32-config.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <ctype.h>
+
+static const char* TAG = "RETRY";
+
+static uint32_t s_budget_ms = RETRY_BUDGET_MS;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+
+
+// #####################################
+// MARK: Classifier
+// #####################################
+
+retry_class_t retry_policy_classify_http(esp_err_t err, int http_status) {
+    if (err != ESP_OK) {
+        switch (err) {
+            // Local problems, retrying the same request cannot help
+            case ESP_ERR_INVALID_ARG:
+            case ESP_ERR_INVALID_STATE:
+            case ESP_ERR_NO_MEM:
+            case ESP_ERR_NOT_SUPPORTED:
+                return RETRY_CLASS_PERMANENT;
+            // Timeouts, EAGAIN, connect and DNS failures
+            default:
+                return RETRY_CLASS_TRANSIENT;
+        }
+    }
+
+    if (http_status >= 200 && http_status < 300) {
+        return RETRY_CLASS_SUCCESS;
+    }
+    switch (http_status) {
+        case 408:   // Request Timeout
+        case 425:   // Too Early
+        case 429:   // Too Many Requests
+            return RETRY_CLASS_TRANSIENT;
+        case 501:   // Not Implemented
+        case 505:   // HTTP Version Not Supported
+            return RETRY_CLASS_PERMANENT;
+        default:
+            // 5xx (incl. proxy 502/503/504) are transient, everything else is a client error
+            return (http_status >= 500 && http_status < 600) ? RETRY_CLASS_TRANSIENT : RETRY_CLASS_PERMANENT;
+    }
+}
+
+uint32_t retry_policy_parse_retry_after(const char* value) {
+    if (value == NULL) {
+        return 0;
+    }
+    while (*value == ' ') {
+        value++;
+    }
+    if (!isdigit((unsigned char)*value)) {
+        return 0;   // HTTP-date form
+    }
+    unsigned long seconds = strtoul(value, NULL, 10);
+    if (seconds > UINT32_MAX / 1000) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)seconds * 1000;
+}
+
+
+
+
+// #####################################
+// MARK: Schedule
+// #####################################
+
+uint32_t retry_policy_backoff_ms(const retry_policy_t* policy, uint8_t retry, uint32_t retry_after_ms) {
+    if (policy == NULL || retry == 0) {
+        return 0;
+    }
+
+    // base * 2^(retry - 1), saturating at max_delay
+    uint32_t cap = policy->base_delay_ms;
+    for (uint8_t i = 1; i < retry && cap < policy->max_delay_ms; i++) {
+        cap *= 2;
+    }
+    if (cap > policy->max_delay_ms) {
+        cap = policy->max_delay_ms;
+    }
+
+    uint32_t delay = (cap > 0) ? esp_random() % (cap + 1) : 0;
+    if (retry_after_ms > delay) {
+        delay = (retry_after_ms > policy->max_delay_ms) ? policy->max_delay_ms : retry_after_ms;
+    }
+    return delay;
+}
+
+bool retry_policy_next(const retry_policy_t* policy, uint8_t attempts_done, retry_class_t cls,
+                       uint32_t retry_after_ms, uint32_t* delay_ms) {
+    if (policy == NULL || delay_ms == NULL || cls != RETRY_CLASS_TRANSIENT) {
+        return false;
+    }
+    if (attempts_done >= policy->max_attempts) {
+        return false;
+    }
+
+    uint32_t delay = retry_policy_backoff_ms(policy, attempts_done, retry_after_ms);
+
+    portENTER_CRITICAL(&s_lock);
+    bool allowed = (delay < s_budget_ms);
+    if (allowed) {
+        s_budget_ms -= delay;
+    }
+    uint32_t remaining = s_budget_ms;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!allowed) {
+        ESP_LOGW(TAG, "Retry budget exhausted (%lu ms left, %lu ms needed)",
+                 (unsigned long)remaining, (unsigned long)delay);
+        return false;
+    }
+    *delay_ms = delay;
+    return true;
+}
+
+
+
+
+// #####################################
+// MARK: Budget
+// #####################################
+
+void retry_budget_reset(uint32_t budget_ms) {
+    portENTER_CRITICAL(&s_lock);
+    s_budget_ms = budget_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void retry_budget_charge(uint32_t elapsed_ms) {
+    portENTER_CRITICAL(&s_lock);
+    s_budget_ms = (elapsed_ms < s_budget_ms) ? s_budget_ms - elapsed_ms : 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t retry_budget_remaining_ms(void) {
+    portENTER_CRITICAL(&s_lock);
+    uint32_t remaining = s_budget_ms;
+    portEXIT_CRITICAL(&s_lock);
+    return remaining;
+}
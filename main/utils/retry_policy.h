@@ -0,0 +1,105 @@
+/**
+ * @file retry_policy.h
+ * @brief Shared retry policy for network requests
+ *
+ * Classifies request outcomes into success, transient and permanent errors,
+ * computes exponential backoff delays with full jitter (honoring a server
+ * Retry-After) and enforces one retry time budget per wake shared by all
+ * clients, so a misconfigured endpoint cannot keep the radio on for long.
+ */
+
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Outcome class of a request attempt
+ */
+typedef enum {
+    RETRY_CLASS_SUCCESS = 0,    ///< Done, no retry
+    RETRY_CLASS_TRANSIENT,      ///< May succeed later (timeout, 429, 5xx, ...)
+    RETRY_CLASS_PERMANENT       ///< Will not succeed by retrying (4xx, bad config, ...)
+} retry_class_t;
+
+/**
+ * @brief Backoff schedule of one client
+ */
+typedef struct {
+    uint8_t max_attempts;       ///< Total attempts including the first one
+    uint32_t base_delay_ms;     ///< Backoff cap of the first retry, doubled per retry
+    uint32_t max_delay_ms;      ///< Upper bound of a single delay (also caps Retry-After)
+} retry_policy_t;
+
+/**
+ * @brief Classify the outcome of an HTTP request
+ *
+ * @param err Transport result (esp_http_client_perform)
+ * @param http_status HTTP status code, only used when err is ESP_OK
+ * @return retry_class_t Outcome class
+ */
+retry_class_t retry_policy_classify_http(esp_err_t err, int http_status);
+
+/**
+ * @brief Parse a Retry-After header value
+ *
+ * Only the delta-seconds form is supported; HTTP dates return 0.
+ *
+ * @param value Header value
+ * @return uint32_t Delay in milliseconds, 0 if absent or unsupported
+ */
+uint32_t retry_policy_parse_retry_after(const char* value);
+
+/**
+ * @brief Backoff delay before a retry
+ *
+ * Full jitter: uniformly random in [0, min(max_delay, base_delay * 2^(retry - 1))].
+ * A server Retry-After is used instead when it is longer, capped at max_delay.
+ *
+ * @param policy Backoff schedule
+ * @param retry Retry number (1 = first retry)
+ * @param retry_after_ms Server Retry-After in milliseconds (0 = none)
+ * @return uint32_t Delay in milliseconds
+ */
+uint32_t retry_policy_backoff_ms(const retry_policy_t* policy, uint8_t retry, uint32_t retry_after_ms);
+
+/**
+ * @brief Decide whether to retry and reserve the delay from the wake budget
+ *
+ * @param policy Backoff schedule
+ * @param attempts_done Attempts made so far (>= 1)
+ * @param cls Class of the last attempt
+ * @param retry_after_ms Server Retry-After in milliseconds (0 = none)
+ * @param delay_ms Output: delay to wait before the next attempt
+ * @return true to retry after delay_ms, false to give up
+ */
+bool retry_policy_next(const retry_policy_t* policy, uint8_t attempts_done, retry_class_t cls,
+                       uint32_t retry_after_ms, uint32_t* delay_ms);
+
+/**
+ * @brief Reset the per-wake retry budget
+ *
+ * The budget starts at RETRY_BUDGET_MS on boot, so this is only needed when
+ * several network phases run without a deep sleep in between.
+ *
+ * @param budget_ms New budget in milliseconds
+ */
+void retry_budget_reset(uint32_t budget_ms);
+
+/**
+ * @brief Charge time spent on retried attempts against the budget
+ *
+ * @param elapsed_ms Duration of a retried attempt
+ */
+void retry_budget_charge(uint32_t elapsed_ms);
+
+/**
+ * @brief Remaining retry budget
+ *
+ * @return uint32_t Milliseconds left for backoff and retried attempts
+ */
+uint32_t retry_budget_remaining_ms(void);
+
+#endif // RETRY_POLICY_H
@@ -0,0 +1,101 @@
+/**
+ * @file time_sync.c
+ * @brief Sensor clock set from the hub's time in ESP-NOW ACKs - Implementation
+ */
+
+#include "time_sync.h"
+#include "../config/esp32-config.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <sys/time.h>
+
+#define DRIFT_SMOOTHING     0.25f       ///< Weight of the newest drift measurement
+
+static const char* TAG = "TIME_SYNC";
+
+static RTC_DATA_ATTR time_sync_state_t s_state;
+
+
+
+
+// #####################################
+// MARK: Estimator
+// #####################################
+
+int64_t time_sync_update(time_sync_state_t* state, uint64_t local_ms, uint64_t true_ms) {
+    int64_t offset = (int64_t)(true_ms - local_ms);
+
+    // The clock ran free since the last sync, so the whole offset is drift
+    if (state->valid && local_ms > state->sync_ms &&
+        local_ms - state->sync_ms >= (uint64_t)TIME_SYNC_DRIFT_MIN_INTERVAL_SECONDS * 1000ULL) {
+        float measured = (float)offset * 1e6f / (float)(local_ms - state->sync_ms);
+        if (measured > TIME_SYNC_MAX_DRIFT_PPM) {
+            measured = TIME_SYNC_MAX_DRIFT_PPM;
+        } else if (measured < -TIME_SYNC_MAX_DRIFT_PPM) {
+            measured = -TIME_SYNC_MAX_DRIFT_PPM;
+        }
+        state->drift_ppm = (state->drift_samples == 0)
+            ? measured
+            : state->drift_ppm + (measured - state->drift_ppm) * DRIFT_SMOOTHING;
+        state->drift_samples++;
+    }
+
+    state->valid = true;
+    state->sync_ms = true_ms;
+    state->syncs++;
+    return offset;
+}
+
+uint64_t time_sync_correct(const time_sync_state_t* state, uint64_t local_ms) {
+    if (!state->valid) {
+        return 0;
+    }
+    float elapsed_ms = (float)(int64_t)(local_ms - state->sync_ms);
+    return local_ms + (int64_t)(elapsed_ms * state->drift_ppm / 1e6f);
+}
+
+
+
+
+// #####################################
+// MARK: Clock
+// #####################################
+
+static uint64_t local_now_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000ULL + (uint64_t)tv.tv_usec / 1000ULL;
+}
+
+esp_err_t time_sync_apply_hub_time(uint64_t hub_time_ms, uint32_t rtt_us,
+                                   uint32_t hub_hold_us, int64_t rx_local_us) {
+    if (hub_time_ms == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rtt_us > TIME_SYNC_MAX_RTT_MS * 1000UL) {
+        ESP_LOGD(TAG, "Round trip %lu us too long, ignoring hub time", (unsigned long)rtt_us);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Hub stamped when sending the ACK: add the way back and our time since reception
+    uint32_t one_way_us = (rtt_us > hub_hold_us) ? (rtt_us - hub_hold_us) / 2 : 0;
+    int64_t since_rx_us = esp_timer_get_time() - rx_local_us;
+    uint64_t true_ms = hub_time_ms + (uint64_t)((one_way_us + since_rx_us) / 1000);
+
+    int64_t offset = time_sync_update(&s_state, local_now_ms(), true_ms);
+
+    struct timeval tv = {
+        .tv_sec = (time_t)(true_ms / 1000ULL),
+        .tv_usec = (suseconds_t)((true_ms % 1000ULL) * 1000ULL),
+    };
+    settimeofday(&tv, NULL);
+
+    ESP_LOGI(TAG, "Clock set from hub (offset %lld ms, rtt %lu us, drift %.1f ppm from %lu syncs)",
+             (long long)offset, (unsigned long)rtt_us, s_state.drift_ppm, (unsigned long)s_state.drift_samples);
+    return ESP_OK;
+}
+
+uint64_t time_sync_get_timestamp_ms(void) {
+    return time_sync_correct(&s_state, local_now_ms());
+}
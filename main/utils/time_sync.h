@@ -0,0 +1,74 @@
+/**
+ * @file time_sync.h
+ * @brief Sensor clock set from the hub's time in ESP-NOW ACKs
+ *
+ * ESP-NOW-only sensors have no path to NTP. The hub puts its NTP time into
+ * every ACK; the sensor sets its system clock from it, correcting for the
+ * one-way delay (half the round trip minus the hub's hold time). The system
+ * clock keeps running through deep sleep on the RTC slow clock, whose rate
+ * error is estimated from the offset found at each sync and applied to
+ * timestamps taken between syncs. State lives in RTC memory.
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Offset/drift estimator state
+ */
+typedef struct {
+    bool valid;                     ///< Clock was set at least once
+    uint64_t sync_ms;               ///< Local clock right after the last sync
+    float drift_ppm;                ///< True time gained per local time, in ppm
+    uint32_t drift_samples;         ///< Syncs that contributed to drift_ppm
+    uint32_t syncs;
+} time_sync_state_t;
+
+/**
+ * @brief Feed one sync into the estimator
+ *
+ * The drift is updated from the offset when at least
+ * TIME_SYNC_DRIFT_MIN_INTERVAL_SECONDS passed since the previous sync;
+ * afterwards the local clock is assumed to be set to true_ms.
+ *
+ * @param state Estimator state
+ * @param local_ms Local clock, not drift-corrected
+ * @param true_ms Reference time at the same moment
+ * @return int64_t Offset true_ms - local_ms
+ */
+int64_t time_sync_update(time_sync_state_t* state, uint64_t local_ms, uint64_t true_ms);
+
+/**
+ * @brief Apply the estimated drift to a local clock reading
+ *
+ * @param state Estimator state
+ * @param local_ms Local clock
+ * @return uint64_t Corrected time, 0 if the clock was never set
+ */
+uint64_t time_sync_correct(const time_sync_state_t* state, uint64_t local_ms);
+
+/**
+ * @brief Set the clock from the time in a hub ACK
+ *
+ * @param hub_time_ms Hub time when sending the ACK (Unix ms)
+ * @param rtt_us Round trip from sending the data to receiving the ACK
+ * @param hub_hold_us Time the hub held the data before sending the ACK
+ * @param rx_local_us esp_timer_get_time() at ACK reception
+ * @return ESP_OK, ESP_ERR_INVALID_STATE (hub has no time),
+ *         ESP_ERR_INVALID_RESPONSE (round trip above TIME_SYNC_MAX_RTT_MS)
+ */
+esp_err_t time_sync_apply_hub_time(uint64_t hub_time_ms, uint32_t rtt_us,
+                                   uint32_t hub_hold_us, int64_t rx_local_us);
+
+/**
+ * @brief Current time from the hub-set clock
+ *
+ * @return uint64_t Unix time in milliseconds, drift-corrected; 0 if never synced
+ */
+uint64_t time_sync_get_timestamp_ms(void);
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,259 @@
+/**
+ * @file ts_codec.c
+ * @brief Compressed time-series blocks (Gorilla-style) for buffered samples - Implementation
+ */
+
+#include "ts_codec.h"
+#include <string.h>
+
+#define HEADER_LEN          sizeof(ts_block_header_t)
+#define MAX_PAYLOAD_LEN     UINT16_MAX
+
+// Bit widths of the variable-length classes. Class i is written as i one
+// bits, a terminating zero (except for the last class), then width[i] bits.
+// Width 0 is the exact-zero class.
+static const uint8_t s_ts_widths[] = { 0, 8, 12, 16, 24, 64 };       ///< Zig-zag delta-of-delta, ms
+static const uint8_t s_value_widths[] = { 0, 4, 8, 12, 33 };         ///< Zig-zag value delta
+
+#define TS_CLASSES      (sizeof(s_ts_widths) / sizeof(s_ts_widths[0]))
+#define VALUE_CLASSES   (sizeof(s_value_widths) / sizeof(s_value_widths[0]))
+
+
+
+
+// #####################################
+// MARK: Bit Stream
+// #####################################
+
+static uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Write bits MSB first; clears as well as sets so a rolled back tail can be overwritten
+ */
+static bool put_bits(ts_encoder_t* enc, uint64_t value, uint8_t width) {
+    if (HEADER_LEN * 8 + enc->bit_pos + width > enc->cap * 8) {
+        return false;
+    }
+    uint8_t* payload = enc->buf + HEADER_LEN;
+    for (int bit = width - 1; bit >= 0; bit--) {
+        size_t byte = enc->bit_pos >> 3;
+        uint8_t mask = (uint8_t)(0x80 >> (enc->bit_pos & 7));
+        if ((value >> bit) & 1) {
+            payload[byte] |= mask;
+        } else {
+            payload[byte] &= (uint8_t)~mask;
+        }
+        enc->bit_pos++;
+    }
+    return true;
+}
+
+static bool get_bits(ts_decoder_t* dec, uint8_t width, uint64_t* value) {
+    if (dec->bit_pos + width > dec->bit_len) {
+        return false;
+    }
+    uint64_t result = 0;
+    for (uint8_t i = 0; i < width; i++) {
+        size_t byte = dec->bit_pos >> 3;
+        uint8_t bit = (dec->payload[byte] >> (7 - (dec->bit_pos & 7))) & 1;
+        result = (result << 1) | bit;
+        dec->bit_pos++;
+    }
+    *value = result;
+    return true;
+}
+
+static bool put_class(ts_encoder_t* enc, uint64_t value, const uint8_t* widths, size_t classes) {
+    size_t cls = 0;
+    while (cls < classes - 1 && (widths[cls] == 0 ? value != 0 : (value >> widths[cls]) != 0)) {
+        cls++;
+    }
+    for (size_t i = 0; i < cls; i++) {
+        if (!put_bits(enc, 1, 1)) {
+            return false;
+        }
+    }
+    if (cls < classes - 1 && !put_bits(enc, 0, 1)) {
+        return false;
+    }
+    return put_bits(enc, value, widths[cls]);
+}
+
+static bool get_class(ts_decoder_t* dec, const uint8_t* widths, size_t classes, uint64_t* value) {
+    size_t cls = 0;
+    while (cls < classes - 1) {
+        uint64_t bit;
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            break;
+        }
+        cls++;
+    }
+    return get_bits(dec, widths[cls], value);
+}
+
+
+
+
+// #####################################
+// MARK: Encoder
+// #####################################
+
+esp_err_t ts_encoder_init(ts_encoder_t* enc, uint8_t* buf, size_t cap, uint8_t channels) {
+    if (enc == NULL || buf == NULL || cap < HEADER_LEN ||
+        channels == 0 || channels > TS_CODEC_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = (cap > HEADER_LEN + MAX_PAYLOAD_LEN) ? HEADER_LEN + MAX_PAYLOAD_LEN : cap;
+    enc->channels = channels;
+    return ESP_OK;
+}
+
+esp_err_t ts_encoder_add(ts_encoder_t* enc, uint64_t ts_ms, const int32_t* values) {
+    if (enc == NULL || values == NULL || enc->count == UINT16_MAX ||
+        (enc->count > 0 && ts_ms < enc->last_ts_ms)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t rollback = enc->bit_pos;
+    bool ok = true;
+    int64_t delta = 0;
+
+    if (enc->count == 0) {
+        // First sample: timestamp lives in the header, values verbatim
+        for (uint8_t ch = 0; ch < enc->channels && ok; ch++) {
+            ok = put_bits(enc, (uint32_t)values[ch], 32);
+        }
+    } else {
+        delta = (int64_t)(ts_ms - enc->last_ts_ms);
+        ok = put_class(enc, zigzag_encode(delta - enc->last_delta_ms), s_ts_widths, TS_CLASSES);
+        for (uint8_t ch = 0; ch < enc->channels && ok; ch++) {
+            int64_t diff = (int64_t)values[ch] - enc->last_values[ch];
+            ok = put_class(enc, zigzag_encode(diff), s_value_widths, VALUE_CLASSES);
+        }
+    }
+
+    if (!ok) {
+        enc->bit_pos = rollback;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (enc->count == 0) {
+        enc->first_ts_ms = ts_ms;
+    } else {
+        enc->last_delta_ms = delta;
+    }
+    enc->last_ts_ms = ts_ms;
+    memcpy(enc->last_values, values, enc->channels * sizeof(int32_t));
+    enc->count++;
+    return ESP_OK;
+}
+
+size_t ts_encoder_finish(ts_encoder_t* enc) {
+    if (enc == NULL) {
+        return 0;
+    }
+    ts_block_header_t header = {
+        .magic = TS_CODEC_MAGIC,
+        .channels = enc->channels,
+        .count = enc->count,
+        .payload_len = (uint16_t)((enc->bit_pos + 7) / 8),
+        .first_ts_ms = enc->first_ts_ms,
+        .last_ts_ms = enc->last_ts_ms,
+    };
+    // Zero the unused bits of the last byte so equal inputs give equal blocks
+    if (enc->bit_pos & 7) {
+        enc->buf[HEADER_LEN + enc->bit_pos / 8] &= (uint8_t)(0xFF00 >> (enc->bit_pos & 7));
+    }
+    memcpy(enc->buf, &header, HEADER_LEN);
+    return ts_block_size(&header);
+}
+
+
+
+
+// #####################################
+// MARK: Decoder
+// #####################################
+
+esp_err_t ts_block_read_header(const uint8_t* block, size_t len, ts_block_header_t* header) {
+    if (block == NULL || header == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len < HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(header, block, HEADER_LEN);
+    if (header->magic != TS_CODEC_MAGIC ||
+        header->channels == 0 || header->channels > TS_CODEC_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len < ts_block_size(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+size_t ts_block_size(const ts_block_header_t* header) {
+    return HEADER_LEN + header->payload_len;
+}
+
+esp_err_t ts_decoder_init(ts_decoder_t* dec, const uint8_t* block, size_t len) {
+    if (dec == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(dec, 0, sizeof(*dec));
+    esp_err_t err = ts_block_read_header(block, len, &dec->header);
+    if (err != ESP_OK) {
+        return err;
+    }
+    dec->payload = block + HEADER_LEN;
+    dec->bit_len = (size_t)dec->header.payload_len * 8;
+    return ESP_OK;
+}
+
+bool ts_decoder_next(ts_decoder_t* dec, uint64_t* ts_ms, int32_t* values) {
+    if (dec == NULL || ts_ms == NULL || values == NULL || dec->index >= dec->header.count) {
+        return false;
+    }
+
+    uint64_t raw;
+    int32_t decoded[TS_CODEC_MAX_CHANNELS];
+    if (dec->index == 0) {
+        for (uint8_t ch = 0; ch < dec->header.channels; ch++) {
+            if (!get_bits(dec, 32, &raw)) {
+                return false;
+            }
+            decoded[ch] = (int32_t)(uint32_t)raw;
+        }
+        dec->last_ts_ms = dec->header.first_ts_ms;
+    } else {
+        if (!get_class(dec, s_ts_widths, TS_CLASSES, &raw)) {
+            return false;
+        }
+        dec->last_delta_ms += zigzag_decode(raw);
+        dec->last_ts_ms += (uint64_t)dec->last_delta_ms;
+        for (uint8_t ch = 0; ch < dec->header.channels; ch++) {
+            if (!get_class(dec, s_value_widths, VALUE_CLASSES, &raw)) {
+                return false;
+            }
+            decoded[ch] = (int32_t)(dec->last_values[ch] + zigzag_decode(raw));
+        }
+    }
+
+    memcpy(dec->last_values, decoded, dec->header.channels * sizeof(int32_t));
+    memcpy(values, decoded, dec->header.channels * sizeof(int32_t));
+    *ts_ms = dec->last_ts_ms;
+    dec->index++;
+    return true;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file ts_codec.h
+ * @brief Compressed time-series blocks (Gorilla-style) for buffered samples
+ *
+ * A block holds samples of a fixed number of integer channels (fixed-point
+ * values such as ADC counts or millivolts). Timestamps are stored as
+ * delta-of-delta, values as zig-zag deltas to the previous sample, each in a
+ * variable-length bit class: a regular wake interval and a stable reading
+ * cost one bit each. A block starts with a plain header (count, size, time
+ * range) so a reader can skip or select blocks without decoding them.
+ *
+ * Encoding and decoding are streaming: samples are appended one at a time
+ * and read back one at a time, with no scratch memory beyond the block.
+ */
+
+#ifndef TS_CODEC_H
+#define TS_CODEC_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TS_CODEC_MAGIC          0xB7    ///< First byte of every block
+#define TS_CODEC_MAX_CHANNELS   6       ///< Value channels per sample
+
+/**
+ * @brief Block header, stored little-endian in front of the bit stream
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t magic;                  ///< TS_CODEC_MAGIC
+    uint8_t channels;               ///< Value channels per sample
+    uint16_t count;                 ///< Samples in the block
+    uint16_t payload_len;           ///< Bit stream bytes after the header
+    uint64_t first_ts_ms;           ///< Timestamp of the first sample
+    uint64_t last_ts_ms;            ///< Timestamp of the last sample
+} ts_block_header_t;
+
+/**
+ * @brief Streaming block encoder
+ */
+typedef struct {
+    uint8_t* buf;                   ///< Block buffer (header + bit stream)
+    size_t cap;                     ///< Buffer size
+    size_t bit_pos;                 ///< Bits written after the header
+    uint8_t channels;
+    uint16_t count;
+    uint64_t first_ts_ms;
+    uint64_t last_ts_ms;
+    int64_t last_delta_ms;
+    int32_t last_values[TS_CODEC_MAX_CHANNELS];
+} ts_encoder_t;
+
+/**
+ * @brief Streaming block decoder
+ */
+typedef struct {
+    const uint8_t* payload;         ///< Bit stream
+    size_t bit_len;                 ///< Bits available
+    size_t bit_pos;
+    ts_block_header_t header;
+    uint16_t index;                 ///< Samples returned so far
+    uint64_t last_ts_ms;
+    int64_t last_delta_ms;
+    int32_t last_values[TS_CODEC_MAX_CHANNELS];
+} ts_decoder_t;
+
+/**
+ * @brief Start a block in a buffer
+ *
+ * @param enc Encoder
+ * @param buf Buffer for the block, at least sizeof(ts_block_header_t) bytes
+ * @param cap Buffer size
+ * @param channels Value channels per sample (1..TS_CODEC_MAX_CHANNELS)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG
+ */
+esp_err_t ts_encoder_init(ts_encoder_t* enc, uint8_t* buf, size_t cap, uint8_t channels);
+
+/**
+ * @brief Append a sample
+ *
+ * Timestamps must not decrease. On ESP_ERR_NO_MEM the block is left as it
+ * was before the call, so the caller can finish it and start a new one.
+ *
+ * @param enc Encoder
+ * @param ts_ms Timestamp in milliseconds
+ * @param values One value per channel
+ * @return ESP_OK, ESP_ERR_NO_MEM (block full), ESP_ERR_INVALID_ARG
+ */
+esp_err_t ts_encoder_add(ts_encoder_t* enc, uint64_t ts_ms, const int32_t* values);
+
+/**
+ * @brief Write the header and close the block
+ *
+ * The encoder may keep appending afterwards; call finish again to update
+ * the header.
+ *
+ * @param enc Encoder
+ * @return size_t Block size in bytes (header + bit stream)
+ */
+size_t ts_encoder_finish(ts_encoder_t* enc);
+
+/**
+ * @brief Read and check a block header
+ *
+ * @param block Block bytes
+ * @param len Bytes available
+ * @param header Output header
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE (truncated), ESP_ERR_INVALID_ARG (not a block)
+ */
+esp_err_t ts_block_read_header(const uint8_t* block, size_t len, ts_block_header_t* header);
+
+/**
+ * @brief Size of a block from its header
+ */
+size_t ts_block_size(const ts_block_header_t* header);
+
+/**
+ * @brief Start decoding a block
+ *
+ * @param dec Decoder
+ * @param block Block bytes
+ * @param len Bytes available
+ * @return ESP_OK or the ts_block_read_header() error
+ */
+esp_err_t ts_decoder_init(ts_decoder_t* dec, const uint8_t* block, size_t len);
+
+/**
+ * @brief Decode the next sample
+ *
+ * @param dec Decoder
+ * @param ts_ms Output timestamp
+ * @param values Output, header.channels values
+ * @return true when a sample was decoded, false at the end or on a corrupt stream
+ */
+bool ts_decoder_next(ts_decoder_t* dec, uint64_t* ts_ms, int32_t* values);
+
+#endif // TS_CODEC_H
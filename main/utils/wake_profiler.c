@@ -0,0 +1,59 @@
+/**
+ * @file wake_profiler.c
+ * @brief Timestamps of the phases of one wake - Implementation
+ */
+
+#include "wake_profiler.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char* TAG = "WAKE_PROFILE";
+
+typedef struct {
+    const char* name;
+    int64_t time_us;
+} wake_mark_t;
+
+static wake_mark_t s_marks[WAKE_PROFILER_MAX_MARKS];
+static size_t s_mark_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void wake_profiler_mark(const char* name) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_mark_count < WAKE_PROFILER_MAX_MARKS) {
+        s_marks[s_mark_count].name = name;
+        s_marks[s_mark_count].time_us = now;
+        s_mark_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static const wake_mark_t* find_mark(const char* name) {
+    for (size_t i = 0; i < s_mark_count; i++) {
+        if (strcmp(s_marks[i].name, name) == 0) {
+            return &s_marks[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t wake_profiler_span_us(const char* from, const char* to) {
+    const wake_mark_t* start = find_mark(from);
+    const wake_mark_t* end = find_mark(to);
+    if (start == NULL || end == NULL || end->time_us < start->time_us) {
+        return 0;
+    }
+    return (uint32_t)(end->time_us - start->time_us);
+}
+
+void wake_profiler_log(void) {
+    int64_t previous = 0;
+    for (size_t i = 0; i < s_mark_count; i++) {
+        ESP_LOGI(TAG, "%-16s %8lld us  (+%lld us)", s_marks[i].name,
+                 (long long)s_marks[i].time_us, (long long)(s_marks[i].time_us - previous));
+        previous = s_marks[i].time_us;
+    }
+}
@@ -0,0 +1,38 @@
+/**
+ * @file wake_profiler.h
+ * @brief Timestamps of the phases of one wake
+ *
+ * Marks are taken with esp_timer (microseconds since boot) and logged
+ * together before sleep, so radio bring-up and other phases can be compared
+ * across firmware changes from the serial log alone.
+ */
+
+#ifndef WAKE_PROFILER_H
+#define WAKE_PROFILER_H
+
+#include <stdint.h>
+
+#define WAKE_PROFILER_MAX_MARKS     16      ///< Marks kept per wake, later ones are ignored
+
+/**
+ * @brief Record a mark
+ *
+ * @param name Phase name, must stay valid for the whole wake (string literal)
+ */
+void wake_profiler_mark(const char* name);
+
+/**
+ * @brief Time between two marks
+ *
+ * @param from Earlier mark
+ * @param to Later mark
+ * @return uint32_t Microseconds, 0 if a mark is missing
+ */
+uint32_t wake_profiler_span_us(const char* from, const char* to);
+
+/**
+ * @brief Log all marks with the time since boot and since the previous mark
+ */
+void wake_profiler_log(void);
+
+#endif // WAKE_PROFILER_H
@@ -13,29 +13,52 @@ class SoilDataHandler(BaseHTTPRequestHandler):
         # print(f"{self.address_string()} - - [{self.log_date_time_string()}] {format % args}")
         pass
 
+    def read_body(self):
+        """Read the request body, plain (Content-Length) or chunked"""
+        if self.headers.get('Transfer-Encoding', '').lower() != 'chunked':
+            return self.rfile.read(int(self.headers['Content-Length']))
+
+        body = bytearray()
+        while True:
+            size = int(self.rfile.readline().split(b';')[0].strip(), 16)
+            if size == 0:
+                # Skip trailers up to the final empty line
+                while self.rfile.readline() not in (b'\r\n', b'\n', b''):
+                    pass
+                return bytes(body)
+            body += self.rfile.read(size)
+            self.rfile.readline()  # CRLF after the chunk data
+
+    def handle_record(self, data):
+        timestamp = datetime.datetime.fromtimestamp(
+            data['timestamp'] / 1000)
+        
+        # Handle different data types
+        data_type = data.get('type', 'soil')  # Default to 'soil' for backward compatibility
+        
+        if data_type == 'soil':
+            print(f"[{timestamp}] SOIL - device_id={data['device_id']}\tMoisture={data['moisture_percent']:.1f}%\tVoltage={data['voltage']:.3f}V\tRaw ADC={data['raw_adc']}")
+        elif data_type == 'battery':
+            print(f"[{timestamp}] BATTERY - device_id={data['device_id']}\tVoltage={data['voltage']:.3f}V")
+        else:
+            print(f"[{timestamp}] UNKNOWN TYPE({data_type}) - device_id={data['device_id']}\tVoltage={data['voltage']:.3f}V")
+
+        # Save to CSV
+        self.save_to_csv(data, timestamp, data_type)
+
     def do_POST(self):
         if self.path == '/soil-data':
-            content_length = int(self.headers['Content-Length'])
-            post_data = self.rfile.read(content_length)
+            post_data = self.read_body()
 
             try:
-                data = json.loads(post_data.decode('utf-8'))
-
-                timestamp = datetime.datetime.fromtimestamp(
-                    data['timestamp'] / 1000)
-                
-                # Handle different data types
-                data_type = data.get('type', 'soil')  # Default to 'soil' for backward compatibility
-                
-                if data_type == 'soil':
-                    print(f"[{timestamp}] SOIL - device_id={data['device_id']}\tMoisture={data['moisture_percent']:.1f}%\tVoltage={data['voltage']:.3f}V\tRaw ADC={data['raw_adc']}")
-                elif data_type == 'battery':
-                    print(f"[{timestamp}] BATTERY - device_id={data['device_id']}\tVoltage={data['voltage']:.3f}V")
+                # One JSON object, or newline-delimited objects from a streamed backlog flush
+                if 'ndjson' in self.headers.get('Content-Type', ''):
+                    records = [json.loads(line) for line in post_data.decode('utf-8').splitlines() if line.strip()]
                 else:
-                    print(f"[{timestamp}] UNKNOWN TYPE({data_type}) - device_id={data['device_id']}\tVoltage={data['voltage']:.3f}V")
+                    records = [json.loads(post_data.decode('utf-8'))]
 
-                # Save to CSV
-                self.save_to_csv(data, timestamp, data_type)
+                for data in records:
+                    self.handle_record(data)
 
                 self.send_response(200)
                 self.send_header('Content-type', 'application/json')
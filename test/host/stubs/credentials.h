@@ -0,0 +1,15 @@
+/**
+ * @file credentials.h
+ * @brief Host stand-in for the untracked credentials of main/config
+ */
+
+#ifndef HOST_CREDENTIALS_H
+#define HOST_CREDENTIALS_H
+
+#define WIFI_SSID       "host"
+#define WIFI_PASSWORD   "host"
+#define INFLUXDB_TOKEN  "host"
+#define MQTT_USERNAME   "host"
+#define MQTT_PASSWORD   "host"
+
+#endif // HOST_CREDENTIALS_H
@@ -0,0 +1,9 @@
+/**
+ * @file adc_oneshot.h
+ * @brief Host stand-in, the configuration only names ADC constants in macros
+ */
+
+#ifndef HOST_ADC_ONESHOT_H
+#define HOST_ADC_ONESHOT_H
+
+#endif // HOST_ADC_ONESHOT_H
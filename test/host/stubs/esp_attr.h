@@ -0,0 +1,13 @@
+/**
+ * @file esp_attr.h
+ * @brief Host stand-in for ESP-IDF memory placement attributes
+ */
+
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#endif // HOST_ESP_ATTR_H
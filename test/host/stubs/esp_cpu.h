@@ -0,0 +1,15 @@
+/**
+ * @file esp_cpu.h
+ * @brief Host stand-in for the CPU cycle counter (one "cycle" per nanosecond)
+ */
+
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#endif // HOST_ESP_CPU_H
@@ -0,0 +1,19 @@
+/**
+ * @file esp_log.h
+ * @brief Host stand-in for ESP-IDF logging (errors and warnings only)
+ */
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+// Compiled but not printed, so the arguments stay type-checked and used
+#define HOST_LOG_QUIET(tag, fmt, ...) do { if (0) printf("%s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_QUIET(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_QUIET(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG_QUIET(tag, fmt, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
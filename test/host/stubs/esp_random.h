@@ -0,0 +1,13 @@
+/**
+ * @file esp_random.h
+ * @brief Host stand-in for the ESP-IDF RNG (seedable, see host_stubs.h)
+ */
+
+#ifndef HOST_ESP_RANDOM_H
+#define HOST_ESP_RANDOM_H
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif // HOST_ESP_RANDOM_H
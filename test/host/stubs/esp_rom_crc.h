@@ -0,0 +1,16 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Host stand-in for the ROM CRC32
+ */
+
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+/**
+ * @brief CRC32 (IEEE 802.3, little-endian), chainable like the ROM function
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,34 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS core types and critical sections
+ *
+ * One tick is one millisecond. Critical sections share a single recursive
+ * mutex, so modules whose tasks run as threads (freertos/task.h) stay consistent.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int portMUX_TYPE;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portMAX_DELAY                   ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks)            ((uint32_t)(ticks))
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define pdFAIL                          pdFALSE
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define portENTER_CRITICAL(mux)         do { (void)(mux); host_critical_enter(); } while (0)
+#define portEXIT_CRITICAL(mux)          do { (void)(mux); host_critical_exit(); } while (0)
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,502 @@
+/**
+ * @file freertos_host.c
+ * @brief Host stand-ins for FreeRTOS tasks, notifications, queues, semaphores and event groups
+ *
+ * Tasks are POSIX threads. Blocking calls wait in short slices so a task
+ * deleted by another one leaves at its next blocking call, like a task
+ * deleted while blocked on the target.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WAIT_SLICE_MS   5
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void* arg;
+    volatile bool deleted;
+    bool notify_pending;
+    uint32_t notify_value;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+    unsigned char* items;
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int count;
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static pthread_mutex_t s_critical;
+static pthread_once_t s_critical_once = PTHREAD_ONCE_INIT;
+static __thread struct host_task* s_current = NULL;
+
+
+
+
+// #####################################
+// MARK: Time
+// #####################################
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    static uint64_t start = 0;
+    if (start == 0) {
+        start = now_ms();
+    }
+    return (TickType_t)(now_ms() - start);
+}
+
+/**
+ * @brief Leave the thread if the calling task was deleted
+ */
+static void exit_if_deleted(pthread_mutex_t* held) {
+    if (s_current != NULL && s_current->deleted) {
+        if (held != NULL) {
+            pthread_mutex_unlock(held);
+        }
+        pthread_exit(NULL);
+    }
+}
+
+/**
+ * @brief Wait on cond for at most one slice
+ *
+ * @return false once ticks have passed since start (never for portMAX_DELAY)
+ */
+static bool wait_slice(pthread_cond_t* cond, pthread_mutex_t* lock, uint64_t start, TickType_t ticks) {
+    uint64_t now = now_ms();
+    if (ticks != portMAX_DELAY && now - start >= ticks) {
+        return false;
+    }
+    uint64_t until = now + WAIT_SLICE_MS;
+    if (ticks != portMAX_DELAY && until > start + ticks) {
+        until = start + ticks;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + (until - now) * 1000000ULL;
+    ts.tv_sec += (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    pthread_cond_timedwait(cond, lock, &ts);
+    exit_if_deleted(lock);
+    return true;
+}
+
+
+
+
+// #####################################
+// MARK: Critical Sections
+// #####################################
+
+static void critical_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void host_critical_enter(void) {
+    pthread_once(&s_critical_once, critical_init);
+    pthread_mutex_lock(&s_critical);
+}
+
+void host_critical_exit(void) {
+    pthread_mutex_unlock(&s_critical);
+}
+
+
+
+
+// #####################################
+// MARK: Tasks
+// #####################################
+
+static struct host_task* task_new(void) {
+    struct host_task* task = calloc(1, sizeof(*task));
+    if (task != NULL) {
+        pthread_mutex_init(&task->lock, NULL);
+        pthread_cond_init(&task->cond, NULL);
+    }
+    return task;
+}
+
+static void* task_main(void* arg) {
+    struct host_task* task = (struct host_task*)arg;
+    s_current = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_size, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    struct host_task* task = task_new();
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (handle != NULL) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    // Threads get the default pthread stack, nothing to report
+    (void)task;
+    return 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (s_current == NULL) {
+        // A thread not created through xTaskCreate, e.g. the test's main()
+        s_current = task_new();
+        s_current->thread = pthread_self();
+    }
+    return s_current;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == s_current) {
+        pthread_exit(NULL);
+    }
+    task->deleted = true;
+    pthread_join(task->thread, NULL);
+    pthread_cond_destroy(&task->cond);
+    pthread_mutex_destroy(&task->lock);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    uint64_t start = now_ms();
+    while (now_ms() - start < ticks) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = WAIT_SLICE_MS * 1000000L };
+        nanosleep(&ts, NULL);
+        exit_if_deleted(NULL);
+    }
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                ret = pdFAIL;
+            } else {
+                task->notify_value = value;
+            }
+            break;
+        default:
+            break;
+    }
+    if (ret == pdPASS) {
+        task->notify_pending = true;
+        pthread_cond_broadcast(&task->cond);
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value,
+                           TickType_t ticks) {
+    struct host_task* task = xTaskGetCurrentTaskHandle();
+    uint64_t start = now_ms();
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    while (!task->notify_pending && wait_slice(&task->cond, &task->lock, start, ticks)) {
+    }
+    if (value != NULL) {
+        *value = task->notify_value;
+    }
+    if (task->notify_pending) {
+        task->notify_pending = false;
+        task->notify_value &= ~clear_on_exit;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct host_task* task = xTaskGetCurrentTaskHandle();
+    uint64_t start = now_ms();
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_value == 0 && wait_slice(&task->cond, &task->lock, start, ticks)) {
+    }
+    uint32_t value = task->notify_value;
+    if (value > 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+
+
+
+// #####################################
+// MARK: Queues
+// #####################################
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue* queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->items = calloc(length, item_size);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    uint64_t start = now_ms();
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && wait_slice(&queue->cond, &queue->lock, start, ticks)) {
+    }
+    if (queue->count < queue->length) {
+        size_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    uint64_t start = now_ms();
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && wait_slice(&queue->cond, &queue->lock, start, ticks)) {
+    }
+    if (queue->count > 0) {
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = (UBaseType_t)queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+
+
+
+// #####################################
+// MARK: Semaphores
+// #####################################
+
+static SemaphoreHandle_t semaphore_new(unsigned int count) {
+    struct host_semaphore* sem = calloc(1, sizeof(*sem));
+    if (sem == NULL) {
+        return NULL;
+    }
+    sem->count = count;
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_new(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return semaphore_new(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    uint64_t start = now_ms();
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0 && wait_slice(&sem->cond, &sem->lock, start, ticks)) {
+    }
+    if (sem->count > 0) {
+        sem->count--;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count == 0) {
+        sem->count = 1;
+        pthread_cond_broadcast(&sem->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    if (sem == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+
+
+
+// #####################################
+// MARK: Event Groups
+// #####################################
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct host_event_group* group = calloc(1, sizeof(*group));
+    if (group == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->cond, NULL);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    if (group == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t value = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t value = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t value = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+/**
+ * @brief Wait condition of xEventGroupWaitBits() (caller holds the group lock)
+ */
+static bool bits_met(const struct host_event_group* group, EventBits_t bits, BaseType_t wait_all) {
+    return wait_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_all, TickType_t ticks) {
+    uint64_t start = now_ms();
+
+    pthread_mutex_lock(&group->lock);
+    while (!bits_met(group, bits, wait_all) && wait_slice(&group->cond, &group->lock, start, ticks)) {
+    }
+    EventBits_t value = group->bits;
+    if (clear_on_exit && bits_met(group, bits, wait_all)) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
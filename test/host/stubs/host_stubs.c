@@ -0,0 +1,72 @@
+/**
+ * @file host_stubs.c
+ * @brief Host stand-ins for the ESP-IDF functions used by the tested modules
+ */
+
+#include "host_stubs.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "mbedtls/base64.h"
+#include <time.h>
+
+static uint32_t s_random_state = 1;
+static int64_t s_timer_us = 0;
+
+void host_random_seed(uint32_t seed) {
+    s_random_state = (seed != 0) ? seed : 1;
+}
+
+uint32_t esp_random(void) {
+    // xorshift32, reproducible across runs
+    s_random_state ^= s_random_state << 13;
+    s_random_state ^= s_random_state >> 17;
+    s_random_state ^= s_random_state << 5;
+    return s_random_state;
+}
+
+void host_timer_set_us(int64_t now_us) {
+    s_timer_us = now_us;
+}
+
+int64_t esp_timer_get_time(void) {
+    return s_timer_us;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    return (code == ESP_OK) ? "ESP_OK" : "ESP_ERR";
+}
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen,
+                          const unsigned char* src, size_t slen) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t needed = (slen + 2) / 3 * 4;
+    if (dst == NULL || dlen < needed + 1) {
+        *olen = needed + 1;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t chunk = (uint32_t)src[i] << 16;
+        if (i + 1 < slen) {
+            chunk |= (uint32_t)src[i + 1] << 8;
+        }
+        if (i + 2 < slen) {
+            chunk |= src[i + 2];
+        }
+        dst[out++] = (unsigned char)alphabet[(chunk >> 18) & 0x3F];
+        dst[out++] = (unsigned char)alphabet[(chunk >> 12) & 0x3F];
+        dst[out++] = (i + 1 < slen) ? (unsigned char)alphabet[(chunk >> 6) & 0x3F] : '=';
+        dst[out++] = (i + 2 < slen) ? (unsigned char)alphabet[chunk & 0x3F] : '=';
+    }
+    dst[out] = '\0';
+    *olen = out;
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file host_stubs.h
+ * @brief Controls of the host stand-ins for the tests
+ */
+
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+#include "esp_system.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Restart esp_random() from a seed
+ */
+void host_random_seed(uint32_t seed);
+
+/**
+ * @brief Set the value esp_timer_get_time() returns
+ */
+void host_timer_set_us(int64_t now_us);
+
+/**
+ * @brief Back the partition API with a fresh, erased file
+ *
+ * @param path File holding the partition contents, truncated
+ * @param label Partition label esp_partition_find_first() matches
+ * @param subtype Data subtype esp_partition_find_first() matches
+ * @param size Partition size, a multiple of 4 KB
+ * @return true when the file was created
+ */
+bool host_partition_attach(const char* path, const char* label, int subtype, uint32_t size);
+
+/**
+ * @brief Close the partition file; esp_partition_find_first() finds nothing afterwards
+ */
+void host_partition_detach(void);
+
+/**
+ * @brief Simulate a power cut after this many more programmed bytes
+ *
+ * The write that crosses the limit is programmed partially and every later
+ * write or erase fails, until the next host_partition_cut_after(SIZE_MAX).
+ */
+void host_partition_cut_after(size_t bytes);
+
+/**
+ * @brief Set the value esp_reset_reason() returns
+ */
+void host_reset_reason_set(esp_reset_reason_t reason);
+
+/**
+ * @brief What the fake MQTT broker (mqtt_host.c) received
+ */
+typedef struct {
+    size_t publishes;               ///< esp_mqtt_client_publish() calls accepted
+    size_t payload_bytes;           ///< Payload bytes of those calls
+    char last_topic[128];
+    char last_payload[512];         ///< Truncated to fit
+} host_mqtt_stats_t;
+
+/**
+ * @brief Client created by the last esp_mqtt_client_init(), NULL once destroyed
+ */
+struct esp_mqtt_client* host_mqtt_client(void);
+
+/**
+ * @brief Send MQTT_EVENT_PUBLISHED for every QoS 1/2 message still pending
+ *
+ * @return Number of acknowledged messages
+ */
+size_t host_mqtt_ack_all(void);
+
+/**
+ * @brief Forget pending QoS 1/2 messages without acknowledging them
+ */
+void host_mqtt_drop_pending(void);
+
+/**
+ * @brief Copy the fake broker's counters
+ */
+void host_mqtt_get_stats(host_mqtt_stats_t* stats);
+
+/**
+ * @brief What the fake HTTP client (http_client_host.c) was asked to do
+ */
+typedef struct {
+    size_t performs;                ///< esp_http_client_perform() calls
+    size_t set_url_calls;           ///< URL parses, including init and redirects
+    size_t header_sets;             ///< esp_http_client_set_header() calls
+    size_t last_body_len;
+    char last_url[256];
+} host_http_stats_t;
+
+/**
+ * @brief Status code the next perform() calls answer with (default 204)
+ */
+void host_http_set_status(int status);
+
+/**
+ * @brief Let the next perform() redirect to location before it answers
+ */
+void host_http_redirect_next(const char* location);
+
+/**
+ * @brief Header value on the last created client, NULL if not set
+ */
+const char* host_http_header(const char* key);
+
+/**
+ * @brief Copy or clear the fake HTTP client's counters
+ */
+void host_http_get_stats(host_http_stats_t* stats);
+void host_http_reset_stats(void);
+
+#endif // HOST_STUBS_H
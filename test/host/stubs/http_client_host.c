@@ -0,0 +1,267 @@
+/**
+ * @file http_client_host.c
+ * @brief Host stand-in for esp_http_client: keeps the request, answers perform() from the test
+ *
+ * set_url() splits the URL into scheme, host, port, path and query, and
+ * headers live in a list of heap strings, both updated with calloc/realloc
+ * like esp_http_client's http_utils_assign_string(). That keeps the cost of
+ * re-preparing a request comparable to the target. perform() records the
+ * request and returns the status set with host_http_set_status(), after an
+ * optional HTTP_EVENT_REDIRECT that replaces the URL.
+ */
+
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "host_stubs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct http_header {
+    char* key;
+    char* value;
+    struct http_header* next;
+} http_header_t;
+
+struct esp_http_client {
+    http_event_handle_cb handler;
+    void* user_data;
+    char* scheme;
+    char* host;
+    int port;
+    char* path;
+    char* query;
+    http_header_t* headers;
+    const char* post_data;
+    int post_len;
+    int status_code;
+};
+
+static esp_http_client_handle_t s_client = NULL;
+static host_http_stats_t s_stats;
+static int s_status = 204;
+static char s_redirect[256];
+
+
+
+
+// #####################################
+// MARK: Request State
+// #####################################
+
+/**
+ * @brief Replace a heap string with len bytes of value (len < 0: strlen)
+ */
+static esp_err_t assign_string(char** str, const char* value, int len) {
+    size_t n = (len < 0) ? strlen(value) : (size_t)len;
+    char* buf = (*str == NULL) ? calloc(1, n + 1) : realloc(*str, n + 1);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(buf, value, n);
+    buf[n] = '\0';
+    *str = buf;
+    return ESP_OK;
+}
+
+static http_header_t* find_header(esp_http_client_handle_t client, const char* key) {
+    for (http_header_t* h = client->headers; h != NULL; h = h->next) {
+        if (strcasecmp(h->key, key) == 0) {
+            return h;
+        }
+    }
+    return NULL;
+}
+
+static void dispatch(esp_http_client_handle_t client, esp_http_client_event_id_t id) {
+    esp_http_client_event_t event = {
+        .event_id = id,
+        .client = client,
+        .user_data = client->user_data,
+    };
+    if (client->handler != NULL) {
+        client->handler(&event);
+    }
+}
+
+
+
+
+// #####################################
+// MARK: Client API
+// #####################################
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->handler = config->event_handler;
+    client->user_data = config->user_data;
+    if (config->url != NULL && esp_http_client_set_url(client, config->url) != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return NULL;
+    }
+    s_client = client;
+    return client;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    while (client->headers != NULL) {
+        esp_http_client_delete_header(client, client->headers->key);
+    }
+    free(client->scheme);
+    free(client->host);
+    free(client->path);
+    free(client->query);
+    if (s_client == client) {
+        s_client = NULL;
+    }
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char* url) {
+    s_stats.set_url_calls++;
+    const char* host = strstr(url, "://");
+    if (host == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = assign_string(&client->scheme, url, (int)(host - url));
+    host += 3;
+
+    const char* path = strchr(host, '/');
+    const char* host_end = (path != NULL) ? path : host + strlen(host);
+    const char* colon = memchr(host, ':', (size_t)(host_end - host));
+    err |= assign_string(&client->host, host, (int)((colon != NULL ? colon : host_end) - host));
+    client->port = (colon != NULL) ? atoi(colon + 1) : (strcmp(client->scheme, "https") == 0 ? 443 : 80);
+
+    const char* query = (path != NULL) ? strchr(path, '?') : NULL;
+    if (path != NULL) {
+        err |= assign_string(&client->path, path, (int)((query != NULL ? query : path + strlen(path)) - path));
+    } else {
+        err |= assign_string(&client->path, "/", -1);
+    }
+    if (query != NULL) {
+        err |= assign_string(&client->query, query + 1, -1);
+    } else {
+        free(client->query);
+        client->query = NULL;
+    }
+    return err;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    s_stats.header_sets++;
+    http_header_t* h = find_header(client, key);
+    if (h != NULL) {
+        return assign_string(&h->value, value, -1);
+    }
+    h = calloc(1, sizeof(*h));
+    if (h == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (assign_string(&h->key, key, -1) != ESP_OK || assign_string(&h->value, value, -1) != ESP_OK) {
+        free(h->key);
+        free(h);
+        return ESP_ERR_NO_MEM;
+    }
+    h->next = client->headers;
+    client->headers = h;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char* key) {
+    for (http_header_t** link = &client->headers; *link != NULL; link = &(*link)->next) {
+        if (strcasecmp((*link)->key, key) == 0) {
+            http_header_t* h = *link;
+            *link = h->next;
+            free(h->key);
+            free(h->value);
+            free(h);
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char* data, int len) {
+    client->post_data = data;
+    client->post_len = len;
+    // esp_http_client defaults the body type like a form post
+    if (data != NULL && find_header(client, "Content-Type") == NULL) {
+        return esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    dispatch(client, HTTP_EVENT_ON_CONNECTED);
+    if (s_redirect[0] != '\0') {
+        esp_err_t err = esp_http_client_set_url(client, s_redirect);
+        s_redirect[0] = '\0';
+        if (err != ESP_OK) {
+            return err;
+        }
+        dispatch(client, HTTP_EVENT_REDIRECT);
+    }
+    dispatch(client, HTTP_EVENT_HEADER_SENT);
+
+    s_stats.performs++;
+    s_stats.last_body_len = (size_t)client->post_len;
+    snprintf(s_stats.last_url, sizeof(s_stats.last_url), "%s://%s:%d%s%s%s", client->scheme,
+             client->host, client->port, client->path, client->query != NULL ? "?" : "",
+             client->query != NULL ? client->query : "");
+    client->status_code = s_status;
+    dispatch(client, HTTP_EVENT_ON_FINISH);
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status_code;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    (void)client;
+    return ESP_OK;
+}
+
+esp_err_t esp_crt_bundle_attach(void* conf) {
+    (void)conf;
+    return ESP_OK;
+}
+
+
+
+
+// #####################################
+// MARK: Test Controls
+// #####################################
+
+void host_http_set_status(int status) {
+    s_status = status;
+}
+
+void host_http_redirect_next(const char* location) {
+    snprintf(s_redirect, sizeof(s_redirect), "%s", location);
+}
+
+const char* host_http_header(const char* key) {
+    if (s_client == NULL) {
+        return NULL;
+    }
+    http_header_t* h = find_header(s_client, key);
+    return (h != NULL) ? h->value : NULL;
+}
+
+void host_http_get_stats(host_http_stats_t* stats) {
+    *stats = s_stats;
+}
+
+void host_http_reset_stats(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+}
@@ -0,0 +1,16 @@
+/**
+ * @file base64.h
+ * @brief Host stand-in for the mbedTLS base64 encoder
+ */
+
+#ifndef HOST_MBEDTLS_BASE64_H
+#define HOST_MBEDTLS_BASE64_H
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL     -0x002A
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen,
+                          const unsigned char* src, size_t slen);
+
+#endif // HOST_MBEDTLS_BASE64_H
@@ -0,0 +1,124 @@
+/**
+ * @file mqtt_host.c
+ * @brief Host stand-in for esp-mqtt: a fake broker that records publishes
+ *
+ * start() connects at once. Publishes are not copied into a client-side
+ * outbox (esp-mqtt does that for QoS > 0 on the target, the same for every
+ * caller); QoS 1/2 message ids wait for host_mqtt_ack_all().
+ */
+
+#include "mqtt_client.h"
+#include "host_stubs.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PENDING_MAX     64
+
+struct esp_mqtt_client {
+    esp_event_handler_t handler;
+    void* handler_args;
+    int next_msg_id;
+    int pending[PENDING_MAX];
+    size_t pending_count;
+};
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static host_mqtt_stats_t s_stats;
+
+static void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id, int msg_id) {
+    esp_mqtt_error_codes_t error = { 0 };
+    esp_mqtt_event_t event = {
+        .event_id = id,
+        .client = client,
+        .msg_id = msg_id,
+        .error_handle = &error,
+    };
+    if (client->handler != NULL) {
+        client->handler(client->handler_args, "MQTT_EVENTS", id, &event);
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config) {
+    (void)config;
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    s_client = client;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void* handler_args) {
+    (void)event;
+    client->handler = handler;
+    client->handler_args = handler_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    dispatch(client, MQTT_EVENT_CONNECTED, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+    client->pending_count = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client) {
+    if (client == s_client) {
+        s_client = NULL;
+    }
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data,
+                            int len, int qos, int retain) {
+    (void)retain;
+    if (qos > 0 && client->pending_count == PENDING_MAX) {
+        return -1;
+    }
+    if (len == 0) {
+        len = (int)strlen(data);
+    }
+    client->next_msg_id = (client->next_msg_id % 0xFFFF) + 1;
+    if (qos > 0) {
+        client->pending[client->pending_count++] = client->next_msg_id;
+    }
+
+    s_stats.publishes++;
+    s_stats.payload_bytes += (size_t)len;
+    strncpy(s_stats.last_topic, topic, sizeof(s_stats.last_topic) - 1);
+    size_t copy = ((size_t)len < sizeof(s_stats.last_payload) - 1) ? (size_t)len : sizeof(s_stats.last_payload) - 1;
+    memcpy(s_stats.last_payload, data, copy);
+    s_stats.last_payload[copy] = '\0';
+    return client->next_msg_id;
+}
+
+esp_mqtt_client_handle_t host_mqtt_client(void) {
+    return s_client;
+}
+
+size_t host_mqtt_ack_all(void) {
+    if (s_client == NULL) {
+        return 0;
+    }
+    // Handlers may publish again, acknowledge only what was pending on entry
+    size_t count = s_client->pending_count;
+    int ids[PENDING_MAX];
+    memcpy(ids, s_client->pending, count * sizeof(ids[0]));
+    s_client->pending_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        dispatch(s_client, MQTT_EVENT_PUBLISHED, ids[i]);
+    }
+    return count;
+}
+
+void host_mqtt_drop_pending(void) {
+    if (s_client != NULL) {
+        s_client->pending_count = 0;
+    }
+}
+
+void host_mqtt_get_stats(host_mqtt_stats_t* stats) {
+    *stats = s_stats;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file nvs_host.c
+ * @brief Host stand-in for drivers/nvs: blobs kept in RAM for the process lifetime
+ */
+
+#include "drivers/nvs/nvs.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTRIES_MAX     64
+#define NAME_MAX_LEN    16
+
+typedef struct {
+    bool used;
+    char ns[NAME_MAX_LEN];
+    char key[NAME_MAX_LEN];
+    void* data;
+    size_t size;
+} nvs_entry_t;
+
+static nvs_entry_t s_entries[ENTRIES_MAX];
+
+static nvs_entry_t* find(const char* ns, const char* key) {
+    for (size_t i = 0; i < ENTRIES_MAX; i++) {
+        if (s_entries[i].used && strncmp(s_entries[i].ns, ns, NAME_MAX_LEN) == 0 &&
+            strncmp(s_entries[i].key, key, NAME_MAX_LEN) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_driver_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_driver_save(const char* ns, const char* key, const void* data, size_t size) {
+    if (ns == NULL || key == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_entry_t* entry = find(ns, key);
+    for (size_t i = 0; entry == NULL && i < ENTRIES_MAX; i++) {
+        if (!s_entries[i].used) {
+            entry = &s_entries[i];
+            entry->used = true;
+            strncpy(entry->ns, ns, NAME_MAX_LEN - 1);
+            strncpy(entry->key, key, NAME_MAX_LEN - 1);
+        }
+    }
+    if (entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    void* copy = malloc(size > 0 ? size : 1);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, size);
+    free(entry->data);
+    entry->data = copy;
+    entry->size = size;
+    return ESP_OK;
+}
+
+esp_err_t nvs_driver_load(const char* ns, const char* key, void* data, size_t size) {
+    nvs_entry_t* entry = find(ns, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (entry->size != size) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(data, entry->data, size);
+    return ESP_OK;
+}
+
+esp_err_t nvs_driver_load_sized(const char* ns, const char* key, void* data, size_t* size) {
+    nvs_entry_t* entry = find(ns, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (entry->size > *size) {
+        *size = entry->size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(data, entry->data, entry->size);
+    *size = entry->size;
+    return ESP_OK;
+}
+
+esp_err_t nvs_driver_erase_key(const char* ns, const char* key) {
+    nvs_entry_t* entry = find(ns, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    free(entry->data);
+    memset(entry, 0, sizeof(*entry));
+    return ESP_OK;
+}
+
+esp_err_t nvs_driver_erase_namespace(const char* ns) {
+    for (size_t i = 0; i < ENTRIES_MAX; i++) {
+        if (s_entries[i].used && strncmp(s_entries[i].ns, ns, NAME_MAX_LEN) == 0) {
+            free(s_entries[i].data);
+            memset(&s_entries[i], 0, sizeof(s_entries[i]));
+        }
+    }
+    return ESP_OK;
+}
+
+bool nvs_driver_key_exists(const char* ns, const char* key) {
+    return find(ns, key) != NULL;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file partition_host.c
+ * @brief Host stand-in for the partition API, backed by a file
+ *
+ * The file holds the partition contents. Writes only clear bits and erases
+ * set whole sectors to 0xFF, like NOR flash. A write budget simulates a
+ * power cut: the write that exceeds it is programmed partially and fails,
+ * as does every write after it.
+ */
+
+#include "host_stubs.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE     4096
+#define MAP_SLOTS       4
+
+static FILE* s_file = NULL;
+static esp_partition_t s_partition;
+static size_t s_write_budget = SIZE_MAX;
+static void* s_maps[MAP_SLOTS];
+static esp_reset_reason_t s_reset_reason = ESP_RST_POWERON;
+
+
+
+
+// #####################################
+// MARK: Controls
+// #####################################
+
+bool host_partition_attach(const char* path, const char* label, int subtype, uint32_t size) {
+    host_partition_detach();
+    s_file = fopen(path, "w+b");
+    if (s_file == NULL) {
+        return false;
+    }
+
+    // Factory state of a never written partition
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (uint32_t pos = 0; pos < size; pos += SECTOR_SIZE) {
+        fwrite(erased, 1, (size - pos < SECTOR_SIZE) ? size - pos : SECTOR_SIZE, s_file);
+    }
+    fflush(s_file);
+
+    memset(&s_partition, 0, sizeof(s_partition));
+    s_partition.type = ESP_PARTITION_TYPE_DATA;
+    s_partition.subtype = subtype;
+    s_partition.address = 0x100000;
+    s_partition.size = size;
+    strncpy(s_partition.label, label, sizeof(s_partition.label) - 1);
+    s_write_budget = SIZE_MAX;
+    return true;
+}
+
+void host_partition_detach(void) {
+    if (s_file != NULL) {
+        fclose(s_file);
+        s_file = NULL;
+    }
+}
+
+void host_partition_cut_after(size_t bytes) {
+    s_write_budget = bytes;
+}
+
+void host_reset_reason_set(esp_reset_reason_t reason) {
+    s_reset_reason = reason;
+}
+
+esp_reset_reason_t esp_reset_reason(void) {
+    return s_reset_reason;
+}
+
+
+
+
+// #####################################
+// MARK: Partition API
+// #####################################
+
+static bool in_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    return s_file != NULL && partition == &s_partition && offset <= partition->size &&
+           size <= partition->size - offset;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    if (s_file == NULL || type != s_partition.type || subtype != s_partition.subtype ||
+        (label != NULL && strcmp(label, s_partition.label) != 0)) {
+        return NULL;
+    }
+    return &s_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (dst == NULL || !in_range(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fseek(s_file, (long)offset, SEEK_SET) != 0 || fread(dst, 1, size, s_file) != size) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    if (src == NULL || !in_range(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t n = (size < s_write_budget) ? size : s_write_budget;
+    if (s_write_budget != SIZE_MAX) {
+        s_write_budget -= n;
+    }
+
+    uint8_t* cells = malloc(size > 0 ? size : 1);
+    if (cells == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_partition_read(partition, offset, cells, n);
+    if (err == ESP_OK) {
+        const uint8_t* bytes = (const uint8_t*)src;
+        for (size_t i = 0; i < n; i++) {
+            cells[i] &= bytes[i];
+        }
+        if (fseek(s_file, (long)offset, SEEK_SET) != 0 || fwrite(cells, 1, n, s_file) != n) {
+            err = ESP_FAIL;
+        }
+        fflush(s_file);
+    }
+    free(cells);
+    if (err == ESP_OK && n < size) {
+        err = ESP_FAIL;     // Power cut in the middle of this write
+    }
+    return err;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (!in_range(partition, offset, size) || offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_budget == 0) {
+        return ESP_FAIL;
+    }
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    if (fseek(s_file, (long)offset, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    for (size_t done = 0; done < size; done += SECTOR_SIZE) {
+        if (fwrite(erased, 1, SECTOR_SIZE, s_file) != SECTOR_SIZE) {
+            return ESP_FAIL;
+        }
+    }
+    fflush(s_file);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void** out_ptr,
+                             spi_flash_mmap_handle_t* out_handle) {
+    (void)memory;
+    if (out_ptr == NULL || out_handle == NULL || !in_range(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t slot = 0; slot < MAP_SLOTS; slot++) {
+        if (s_maps[slot] != NULL) {
+            continue;
+        }
+        // A snapshot: the log appends nothing while a reader is open
+        void* copy = malloc(size);
+        if (copy == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (esp_partition_read(partition, offset, copy, size) != ESP_OK) {
+            free(copy);
+            return ESP_FAIL;
+        }
+        s_maps[slot] = copy;
+        *out_ptr = copy;
+        *out_handle = slot;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle) {
+    if (handle < MAP_SLOTS) {
+        free(s_maps[handle]);
+        s_maps[handle] = NULL;
+    }
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
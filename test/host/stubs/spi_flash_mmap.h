@@ -0,0 +1,15 @@
+/**
+ * @file spi_flash_mmap.h
+ * @brief Host stand-in for the flash mapping handle
+ */
+
+#ifndef HOST_SPI_FLASH_MMAP_H
+#define HOST_SPI_FLASH_MMAP_H
+
+#include <stdint.h>
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle);
+
+#endif // HOST_SPI_FLASH_MMAP_H
@@ -0,0 +1,205 @@
+/**
+ * @file test_adaptive_sleep.c
+ * @brief Host replay of the adaptive sleep interval against a fixed schedule
+ *
+ * Two synthetic two-week moisture traces at one-minute resolution: a dry
+ * spell (slow dry-down, faster by day) and an irrigated bed (a 30-minute
+ * watering every other morning, drainage to field capacity, dry-down). The
+ * scheduler sees the trace plus sensor noise at the times it chose, through
+ * a stubbed clock. Between samples the series is rebuilt by linear
+ * interpolation, as a dashboard would draw it; samples taken and the max/RMS
+ * error against the trace are printed next to the fixed 60-minute schedule
+ * and a fixed schedule with as many samples as the adaptive one.
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "application/adaptive_sleep.h"
+#include "config/esp32-config.h"
+#include "esp_random.h"
+#include <math.h>
+#include <string.h>
+
+#define TRACE_MINUTES       (14 * 24 * 60)
+#define SAMPLES_MAX         TRACE_MINUTES
+#define FIXED_INTERVAL_S    (60 * 60)
+#define NOISE_PERCENT       0.05f       ///< Uniform sensor noise, +-
+#define BATTERY_PERCENT     80.0f
+#define START_MS            1700000000000ULL
+
+static float s_trace[TRACE_MINUTES + 1];
+static uint64_t s_now_ms;
+
+/**
+ * @brief Recorded samples of one schedule
+ */
+typedef struct {
+    uint32_t t_s[SAMPLES_MAX];
+    float moisture[SAMPLES_MAX];
+    size_t count;
+    uint32_t shortest_sleep_s;
+} schedule_t;
+
+static schedule_t s_adaptive;
+static schedule_t s_fixed;
+static schedule_t s_same_budget;
+
+// The scheduler's clock
+uint64_t esp_utils_get_timestamp_ms(void) {
+    return s_now_ms;
+}
+
+/**
+ * @brief Evaporative demand over the day: low at night, peak in the early afternoon
+ */
+static float day_factor(int minute) {
+    float hour = (float)(minute % (24 * 60)) / 60.0f;
+    float sun = sinf((hour - 8.0f) / 12.0f * 3.14159265f);
+    return 0.3f + (sun > 0.0f ? sun : 0.0f);
+}
+
+static void make_dry_spell(void) {
+    float m = 42.0f;
+    for (int k = 0; k <= TRACE_MINUTES; k++) {
+        s_trace[k] = m;
+        m -= 0.0045f / 60.0f * day_factor(k) * (m - 12.0f);
+    }
+}
+
+static void make_irrigation(void) {
+    float m = 32.0f;
+    for (int k = 0; k <= TRACE_MINUTES; k++) {
+        s_trace[k] = m;
+        int minute_of_cycle = k % (48 * 60);
+        if (minute_of_cycle >= 6 * 60 && minute_of_cycle < 6 * 60 + 30) {
+            m += 0.5f * (48.0f - m) / 16.0f;        // Watering, saturates towards 48 %
+        } else if (m > 38.0f) {
+            m -= (m - 38.0f) / 90.0f;               // Drainage to field capacity
+        }
+        m -= 0.006f / 60.0f * day_factor(k) * (m - 12.0f);
+    }
+}
+
+static float trace_at(uint32_t t_s) {
+    uint32_t k = t_s / 60;
+    if (k >= TRACE_MINUTES) {
+        return s_trace[TRACE_MINUTES];
+    }
+    float frac = (float)(t_s % 60) / 60.0f;
+    return s_trace[k] + (s_trace[k + 1] - s_trace[k]) * frac;
+}
+
+static float measure(uint32_t t_s) {
+    float noise = ((float)(esp_random() % 2001) / 1000.0f - 1.0f) * NOISE_PERCENT;
+    return trace_at(t_s) + noise;
+}
+
+static void run_adaptive(schedule_t* out) {
+    memset(out, 0, sizeof(*out));
+    adaptive_sleep_reset();
+    host_random_seed(7);
+    out->shortest_sleep_s = UINT32_MAX;
+    uint32_t t = 0;
+    while (t <= TRACE_MINUTES * 60U && out->count < SAMPLES_MAX) {
+        s_now_ms = START_MS + (uint64_t)t * 1000ULL;
+        float m = measure(t);
+        out->t_s[out->count] = t;
+        out->moisture[out->count++] = m;
+        uint32_t sleep_s = adaptive_sleep_next_seconds(m, BATTERY_PERCENT);
+        CHECK(sleep_s >= ADAPTIVE_SLEEP_MIN_SECONDS);
+        CHECK(sleep_s <= ADAPTIVE_SLEEP_MAX_SECONDS);
+        if (sleep_s < out->shortest_sleep_s) {
+            out->shortest_sleep_s = sleep_s;
+        }
+        t += sleep_s;
+    }
+}
+
+static void run_fixed(schedule_t* out, uint32_t interval_s) {
+    memset(out, 0, sizeof(*out));
+    host_random_seed(7);
+    for (uint32_t t = 0; t <= TRACE_MINUTES * 60U; t += interval_s) {
+        out->t_s[out->count] = t;
+        out->moisture[out->count++] = measure(t);
+    }
+}
+
+/**
+ * @brief Error of the linearly interpolated samples against the trace, per minute
+ */
+static void interpolation_error(const schedule_t* s, float* max_err, float* rms_err) {
+    double sum_sq = 0.0;
+    size_t n = 0;
+    size_t seg = 0;
+    *max_err = 0.0f;
+    uint32_t last_t = s->t_s[s->count - 1];
+    for (uint32_t t = 0; t <= last_t; t += 60) {
+        while (seg + 1 < s->count && s->t_s[seg + 1] < t) {
+            seg++;
+        }
+        float rebuilt = s->moisture[seg];
+        if (seg + 1 < s->count && s->t_s[seg + 1] > s->t_s[seg]) {
+            float frac = (float)(t - s->t_s[seg]) / (float)(s->t_s[seg + 1] - s->t_s[seg]);
+            rebuilt += (s->moisture[seg + 1] - s->moisture[seg]) * frac;
+        }
+        float err = fabsf(rebuilt - trace_at(t));
+        *max_err = fmaxf(*max_err, err);
+        sum_sq += (double)err * err;
+        n++;
+    }
+    *rms_err = (float)sqrt(sum_sq / (double)n);
+}
+
+typedef struct {
+    size_t samples;
+    float max_err;
+    float rms_err;
+} replay_result_t;
+
+static replay_result_t report(const char* trace, const char* name, const schedule_t* s) {
+    replay_result_t r = { .samples = s->count };
+    interpolation_error(s, &r.max_err, &r.rms_err);
+    printf("bench: %-10s %-13s %4zu samples, max error %5.2f %%, RMS %5.3f %%\n",
+           trace, name, r.samples, r.max_err, r.rms_err);
+    return r;
+}
+
+/**
+ * @brief Replay the current trace: adaptive, fixed 60 minutes, fixed with the adaptive sample count
+ */
+static void replay(const char* trace, replay_result_t* adaptive, replay_result_t* fixed,
+                   replay_result_t* same_budget) {
+    run_adaptive(&s_adaptive);
+    run_fixed(&s_fixed, FIXED_INTERVAL_S);
+    run_fixed(&s_same_budget, TRACE_MINUTES * 60U / (uint32_t)(s_adaptive.count - 1));
+    *adaptive = report(trace, "adaptive", &s_adaptive);
+    *fixed = report(trace, "fixed 60m", &s_fixed);
+    *same_budget = report(trace, "fixed, same n", &s_same_budget);
+}
+
+static void test_dry_spell(void) {
+    replay_result_t adaptive, fixed, same_budget;
+    make_dry_spell();
+    replay("dry spell", &adaptive, &fixed, &same_budget);
+
+    // Stable soil: never below the start interval, far fewer wakes, error well inside the target delta
+    CHECK(adaptive.samples * 2 < fixed.samples);
+    CHECK(adaptive.max_err < ADAPTIVE_SLEEP_TARGET_DELTA_PERCENT / 4.0f);
+    CHECK(s_adaptive.shortest_sleep_s >= DEEP_SLEEP_DURATION_SECONDS);
+}
+
+static void test_irrigation(void) {
+    replay_result_t adaptive, fixed, same_budget;
+    make_irrigation();
+    replay("irrigation", &adaptive, &fixed, &same_budget);
+
+    // Watering shortens the interval, the dry-down in between runs at the maximum
+    CHECK(s_adaptive.shortest_sleep_s < ADAPTIVE_SLEEP_MAX_SECONDS / 2);
+    CHECK(adaptive.samples * 2 < fixed.samples);
+}
+
+int main(void) {
+    RUN_TEST(test_dry_spell);
+    RUN_TEST(test_irrigation);
+    return TEST_RESULT();
+}
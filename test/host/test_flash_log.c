@@ -0,0 +1,228 @@
+/**
+ * @file test_flash_log.c
+ * @brief Host tests of the flash record log on a file-backed partition
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "drivers/flash_log/flash_log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_FILE        "flash_log_test.bin"
+#define LOG_SECTORS     6           ///< Two superblock sectors and four data sectors
+#define HDR_LEN         12          ///< Record header in flash_log.c
+
+static void make_payload(uint8_t* buf, uint32_t tag, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(tag * 7u + i);
+    }
+}
+
+static bool payload_matches(const flash_log_record_t* record, uint32_t tag, size_t len) {
+    uint8_t expected[512];
+    make_payload(expected, tag, len);
+    return record->len == len && memcmp(record->data, expected, len) == 0;
+}
+
+static void append_tagged(uint32_t tag, size_t len) {
+    uint8_t buf[512];
+    make_payload(buf, tag, len);
+    CHECK_EQ(flash_log_append(buf, len), ESP_OK);
+}
+
+static void open_fresh_log(void) {
+    CHECK(host_partition_attach(LOG_FILE, FLASH_LOG_PARTITION_LABEL, FLASH_LOG_PARTITION_SUBTYPE,
+                                LOG_SECTORS * 4096));
+    host_reset_reason_set(ESP_RST_POWERON);
+    CHECK_EQ(flash_log_init(), ESP_OK);
+}
+
+static void reboot(esp_reset_reason_t reason) {
+    CHECK_EQ(flash_log_deinit(), ESP_OK);
+    host_reset_reason_set(reason);
+    CHECK_EQ(flash_log_init(), ESP_OK);
+}
+
+static void close_log(void) {
+    CHECK_EQ(flash_log_deinit(), ESP_OK);
+    host_partition_detach();
+    remove(LOG_FILE);
+}
+
+static void test_append_and_read(void) {
+    open_fresh_log();
+    CHECK_EQ(flash_log_count(), 0);
+    for (uint32_t i = 1; i <= 10; i++) {
+        append_tagged(i, i * 20);
+    }
+    CHECK_EQ(flash_log_count(), 10);
+
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    uint8_t byte = 0;
+    CHECK_EQ(flash_log_append(&byte, 1), ESP_ERR_INVALID_STATE);
+    for (uint32_t i = 1; i <= 10; i++) {
+        CHECK(flash_log_reader_next(&reader, &record));
+        CHECK_EQ(record.seq, i);
+        CHECK(payload_matches(&record, i, i * 20));
+    }
+    CHECK(!flash_log_reader_next(&reader, &record));
+    CHECK_EQ(flash_log_deinit(), ESP_ERR_INVALID_STATE);
+    flash_log_reader_end(&reader);
+    close_log();
+}
+
+static void test_consume(void) {
+    open_fresh_log();
+    for (uint32_t i = 1; i <= 10; i++) {
+        append_tagged(i, 64);
+    }
+    CHECK_EQ(flash_log_consume(4), ESP_OK);
+    CHECK_EQ(flash_log_count(), 6);
+
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    CHECK(flash_log_reader_next(&reader, &record));
+    CHECK_EQ(record.seq, 5);
+    CHECK(payload_matches(&record, 5, 64));
+    flash_log_reader_end(&reader);
+
+    // Past the head: everything goes, sequence numbers keep counting
+    CHECK_EQ(flash_log_consume(100), ESP_OK);
+    CHECK_EQ(flash_log_count(), 0);
+    append_tagged(11, 64);
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.next_seq, 12);
+    close_log();
+}
+
+static void test_recover_after_reset(void) {
+    open_fresh_log();
+    for (uint32_t i = 1; i <= 5; i++) {
+        append_tagged(i, 300);
+    }
+    CHECK_EQ(flash_log_consume(2), ESP_OK);
+
+    // Any reset but deep sleep scans the partition from the superblock
+    reboot(ESP_RST_POWERON);
+    CHECK_EQ(flash_log_count(), 3);
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    for (uint32_t i = 3; i <= 5; i++) {
+        CHECK(flash_log_reader_next(&reader, &record));
+        CHECK_EQ(record.seq, i);
+        CHECK(payload_matches(&record, i, 300));
+    }
+    CHECK(!flash_log_reader_next(&reader, &record));
+    flash_log_reader_end(&reader);
+
+    // A deep-sleep wake resumes from RTC memory
+    reboot(ESP_RST_DEEPSLEEP);
+    CHECK_EQ(flash_log_count(), 3);
+    append_tagged(6, 300);
+    CHECK_EQ(flash_log_count(), 4);
+    close_log();
+}
+
+static void test_full_ring_drops_oldest(void) {
+    open_fresh_log();
+    const uint32_t appended = 200;
+    for (uint32_t i = 1; i <= appended; i++) {
+        append_tagged(i, 200);
+    }
+
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK(stats.count > 0);
+    CHECK(stats.count < appended);
+    CHECK_EQ(stats.dropped, appended - stats.count);
+
+    reboot(ESP_RST_POWERON);
+    CHECK_EQ(flash_log_count(), stats.count);
+
+    // The newest records survive, contiguous up to the last append
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    uint32_t expected = appended - stats.count + 1;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    while (flash_log_reader_next(&reader, &record)) {
+        CHECK_EQ(record.seq, expected);
+        CHECK(payload_matches(&record, expected, 200));
+        expected++;
+    }
+    flash_log_reader_end(&reader);
+    CHECK_EQ(expected, appended + 1);
+    close_log();
+}
+
+static void test_torn_write_is_skipped(void) {
+    open_fresh_log();
+    for (uint32_t i = 1; i <= 3; i++) {
+        append_tagged(i, 100);
+    }
+
+    // Power cut after the header and part of the payload
+    host_partition_cut_after(HDR_LEN + 20);
+    uint8_t buf[100];
+    make_payload(buf, 4, sizeof(buf));
+    CHECK(flash_log_append(buf, sizeof(buf)) != ESP_OK);
+    host_partition_cut_after(SIZE_MAX);
+
+    reboot(ESP_RST_POWERON);
+    CHECK_EQ(flash_log_count(), 3);
+    append_tagged(4, 100);
+    append_tagged(5, 100);
+
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    for (uint32_t i = 1; i <= 5; i++) {
+        CHECK(flash_log_reader_next(&reader, &record));
+        CHECK_EQ(record.seq, i);
+        CHECK(payload_matches(&record, i, 100));
+    }
+    CHECK(!flash_log_reader_next(&reader, &record));
+    flash_log_reader_end(&reader);
+    close_log();
+}
+
+static void test_superblock_sectors_alternate(void) {
+    open_fresh_log();
+    // Each consume writes a superblock slot, several times the slots of one sector
+    for (uint32_t i = 1; i <= 400; i++) {
+        append_tagged(i, 32);
+        CHECK_EQ(flash_log_consume(i), ESP_OK);
+    }
+    append_tagged(401, 32);
+
+    reboot(ESP_RST_POWERON);
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.next_seq, 402);
+
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    CHECK(flash_log_reader_next(&reader, &record));
+    CHECK_EQ(record.seq, 401);
+    CHECK(payload_matches(&record, 401, 32));
+    flash_log_reader_end(&reader);
+    close_log();
+}
+
+int main(void) {
+    RUN_TEST(test_append_and_read);
+    RUN_TEST(test_consume);
+    RUN_TEST(test_recover_after_reset);
+    RUN_TEST(test_full_ring_drops_oldest);
+    RUN_TEST(test_torn_write_is_skipped);
+    RUN_TEST(test_superblock_sectors_alternate);
+    return TEST_RESULT();
+}
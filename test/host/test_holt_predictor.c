@@ -0,0 +1,79 @@
+/**
+ * @file test_holt_predictor.c
+ * @brief Host tests of the fixed-point Holt predictor
+ */
+
+#include "test_host.h"
+#include "utils/holt_predictor.h"
+
+#define ALPHA   16384       // 0.5
+#define BETA    8192        // 0.25
+
+static void test_reset_predicts_value(void) {
+    holt_model_t model;
+    holt_reset(&model, 4200);
+    CHECK_EQ(holt_predict(&model, 1), 4200);
+    CHECK_EQ(holt_predict(&model, 10), 4200);
+}
+
+static void test_follows_linear_trend(void) {
+    holt_model_t model;
+    holt_reset(&model, 1000);
+    for (int i = 1; i <= 60; i++) {
+        holt_update(&model, 1000 + 20 * i, ALPHA, BETA);
+    }
+    // Converged on the slope: the next values are predicted within a unit
+    int32_t next = holt_predict(&model, 1);
+    CHECK(next >= 2219 && next <= 2221);
+    int32_t ahead = holt_predict(&model, 5);
+    CHECK(ahead >= 2298 && ahead <= 2302);
+}
+
+static void test_advance_matches_predict(void) {
+    holt_model_t model;
+    holt_reset(&model, 500);
+    for (int i = 1; i <= 10; i++) {
+        holt_update(&model, 500 - 7 * i, ALPHA, BETA);
+    }
+    int32_t predicted = holt_predict(&model, 3);
+    holt_advance(&model);
+    holt_advance(&model);
+    CHECK_EQ(holt_predict(&model, 1), predicted);
+}
+
+static void test_both_sides_agree(void) {
+    // Sensor and hub step the same model on the same inputs
+    holt_model_t sensor, hub;
+    holt_reset(&sensor, -300);
+    holt_reset(&hub, -300);
+    const int32_t readings[] = { -290, -270, -265, -240, -251, -230 };
+    for (unsigned i = 0; i < sizeof(readings) / sizeof(readings[0]); i++) {
+        if (i % 2 == 0) {
+            holt_update(&sensor, readings[i], ALPHA, BETA);
+            holt_update(&hub, readings[i], ALPHA, BETA);
+        } else {
+            holt_advance(&sensor);
+            holt_advance(&hub);
+        }
+    }
+    CHECK_EQ(sensor.level, hub.level);
+    CHECK_EQ(sensor.trend, hub.trend);
+}
+
+static void test_alpha_one_follows_observation(void) {
+    holt_model_t model;
+    holt_reset(&model, 100);
+    holt_update(&model, 250, HOLT_Q15_ONE - 1, 0);
+    int32_t next = holt_predict(&model, 1);
+    CHECK(next >= 249 && next <= 250);
+    CHECK_EQ(model.trend, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_reset_predicts_value);
+    RUN_TEST(test_follows_linear_trend);
+    RUN_TEST(test_advance_matches_predict);
+    RUN_TEST(test_both_sides_agree);
+    RUN_TEST(test_alpha_one_follows_observation);
+    return TEST_RESULT();
+}
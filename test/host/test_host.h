@@ -0,0 +1,40 @@
+/**
+ * @file test_host.h
+ * @brief Minimal assertions for the host tests
+ *
+ * Each test file is its own executable: it runs its cases from main() and
+ * returns TEST_RESULT(), non-zero when a check failed.
+ */
+
+#ifndef TEST_HOST_H
+#define TEST_HOST_H
+
+#include <stdio.h>
+
+static int s_test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        s_test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if (_a != _b) { \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                __FILE__, __LINE__, #a, #b, _a, _b); \
+        s_test_failures++; \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+    int _before = s_test_failures; \
+    fn(); \
+    printf("%s %s\n", (s_test_failures == _before) ? "PASS" : "FAIL", #fn); \
+} while (0)
+
+#define TEST_RESULT() (s_test_failures == 0 ? 0 : 1)
+
+#endif // TEST_HOST_H
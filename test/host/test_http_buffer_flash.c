@@ -0,0 +1,248 @@
+/**
+ * @file test_http_buffer_flash.c
+ * @brief Host tests of the HTTP flash buffer (ts_codec blocks in the flash log)
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "drivers/http/http_buffer.h"
+#include "drivers/flash_log/flash_log.h"
+#include "utils/ts_codec.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_FILE        "http_buffer_test.bin"
+#define LOG_SECTORS     6
+#define DEVICE_ID       "ESP32_TEST"
+#define INTERVAL_MS     600000ULL
+#define SENT_MAX        512
+#define STREAM_MAX      (SENT_MAX * 200)
+#define LIMIT           120         ///< Blocks of 30 samples
+
+static char s_sent[SENT_MAX][256];
+static size_t s_sent_count;
+static size_t s_fail_after;
+static char s_stream[STREAM_MAX];
+
+static http_buffer_sample_t make_sample(uint32_t i) {
+    http_buffer_sample_t sample = {
+        .timestamp_ms = 1700000000000ULL + i * INTERVAL_MS,
+        .soil_mv = 1500 + (int32_t)(i % 3),
+        .moisture_centi = 4200 - (int32_t)i,
+        .raw_adc = 2000 + (int32_t)(i % 5),
+        .battery_mv = 3900,
+        .battery_deci = 800,
+    };
+    return sample;
+}
+
+static void expected_json(uint32_t i, char* buf, size_t cap) {
+    http_buffer_sample_t sample = make_sample(i);
+    CHECK(http_buffer_format_sample(&sample, DEVICE_ID, buf, cap) > 0);
+}
+
+static esp_err_t fake_send(const char* json) {
+    if (s_sent_count >= s_fail_after || s_sent_count >= SENT_MAX) {
+        return ESP_FAIL;
+    }
+    strncpy(s_sent[s_sent_count++], json, sizeof(s_sent[0]) - 1);
+    return ESP_OK;
+}
+
+static void open_buffer(int32_t max_samples) {
+    http_buffer_config_t config = {
+        .max_buffered_packets = max_samples,
+        .enable_buffering = true,
+        .device_id = DEVICE_ID,
+    };
+    CHECK_EQ(http_buffer_init(&config), ESP_OK);
+}
+
+static void open_fresh_buffer(int32_t max_samples) {
+    CHECK(host_partition_attach(LOG_FILE, FLASH_LOG_PARTITION_LABEL, FLASH_LOG_PARTITION_SUBTYPE,
+                                LOG_SECTORS * 4096));
+    host_reset_reason_set(ESP_RST_POWERON);
+    open_buffer(max_samples);
+    CHECK_EQ(http_buffer_clear_all(), ESP_OK);
+    s_sent_count = 0;
+    s_fail_after = SIZE_MAX;
+}
+
+static void close_buffer(void) {
+    http_buffer_deinit();
+    CHECK_EQ(flash_log_deinit(), ESP_OK);
+    host_partition_detach();
+    remove(LOG_FILE);
+}
+
+static void add_samples(uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; i++) {
+        http_buffer_sample_t sample = make_sample(i);
+        CHECK_EQ(http_buffer_add_sample(&sample), ESP_OK);
+    }
+}
+
+static size_t stream_all(void) {
+    size_t len = 0;
+    int n;
+    while ((n = http_buffer_stream_read(&s_stream[len], 100, NULL)) > 0) {
+        len += (size_t)n;
+    }
+    s_stream[len] = '\0';
+    return len;
+}
+
+static void test_stream_replays_all_samples(void) {
+    open_fresh_buffer(LIMIT);
+    add_samples(0, 100);
+    CHECK_EQ(http_buffer_get_count(), 100);
+    CHECK(flash_log_count() > 1);   // Several full blocks in flash
+
+    int32_t count = 0;
+    CHECK_EQ(http_buffer_stream_begin(&count), ESP_OK);
+    CHECK_EQ(count, 100);
+    stream_all();
+
+    char expected[256];
+    const char* line = s_stream;
+    for (uint32_t i = 0; i < 100; i++) {
+        expected_json(i, expected, sizeof(expected));
+        const char* end = strchr(line, '\n');
+        CHECK(end != NULL);
+        if (end == NULL) {
+            break;
+        }
+        CHECK_EQ((size_t)(end - line), strlen(expected));
+        CHECK(strncmp(line, expected, strlen(expected)) == 0);
+        line = end + 1;
+    }
+    CHECK_EQ(*line, '\0');
+
+    CHECK_EQ(http_buffer_stream_end(true), ESP_OK);
+    CHECK_EQ(http_buffer_get_count(), 0);
+    close_buffer();
+}
+
+static void test_unsent_stream_keeps_samples(void) {
+    open_fresh_buffer(1000);
+    add_samples(0, 40);
+
+    int32_t count = 0;
+    CHECK_EQ(http_buffer_stream_begin(&count), ESP_OK);
+    CHECK(http_buffer_stream_read(s_stream, 50, NULL) > 0);
+    CHECK_EQ(http_buffer_stream_end(false), ESP_OK);
+    CHECK_EQ(http_buffer_get_count(), 40);
+
+    // A partly streamed block stays, only blocks streamed completely go
+    CHECK_EQ(http_buffer_stream_begin(&count), ESP_OK);
+    CHECK(http_buffer_stream_read(s_stream, 50, NULL) > 0);
+    CHECK_EQ(http_buffer_stream_end(true), ESP_OK);
+    CHECK_EQ(http_buffer_get_count(), 40);
+    close_buffer();
+}
+
+static void test_flush_keeps_partly_sent_block(void) {
+    open_fresh_buffer(LIMIT);
+    add_samples(0, 100);
+    CHECK_EQ(flash_log_count(), 3);
+
+    s_fail_after = 70;
+    CHECK_EQ(http_buffer_flush_packets(fake_send), ESP_FAIL);
+    CHECK_EQ(s_sent_count, 70);
+    int32_t left = http_buffer_get_count();
+    CHECK_EQ(left, 40);     // The block of samples 60..89 is kept whole
+    CHECK_EQ(flash_log_count(), 2);
+
+    // The rest goes out on the next flush, starting at the kept block
+    s_sent_count = 0;
+    s_fail_after = SIZE_MAX;
+    CHECK_EQ(http_buffer_flush_packets(fake_send), ESP_OK);
+    CHECK_EQ(s_sent_count, (size_t)left);
+    char expected[256];
+    expected_json(99, expected, sizeof(expected));
+    CHECK(strcmp(s_sent[s_sent_count - 1], expected) == 0);
+    expected_json(100 - (uint32_t)left, expected, sizeof(expected));
+    CHECK(strcmp(s_sent[0], expected) == 0);
+    CHECK_EQ(http_buffer_get_count(), 0);
+    close_buffer();
+}
+
+static void test_open_block_survives_deep_sleep(void) {
+    open_fresh_buffer(1000);
+    add_samples(0, 3);
+    CHECK_EQ(flash_log_count(), 0);    // Still in RTC memory
+
+    // Deep sleep: RTC memory and the flash log stay
+    http_buffer_deinit();
+    CHECK_EQ(flash_log_deinit(), ESP_OK);
+    host_reset_reason_set(ESP_RST_DEEPSLEEP);
+    open_buffer(1000);
+    CHECK_EQ(http_buffer_get_count(), 3);
+    add_samples(3, 2);
+
+    CHECK_EQ(http_buffer_flush_packets(fake_send), ESP_OK);
+    CHECK_EQ(s_sent_count, 5);
+    char expected[256];
+    for (uint32_t i = 0; i < 5; i++) {
+        expected_json(i, expected, sizeof(expected));
+        CHECK(strcmp(s_sent[i], expected) == 0);
+    }
+    close_buffer();
+}
+
+static void test_limit_drops_oldest_block(void) {
+    open_fresh_buffer(60);
+    add_samples(0, 200);
+    int32_t count = http_buffer_get_count();
+    CHECK(count <= 60);
+    CHECK(count > 60 - 60 / 4);     // At most one block of a quarter of the limit dropped
+
+    // The newest samples survive, contiguous up to the last one
+    CHECK_EQ(http_buffer_flush_packets(fake_send), ESP_OK);
+    CHECK_EQ(s_sent_count, (size_t)count);
+    char expected[256];
+    for (size_t i = 0; i < s_sent_count; i++) {
+        expected_json(200 - (uint32_t)count + (uint32_t)i, expected, sizeof(expected));
+        CHECK(strcmp(s_sent[i], expected) == 0);
+    }
+    close_buffer();
+}
+
+static void test_blocks_are_smaller_than_json(void) {
+    open_fresh_buffer(1000);
+    add_samples(0, 100);
+    CHECK_EQ(http_buffer_stream_begin(&(int32_t){0}), ESP_OK);
+    size_t json_bytes = stream_all();
+    CHECK_EQ(http_buffer_stream_end(false), ESP_OK);
+
+    flash_log_reader_t reader;
+    flash_log_record_t record;
+    size_t block_bytes = 0;
+    CHECK_EQ(flash_log_reader_begin(&reader), ESP_OK);
+    while (flash_log_reader_next(&reader, &record)) {
+        ts_block_header_t header;
+        CHECK_EQ(ts_block_read_header(record.data, record.len, &header), ESP_OK);
+        block_bytes += record.len;
+    }
+    flash_log_reader_end(&reader);
+    CHECK(block_bytes * 10 < json_bytes);
+    close_buffer();
+}
+
+static void test_json_packets_are_rejected(void) {
+    open_fresh_buffer(1000);
+    CHECK_EQ(http_buffer_add_packet("{}"), ESP_ERR_NOT_SUPPORTED);
+    CHECK_EQ(http_buffer_get_count(), 0);
+    close_buffer();
+}
+
+int main(void) {
+    RUN_TEST(test_stream_replays_all_samples);
+    RUN_TEST(test_unsent_stream_keeps_samples);
+    RUN_TEST(test_flush_keeps_partly_sent_block);
+    RUN_TEST(test_open_block_survives_deep_sleep);
+    RUN_TEST(test_limit_drops_oldest_block);
+    RUN_TEST(test_blocks_are_smaller_than_json);
+    RUN_TEST(test_json_packets_are_rejected);
+    return TEST_RESULT();
+}
@@ -0,0 +1,407 @@
+/**
+ * @file test_hub_influx_aggregator.c
+ * @brief Host tests of the hub InfluxDB aggregator against a fake HTTP backend
+ *
+ * Every sample carries a unique raw_adc value, so the tests can tell from the
+ * recorded bodies which points were written and under which device. The fake
+ * backend can hold a write open (gate) to let backlog build up behind it, and
+ * the benchmark gives it the latency and bandwidth of a slow uplink.
+ */
+
+#include "test_host.h"
+#include "application/hub_influx_aggregator.h"
+#include "config/esp32-config.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FAKE_BODIES_MAX     64
+#define LATENCY_MS          20
+#define WAIT_MS             3000
+#define ID_MAX              4096
+
+#define BENCH_DEVICES       16
+#define BENCH_INTERVAL_US   2000        ///< Offered load: one sample every 2 ms
+#define BENCH_SECONDS       2
+#define UPLINK_RTT_US       30000
+#define UPLINK_BYTES_PER_S  32768
+#define BENCH_ADDS          100000
+
+/**
+ * @brief Fake HTTP backend: records bodies, can hold a write open or act as a slow uplink
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char bodies[FAKE_BODIES_MAX][HUB_AGG_BODY_BYTES];
+    size_t posts;
+    size_t bytes;
+    size_t points;                  ///< Soil/battery line pairs accepted
+    esp_err_t result;
+    bool gate_closed;               ///< Writes wait until the gate opens
+    bool in_write;
+    bool slow_uplink;               ///< Sleep for round trip and transfer time
+} fake_http_t;
+
+static fake_http_t s_http = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static esp_err_t fake_post(const char* body, size_t len, void* ctx) {
+    fake_http_t* http = (fake_http_t*)ctx;
+    pthread_mutex_lock(&http->lock);
+    http->in_write = true;
+    pthread_cond_broadcast(&http->cond);
+    while (http->gate_closed) {
+        pthread_cond_wait(&http->cond, &http->lock);
+    }
+    bool slow = http->slow_uplink;
+    pthread_mutex_unlock(&http->lock);
+
+    if (slow) {
+        uint64_t us = UPLINK_RTT_US + (uint64_t)len * 1000000ULL / UPLINK_BYTES_PER_S;
+        struct timespec ts = { .tv_sec = (time_t)(us / 1000000), .tv_nsec = (long)(us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+
+    pthread_mutex_lock(&http->lock);
+    esp_err_t result = http->result;
+    if (result == ESP_OK) {
+        if (http->posts < FAKE_BODIES_MAX && len < HUB_AGG_BODY_BYTES && strlen(body) == len) {
+            memcpy(http->bodies[http->posts], body, len + 1);
+        }
+        http->posts++;
+        http->bytes += len;
+        for (const char* p = body; (p = strstr(p, "soil_moisture,")) != NULL; p++) {
+            http->points++;
+        }
+    }
+    http->in_write = false;
+    pthread_mutex_unlock(&http->lock);
+    return result;
+}
+
+// Only reached through the default transport, which these tests replace
+esp_err_t influxdb_send_line_protocol(const char* line_protocol) {
+    (void)line_protocol;
+    return ESP_FAIL;
+}
+
+bool influxdb_client_is_initialized(void) {
+    return false;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_us(void) {
+    return now_ns() / 1000ULL;
+}
+
+static void sleep_us(uint64_t us) {
+    struct timespec ts = { .tv_sec = (time_t)(us / 1000000), .tv_nsec = (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void start_aggregator(bool gate_closed) {
+    pthread_mutex_lock(&s_http.lock);
+    s_http.posts = 0;
+    s_http.bytes = 0;
+    s_http.points = 0;
+    s_http.result = ESP_OK;
+    s_http.gate_closed = gate_closed;
+    s_http.in_write = false;
+    s_http.slow_uplink = false;
+    pthread_mutex_unlock(&s_http.lock);
+
+    hub_influx_aggregator_config_t config = {
+        .max_latency_ms = LATENCY_MS,
+        .transport = fake_post,
+        .transport_ctx = &s_http,
+    };
+    CHECK_EQ(hub_influx_aggregator_init(&config), ESP_OK);
+}
+
+static void open_gate(void) {
+    pthread_mutex_lock(&s_http.lock);
+    s_http.gate_closed = false;
+    pthread_cond_broadcast(&s_http.cond);
+    pthread_mutex_unlock(&s_http.lock);
+}
+
+static void set_result(esp_err_t result) {
+    pthread_mutex_lock(&s_http.lock);
+    s_http.result = result;
+    pthread_mutex_unlock(&s_http.lock);
+}
+
+static bool wait_in_write(void) {
+    uint64_t deadline = now_us() + WAIT_MS * 1000ULL;
+    pthread_mutex_lock(&s_http.lock);
+    while (!s_http.in_write && now_us() < deadline) {
+        pthread_mutex_unlock(&s_http.lock);
+        sleep_us(1000);
+        pthread_mutex_lock(&s_http.lock);
+    }
+    bool in_write = s_http.in_write;
+    pthread_mutex_unlock(&s_http.lock);
+    return in_write;
+}
+
+static bool wait_drained(void) {
+    uint64_t deadline = now_us() + WAIT_MS * 1000ULL;
+    hub_influx_aggregator_stats_t stats;
+    do {
+        hub_influx_aggregator_get_stats(&stats);
+        if (stats.pending == 0) {
+            return true;
+        }
+        sleep_us(1000);
+    } while (now_us() < deadline);
+    return false;
+}
+
+static esp_err_t add_sample(int device, int id) {
+    telemetry_sample_t sample = {
+        .timestamp_ms = 1700000000000ULL + (uint64_t)id * 1000ULL,
+        .soil_voltage = 1.5f,
+        .moisture_percent = 40.0f,
+        .soil_raw_adc = id,
+        .battery_voltage = 3.9f,
+        .battery_percent = 80.0f,
+    };
+    snprintf(sample.device_id, sizeof(sample.device_id), "SENSOR_%02d", device);
+    return hub_influx_aggregator_add(&sample);
+}
+
+/**
+ * @brief Points found in the recorded bodies
+ */
+typedef struct {
+    int seen[ID_MAX];               ///< Times each id was written
+    int device[ID_MAX];             ///< Device each id was written for
+    int order[ID_MAX];              ///< Ids in write order
+    size_t count;
+} written_t;
+
+/**
+ * @brief Parse the soil lines of all bodies, check each body is grouped and fits
+ */
+static void collect_written(written_t* out) {
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&s_http.lock);
+    size_t posts = (s_http.posts < FAKE_BODIES_MAX) ? s_http.posts : FAKE_BODIES_MAX;
+    for (size_t b = 0; b < posts; b++) {
+        const char* body = s_http.bodies[b];
+        CHECK(strlen(body) < HUB_AGG_BODY_BYTES);
+        size_t soil = 0;
+        size_t battery = 0;
+        bool in_battery = false;
+        for (const char* line = body; line != NULL && *line != '\0'; ) {
+            int device = -1;
+            int id = -1;
+            if (strncmp(line, "soil_moisture,", 14) == 0) {
+                CHECK(!in_battery);     // Soil lines first, then battery
+                const char* adc = strstr(line, "raw_adc=");
+                CHECK(sscanf(line, "soil_moisture,device=SENSOR_%d", &device) == 1);
+                CHECK(adc != NULL && sscanf(adc, "raw_adc=%d", &id) == 1);
+                if (id >= 0 && id < ID_MAX) {
+                    out->seen[id]++;
+                    out->device[id] = device;
+                    out->order[out->count++] = id;
+                }
+                soil++;
+            } else {
+                CHECK(strncmp(line, "battery,", 8) == 0);
+                in_battery = true;
+                battery++;
+            }
+            line = strchr(line, '\n');
+            line = (line != NULL) ? line + 1 : NULL;
+        }
+        CHECK_EQ(soil, battery);
+    }
+    pthread_mutex_unlock(&s_http.lock);
+}
+
+static void test_shed_keeps_latest_per_device(void) {
+    static written_t written;
+    start_aggregator(true);
+
+    // One sample from each of ten quiet sensors, then a chatty one floods the buffer
+    for (int d = 1; d <= 10; d++) {
+        CHECK_EQ(add_sample(d, d), ESP_OK);
+    }
+    for (int id = 100; id < 100 + 40; id++) {
+        CHECK_EQ(add_sample(0, id), ESP_OK);
+    }
+    CHECK(wait_in_write());         // Write of the first points held open
+    for (int id = 140; id < 100 + 190; id++) {
+        CHECK_EQ(add_sample(0, id), ESP_OK);
+    }
+
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_added, 200);
+    CHECK_EQ(stats.pending, HUB_AGG_MAX_POINTS);
+    CHECK_EQ(stats.points_shed, 200 - HUB_AGG_MAX_POINTS);
+
+    open_gate();
+    CHECK(wait_drained());
+    hub_influx_aggregator_get_stats(&stats);
+    // Points of the held write shed meanwhile count as shed, not as written
+    CHECK_EQ(stats.points_added, stats.points_written + stats.points_shed);
+
+    collect_written(&written);
+    for (int d = 1; d <= 10; d++) {
+        CHECK_EQ(written.seen[d], 1);
+        CHECK_EQ(written.device[d], d);
+    }
+    CHECK_EQ(written.seen[100 + 189], 1);   // The chatty sensor's latest
+    for (int id = 0; id < ID_MAX; id++) {
+        CHECK(written.seen[id] <= 1);
+    }
+    CHECK(written.count >= stats.points_written);
+    hub_influx_aggregator_deinit();
+}
+
+static void test_device_slot_reuse(void) {
+    static written_t written;
+    start_aggregator(false);
+
+    // Every slot holds a device with pending points while the uplink fails
+    set_result(ESP_FAIL);
+    for (int d = 0; d < HUB_AGG_MAX_DEVICES; d++) {
+        CHECK_EQ(add_sample(d, d), ESP_OK);
+    }
+    CHECK_EQ(add_sample(HUB_AGG_MAX_DEVICES, 100), ESP_ERR_NO_MEM);
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_shed, 1);
+    CHECK_EQ(stats.pending, HUB_AGG_MAX_DEVICES);
+
+    // Once written, a new device takes a free slot, known devices keep theirs
+    set_result(ESP_OK);
+    CHECK(wait_drained());
+    CHECK_EQ(add_sample(HUB_AGG_MAX_DEVICES, 101), ESP_OK);
+    CHECK_EQ(add_sample(HUB_AGG_MAX_DEVICES + 1, 102), ESP_OK);
+    CHECK_EQ(add_sample(3, 103), ESP_OK);
+    CHECK(wait_drained());
+
+    collect_written(&written);
+    for (int d = 0; d < HUB_AGG_MAX_DEVICES; d++) {
+        CHECK_EQ(written.seen[d], 1);
+        CHECK_EQ(written.device[d], d);
+    }
+    CHECK_EQ(written.seen[100], 0);
+    CHECK_EQ(written.device[101], HUB_AGG_MAX_DEVICES);
+    CHECK_EQ(written.device[102], HUB_AGG_MAX_DEVICES + 1);
+    CHECK_EQ(written.device[103], 3);
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_written, HUB_AGG_MAX_DEVICES + 3);
+    hub_influx_aggregator_deinit();
+}
+
+static void test_partial_flush_at_body_limit(void) {
+    static written_t written;
+    start_aggregator(true);
+
+    // A full buffer is more than one body
+    for (int id = 1; id <= HUB_AGG_MAX_POINTS; id++) {
+        CHECK_EQ(add_sample(id % 8, id), ESP_OK);
+    }
+    open_gate();
+    CHECK(wait_drained());
+
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_shed, 0);
+    CHECK_EQ(stats.points_written, HUB_AGG_MAX_POINTS);
+    CHECK(stats.flushes >= 3);
+    CHECK(stats.last_flush_bytes < HUB_AGG_BODY_BYTES);
+
+    // Written once each, in order, the remainder of a full body in the next one
+    collect_written(&written);
+    CHECK_EQ(written.count, HUB_AGG_MAX_POINTS);
+    for (size_t i = 0; i < written.count; i++) {
+        CHECK_EQ(written.order[i], (int)i + 1);
+        CHECK_EQ(written.device[i + 1], (int)(i + 1) % 8);
+    }
+    hub_influx_aggregator_deinit();
+}
+
+static void bench_slow_uplink(void) {
+    start_aggregator(false);
+    pthread_mutex_lock(&s_http.lock);
+    s_http.slow_uplink = true;
+    pthread_mutex_unlock(&s_http.lock);
+
+    int adds = 0;
+    uint64_t start = now_us();
+    uint64_t next = start;
+    while (now_us() - start < BENCH_SECONDS * 1000000ULL) {
+        CHECK_EQ(add_sample(adds % BENCH_DEVICES, adds % ID_MAX), ESP_OK);
+        adds++;
+        next += BENCH_INTERVAL_US;
+        if (next > now_us()) {
+            sleep_us(next - now_us());
+        }
+    }
+    CHECK(wait_drained());
+    double seconds = (double)(now_us() - start) / 1e6;
+
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_added, stats.points_written + stats.points_shed);
+    pthread_mutex_lock(&s_http.lock);
+    size_t bytes = s_http.bytes;
+    size_t points = s_http.points;
+    pthread_mutex_unlock(&s_http.lock);
+
+    // Backlog shed while its write is in flight still reaches the server
+    printf("bench: uplink %d ms + %d B/s, offered %.0f points/s from %d devices\n",
+           UPLINK_RTT_US / 1000, UPLINK_BYTES_PER_S, adds / seconds, BENCH_DEVICES);
+    printf("bench: delivered %.0f points/s, %.0f bytes/s in %lu writes (%lu of %lu points)\n",
+           points / seconds, bytes / seconds, (unsigned long)stats.flushes,
+           (unsigned long)points, (unsigned long)stats.points_added);
+    printf("bench: stats written %lu, shed %lu (in flight or lost)\n",
+           (unsigned long)stats.points_written, (unsigned long)stats.points_shed);
+    hub_influx_aggregator_deinit();
+}
+
+static void bench_add_while_shedding(void) {
+    // A write held open keeps the buffer full, every add sheds one point.
+    // Quiet sensors at the front, the victim is behind them.
+    start_aggregator(true);
+    for (int i = 0; i < HUB_AGG_MAX_POINTS; i++) {
+        CHECK_EQ(add_sample((i < BENCH_DEVICES - 1) ? i + 1 : 0, i), ESP_OK);
+    }
+    CHECK(wait_in_write());
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_ADDS; i++) {
+        CHECK_EQ(add_sample(0, i % ID_MAX), ESP_OK);
+    }
+    uint64_t elapsed = now_ns() - start;
+    hub_influx_aggregator_stats_t stats;
+    hub_influx_aggregator_get_stats(&stats);
+    CHECK_EQ(stats.points_shed, BENCH_ADDS);
+    printf("bench: add with a full buffer %.0f ns (%d points, %d quiet devices in front)\n",
+           (double)elapsed / BENCH_ADDS, HUB_AGG_MAX_POINTS, BENCH_DEVICES - 1);
+
+    open_gate();
+    hub_influx_aggregator_deinit();
+}
+
+int main(void) {
+    RUN_TEST(test_shed_keeps_latest_per_device);
+    RUN_TEST(test_device_slot_reuse);
+    RUN_TEST(test_partial_flush_at_body_limit);
+    RUN_TEST(bench_slow_uplink);
+    RUN_TEST(bench_add_while_shedding);
+    return TEST_RESULT();
+}
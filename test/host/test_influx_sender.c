@@ -0,0 +1,161 @@
+/**
+ * @file test_influx_sender.c
+ * @brief Host tests of the batching InfluxDB writer against a fake HTTP backend
+ */
+
+#include "test_host.h"
+#include "application/influx_sender_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define FAKE_BODY_MAX   2048
+#define FAKE_POSTS_MAX  16
+
+/**
+ * @brief Fake HTTP backend: records every POST body, answers with a set result
+ */
+typedef struct {
+    char bodies[FAKE_POSTS_MAX][FAKE_BODY_MAX];
+    size_t posts;
+    esp_err_t result;
+} fake_http_t;
+
+static fake_http_t s_http;
+
+static esp_err_t fake_post(const char* body, size_t len, void* ctx) {
+    fake_http_t* http = (fake_http_t*)ctx;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    portENTER_CRITICAL(&lock);
+    esp_err_t result = http->result;
+    if (http->posts < FAKE_POSTS_MAX && len < FAKE_BODY_MAX && strlen(body) == len) {
+        memcpy(http->bodies[http->posts], body, len + 1);
+    }
+    http->posts++;
+    portEXIT_CRITICAL(&lock);
+    return result;
+}
+
+// Only reached through the default transport, which these tests replace
+esp_err_t influxdb_send_line_protocol(const char* line_protocol) {
+    (void)line_protocol;
+    return ESP_FAIL;
+}
+
+static void start_writer(size_t batch_bytes, uint32_t flush_interval_ms) {
+    memset(&s_http, 0, sizeof(s_http));
+    influx_sender_config_t config = {
+        .batch_bytes = batch_bytes,
+        .flush_interval_ms = flush_interval_ms,
+        .queue_len = 32,
+        .transport = fake_post,
+        .transport_ctx = &s_http,
+    };
+    CHECK_EQ(influx_sender_init(&config), ESP_OK);
+}
+
+static void enqueue_sample(int i) {
+    influxdb_soil_data_t soil = {
+        .timestamp_ns = 1700000000000000000ULL + (uint64_t)i * 600000000000ULL,
+        .voltage = 1.5f,
+        .moisture_percent = 40.0f + (float)i,
+        .raw_adc = 2000 + i,
+    };
+    strcpy(soil.device_id, "ESP32_TEST");
+    influxdb_battery_data_t battery = {
+        .timestamp_ns = soil.timestamp_ns,
+        .voltage = 3.9f,
+        .percentage = 80.0f,
+    };
+    strcpy(battery.device_id, "ESP32_TEST");
+    CHECK_EQ(influx_sender_enqueue_battery(&battery), ESP_OK);
+    CHECK_EQ(influx_sender_enqueue_soil(&soil), ESP_OK);
+}
+
+static size_t count_lines(const char* body) {
+    size_t lines = 1;
+    for (const char* p = body; *p != '\0'; p++) {
+        lines += (*p == '\n');
+    }
+    return lines;
+}
+
+static void test_drain_writes_one_post(void) {
+    start_writer(4096, 60000);
+    for (int i = 0; i < 5; i++) {
+        enqueue_sample(i);
+    }
+    CHECK_EQ(influx_sender_wait_until_empty(1000), ESP_OK);
+    CHECK_EQ(s_http.posts, 1);
+    CHECK_EQ(count_lines(s_http.bodies[0]), 10);
+    CHECK(strncmp(s_http.bodies[0], "battery,device=ESP32_TEST ", 26) == 0);
+    CHECK(strstr(s_http.bodies[0], "\nsoil_moisture,device=ESP32_TEST ") != NULL);
+    CHECK(s_http.bodies[0][strlen(s_http.bodies[0]) - 1] != '\n');
+
+    influx_sender_stats_t stats;
+    CHECK_EQ(influx_sender_get_stats(&stats), ESP_OK);
+    CHECK_EQ(stats.points_enqueued, 10);
+    CHECK_EQ(stats.points_written, 10);
+    CHECK_EQ(stats.batches_written, 1);
+    CHECK_EQ(stats.points_dropped, 0);
+
+    // Nothing left: a second drain does not POST
+    CHECK_EQ(influx_sender_wait_until_empty(1000), ESP_OK);
+    CHECK_EQ(s_http.posts, 1);
+    influx_sender_deinit();
+}
+
+static void test_size_trigger_splits_batches(void) {
+    start_writer(512, 60000);
+    for (int i = 0; i < 8; i++) {
+        enqueue_sample(i);
+    }
+    CHECK_EQ(influx_sender_wait_until_empty(1000), ESP_OK);
+    CHECK(s_http.posts > 1);
+
+    size_t lines = 0;
+    for (size_t i = 0; i < s_http.posts; i++) {
+        CHECK(strlen(s_http.bodies[i]) < 512);
+        lines += count_lines(s_http.bodies[i]);
+    }
+    CHECK_EQ(lines, 16);
+    influx_sender_deinit();
+}
+
+static void test_failed_post_is_kept_for_retry(void) {
+    start_writer(4096, 60000);
+    s_http.result = ESP_ERR_TIMEOUT;
+    enqueue_sample(0);
+    CHECK_EQ(influx_sender_wait_until_empty(1000), ESP_ERR_TIMEOUT);
+    CHECK_EQ(s_http.posts, 1);
+
+    // Same batch goes out again on the next drain, nothing is lost or duplicated
+    s_http.result = ESP_OK;
+    CHECK_EQ(influx_sender_wait_until_empty(1000), ESP_OK);
+    CHECK_EQ(s_http.posts, 2);
+    CHECK(strcmp(s_http.bodies[0], s_http.bodies[1]) == 0);
+
+    influx_sender_stats_t stats;
+    influx_sender_get_stats(&stats);
+    CHECK_EQ(stats.batches_failed, 1);
+    CHECK_EQ(stats.batches_written, 1);
+    CHECK_EQ(stats.points_written, 2);
+    influx_sender_deinit();
+}
+
+static void test_time_trigger_flushes_partial_batch(void) {
+    start_writer(4096, 50);
+    enqueue_sample(0);
+    vTaskDelay(pdMS_TO_TICKS(300));
+    CHECK_EQ(s_http.posts, 1);
+    CHECK_EQ(count_lines(s_http.bodies[0]), 2);
+    influx_sender_deinit();
+}
+
+int main(void) {
+    RUN_TEST(test_drain_writes_one_post);
+    RUN_TEST(test_size_trigger_splits_batches);
+    RUN_TEST(test_failed_post_is_kept_for_retry);
+    RUN_TEST(test_time_trigger_flushes_partial_batch);
+    return TEST_RESULT();
+}
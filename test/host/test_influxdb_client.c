@@ -0,0 +1,271 @@
+/**
+ * @file test_influxdb_client.c
+ * @brief Host tests of the InfluxDB write request template, benchmark against per-call setup
+ *
+ * The client runs against the fake esp_http_client (stubs/http_client_host.c).
+ * The benchmark compares influxdb_send_line_protocol() with the request
+ * setup it replaced: URL and Authorization formatted on every write and set
+ * on the handle together with the static headers (copied below from the
+ * client before the template). It prints ns, heap calls and stack bytes per
+ * write; the stack is measured by painting the stack of the benchmark thread.
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "drivers/influxdb/influxdb_client.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SERVER          "data.example.org"
+#define ENDPOINT        "/api/v2/write"
+#define WRITE_URL       "https://" SERVER ":443" ENDPOINT "?org=Garden&bucket=soil&precision=ns"
+#define SMALL_BODY      "soil_moisture,device=ESP32_A1B2C3 voltage=1.512,moisture_percent=41.93,raw_adc=2061 1700000000000000000"
+#define BENCH_WRITES    100000
+#define BENCH_STACK     (256 * 1024)
+#define STACK_PAINT     0xA5
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static unsigned s_allocs = 0;
+
+void* __wrap_malloc(size_t size) {
+    s_allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    s_allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    s_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+// Streams are covered by the HTTP stream code, not by these tests
+esp_err_t http_stream_post(esp_http_client_handle_t client, http_stream_producer_t producer,
+                           void* ctx, int* status_code) {
+    (void)client;
+    (void)producer;
+    (void)ctx;
+    *status_code = 0;
+    return ESP_FAIL;
+}
+
+static influxdb_client_config_t s_config = {
+    .server = SERVER,
+    .port = 443,
+    .bucket = "soil",
+    .org = "Garden",
+    // Same length as an InfluxDB 2.x API token
+    .token = "q3Zp0m7V4c1xYb8Hn2Jk5Lr9Tw6Ds0Fg3Ah7Qe1Mz4Xc8Vb2Nn5Ul9Ko3Ij6Uh0Yg4Tf7Rd1Se5Wa8Qz2Px6Oc9Lv3Mb7Nk1Jh4Gf==",
+    .endpoint = ENDPOINT,
+    .timeout_ms = 5000,
+    .max_retries = 0,
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void start_client(void) {
+    host_http_set_status(204);
+    host_http_reset_stats();
+    CHECK_EQ(influxdb_client_init(&s_config), ESP_OK);
+}
+
+static void test_template_prepared_once(void) {
+    start_client();
+    host_http_stats_t stats;
+    host_http_get_stats(&stats);
+    CHECK_EQ(stats.set_url_calls, 1);
+    CHECK_EQ(stats.header_sets, 3);
+    CHECK(strncmp(host_http_header("Authorization"), "Token ", 6) == 0);
+    CHECK(strcmp(host_http_header("Content-Type"), "text/plain; charset=utf-8") == 0);
+
+    for (int i = 0; i < 10; i++) {
+        CHECK_EQ(influxdb_send_line_protocol(SMALL_BODY), ESP_OK);
+    }
+    host_http_get_stats(&stats);
+    CHECK_EQ(stats.performs, 10);
+    CHECK_EQ(stats.set_url_calls, 1);
+    CHECK_EQ(stats.header_sets, 3);
+    CHECK_EQ(stats.last_body_len, strlen(SMALL_BODY));
+    CHECK(strcmp(stats.last_url, WRITE_URL) == 0);
+    influxdb_client_deinit();
+}
+
+static void test_redirect_restores_url(void) {
+    start_client();
+    host_http_redirect_next("https://" SERVER ":8443/elsewhere");
+    CHECK_EQ(influxdb_send_line_protocol(SMALL_BODY), ESP_OK);
+    host_http_stats_t stats;
+    host_http_get_stats(&stats);
+    CHECK(strcmp(stats.last_url, "https://" SERVER ":8443/elsewhere") == 0);
+
+    // The next write goes to the write URL again, later ones leave it alone
+    CHECK_EQ(influxdb_send_line_protocol(SMALL_BODY), ESP_OK);
+    host_http_get_stats(&stats);
+    CHECK(strcmp(stats.last_url, WRITE_URL) == 0);
+    size_t url_calls = stats.set_url_calls;
+    CHECK_EQ(influxdb_send_line_protocol(SMALL_BODY), ESP_OK);
+    host_http_get_stats(&stats);
+    CHECK_EQ(stats.set_url_calls, url_calls);
+    influxdb_client_deinit();
+}
+
+static void test_gzip_header_follows_body(void) {
+    static char big[INFLUXDB_GZIP_MIN_BYTES * 4];
+    size_t len = 0;
+    while (len + sizeof(SMALL_BODY) + 1 < sizeof(big)) {
+        memcpy(&big[len], SMALL_BODY "\n", sizeof(SMALL_BODY));
+        len += sizeof(SMALL_BODY);
+    }
+    big[len - 1] = '\0';
+
+    start_client();
+    CHECK_EQ(influxdb_send_line_protocol(big), ESP_OK);
+    CHECK(host_http_header("Content-Encoding") != NULL);
+    host_http_stats_t stats;
+    host_http_get_stats(&stats);
+    CHECK(stats.last_body_len < len / 4);
+
+    CHECK_EQ(influxdb_send_line_protocol(SMALL_BODY), ESP_OK);
+    CHECK(host_http_header("Content-Encoding") == NULL);
+    host_http_get_stats(&stats);
+    CHECK_EQ(stats.last_body_len, strlen(SMALL_BODY));
+    influxdb_client_deinit();
+}
+
+
+
+
+// #####################################
+// MARK: Benchmark
+// #####################################
+
+static esp_http_client_handle_t s_previous_client = NULL;
+
+/**
+ * @brief Request setup before the template, as it was in influxdb_client.c
+ */
+static esp_err_t previous_prepare_request(void)
+{
+    // Build full URL with query parameters
+    char full_url[256];
+    snprintf(full_url, sizeof(full_url), "https://%s:%d%s?org=%s&bucket=%s&precision=ns",
+             s_config.server, s_config.port, s_config.endpoint, s_config.org, s_config.bucket);
+
+    // Set the URL for this request
+    esp_err_t err = ESP_OK;
+    err |= esp_http_client_set_url(s_previous_client, full_url);
+
+    // Set headers
+    err |= esp_http_client_set_header(s_previous_client, "Content-Type", "text/plain; charset=utf-8");
+    err |= esp_http_client_set_header(s_previous_client, "Accept", "application/json");
+
+    // Set authorization header if token is provided
+    if (strlen(s_config.token) > 0) {
+        char auth_header[512];
+        snprintf(auth_header, sizeof(auth_header), "Token %s", s_config.token);
+        err |= esp_http_client_set_header(s_previous_client, "Authorization", auth_header);
+    }
+    return err;
+}
+
+static esp_err_t previous_send_line_protocol(const char* line_protocol)
+{
+    esp_err_t err = previous_prepare_request();
+    // The client is reused, drop the encoding of a previous compressed request
+    esp_http_client_delete_header(s_previous_client, "Content-Encoding");
+    err |= esp_http_client_set_post_field(s_previous_client, line_protocol, (int)strlen(line_protocol));
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_http_client_perform(s_previous_client);
+    if (err == ESP_OK && esp_http_client_get_status_code(s_previous_client) != 204) {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+typedef struct {
+    esp_err_t (*write)(const char* line_protocol);
+    int writes;
+    double seconds;
+    unsigned allocs;
+} bench_run_t;
+
+static void* bench_thread(void* arg) {
+    bench_run_t* run = (bench_run_t*)arg;
+    if (run->write == NULL) {
+        return NULL;
+    }
+    unsigned allocs_before = s_allocs;
+    double start = now_s();
+    for (int i = 0; i < run->writes; i++) {
+        CHECK_EQ(run->write(SMALL_BODY), ESP_OK);
+    }
+    run->seconds = now_s() - start;
+    run->allocs = s_allocs - allocs_before;
+    return NULL;
+}
+
+/**
+ * @brief Run the writes on a painted stack, returns the deepest stack use in bytes
+ */
+static size_t run_on_painted_stack(bench_run_t* run) {
+    static uint8_t stack[BENCH_STACK] __attribute__((aligned(4096)));
+    memset(stack, STACK_PAINT, BENCH_STACK);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, BENCH_STACK);
+    pthread_t thread;
+    CHECK_EQ(pthread_create(&thread, &attr, bench_thread, run), 0);
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    size_t untouched = 0;
+    while (untouched < BENCH_STACK && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    return BENCH_STACK - untouched;
+}
+
+static void bench_write_setup(void) {
+    bench_run_t idle = { 0 };
+    size_t base_stack = run_on_painted_stack(&idle);
+
+    esp_http_client_config_t config = { .url = WRITE_URL, .method = HTTP_METHOD_POST };
+    s_previous_client = esp_http_client_init(&config);
+    bench_run_t before = { .write = previous_send_line_protocol, .writes = BENCH_WRITES };
+    size_t before_stack = run_on_painted_stack(&before) - base_stack;
+    esp_http_client_cleanup(s_previous_client);
+
+    start_client();
+    bench_run_t after = { .write = influxdb_send_line_protocol, .writes = BENCH_WRITES };
+    size_t after_stack = run_on_painted_stack(&after) - base_stack;
+    influxdb_client_deinit();
+
+    printf("bench: per-call setup  %6.1f ns/write, %.2f heap calls/write, %zu bytes stack\n",
+           before.seconds * 1e9 / before.writes, (double)before.allocs / before.writes, before_stack);
+    printf("bench: prepared once   %6.1f ns/write, %.2f heap calls/write, %zu bytes stack\n",
+           after.seconds * 1e9 / after.writes, (double)after.allocs / after.writes, after_stack);
+    CHECK(after.allocs < before.allocs);
+    CHECK(after_stack < before_stack);
+}
+
+int main(void) {
+    RUN_TEST(test_template_prepared_once);
+    RUN_TEST(test_redirect_restores_url);
+    RUN_TEST(test_gzip_header_follows_body);
+    RUN_TEST(bench_write_setup);
+    return TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+/**
+ * @file test_influxdb_gzip.c
+ * @brief Host tests of the InfluxDB gzip encoder against zlib, benchmark on line protocol bodies
+ *
+ * Every output is inflated with zlib (which also checks the CRC-32 and size
+ * trailer) and compared with the input byte for byte. The benchmark
+ * compresses soil/battery batches built with the firmware's line formatters
+ * at sizes around INFLUXDB_GZIP_MIN_BYTES and prints ratio and µs per KB,
+ * with zlib level 1 on the same body for reference.
+ */
+
+#include "test_host.h"
+#include "drivers/influxdb/influxdb_gzip.h"
+#include "application/influxdb_sender.h"
+#include "config/esp32-config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define BODY_MAX    16384
+#define OUT_MAX     (BODY_MAX + BODY_MAX / 8 + 64)
+
+static char s_body[BODY_MAX];
+static uint8_t s_out[OUT_MAX];
+static uint8_t s_inflated[BODY_MAX];
+
+// Only reached through influxdb_write_*(), which these tests do not call
+esp_err_t influxdb_send_line_protocol(const char* line_protocol) {
+    (void)line_protocol;
+    return ESP_FAIL;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Line protocol batch as the firmware sends it: soil and battery lines of one device
+ */
+static size_t make_body(size_t target) {
+    size_t len = 0;
+    for (int i = 0; len < target; i++) {
+        char line[160];
+        int n;
+        if (i % 2 == 0) {
+            influxdb_soil_data_t soil = {
+                .timestamp_ns = 1700000000000000000ULL + (uint64_t)(i / 2) * 600000000000ULL,
+                .voltage = 1.5f + (float)(i % 7) * 0.013f,
+                .moisture_percent = 42.0f - (float)i * 0.07f,
+                .raw_adc = 2048 + (i * 37) % 50,
+            };
+            strcpy(soil.device_id, "ESP32_A1B2C3");
+            n = influxdb_format_soil_line(&soil, line, sizeof(line));
+        } else {
+            influxdb_battery_data_t battery = {
+                .timestamp_ns = 1700000000000000000ULL + (uint64_t)(i / 2) * 600000000000ULL,
+                .voltage = 3.912f - (float)i * 0.001f,
+                .percentage = 81.0f - (float)i * 0.1f,
+            };
+            strcpy(battery.device_id, "ESP32_A1B2C3");
+            n = influxdb_format_battery_line(&battery, line, sizeof(line));
+        }
+        if (n <= 0 || len + (size_t)n + 1 >= BODY_MAX) {
+            break;
+        }
+        if (len > 0) {
+            s_body[len++] = '\n';
+        }
+        memcpy(&s_body[len], line, (size_t)n);
+        len += (size_t)n;
+    }
+    s_body[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Inflate a gzip member with zlib, returns the inflated length or -1
+ */
+static long gunzip(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_cap) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        return -1;
+    }
+    zs.next_in = (Bytef*)in;
+    zs.avail_in = (uInt)in_len;
+    zs.next_out = out;
+    zs.avail_out = (uInt)out_cap;
+    int ret = inflate(&zs, Z_FINISH);
+    long len = (ret == Z_STREAM_END && zs.avail_in == 0) ? (long)zs.total_out : -1;
+    inflateEnd(&zs);
+    return len;
+}
+
+static void check_round_trip(const uint8_t* in, size_t in_len) {
+    size_t out_len = 0;
+    CHECK_EQ(influxdb_gzip_compress(in, in_len, s_out, sizeof(s_out), &out_len), ESP_OK);
+    long len = gunzip(s_out, out_len, s_inflated, sizeof(s_inflated));
+    CHECK_EQ(len, (long)in_len);
+    CHECK(len < 0 || memcmp(s_inflated, in, in_len) == 0);
+}
+
+static void test_line_protocol_round_trip(void) {
+    static const size_t sizes[] = { 1, 100, INFLUXDB_GZIP_MIN_BYTES, 4096, BODY_MAX - 200 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t len = make_body(sizes[i]);
+        check_round_trip((const uint8_t*)s_body, len);
+    }
+}
+
+static void test_edge_inputs_round_trip(void) {
+    static uint8_t buf[BODY_MAX / 2];
+
+    // Empty body
+    check_round_trip(buf, 0);
+
+    // Long runs need the 258-byte length code and chained matches
+    memset(buf, 'a', sizeof(buf));
+    check_round_trip(buf, sizeof(buf));
+
+    // Repeats exactly one window back and just beyond it
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)((i % (INFLUXDB_GZIP_WINDOW + 1)) * 7);
+    }
+    check_round_trip(buf, sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)((i % INFLUXDB_GZIP_WINDOW) * 13);
+    }
+    check_round_trip(buf, sizeof(buf));
+
+    // Incompressible data, all literals including the 9-bit codes
+    srand(1);
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)rand();
+    }
+    check_round_trip(buf, sizeof(buf));
+}
+
+static void test_small_output_is_rejected(void) {
+    size_t len = make_body(2048);
+    size_t out_len = 0;
+    CHECK_EQ(influxdb_gzip_compress((const uint8_t*)s_body, len, s_out, len / 10, &out_len),
+             ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(influxdb_gzip_compress(NULL, len, s_out, sizeof(s_out), &out_len), ESP_ERR_INVALID_ARG);
+}
+
+static void bench_line_protocol(void) {
+    static const size_t sizes[] = {
+        INFLUXDB_GZIP_MIN_BYTES / 2, INFLUXDB_GZIP_MIN_BYTES, INFLUXDB_GZIP_MIN_BYTES * 2,
+        INFLUXDB_GZIP_MIN_BYTES * 4, INFLUXDB_GZIP_MIN_BYTES * 16,
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t len = make_body(sizes[i]);
+        size_t out_len = 0;
+        int rounds = 0;
+        double start = now_s();
+        double elapsed;
+        do {
+            CHECK_EQ(influxdb_gzip_compress((const uint8_t*)s_body, len, s_out, sizeof(s_out), &out_len),
+                     ESP_OK);
+            rounds++;
+            elapsed = now_s() - start;
+        } while (elapsed < 0.2);
+
+        uLongf zlib_len = sizeof(s_out);
+        CHECK_EQ(compress2(s_out, &zlib_len, (const Bytef*)s_body, len, 1), Z_OK);
+
+        printf("bench: %5zu bytes -> %5zu gzip (ratio %.2f, zlib -1 %.2f), %.2f us/KB\n",
+               len, out_len, (double)len / (double)out_len, (double)len / (double)zlib_len,
+               elapsed * 1e6 / rounds / ((double)len / 1024.0));
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_line_protocol_round_trip);
+    RUN_TEST(test_edge_inputs_round_trip);
+    RUN_TEST(test_small_output_is_rejected);
+    RUN_TEST(bench_line_protocol);
+    return TEST_RESULT();
+}
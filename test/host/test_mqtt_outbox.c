@@ -0,0 +1,310 @@
+/**
+ * @file test_mqtt_outbox.c
+ * @brief Host tests of the MQTT publish-slot arena, benchmark of the publish path
+ *
+ * Linked with --wrap=malloc,--wrap=calloc to count allocations made after init.
+ * The benchmark runs mqtt_publish_soil_data() through the real driver and
+ * outbox against the fake broker (stubs/mqtt_host.c), and the cJSON path it
+ * replaced when cJSON is available (HOST_HAVE_CJSON, see CMakeLists.txt).
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "drivers/mqtt/mqtt_outbox.h"
+#include "application/mqtt_sender.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if HOST_HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define SLOTS               4
+#define BENCH_MESSAGES      200000
+#define DEVICE_ID           "ESP32_TEST"
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+
+static unsigned s_allocs = 0;
+
+void* __wrap_malloc(size_t size) {
+    s_allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    s_allocs++;
+    return __real_calloc(n, size);
+}
+
+static int s_done_calls = 0;
+static esp_err_t s_done_result = ESP_FAIL;
+
+static void on_done(int msg_id, esp_err_t result, void* ctx) {
+    (void)msg_id;
+    (void)ctx;
+    s_done_calls++;
+    s_done_result = result;
+}
+
+static mqtt_outbox_slot_t* publish(int msg_id) {
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    if (slot == NULL) {
+        return NULL;
+    }
+    strcpy(slot->topic, "sensors/soil");
+    slot->payload_len = (size_t)snprintf(slot->payload, sizeof(slot->payload), "{\"id\":%d}", msg_id);
+    slot->done_cb = on_done;
+    mqtt_outbox_mark_in_flight(slot, msg_id);
+    return slot;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void test_reserve_and_complete(void) {
+    mqtt_outbox_stats_t stats;
+    CHECK_EQ(mqtt_outbox_init(SLOTS), ESP_OK);
+
+    for (int i = 0; i < SLOTS; i++) {
+        CHECK(publish(i + 1) != NULL);
+    }
+    CHECK(mqtt_outbox_reserve() == NULL);
+    CHECK_EQ(mqtt_outbox_in_flight_count(), SLOTS);
+
+    s_done_calls = 0;
+    CHECK(mqtt_outbox_complete(2, ESP_OK));
+    CHECK_EQ(s_done_calls, 1);
+    CHECK_EQ(s_done_result, ESP_OK);
+    CHECK(!mqtt_outbox_complete(2, ESP_OK));
+    CHECK_EQ(mqtt_outbox_in_flight_count(), SLOTS - 1);
+
+    CHECK_EQ(mqtt_outbox_fail_all_in_flight(ESP_ERR_TIMEOUT, NULL), SLOTS - 1);
+    CHECK_EQ(s_done_result, ESP_ERR_TIMEOUT);
+
+    mqtt_outbox_get_stats(&stats);
+    CHECK_EQ(stats.capacity, SLOTS);
+    CHECK_EQ(stats.in_use, 0);
+    CHECK_EQ(stats.high_water, SLOTS);
+    CHECK_EQ(stats.reserve_failures, 1);
+    mqtt_outbox_deinit();
+}
+
+static void test_early_ack(void) {
+    CHECK_EQ(mqtt_outbox_init(SLOTS), ESP_OK);
+
+    // PUBACK overtakes mark_in_flight
+    CHECK(!mqtt_outbox_complete(7, ESP_OK));
+    s_done_calls = 0;
+    mqtt_outbox_slot_t* slot = mqtt_outbox_reserve();
+    CHECK(slot != NULL);
+    slot->done_cb = on_done;
+    CHECK(!mqtt_outbox_mark_in_flight(slot, 7));
+    CHECK_EQ(s_done_calls, 1);
+    CHECK_EQ(mqtt_outbox_in_flight_count(), 0);
+    mqtt_outbox_deinit();
+}
+
+static void test_session_reset_forgets_early_acks(void) {
+    CHECK_EQ(mqtt_outbox_init(SLOTS), ESP_OK);
+
+    // Stale PUBACK from the previous session must not complete a reused id
+    CHECK(!mqtt_outbox_complete(3, ESP_OK));
+    mqtt_outbox_reset_session();
+    s_done_calls = 0;
+    CHECK(publish(3) != NULL);
+    CHECK_EQ(s_done_calls, 0);
+    CHECK_EQ(mqtt_outbox_in_flight_count(), 1);
+    CHECK(mqtt_outbox_complete(3, ESP_OK));
+    CHECK_EQ(s_done_calls, 1);
+    mqtt_outbox_deinit();
+}
+
+static void start_client(void) {
+    mqtt_client_config_t config = {
+        .broker_uri = "mqtt://broker.local",
+        .client_id = DEVICE_ID,
+        .keepalive = 60,
+        .timeout_ms = 1000,
+        .outbox_slots = SLOTS,
+    };
+    CHECK_EQ(mqtt_client_init(&config), ESP_OK);
+    CHECK_EQ(mqtt_client_connect(), ESP_OK);
+}
+
+static mqtt_soil_data_t soil_sample(int i) {
+    mqtt_soil_data_t data = {
+        .timestamp_ms = 1700000000000ULL + (uint64_t)i * 600000ULL,
+        .voltage = 1.512f + (float)(i % 7) * 0.001f,
+        .moisture_percent = 41.25f - (float)(i % 11) * 0.01f,
+        .raw_adc = 1870 + i % 13,
+    };
+    strcpy(data.device_id, DEVICE_ID);
+    return data;
+}
+
+static void test_batch_uses_cached_topic(void) {
+    start_client();
+    mqtt_batch_sample_t sample = {
+        .timestamp_ms = 1700000000000ULL,
+        .soil_voltage = 1.5f,
+        .moisture_percent = 40.0f,
+        .raw_adc = 1900,
+        .battery_voltage = 3.9f,
+        .battery_percent = 80.0f,
+    };
+    mqtt_batch_add_sample(&sample);
+    mqtt_batch_diag_t diag = { .wake_count = 1 };
+
+    unsigned allocs_before = s_allocs;
+    CHECK_EQ(mqtt_publish_batch(DEVICE_ID, &diag), MQTT_CLIENT_STATUS_OK);
+    CHECK_EQ(s_allocs - allocs_before, 0);
+    host_mqtt_stats_t stats;
+    host_mqtt_get_stats(&stats);
+    CHECK(strcmp(stats.last_topic, "soil_sensor/" DEVICE_ID "/batch") == 0);
+
+    // The PUBACK removes the sample from the backlog
+    CHECK_EQ(host_mqtt_ack_all(), 1);
+    CHECK_EQ(mqtt_batch_pending_count(), 0);
+    mqtt_client_deinit();
+}
+
+#if HOST_HAVE_CJSON
+// Publish path before the outbox arena (baseline commit), unchanged apart
+// from calling esp-mqtt through the fake broker's client handle
+
+static char* create_soil_json_payload(const mqtt_soil_data_t* data) {
+    cJSON* root = cJSON_CreateObject();
+    if (root == NULL) {
+        return NULL;
+    }
+    cJSON_AddNumberToObject(root, "timestamp", (double)data->timestamp_ms);
+    cJSON_AddStringToObject(root, "device_id", data->device_id);
+    cJSON_AddNumberToObject(root, "voltage", data->voltage);
+    cJSON_AddNumberToObject(root, "moisture_percent", data->moisture_percent);
+    cJSON_AddNumberToObject(root, "raw_adc", data->raw_adc);
+    char* payload = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return payload;
+}
+
+static esp_err_t previous_client_publish(const char* topic, const char* payload, size_t payload_len,
+                                         int qos, int retain) {
+    if (host_mqtt_client() == NULL || !mqtt_client_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (topic == NULL || payload == NULL || payload_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int msg_id = esp_mqtt_client_publish(host_mqtt_client(), topic, payload, payload_len, qos, retain);
+    if (msg_id < 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static mqtt_client_status_t previous_publish_soil_data(const mqtt_soil_data_t* data) {
+    if (data == NULL) {
+        return MQTT_CLIENT_STATUS_INVALID_PARAM;
+    }
+    char* payload = create_soil_json_payload(data);
+    if (payload == NULL) {
+        return MQTT_CLIENT_STATUS_ERROR;
+    }
+    char topic[128];
+    snprintf(topic, sizeof(topic), "soil_sensor/%s/soil", data->device_id);
+    esp_err_t err = previous_client_publish(topic, payload, strlen(payload), 1, 1);
+    free(payload);
+    if (err != ESP_OK) {
+        return MQTT_CLIENT_STATUS_ERROR;
+    }
+    return MQTT_CLIENT_STATUS_OK;
+}
+
+static void* counted_malloc(size_t size) {
+    return malloc(size);
+}
+#endif // HOST_HAVE_CJSON
+
+static void bench_publish_soil(void) {
+    start_client();
+    mqtt_soil_data_t data = soil_sample(0);
+    CHECK_EQ(mqtt_publish_soil_data(&data), MQTT_CLIENT_STATUS_OK);    // Fills the topic cache
+    host_mqtt_ack_all();
+
+    unsigned allocs_before = s_allocs;
+    double start = now_s();
+    for (int i = 1; i <= BENCH_MESSAGES; i++) {
+        data = soil_sample(i);
+        mqtt_publish_soil_data(&data);
+        host_mqtt_ack_all();
+    }
+    double arena_s = now_s() - start;
+    unsigned arena_allocs = s_allocs - allocs_before;
+    CHECK_EQ(arena_allocs, 0);
+    CHECK_EQ(mqtt_outbox_in_flight_count(), 0);
+    host_mqtt_stats_t stats;
+    host_mqtt_get_stats(&stats);
+    CHECK(strcmp(stats.last_topic, "soil_sensor/" DEVICE_ID "/soil") == 0);
+    printf("bench: outbox path  %6.1f ns/publish, %.2f allocs/publish (%d publishes)\n",
+           arena_s * 1e9 / BENCH_MESSAGES, (double)arena_allocs / BENCH_MESSAGES, BENCH_MESSAGES);
+
+#if HOST_HAVE_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = counted_malloc, .free_fn = free };
+    cJSON_InitHooks(&hooks);
+    allocs_before = s_allocs;
+    start = now_s();
+    for (int i = 1; i <= BENCH_MESSAGES; i++) {
+        data = soil_sample(i);
+        CHECK_EQ(previous_publish_soil_data(&data), MQTT_CLIENT_STATUS_OK);
+        host_mqtt_drop_pending();
+    }
+    double cjson_s = now_s() - start;
+    unsigned cjson_allocs = s_allocs - allocs_before;
+    printf("bench: cJSON path   %6.1f ns/publish, %.2f allocs/publish\n",
+           cjson_s * 1e9 / BENCH_MESSAGES, (double)cjson_allocs / BENCH_MESSAGES);
+#else
+    printf("bench: cJSON path skipped, cJSON not found (set IDF_PATH or install libcjson)\n");
+#endif
+
+    // Where the outbox path's time goes: serialization and the bookkeeping
+    // locks. A host critical section is a pthread mutex round trip, several
+    // times a target portENTER_CRITICAL on one core, while glibc serves the
+    // old path's small mallocs from a lock-free per-thread cache; on the
+    // target every heap_caps_malloc/free takes the heap lock instead.
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX_LEN];
+    start = now_s();
+    for (int i = 1; i <= BENCH_MESSAGES; i++) {
+        data = soil_sample(i);
+        snprintf(payload, sizeof(payload),
+            "{\"timestamp\":%llu,\"device_id\":\"%s\",\"voltage\":%.3f,\"moisture_percent\":%.2f,\"raw_adc\":%d}",
+            (unsigned long long)data.timestamp_ms, data.device_id,
+            data.voltage, data.moisture_percent, data.raw_adc);
+    }
+    double format_s = now_s() - start;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    start = now_s();
+    for (int i = 1; i <= BENCH_MESSAGES; i++) {
+        portENTER_CRITICAL(&lock);
+        portEXIT_CRITICAL(&lock);
+    }
+    double critical_s = now_s() - start;
+    printf("bench: of which     %6.1f ns snprintf, %.1f ns per host critical section\n",
+           format_s * 1e9 / BENCH_MESSAGES, critical_s * 1e9 / BENCH_MESSAGES);
+    mqtt_client_deinit();
+}
+
+int main(void) {
+    RUN_TEST(test_reserve_and_complete);
+    RUN_TEST(test_early_ack);
+    RUN_TEST(test_session_reset_forgets_early_acks);
+    RUN_TEST(test_batch_uses_cached_topic);
+    RUN_TEST(bench_publish_soil);
+    return TEST_RESULT();
+}
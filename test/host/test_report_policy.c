@@ -0,0 +1,167 @@
+/**
+ * @file test_report_policy.c
+ * @brief Host replay of the report policy: Holt predictor vs plain deadband vs send-all
+ *
+ * A three-week trace of hourly wakes (dry-down faster by day, a watering
+ * every fourth morning, sensor noise, a slowly discharging battery) runs
+ * through report_policy_evaluate/prepare/record twice: as built for the
+ * firmware (REPORT_PREDICTOR_ENABLED) and as the plain deadband (the same
+ * source compiled without the predictor, see CMakeLists.txt). A hub rebuilds
+ * the withheld samples from the reports, as described in report_policy.h.
+ * Printed are reports sent and the max/RMS error of the rebuilt series
+ * against the values the sensor measured.
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "application/report_policy.h"
+#include "config/esp32-config.h"
+#include "esp_random.h"
+#include <math.h>
+#include <string.h>
+
+#define WAKES               (21 * 24)
+#define WAKE_INTERVAL_S     DEEP_SLEEP_DURATION_SECONDS
+#define MOISTURE_NOISE      0.3f        ///< Uniform sensor noise, +- percent
+#define BATTERY_NOISE       0.01f       ///< Uniform ADC noise, +- volts
+#define START_MS            1700000000000ULL
+
+// The plain deadband build of report_policy.c
+report_policy_decision_t deadband_policy_evaluate(const telemetry_sample_t* sample);
+void deadband_policy_prepare(telemetry_sample_t* sample);
+void deadband_policy_record(const telemetry_sample_t* sample, report_policy_decision_t decision, bool delivered);
+
+/**
+ * @brief One build of the policy
+ */
+typedef struct {
+    const char* name;
+    report_policy_decision_t (*evaluate)(const telemetry_sample_t* sample);
+    void (*prepare)(telemetry_sample_t* sample);
+    void (*record)(const telemetry_sample_t* sample, report_policy_decision_t decision, bool delivered);
+} policy_build_t;
+
+/**
+ * @brief Outcome of one replay
+ */
+typedef struct {
+    size_t sent;
+    size_t rebuilt;                 ///< Wakes up to the last report, known to the hub
+    float max_err;
+    float rms_err;
+} replay_result_t;
+
+static float s_moisture[WAKES];
+static float s_battery[WAKES];
+static uint64_t s_now_ms;
+
+// The policy's clock
+uint64_t esp_utils_get_timestamp_ms(void) {
+    return s_now_ms;
+}
+
+static float noise(float amplitude) {
+    return ((float)(esp_random() % 2001) / 1000.0f - 1.0f) * amplitude;
+}
+
+/**
+ * @brief Evaporative demand over the day: low at night, peak in the early afternoon
+ */
+static float day_factor(int minute) {
+    float hour = (float)(minute % (24 * 60)) / 60.0f;
+    float sun = sinf((hour - 8.0f) / 12.0f * 3.14159265f);
+    return 0.3f + (sun > 0.0f ? sun : 0.0f);
+}
+
+static void make_trace(void) {
+    host_random_seed(11);
+    float m = 36.0f;
+    for (int k = 0; k < WAKES * 60; k++) {
+        if (k % 60 == 0) {
+            int wake = k / 60;
+            s_moisture[wake] = m + noise(MOISTURE_NOISE);
+            s_battery[wake] = 4.10f - 0.012f * (float)wake / 24.0f + noise(BATTERY_NOISE);
+        }
+        int minute_of_cycle = k % (4 * 24 * 60);
+        if (minute_of_cycle >= 6 * 60 && minute_of_cycle < 6 * 60 + 30) {
+            m += 0.5f * (48.0f - m) / 16.0f;        // Watering, saturates towards 48 %
+        } else if (m > 38.0f) {
+            m -= (m - 38.0f) / 90.0f;               // Drainage to field capacity
+        }
+        m -= 0.006f / 60.0f * day_factor(k) * (m - 12.0f);
+    }
+}
+
+static replay_result_t replay(const policy_build_t* policy) {
+    static float rebuilt[WAKES];
+    replay_result_t r = { 0 };
+    holt_model_t hub_model = { 0 };
+    float last_reported = 0.0f;
+    int last_report = -1;
+
+    for (int wake = 0; wake < WAKES; wake++) {
+        s_now_ms = START_MS + (uint64_t)wake * WAKE_INTERVAL_S * 1000ULL;
+        telemetry_sample_t sample = {
+            .timestamp_ms = s_now_ms,
+            .moisture_percent = s_moisture[wake],
+            .battery_voltage = s_battery[wake],
+        };
+        report_policy_decision_t decision = policy->evaluate(&sample);
+        if (decision == REPORT_POLICY_SKIP) {
+            policy->record(&sample, decision, false);
+            continue;
+        }
+        policy->prepare(&sample);
+        policy->record(&sample, decision, true);
+        r.sent++;
+
+        // Hub: withheld samples from the previous model, or held at the last report
+        CHECK_EQ(sample.suppressed, (uint32_t)(wake - last_report - 1));
+        for (uint32_t i = 1; i <= sample.suppressed; i++) {
+            rebuilt[last_report + (int)i] = sample.has_model ?
+                (float)holt_predict(&hub_model, i) / 100.0f : last_reported;
+        }
+        rebuilt[wake] = sample.moisture_percent;
+        hub_model = sample.model;
+        last_reported = sample.moisture_percent;
+        last_report = wake;
+    }
+
+    double sum_sq = 0.0;
+    r.rebuilt = (size_t)(last_report + 1);
+    for (size_t i = 0; i < r.rebuilt; i++) {
+        float err = fabsf(rebuilt[i] - s_moisture[i]);
+        r.max_err = fmaxf(r.max_err, err);
+        sum_sq += (double)err * err;
+    }
+    r.rms_err = (float)sqrt(sum_sq / (double)r.rebuilt);
+    printf("bench: %-12s %3zu of %d wakes sent, max error %4.2f %%, RMS %5.3f %%\n",
+           policy->name, r.sent, WAKES, r.max_err, r.rms_err);
+    return r;
+}
+
+static void test_replay(void) {
+    static const policy_build_t holt = {
+        "holt", report_policy_evaluate, report_policy_prepare, report_policy_record,
+    };
+    static const policy_build_t deadband = {
+        "deadband", deadband_policy_evaluate, deadband_policy_prepare, deadband_policy_record,
+    };
+    make_trace();
+    printf("bench: %-12s %3d of %d wakes sent, max error %4.2f %%, RMS %5.3f %%\n",
+           "send-all", WAKES, WAKES, 0.0f, 0.0f);
+    replay_result_t with_holt = replay(&holt);
+    replay_result_t with_deadband = replay(&deadband);
+
+    // Both keep every withheld sample within the deadband (plus centi-percent rounding)
+    CHECK(with_holt.max_err <= REPORT_MOISTURE_DEADBAND_PERCENT + 0.01f);
+    CHECK(with_deadband.max_err <= REPORT_MOISTURE_DEADBAND_PERCENT + 0.01f);
+    CHECK(with_deadband.sent < WAKES / 2);
+    // Waterings restart the model instead of kicking its trend into extra reports
+    CHECK(with_holt.sent <= with_deadband.sent);
+}
+
+int main(void) {
+    RUN_TEST(test_replay);
+    return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+/**
+ * @file test_retry_policy.c
+ * @brief Host tests of the retry classifier, Retry-After parser, backoff schedule and budget
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "utils/retry_policy.h"
+#include "config/esp32-config.h"
+
+static void test_classify_transport_errors(void) {
+    CHECK_EQ(retry_policy_classify_http(ESP_ERR_TIMEOUT, 0), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_FAIL, 0), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_ERR_INVALID_ARG, 0), RETRY_CLASS_PERMANENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_ERR_NO_MEM, 0), RETRY_CLASS_PERMANENT);
+    // The status is ignored when the transport failed
+    CHECK_EQ(retry_policy_classify_http(ESP_ERR_TIMEOUT, 204), RETRY_CLASS_TRANSIENT);
+}
+
+static void test_classify_http_status(void) {
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 200), RETRY_CLASS_SUCCESS);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 204), RETRY_CLASS_SUCCESS);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 408), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 429), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 500), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 503), RETRY_CLASS_TRANSIENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 501), RETRY_CLASS_PERMANENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 400), RETRY_CLASS_PERMANENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 401), RETRY_CLASS_PERMANENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 404), RETRY_CLASS_PERMANENT);
+    CHECK_EQ(retry_policy_classify_http(ESP_OK, 301), RETRY_CLASS_PERMANENT);
+}
+
+static void test_parse_retry_after(void) {
+    CHECK_EQ(retry_policy_parse_retry_after(NULL), 0);
+    CHECK_EQ(retry_policy_parse_retry_after("5"), 5000);
+    CHECK_EQ(retry_policy_parse_retry_after("  120"), 120000);
+    CHECK_EQ(retry_policy_parse_retry_after("Wed, 21 Oct 2015 07:28:00 GMT"), 0);
+    CHECK_EQ(retry_policy_parse_retry_after("99999999999"), UINT32_MAX);
+}
+
+static void test_backoff_bounds(void) {
+    const retry_policy_t policy = { .max_attempts = 6, .base_delay_ms = 100, .max_delay_ms = 1000 };
+    host_random_seed(42);
+    CHECK_EQ(retry_policy_backoff_ms(&policy, 0, 0), 0);
+    for (int i = 0; i < 1000; i++) {
+        // Full jitter below the doubled cap, saturating at max_delay
+        CHECK(retry_policy_backoff_ms(&policy, 1, 0) <= 100);
+        CHECK(retry_policy_backoff_ms(&policy, 2, 0) <= 200);
+        CHECK(retry_policy_backoff_ms(&policy, 3, 0) <= 400);
+        CHECK(retry_policy_backoff_ms(&policy, 5, 0) <= 1000);
+        CHECK(retry_policy_backoff_ms(&policy, 200, 0) <= 1000);
+    }
+}
+
+static void test_backoff_spreads(void) {
+    const retry_policy_t policy = { .max_attempts = 3, .base_delay_ms = 1000, .max_delay_ms = 1000 };
+    host_random_seed(7);
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint32_t delay = retry_policy_backoff_ms(&policy, 1, 0);
+        lo = (delay < lo) ? delay : lo;
+        hi = (delay > hi) ? delay : hi;
+    }
+    CHECK(lo < 100);
+    CHECK(hi > 900);
+}
+
+static void test_backoff_retry_after(void) {
+    const retry_policy_t policy = { .max_attempts = 3, .base_delay_ms = 100, .max_delay_ms = 5000 };
+    host_random_seed(1);
+    // A longer Retry-After wins, capped at max_delay
+    CHECK_EQ(retry_policy_backoff_ms(&policy, 1, 3000), 3000);
+    CHECK_EQ(retry_policy_backoff_ms(&policy, 1, 60000), 5000);
+}
+
+static void test_next_and_budget(void) {
+    const retry_policy_t policy = { .max_attempts = 3, .base_delay_ms = 400, .max_delay_ms = 400 };
+    uint32_t delay = 0;
+    retry_budget_reset(1000);
+
+    CHECK(!retry_policy_next(&policy, 1, RETRY_CLASS_PERMANENT, 0, &delay));
+    CHECK(!retry_policy_next(&policy, 1, RETRY_CLASS_SUCCESS, 0, &delay));
+    CHECK(!retry_policy_next(&policy, 3, RETRY_CLASS_TRANSIENT, 0, &delay));
+
+    // Each granted retry takes its delay from the shared budget
+    CHECK(retry_policy_next(&policy, 1, RETRY_CLASS_TRANSIENT, 400, &delay));
+    CHECK_EQ(delay, 400);
+    CHECK_EQ(retry_budget_remaining_ms(), 600);
+    CHECK(retry_policy_next(&policy, 2, RETRY_CLASS_TRANSIENT, 400, &delay));
+    CHECK_EQ(retry_budget_remaining_ms(), 200);
+    CHECK(!retry_policy_next(&policy, 1, RETRY_CLASS_TRANSIENT, 400, &delay));
+
+    retry_budget_charge(150);
+    CHECK_EQ(retry_budget_remaining_ms(), 50);
+    retry_budget_charge(500);
+    CHECK_EQ(retry_budget_remaining_ms(), 0);
+    retry_budget_reset(RETRY_BUDGET_MS);
+}
+
+int main(void) {
+    RUN_TEST(test_classify_transport_errors);
+    RUN_TEST(test_classify_http_status);
+    RUN_TEST(test_parse_retry_after);
+    RUN_TEST(test_backoff_bounds);
+    RUN_TEST(test_backoff_spreads);
+    RUN_TEST(test_backoff_retry_after);
+    RUN_TEST(test_next_and_budget);
+    return TEST_RESULT();
+}
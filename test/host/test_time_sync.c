@@ -0,0 +1,106 @@
+/**
+ * @file test_time_sync.c
+ * @brief Host tests of the hub time offset/drift estimator
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "utils/time_sync.h"
+#include "config/esp32-config.h"
+
+#define HUB_EPOCH_MS    1700000000000ULL
+#define SYNC_PERIOD_MS  (15ULL * 60ULL * 1000ULL)
+
+/**
+ * @brief Run syncs against a local clock with a fixed rate error
+ *
+ * @return Error of the last drift-corrected reading before a sync, in ms
+ */
+static int64_t run_drifting_clock(time_sync_state_t* state, int32_t ppm, int syncs) {
+    uint64_t truth = HUB_EPOCH_MS;
+    uint64_t local = truth - 5000;
+    time_sync_update(state, local, truth);
+    local = truth;
+
+    int64_t error = 0;
+    for (int i = 0; i < syncs; i++) {
+        truth += SYNC_PERIOD_MS;
+        local += SYNC_PERIOD_MS - (int64_t)SYNC_PERIOD_MS * ppm / 1000000;
+        error = (int64_t)(truth - time_sync_correct(state, local));
+        time_sync_update(state, local, truth);
+        local = truth;      // The clock is set at every sync
+    }
+    return error;
+}
+
+static void test_first_sync_sets_offset(void) {
+    time_sync_state_t state = {0};
+    CHECK_EQ(time_sync_correct(&state, HUB_EPOCH_MS), 0);
+    CHECK_EQ(time_sync_update(&state, HUB_EPOCH_MS - 5000, HUB_EPOCH_MS), 5000);
+    CHECK(state.valid);
+    CHECK_EQ(state.sync_ms, HUB_EPOCH_MS);
+    CHECK_EQ(state.drift_samples, 0);
+    // No drift known yet: readings pass through
+    CHECK_EQ(time_sync_correct(&state, HUB_EPOCH_MS + 1234), HUB_EPOCH_MS + 1234);
+}
+
+static void test_learns_slow_clock(void) {
+    time_sync_state_t state = {0};
+    int64_t error = run_drifting_clock(&state, 300, 6);
+    CHECK(state.drift_ppm > 295.0f && state.drift_ppm < 305.0f);
+    CHECK(error >= -2 && error <= 2);
+}
+
+static void test_learns_fast_clock(void) {
+    time_sync_state_t state = {0};
+    int64_t error = run_drifting_clock(&state, -1500, 6);
+    CHECK(state.drift_ppm < -1495.0f && state.drift_ppm > -1505.0f);
+    CHECK(error >= -2 && error <= 2);
+}
+
+static void test_short_interval_keeps_drift(void) {
+    time_sync_state_t state = {0};
+    time_sync_update(&state, HUB_EPOCH_MS, HUB_EPOCH_MS);
+    // Too soon after the last sync for a useful rate: offset only
+    uint64_t local = HUB_EPOCH_MS + (TIME_SYNC_DRIFT_MIN_INTERVAL_SECONDS - 1) * 1000ULL;
+    CHECK_EQ(time_sync_update(&state, local, local + 40), 40);
+    CHECK_EQ(state.drift_samples, 0);
+    CHECK(state.drift_ppm == 0.0f);
+}
+
+static void test_drift_is_clamped(void) {
+    time_sync_state_t state = {0};
+    time_sync_update(&state, HUB_EPOCH_MS, HUB_EPOCH_MS);
+    uint64_t local = HUB_EPOCH_MS + SYNC_PERIOD_MS;
+    time_sync_update(&state, local, local + SYNC_PERIOD_MS);   // 100 % off
+    CHECK(state.drift_ppm == TIME_SYNC_MAX_DRIFT_PPM);
+}
+
+static void test_smooths_outlier(void) {
+    time_sync_state_t state = {0};
+    run_drifting_clock(&state, 200, 4);
+    // One sync with an extra 90 ms offset moves the estimate only partly
+    uint64_t local = state.sync_ms + SYNC_PERIOD_MS;
+    uint64_t truth = local + SYNC_PERIOD_MS * 200 / 1000000 + 90;
+    time_sync_update(&state, local, truth);
+    CHECK(state.drift_ppm > 210.0f && state.drift_ppm < 200.0f + 100.0f);
+}
+
+static void test_apply_rejects_unusable_ack(void) {
+    host_timer_set_us(1000000);
+    CHECK_EQ(time_sync_apply_hub_time(0, 2000, 500, 1000000), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(time_sync_apply_hub_time(HUB_EPOCH_MS, (TIME_SYNC_MAX_RTT_MS + 1) * 1000, 0, 1000000),
+             ESP_ERR_INVALID_RESPONSE);
+    CHECK_EQ(time_sync_get_timestamp_ms(), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_first_sync_sets_offset);
+    RUN_TEST(test_learns_slow_clock);
+    RUN_TEST(test_learns_fast_clock);
+    RUN_TEST(test_short_interval_keeps_drift);
+    RUN_TEST(test_drift_is_clamped);
+    RUN_TEST(test_smooths_outlier);
+    RUN_TEST(test_apply_rejects_unusable_ack);
+    return TEST_RESULT();
+}
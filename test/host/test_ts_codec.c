@@ -0,0 +1,316 @@
+/**
+ * @file test_ts_codec.c
+ * @brief Host tests of the compressed time-series blocks, benchmark on the backlog shapes
+ *
+ * The benchmark encodes the two backlogs the firmware keeps: the MQTT batch
+ * backlog (MQTT_BATCH_BACKLOG_MAX wakes of five fixed-point channels, as in
+ * mqtt_sender.c, and the same with a full ULP sleep backlog) and a flash log
+ * block of ULP readings (timestamp, soil raw ADC, battery raw ADC) filling
+ * HTTP_BUFFER_BLOCK_BYTES. It prints bytes per sample next to the JSON rows
+ * and the raw structs those backlogs would otherwise hold, and ns per sample
+ * to encode and decode.
+ */
+
+#include "test_host.h"
+#include "host_stubs.h"
+#include "utils/ts_codec.h"
+#include "application/mqtt_sender.h"
+#include "config/esp32-config.h"
+#include "esp_random.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLES     64
+#define CHANNELS    3
+
+static uint64_t s_ts[SAMPLES];
+static int32_t s_values[SAMPLES][CHANNELS];
+
+static void make_series(void) {
+    uint64_t ts = 1700000000000ULL;
+    for (int i = 0; i < SAMPLES; i++) {
+        // Regular interval with some jitter, slowly drifting values and a jump
+        ts += 600000 + ((i % 5 == 0) ? 37 : 0);
+        s_ts[i] = ts;
+        s_values[i][0] = 2150 + i / 4;
+        s_values[i][1] = 4012 - (i % 3);
+        s_values[i][2] = (i == 40) ? -123456 : 55;
+    }
+}
+
+static size_t encode(uint8_t* buf, size_t cap, int count) {
+    ts_encoder_t enc;
+    CHECK_EQ(ts_encoder_init(&enc, buf, cap, CHANNELS), ESP_OK);
+    for (int i = 0; i < count; i++) {
+        CHECK_EQ(ts_encoder_add(&enc, s_ts[i], s_values[i]), ESP_OK);
+    }
+    return ts_encoder_finish(&enc);
+}
+
+static void test_round_trip(void) {
+    uint8_t buf[1024];
+    make_series();
+    size_t len = encode(buf, sizeof(buf), SAMPLES);
+    CHECK(len > sizeof(ts_block_header_t));
+    // Far below the raw 8 + 3 * 4 bytes per sample
+    CHECK(len < SAMPLES * 20 / 4);
+
+    ts_block_header_t header;
+    CHECK_EQ(ts_block_read_header(buf, len, &header), ESP_OK);
+    CHECK_EQ(header.count, SAMPLES);
+    CHECK_EQ(header.channels, CHANNELS);
+    CHECK_EQ(header.first_ts_ms, s_ts[0]);
+    CHECK_EQ(header.last_ts_ms, s_ts[SAMPLES - 1]);
+    CHECK_EQ(ts_block_size(&header), len);
+
+    ts_decoder_t dec;
+    CHECK_EQ(ts_decoder_init(&dec, buf, len), ESP_OK);
+    uint64_t ts;
+    int32_t values[CHANNELS];
+    for (int i = 0; i < SAMPLES; i++) {
+        CHECK(ts_decoder_next(&dec, &ts, values));
+        CHECK_EQ(ts, s_ts[i]);
+        CHECK(memcmp(values, s_values[i], sizeof(values)) == 0);
+    }
+    CHECK(!ts_decoder_next(&dec, &ts, values));
+}
+
+static void test_full_block_rolls_back(void) {
+    uint8_t buf[48];
+    ts_encoder_t enc;
+    make_series();
+    CHECK_EQ(ts_encoder_init(&enc, buf, sizeof(buf), CHANNELS), ESP_OK);
+    int added = 0;
+    while (added < SAMPLES && ts_encoder_add(&enc, s_ts[added], s_values[added]) == ESP_OK) {
+        added++;
+    }
+    CHECK(added > 0 && added < SAMPLES);
+    size_t len = ts_encoder_finish(&enc);
+    CHECK(len <= sizeof(buf));
+
+    // The block holds exactly the samples accepted before the full one
+    ts_decoder_t dec;
+    CHECK_EQ(ts_decoder_init(&dec, buf, len), ESP_OK);
+    uint64_t ts;
+    int32_t values[CHANNELS];
+    int decoded = 0;
+    while (ts_decoder_next(&dec, &ts, values)) {
+        CHECK_EQ(ts, s_ts[decoded]);
+        CHECK(memcmp(values, s_values[decoded], sizeof(values)) == 0);
+        decoded++;
+    }
+    CHECK_EQ(decoded, added);
+}
+
+static void test_rejects_bad_input(void) {
+    uint8_t buf[256];
+    ts_encoder_t enc;
+    make_series();
+    CHECK_EQ(ts_encoder_init(&enc, buf, sizeof(buf), 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(ts_encoder_init(&enc, buf, sizeof(buf), TS_CODEC_MAX_CHANNELS + 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(ts_encoder_init(&enc, buf, sizeof(buf), CHANNELS), ESP_OK);
+    CHECK_EQ(ts_encoder_add(&enc, s_ts[5], s_values[5]), ESP_OK);
+    CHECK_EQ(ts_encoder_add(&enc, s_ts[4], s_values[4]), ESP_ERR_INVALID_ARG);
+
+    size_t len = encode(buf, sizeof(buf), 8);
+    ts_block_header_t header;
+    CHECK_EQ(ts_block_read_header(buf, len - 1, &header), ESP_ERR_INVALID_SIZE);
+    buf[0] ^= 0xFF;
+    CHECK_EQ(ts_block_read_header(buf, len, &header), ESP_ERR_INVALID_ARG);
+}
+
+static void test_deterministic(void) {
+    uint8_t a[512], b[512];
+    memset(a, 0x00, sizeof(a));
+    memset(b, 0xFF, sizeof(b));
+    make_series();
+    size_t len_a = encode(a, sizeof(a), 20);
+    size_t len_b = encode(b, sizeof(b), 20);
+    CHECK_EQ(len_a, len_b);
+    CHECK(memcmp(a, b, len_a) == 0);
+}
+
+
+
+
+
+// #####################################
+// MARK: Benchmark
+// #####################################
+
+#define BENCH_SAMPLES       512                             ///< More than a flash log block takes
+#define BENCH_BLOCK_CAP     2048
+#define BENCH_ROUNDS_SAMPLES 2000000                        ///< Samples encoded per timing
+#define START_MS            1700000000000ULL
+
+/**
+ * @brief ULP reading as a flash record without the codec
+ */
+typedef struct {
+    uint64_t ts_ms;
+    uint16_t soil_raw;
+    uint16_t battery_raw;
+} ulp_record_t;
+
+static uint64_t s_bench_ts[BENCH_SAMPLES];
+static int32_t s_bench_values[BENCH_SAMPLES][TS_CODEC_MAX_CHANNELS];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int32_t jitter(int32_t amplitude) {
+    return (int32_t)(esp_random() % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief Hourly wakes as the batch backlog holds them, JSON rows as mqtt_sender.c writes them
+ *
+ * Wake times jitter with boot time, the soil dries slowly, readings carry ADC noise.
+ */
+static size_t make_batch_backlog(size_t count) {
+    size_t json_len = 0;
+    host_random_seed(3);
+    uint64_t ts = START_MS;
+    for (size_t i = 0; i < count; i++) {
+        ts += (uint64_t)DEEP_SLEEP_DURATION_SECONDS * 1000ULL + (uint64_t)(1500 + jitter(400));
+        int raw = 2100 + (int)i / 3 + jitter(4);
+        mqtt_batch_sample_t sample = {
+            .timestamp_ms = ts,
+            .soil_voltage = (float)raw * 3.3f / 4095.0f,
+            .moisture_percent = (2900.0f - (float)raw) / 16.0f,
+            .raw_adc = raw,
+            .battery_voltage = 3.95f - 0.0004f * (float)i + (float)jitter(3) / 1000.0f,
+        };
+        sample.battery_percent = (sample.battery_voltage - 3.3f) / 0.9f * 100.0f;
+
+        // Fixed point as in write_batch_block()
+        s_bench_ts[i] = sample.timestamp_ms;
+        s_bench_values[i][0] = (int32_t)lroundf(sample.soil_voltage * 1000.0f);
+        s_bench_values[i][1] = (int32_t)lroundf(sample.moisture_percent * 100.0f);
+        s_bench_values[i][2] = sample.raw_adc;
+        s_bench_values[i][3] = (int32_t)lroundf(sample.battery_voltage * 1000.0f);
+        s_bench_values[i][4] = (int32_t)lroundf(sample.battery_percent * 10.0f);
+
+        char row[96];
+        json_len += (size_t)snprintf(row, sizeof(row), "%s[%llu,%.3f,%.2f,%d,%.3f,%.1f]", (i > 0) ? "," : "",
+                                     (unsigned long long)sample.timestamp_ms, sample.soil_voltage,
+                                     sample.moisture_percent, sample.raw_adc,
+                                     sample.battery_voltage, sample.battery_percent);
+    }
+    return json_len;
+}
+
+/**
+ * @brief ULP readings on the ULP timer period, JSON rows in the batch style
+ */
+static size_t make_ulp_readings(size_t count) {
+    size_t json_len = 0;
+    host_random_seed(5);
+    for (size_t i = 0; i < count; i++) {
+        s_bench_ts[i] = START_MS + (uint64_t)i * 10ULL * 60ULL * 1000ULL;
+        s_bench_values[i][0] = 2100 + (int32_t)i / 8 + jitter(4);
+        s_bench_values[i][1] = 2450 - (int32_t)i / 40 + jitter(2);
+
+        char row[64];
+        json_len += (size_t)snprintf(row, sizeof(row), "%s[%llu,%ld,%ld]", (i > 0) ? "," : "",
+                                     (unsigned long long)s_bench_ts[i],
+                                     (long)s_bench_values[i][0], (long)s_bench_values[i][1]);
+    }
+    return json_len;
+}
+
+/**
+ * @brief Encode the bench series into buf, as many samples as fit
+ */
+static size_t bench_encode(uint8_t* buf, size_t cap, uint8_t channels, size_t count, size_t* encoded) {
+    ts_encoder_t enc;
+    ts_encoder_init(&enc, buf, cap, channels);
+    size_t n = 0;
+    while (n < count && ts_encoder_add(&enc, s_bench_ts[n], s_bench_values[n]) == ESP_OK) {
+        n++;
+    }
+    *encoded = n;
+    return ts_encoder_finish(&enc);
+}
+
+static void bench_shape(const char* name, uint8_t channels, size_t count, size_t cap,
+                        size_t json_len, size_t raw_size, bool base64) {
+    static uint8_t block[BENCH_BLOCK_CAP];
+    size_t encoded = 0;
+    size_t len = bench_encode(block, cap, channels, count, &encoded);
+    CHECK(encoded > 0);
+
+    // Round trip before timing
+    ts_decoder_t dec;
+    uint64_t ts;
+    int32_t values[TS_CODEC_MAX_CHANNELS];
+    CHECK_EQ(ts_decoder_init(&dec, block, len), ESP_OK);
+    for (size_t i = 0; i < encoded; i++) {
+        CHECK(ts_decoder_next(&dec, &ts, values));
+        CHECK_EQ(ts, s_bench_ts[i]);
+        CHECK(memcmp(values, s_bench_values[i], channels * sizeof(int32_t)) == 0);
+    }
+
+    size_t rounds = BENCH_ROUNDS_SAMPLES / encoded;
+    uint64_t start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        size_t n;
+        bench_encode(block, cap, channels, encoded, &n);
+    }
+    double encode_ns = (double)(now_ns() - start) / (double)(rounds * encoded);
+
+    uint64_t sum = 0;
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        ts_decoder_init(&dec, block, len);
+        while (ts_decoder_next(&dec, &ts, values)) {
+            sum += ts + (uint64_t)values[0];
+        }
+    }
+    double decode_ns = (double)(now_ns() - start) / (double)(rounds * encoded);
+    CHECK(sum != 0);
+
+    double block_per_sample = (double)len / (double)encoded;
+    char wire[32] = "";
+    if (base64) {
+        snprintf(wire, sizeof(wire), " (base64 %.2f)", (double)((len + 2) / 3 * 4) / (double)encoded);
+    }
+    printf("bench: %-21s %3zu samples, block %5.2f B/sample%s, JSON %5.2f, raw struct %zu; "
+           "encode %5.1f ns/sample, decode %5.1f ns/sample\n",
+           name, encoded, block_per_sample, wire, (double)json_len / (double)count, raw_size,
+           encode_ns, decode_ns);
+    CHECK(block_per_sample < (double)raw_size);
+}
+
+static void bench_backlog_shapes(void) {
+    size_t json_len = make_batch_backlog(MQTT_BATCH_BACKLOG_MAX);
+    bench_shape("MQTT batch backlog", 5, MQTT_BATCH_BACKLOG_MAX, BENCH_BLOCK_CAP, json_len,
+                sizeof(mqtt_batch_sample_t), true);
+
+    json_len = make_batch_backlog(8 + ULP_SAMPLER_RING_LEN);
+    bench_shape("MQTT backlog with ULP", 5, 8 + ULP_SAMPLER_RING_LEN, BENCH_BLOCK_CAP, json_len,
+                sizeof(mqtt_batch_sample_t), true);
+
+    // As many readings as one flash log block takes
+    json_len = make_ulp_readings(BENCH_SAMPLES);
+    size_t encoded = 0;
+    uint8_t block[HTTP_BUFFER_BLOCK_BYTES];
+    bench_encode(block, sizeof(block), 2, BENCH_SAMPLES, &encoded);
+    CHECK(encoded < BENCH_SAMPLES);
+    json_len = make_ulp_readings(encoded);
+    bench_shape("flash log ULP block", 2, encoded, HTTP_BUFFER_BLOCK_BYTES, json_len, sizeof(ulp_record_t), false);
+}
+
+int main(void) {
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_full_block_rolls_back);
+    RUN_TEST(test_rejects_bad_input);
+    RUN_TEST(test_deterministic);
+    RUN_TEST(bench_backlog_shapes);
+    return TEST_RESULT();
+}